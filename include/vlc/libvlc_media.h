@@ -278,6 +278,11 @@ typedef enum libvlc_media_parse_flag_t
      * when the input is asking for credentials.
      */
     libvlc_media_do_interact    = 0x08,
+    /**
+     * Parse this media before the media parsed without this flag, for
+     * instance because it is shown to the user.
+     */
+    libvlc_media_parse_interactive = 0x10,
 } libvlc_media_parse_flag_t;
 
 /**
@@ -230,6 +230,44 @@ static inline block_t *block_Duplicate( const block_t *p_block )
     return p_dup;
 }
 
+/**
+ * Shares a block payload.
+ *
+ * Creates a new reference to the payload of a block, without copying it.
+ * Both blocks have their own properties (flags, timestamps and payload
+ * bounds), but the payload itself becomes read-only for all its users:
+ * block_Realloc() and block_TryRealloc() make a private copy of a shared
+ * payload, and block_Unshare() must be used before modifying it in place.
+ *
+ * The first time a block is shared, it is replaced with an equivalent shared
+ * block, hence the pointer to pointer.
+ *
+ * @param pp_block pointer to the block to share [IN/OUT]
+ * @return the new reference on success, NULL on error (in that case,
+ * *pp_block is left untouched).
+ */
+VLC_API block_t *block_Share(block_t **pp_block) VLC_USED;
+
+/**
+ * Checks whether the payload of a block is shared.
+ *
+ * @return true if the payload is referenced by other blocks and must not
+ * be modified in place.
+ */
+VLC_API bool block_IsShared(const block_t *block) VLC_USED;
+
+/**
+ * Makes a block payload writable.
+ *
+ * Returns the block unchanged if its payload is not shared. Otherwise,
+ * the payload is copied (unless this is its last reference) and the
+ * reference is released.
+ *
+ * @return a block with a writable payload, or NULL on memory error (in that
+ * case, the block is released).
+ */
+VLC_API block_t *block_Unshare(block_t *block) VLC_USED;
+
 /**
  * Wraps heap in a block.
  *
@@ -637,6 +637,33 @@ vlc_playlist_Sort(vlc_playlist_t *playlist,
                   const struct vlc_playlist_sort_criterion criteria[],
                   size_t count);
 
+/**
+ * Begin a batch of changes.
+ *
+ * Until the matching vlc_playlist_EndBatch(), consecutive insertions forming
+ * a single slice are notified by a single on_items_added() event (and
+ * similarly for removals), and the current index, has_prev and has_next
+ * changes are notified once at the end.
+ *
+ * This is useful to add or remove many items by chunks, for example while
+ * loading a large playlist.
+ *
+ * Batches may be nested. The playlist must remain locked until the end of
+ * the batch.
+ *
+ * \param playlist the playlist, locked
+ */
+VLC_API void
+vlc_playlist_BeginBatch(vlc_playlist_t *playlist);
+
+/**
+ * End a batch of changes, and notify the pending changes.
+ *
+ * \param playlist the playlist, locked
+ */
+VLC_API void
+vlc_playlist_EndBatch(vlc_playlist_t *playlist);
+
 /**
  * Return the index of a given item.
  *
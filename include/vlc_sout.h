@@ -87,6 +87,8 @@ enum access_out_query_e
 {
     ACCESS_OUT_CONTROLS_PACE, /* arg1=bool *, can fail (assume true) */
     ACCESS_OUT_CAN_SEEK, /* arg1=bool *, can fail (assume false) */
+    ACCESS_OUT_GET_FD, /* arg1=int *, can fail; data written directly to the
+                          descriptor goes at its current file offset */
 };
 
 VLC_API sout_access_out_t * sout_AccessOutNew( vlc_object_t *, const char *psz_access, const char *psz_name ) VLC_USED;
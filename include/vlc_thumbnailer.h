@@ -112,6 +112,91 @@ vlc_thumbnailer_RequestByPos( vlc_thumbnailer_t *thumbnailer,
                               input_item_t *input_item, vlc_tick_t timeout,
                               vlc_thumbnailer_cb cb, void* user_data );
 
+/**
+ * Set of thumbnails taken at regular intervals, e.g. for seek bar previews
+ */
+typedef struct vlc_thumbnailer_storyboard_t
+{
+    /** Number of thumbnails */
+    size_t count;
+    /** Thumbnails, by increasing time */
+    picture_t **thumbnails;
+    /** Media time of each thumbnail */
+    vlc_tick_t *times;
+    /** Requested time between two thumbnails */
+    vlc_tick_t interval;
+    /** Media length, or VLC_TICK_INVALID if unknown */
+    vlc_tick_t length;
+
+    /**
+     * Sprite sheet (VLC_CODEC_RGBA), with the thumbnails from left to right
+     * then top to bottom, or NULL if none was requested
+     */
+    picture_t *sheet;
+    unsigned columns;
+    unsigned rows;
+    unsigned tile_width;
+    unsigned tile_height;
+} vlc_thumbnailer_storyboard_t;
+
+/**
+ * \brief vlc_thumbnailer_storyboard_cb defines a callback invoked on
+ * storyboard completion or error
+ *
+ * The storyboard and its pictures are owned by the thumbnailer, and are only
+ * valid within the callback scope (pictures can be held with
+ * \link picture_Hold \endlink).
+ *
+ * \param data Is the opaque pointer passed to vlc_thumbnailer_RequestStoryboard
+ * \param storyboard The storyboard, or NULL in case of failure or timeout
+ */
+typedef void(*vlc_thumbnailer_storyboard_cb)( void* data,
+                        const vlc_thumbnailer_storyboard_t* storyboard );
+
+/**
+ * \brief vlc_thumbnailer_RequestStoryboard Requests thumbnails at regular
+ * intervals
+ * \param thumbnailer A thumbnailer object
+ * \param input_item The input item to generate the thumbnails for
+ * \param interval The time between two thumbnails
+ * \param max_count The maximum number of thumbnails, or 0 for no limit
+ * \param tile_width The width of a sprite sheet tile, or 0 for no sprite sheet
+ * \param columns The number of tiles per sprite sheet row, or 0 for a default
+ * \param timeout A timeout value, or VLC_TICK_INVALID to disable timeout
+ * \param cb A user callback to be called on completion (success & error)
+ * \param user_data An opaque value, provided as cb's first parameter
+ * \return An opaque request object, or NULL in case of failure
+ *
+ * The thumbnails are taken in a single pass over the media, from one key
+ * frame to the next: each thumbnail is the key frame before its time (or the
+ * next one, if that was already used by the previous thumbnail), so times
+ * are approximate. Thumbnails after the end of the media are omitted.
+ *
+ * Several storyboard requests are processed in parallel. Otherwise, the
+ * request follows the same rules as \ref vlc_thumbnailer_RequestByTime, and
+ * can be cancelled with \ref vlc_thumbnailer_Cancel.
+ */
+VLC_API vlc_thumbnailer_request_t*
+vlc_thumbnailer_RequestStoryboard( vlc_thumbnailer_t *thumbnailer,
+                                   input_item_t *input_item,
+                                   vlc_tick_t interval, unsigned max_count,
+                                   unsigned tile_width, unsigned columns,
+                                   vlc_tick_t timeout,
+                                   vlc_thumbnailer_storyboard_cb cb,
+                                   void* user_data );
+
+/**
+ * \brief vlc_thumbnailer_storyboard_WebVTT Writes a sprite sheet index
+ * \param storyboard A storyboard with a sprite sheet
+ * \param sheet_url The URL the sprite sheet will be published at
+ * \return A WebVTT document with one cue per thumbnail, pointing to its
+ * tile with a media fragment (#xywh=), or NULL on error. It must be freed.
+ */
+VLC_API char*
+vlc_thumbnailer_storyboard_WebVTT( const vlc_thumbnailer_storyboard_t* storyboard,
+                                   const char* sheet_url )
+VLC_USED;
+
 /**
  * \brief vlc_thumbnailer_Cancel Cancel a thumbnail request
  * \param thumbnailer A thumbnailer object
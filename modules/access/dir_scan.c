@@ -0,0 +1,387 @@
+/*****************************************************************************
+ * dir_scan.c: directory listing with parallel stat
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+#include <vlc_interrupt.h>
+
+#include "dir_scan.h"
+
+/* The file names must go through vlc_readdir() and vlc_stat() where they are
+ * converted from/to the system charset (Windows and OS/2). */
+#if defined(DT_UNKNOWN) && !defined(_WIN32) && !defined(__OS2__)
+# define HAVE_DIRENT_TYPE 1
+#endif
+#if defined(HAVE_OPENAT) && !defined(_WIN32) && !defined(__OS2__)
+# define HAVE_STAT_AT 1
+#endif
+
+#define DIR_SCAN_MAX_THREADS 16
+/* Minimum number of pending stat() per thread worth starting it */
+#define DIR_SCAN_MIN_BATCH 8
+
+enum
+{
+    ENTRY_PENDING, /* needs a stat() */
+    ENTRY_TAKEN, /* stat() in progress */
+    ENTRY_DONE,
+    ENTRY_FAILED,
+};
+
+struct dir_scan_entry
+{
+    char *name;
+    mode_t mode;
+    unsigned char state;
+};
+
+struct vlc_dir_scan
+{
+    DIR *dir;
+    char *path;
+
+    struct dir_scan_entry *entries;
+    size_t count;
+    size_t current; /* next entry to return */
+    size_t next; /* next entry for the threads to look at */
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait_done;
+    bool closing;
+    bool interrupted;
+
+    unsigned thread_count;
+    vlc_thread_t threads[DIR_SCAN_MAX_THREADS];
+
+    struct vlc_dir_scan_stats stats;
+};
+
+static int dir_scan_Stat(struct vlc_dir_scan *scan, const char *name,
+                         mode_t *modep)
+{
+    struct stat st;
+
+#ifdef HAVE_STAT_AT
+    if (fstatat(dirfd(scan->dir), name, &st, 0))
+        return -1;
+#else
+    char *path;
+
+    if (asprintf(&path, "%s"DIR_SEP"%s", scan->path, name) == -1)
+        return -1;
+
+    int val = vlc_stat(path, &st);
+    free(path);
+    if (val)
+        return -1;
+#endif
+    *modep = st.st_mode & S_IFMT;
+    return 0;
+}
+
+/* Resolves a taken entry. Called without the lock. */
+static void dir_scan_Resolve(struct vlc_dir_scan *scan,
+                             struct dir_scan_entry *e)
+{
+    mode_t mode;
+    int val = dir_scan_Stat(scan, e->name, &mode);
+
+    vlc_mutex_lock(&scan->lock);
+    assert(e->state == ENTRY_TAKEN);
+    if (val == 0)
+    {
+        e->mode = mode;
+        e->state = ENTRY_DONE;
+    }
+    else
+    {
+        e->state = ENTRY_FAILED;
+        scan->stats.failed++;
+    }
+    vlc_cond_broadcast(&scan->wait_done);
+    vlc_mutex_unlock(&scan->lock);
+}
+
+static void *dir_scan_Run(void *data)
+{
+    struct vlc_dir_scan *scan = data;
+
+    vlc_mutex_lock(&scan->lock);
+    while (!scan->closing)
+    {
+        /* Entries are taken in directory order, so that the reader finds
+         * the first ones resolved first. The reader may take some too. */
+        while (scan->next < scan->count
+            && scan->entries[scan->next].state != ENTRY_PENDING)
+            scan->next++;
+        if (scan->next >= scan->count)
+            break;
+
+        struct dir_scan_entry *e = &scan->entries[scan->next++];
+
+        e->state = ENTRY_TAKEN;
+        vlc_mutex_unlock(&scan->lock);
+        dir_scan_Resolve(scan, e);
+        vlc_mutex_lock(&scan->lock);
+    }
+    vlc_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+static int dir_scan_Append(struct vlc_dir_scan *scan, size_t *allocp,
+                           const char *name, mode_t mode, bool known)
+{
+    if (scan->count == *allocp)
+    {
+        size_t alloc = *allocp ? 2 * *allocp : 64;
+        struct dir_scan_entry *entries =
+            realloc(scan->entries, alloc * sizeof (*entries));
+        if (unlikely(entries == NULL))
+            return -1;
+        scan->entries = entries;
+        *allocp = alloc;
+    }
+
+    struct dir_scan_entry *e = &scan->entries[scan->count];
+
+    e->name = strdup(name);
+    if (unlikely(e->name == NULL))
+        return -1;
+    e->mode = mode;
+    e->state = known ? ENTRY_DONE : ENTRY_PENDING;
+    scan->count++;
+    return 0;
+}
+
+/* Reads all the names, with their type if the file system tells it. */
+static int dir_scan_ReadNames(struct vlc_dir_scan *scan)
+{
+    size_t alloc = 0;
+    unsigned pending = 0;
+
+#ifdef HAVE_DIRENT_TYPE
+    struct dirent *ent;
+
+    while ((ent = readdir(scan->dir)) != NULL)
+    {
+        const char *name = ent->d_name;
+        mode_t mode = 0;
+
+        switch (ent->d_type)
+        {
+            case DT_REG:  mode = S_IFREG;  break;
+            case DT_DIR:  mode = S_IFDIR;  break;
+            case DT_BLK:  mode = S_IFBLK;  break;
+            case DT_CHR:  mode = S_IFCHR;  break;
+            case DT_FIFO: mode = S_IFIFO;  break;
+# ifdef S_IFSOCK
+            case DT_SOCK: mode = S_IFSOCK; break;
+# endif
+            default: /* DT_LNK must be followed; DT_UNKNOWN */
+                break;
+        }
+#else
+    const char *name;
+
+    while ((name = vlc_readdir(scan->dir)) != NULL)
+    {
+        mode_t mode = 0;
+#endif
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+        if (dir_scan_Append(scan, &alloc, name, mode, mode != 0))
+            return -1;
+        if (mode == 0)
+            pending++;
+    }
+
+    scan->stats.entries = scan->count;
+    scan->stats.stats = pending;
+    return pending;
+}
+
+struct vlc_dir_scan *vlc_dir_scan_New(DIR *dir, const char *path,
+                                      unsigned threads)
+{
+    struct vlc_dir_scan *scan = malloc(sizeof (*scan));
+    if (unlikely(scan == NULL))
+        return NULL;
+
+    scan->dir = dir;
+    scan->path = (path != NULL) ? strdup(path) : NULL;
+    scan->entries = NULL;
+    scan->count = 0;
+    scan->current = 0;
+    scan->next = 0;
+    scan->closing = false;
+    scan->thread_count = 0;
+    memset(&scan->stats, 0, sizeof (scan->stats));
+
+    int pending = dir_scan_ReadNames(scan);
+    if (pending < 0 || (path != NULL && scan->path == NULL))
+    {
+        for (size_t i = 0; i < scan->count; i++)
+            free(scan->entries[i].name);
+        free(scan->entries);
+        free(scan->path);
+        free(scan);
+        return NULL;
+    }
+
+    vlc_mutex_init(&scan->lock);
+    vlc_cond_init(&scan->wait_done);
+
+    /* Do not bother with threads for a handful of stat() calls: the reader
+     * resolves those itself. */
+    if (threads > (unsigned)pending / DIR_SCAN_MIN_BATCH)
+        threads = pending / DIR_SCAN_MIN_BATCH;
+    if (threads > DIR_SCAN_MAX_THREADS)
+        threads = DIR_SCAN_MAX_THREADS;
+
+    while (scan->thread_count < threads)
+    {
+        if (vlc_clone(&scan->threads[scan->thread_count], dir_scan_Run, scan,
+                      VLC_THREAD_PRIORITY_LOW))
+            break; /* the reader will do the rest */
+        scan->thread_count++;
+    }
+    return scan;
+}
+
+void vlc_dir_scan_Delete(struct vlc_dir_scan *scan)
+{
+    vlc_mutex_lock(&scan->lock);
+    scan->closing = true;
+    vlc_mutex_unlock(&scan->lock);
+
+    for (unsigned i = 0; i < scan->thread_count; i++)
+        vlc_join(scan->threads[i], NULL);
+
+    vlc_cond_destroy(&scan->wait_done);
+    vlc_mutex_destroy(&scan->lock);
+    for (size_t i = 0; i < scan->count; i++)
+        free(scan->entries[i].name);
+    free(scan->entries);
+    free(scan->path);
+    free(scan);
+}
+
+static void dir_scan_WakeUp(void *data)
+{
+    struct vlc_dir_scan *scan = data;
+
+    vlc_mutex_lock(&scan->lock);
+    scan->interrupted = true;
+    vlc_cond_broadcast(&scan->wait_done);
+    vlc_mutex_unlock(&scan->lock);
+}
+
+/* Waits for a thread to resolve an entry. Called with the lock held. */
+static int dir_scan_Wait(struct vlc_dir_scan *scan,
+                         const struct dir_scan_entry *e)
+{
+    vlc_tick_t start = vlc_tick_now();
+
+    scan->interrupted = false;
+    vlc_mutex_unlock(&scan->lock);
+    vlc_interrupt_register(dir_scan_WakeUp, scan);
+    vlc_mutex_lock(&scan->lock);
+
+    while (e->state == ENTRY_TAKEN && !scan->interrupted)
+        vlc_cond_wait(&scan->wait_done, &scan->lock);
+
+    vlc_mutex_unlock(&scan->lock);
+    vlc_interrupt_unregister();
+    vlc_mutex_lock(&scan->lock);
+
+    scan->stats.blocked += vlc_tick_now() - start;
+
+    if (e->state == ENTRY_TAKEN)
+    {
+        errno = EINTR;
+        return -1;
+    }
+    return 0;
+}
+
+int vlc_dir_scan_Next(struct vlc_dir_scan *scan, const char **namep,
+                      mode_t *modep)
+{
+    int ret = 0;
+
+    vlc_mutex_lock(&scan->lock);
+    while (scan->current < scan->count)
+    {
+        struct dir_scan_entry *e = &scan->entries[scan->current];
+
+        switch (e->state)
+        {
+            case ENTRY_PENDING:
+                /* Not taken by any thread yet: faster to do it here */
+                e->state = ENTRY_TAKEN;
+                vlc_mutex_unlock(&scan->lock);
+                dir_scan_Resolve(scan, e);
+                vlc_mutex_lock(&scan->lock);
+                continue;
+
+            case ENTRY_TAKEN:
+                if (dir_scan_Wait(scan, e))
+                {
+                    ret = -1;
+                    goto out;
+                }
+                continue;
+
+            case ENTRY_DONE:
+                *namep = e->name;
+                *modep = e->mode;
+                scan->current++;
+                ret = 1;
+                goto out;
+
+            case ENTRY_FAILED:
+                scan->current++;
+                continue;
+        }
+        vlc_assert_unreachable();
+    }
+out:
+    vlc_mutex_unlock(&scan->lock);
+    return ret;
+}
+
+void vlc_dir_scan_GetStats(struct vlc_dir_scan *scan,
+                           struct vlc_dir_scan_stats *stats)
+{
+    vlc_mutex_lock(&scan->lock);
+    *stats = scan->stats;
+    vlc_mutex_unlock(&scan->lock);
+}
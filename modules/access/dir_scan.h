@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * dir_scan.h: directory listing with parallel stat
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_ACCESS_DIR_SCAN_H
+#define VLC_ACCESS_DIR_SCAN_H
+
+#include <sys/types.h>
+
+/**
+ * Directory listing engine.
+ *
+ * Reads all the names of a directory stream up front, then resolves the
+ * type of each entry. The type reported by readdir() is used whenever the
+ * file system provides it, so that most entries need no stat() at all.
+ * The remaining entries (symbolic links, or file systems without entry
+ * types) are stat()'ed by a small pool of threads, which hides the round
+ * trip of each stat() on network mounts.
+ *
+ * Entries are returned in directory order, as soon as each one is
+ * resolved, while the threads keep working on the following ones.
+ *
+ * All functions must be called from the same thread.
+ */
+struct vlc_dir_scan;
+
+struct vlc_dir_scan_stats
+{
+    unsigned entries; /**< entries read from the directory */
+    unsigned stats;   /**< entries that needed a stat() */
+    unsigned failed;  /**< entries whose stat() failed (skipped) */
+    vlc_tick_t blocked; /**< time spent waiting in vlc_dir_scan_Next() */
+};
+
+/**
+ * Creates a listing engine and reads the directory names.
+ *
+ * \param dir directory stream (not owned)
+ * \param path directory path, used if stat() cannot be relative to the
+ *             directory stream
+ * \param threads maximum number of stat() threads (0 for none)
+ * \return an engine, or NULL on memory error
+ */
+struct vlc_dir_scan *vlc_dir_scan_New(DIR *dir, const char *path,
+                                      unsigned threads);
+
+/**
+ * Destroys a listing engine.
+ *
+ * Waits for stat() calls in progress.
+ */
+void vlc_dir_scan_Delete(struct vlc_dir_scan *);
+
+/**
+ * Gets the next directory entry.
+ *
+ * Waits for the entry to be resolved if needed. Symbolic links are
+ * followed. Entries that cannot be resolved (e.g. dangling links) and the
+ * "." and ".." entries are skipped.
+ * The wait can be interrupted with vlc_interrupt_kill().
+ *
+ * \param namep where to store the entry name, valid until the engine is
+ *              destroyed [OUT]
+ * \param modep where to store the file type bits (S_IFMT) [OUT]
+ * \retval 1 an entry was returned
+ * \retval 0 end of the directory
+ * \retval -1 interrupted (errno is set to EINTR)
+ */
+int vlc_dir_scan_Next(struct vlc_dir_scan *, const char **namep,
+                      mode_t *modep);
+
+void vlc_dir_scan_GetStats(struct vlc_dir_scan *,
+                           struct vlc_dir_scan_stats *);
+
+#endif
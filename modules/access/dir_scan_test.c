@@ -0,0 +1,289 @@
+/*****************************************************************************
+ * dir_scan_test.c: directory listing test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Lists a synthetic tree of files, directories and symbolic links, checks
+ * the reported types, and compares the time to walk the tree with a plain
+ * readdir() and stat() loop.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "dir_scan.h"
+
+#define DIRS  16
+#define FILES 1000 /* per directory, a quarter being symbolic links */
+
+static char root[] = "/tmp/vlc-dir-scan-XXXXXX";
+
+static void make_path(char *buf, size_t size, unsigned d, const char *name)
+{
+    int len = snprintf(buf, size, "%s/d%02u%s%s", root, d,
+                       name != NULL ? "/" : "", name != NULL ? name : "");
+    assert(len > 0 && (size_t)len < size);
+}
+
+static void create_tree(void)
+{
+    char path[256], target[256];
+
+    assert(mkdtemp(root) != NULL);
+
+    for (unsigned d = 0; d < DIRS; d++)
+    {
+        make_path(path, sizeof (path), d, NULL);
+        assert(mkdir(path, 0700) == 0);
+
+        for (unsigned i = 0; i < FILES; i++)
+        {
+            char name[32];
+
+            snprintf(name, sizeof (name), "f%04u.mkv", i);
+            make_path(path, sizeof (path), d, name);
+
+            if (i % 4 != 3)
+            {
+                int fd = open(path, O_WRONLY|O_CREAT|O_EXCL, 0600);
+                assert(fd != -1);
+                close(fd);
+                continue;
+            }
+
+            /* Links to a file, to a directory, and one dangling link */
+            if (i == 3)
+                snprintf(target, sizeof (target), "nowhere");
+            else if (i % 8 == 3)
+                snprintf(target, sizeof (target), "../d%02u", (d + 1) % DIRS);
+            else
+                snprintf(target, sizeof (target), "f%04u.mkv", i - 1);
+            assert(symlink(target, path) == 0);
+        }
+    }
+}
+
+static void remove_tree(void)
+{
+    char path[256];
+
+    for (unsigned d = 0; d < DIRS; d++)
+    {
+        for (unsigned i = 0; i < FILES; i++)
+        {
+            char name[32];
+
+            snprintf(name, sizeof (name), "f%04u.mkv", i);
+            make_path(path, sizeof (path), d, name);
+            unlink(path);
+        }
+        make_path(path, sizeof (path), d, NULL);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+static mode_t expected_mode(unsigned i)
+{
+    if (i % 4 != 3)
+        return S_IFREG;
+    return (i % 8 == 3) ? S_IFDIR : S_IFREG;
+}
+
+static void test_list(unsigned d, unsigned threads)
+{
+    char path[256];
+    unsigned char seen[FILES] = { 0 };
+    const char *name;
+    mode_t mode;
+    int val;
+
+    make_path(path, sizeof (path), d, NULL);
+
+    DIR *dir = vlc_opendir(path);
+    assert(dir != NULL);
+
+    struct vlc_dir_scan *scan = vlc_dir_scan_New(dir, path, threads);
+    assert(scan != NULL);
+
+    while ((val = vlc_dir_scan_Next(scan, &name, &mode)) > 0)
+    {
+        unsigned i;
+
+        assert(sscanf(name, "f%04u.mkv", &i) == 1 && i < FILES);
+        assert(!seen[i]);
+        seen[i] = 1;
+        assert(mode == expected_mode(i));
+    }
+    assert(val == 0);
+    assert(vlc_dir_scan_Next(scan, &name, &mode) == 0);
+
+    for (unsigned i = 0; i < FILES; i++)
+        assert(seen[i] == (i != 3)); /* the dangling link is skipped */
+
+    struct vlc_dir_scan_stats stats;
+    vlc_dir_scan_GetStats(scan, &stats);
+    assert(stats.entries == FILES);
+    assert(stats.failed == 1);
+    assert(stats.stats >= FILES / 4);
+    vlc_dir_scan_Delete(scan);
+    closedir(dir);
+}
+
+/* The listing is abandoned while the threads are still busy */
+static void test_abandon(void)
+{
+    char path[256];
+    const char *name;
+    mode_t mode;
+
+    make_path(path, sizeof (path), 0, NULL);
+
+    DIR *dir = vlc_opendir(path);
+    assert(dir != NULL);
+
+    struct vlc_dir_scan *scan = vlc_dir_scan_New(dir, path, 8);
+    assert(scan != NULL);
+    assert(vlc_dir_scan_Next(scan, &name, &mode) == 1);
+    vlc_dir_scan_Delete(scan);
+    closedir(dir);
+}
+
+/* Walks the top directory and its subdirectories */
+static unsigned walk_scan(const char *path, unsigned threads, bool top)
+{
+    DIR *dir = vlc_opendir(path);
+    assert(dir != NULL);
+
+    struct vlc_dir_scan *scan = vlc_dir_scan_New(dir, path, threads);
+    assert(scan != NULL);
+
+    const char *name;
+    mode_t mode;
+    unsigned count = 0;
+
+    while (vlc_dir_scan_Next(scan, &name, &mode) > 0)
+    {
+        count++;
+        if (top && mode == S_IFDIR)
+        {
+            char *sub;
+
+            assert(asprintf(&sub, "%s/%s", path, name) != -1);
+            count += walk_scan(sub, threads, false);
+            free(sub);
+        }
+    }
+    vlc_dir_scan_Delete(scan);
+    closedir(dir);
+    return count;
+}
+
+/* As the directory access used to do it */
+static unsigned walk_stat(const char *path, bool top)
+{
+    DIR *dir = vlc_opendir(path);
+    assert(dir != NULL);
+
+    const char *name;
+    unsigned count = 0;
+
+    while ((name = vlc_readdir(dir)) != NULL)
+    {
+        struct stat st;
+
+        if (!strcmp(name, ".") || !strcmp(name, "..")
+         || fstatat(dirfd(dir), name, &st, 0))
+            continue;
+        count++;
+        if (top && S_ISDIR(st.st_mode))
+        {
+            char *sub;
+
+            assert(asprintf(&sub, "%s/%s", path, name) != -1);
+            count += walk_stat(sub, false);
+            free(sub);
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static void bench_report(const char *name, unsigned count, vlc_tick_t elapsed)
+{
+    printf("%-22s %6u entries in %5"PRId64" us\n", name, count,
+           US_FROM_VLC_TICK(elapsed));
+}
+
+int main(void)
+{
+    create_tree();
+
+    for (unsigned d = 0; d < DIRS; d += 5)
+    {
+        test_list(d, 0);
+        test_list(d, 1);
+        test_list(d, 8);
+    }
+    test_abandon();
+
+    /* Everything but the dangling links */
+    const unsigned total = DIRS + DIRS * (FILES - 1);
+    vlc_tick_t start;
+    unsigned count;
+
+    start = vlc_tick_now();
+    count = walk_stat(root, true);
+    assert(count == total);
+    bench_report("readdir()+stat()", count, vlc_tick_now() - start);
+
+    start = vlc_tick_now();
+    count = walk_scan(root, 0, true);
+    assert(count == total);
+    bench_report("scan, no threads", count, vlc_tick_now() - start);
+
+    for (unsigned threads = 2; threads <= 8; threads *= 2)
+    {
+        char name[32];
+
+        start = vlc_tick_now();
+        count = walk_scan(root, threads, true);
+        assert(count == total);
+        snprintf(name, sizeof (name), "scan, %u threads", threads);
+        bench_report(name, count, vlc_tick_now() - start);
+    }
+
+    remove_tree();
+    return 0;
+}
@@ -31,11 +31,11 @@
 # include "config.h"
 #endif
 
-#include <limits.h>
 #include <sys/stat.h>
 
 #include <vlc_common.h>
 #include "fs.h"
+#include "dir_scan.h"
 #include <vlc_access.h>
 #include <vlc_input_item.h>
 
@@ -113,29 +113,29 @@ int DirRead (stream_t *access, input_item_node_t *node)
 {
     access_sys_t *sys = access->p_sys;
     const char *entry;
-    int ret = VLC_SUCCESS;
+    mode_t mode;
+    int ret = VLC_SUCCESS, val;
 
     bool special_files = var_InheritBool(access, "list-special-files");
+    unsigned threads = var_InheritInteger(access, "directory-stat-threads");
+
+    /* Entries are added as soon as their type is known, while the
+     * remaining ones are stat()'ed in the background. */
+    struct vlc_dir_scan *scan = vlc_dir_scan_New(sys->dir,
+                                                 access->psz_filepath,
+                                                 threads);
+    if (unlikely(scan == NULL))
+        return VLC_ENOMEM;
 
     struct vlc_readdir_helper rdh;
     vlc_readdir_helper_init(&rdh, access, node);
 
-    while (ret == VLC_SUCCESS && (entry = vlc_readdir(sys->dir)) != NULL)
+    while (ret == VLC_SUCCESS
+        && (val = vlc_dir_scan_Next(scan, &entry, &mode)) > 0)
     {
-        struct stat st;
         int type;
 
-#ifdef HAVE_OPENAT
-        if (fstatat(dirfd(sys->dir), entry, &st, 0))
-            continue;
-#else
-        char path[PATH_MAX];
-
-        if (snprintf(path, PATH_MAX, "%s"DIR_SEP"%s", access->psz_filepath,
-                     entry) >= PATH_MAX || vlc_stat(path, &st))
-            continue;
-#endif
-        switch (st.st_mode & S_IFMT)
+        switch (mode)
         {
             case S_IFBLK:
                 if (!special_files)
@@ -186,6 +186,15 @@ int DirRead (stream_t *access, input_item_node_t *node)
         free(uri);
     }
 
+    if (ret == VLC_SUCCESS && val < 0)
+        ret = VLC_EGENERIC; /* interrupted */
+
+    struct vlc_dir_scan_stats stats;
+    vlc_dir_scan_GetStats(scan, &stats);
+    msg_Dbg(access, "%u entries, %u stat() calls, %"PRId64" ms blocked",
+            stats.entries, stats.stats, MS_FROM_VLC_TICK(stats.blocked));
+    vlc_dir_scan_Delete(scan);
+
     vlc_readdir_helper_finish(&rdh, ret == VLC_SUCCESS);
 
     return ret;
@@ -63,10 +63,18 @@
 #include <vlc_fs.h>
 #include <vlc_url.h>
 #include <vlc_interrupt.h>
+#if !defined (_WIN32) && !defined (__OS2__)
+# include <vlc_block.h>
+# include "file_aio.h"
+# define HAVE_FILE_AIO 1
+#endif
 
 typedef struct
 {
     int fd;
+#ifdef HAVE_FILE_AIO
+    struct vlc_file_aio *aio;
+#endif
 
     bool b_pace_control;
 } access_sys_t;
@@ -129,6 +137,41 @@ static bool IsRemote (const char *path)
 
 static ssize_t Read (stream_t *, void *, size_t);
 static int FileSeek (stream_t *, uint64_t);
+#ifdef HAVE_FILE_AIO
+static block_t *AsyncBlock (stream_t *, bool *);
+static int AsyncSeek (stream_t *, uint64_t);
+
+/* Sets up asynchronous read-ahead on a regular file, if enabled */
+static struct vlc_file_aio *AsyncOpen (stream_t *p_access, int fd)
+{
+    unsigned depth = var_InheritInteger (p_access, "file-read-ahead");
+    if (depth == 0)
+        return NULL;
+
+    /* Reads are aligned to whole pages */
+    size_t size = (var_InheritInteger (p_access, "file-read-size") << 10)
+                  & ~(size_t)4095;
+    off_t offset = lseek (fd, 0, SEEK_CUR);
+    if (offset == (off_t)-1 || size == 0)
+        return NULL;
+
+    /* Network file systems have a higher latency to cover */
+    if (IsRemote (fd, p_access->psz_filepath))
+        depth *= 2;
+
+#ifdef __linux__
+    bool uring = var_InheritBool (p_access, "file-io-uring");
+#else
+    bool uring = false;
+#endif
+    struct vlc_file_aio *aio = vlc_file_aio_New (fd, offset, size, depth,
+                                                 uring);
+    if (aio != NULL)
+        msg_Dbg (p_access, "read-ahead: %u x %zu KiB (%s)", depth,
+                 size >> 10, vlc_file_aio_GetBackend (aio));
+    return aio;
+}
+#endif
 static int NoSeek (stream_t *, uint64_t);
 static int FileControl (stream_t *, int, va_list);
 
@@ -213,6 +256,9 @@ int FileOpen( vlc_object_t *p_this )
     p_access->pf_control = FileControl;
     p_access->p_sys = p_sys;
     p_sys->fd = fd;
+#ifdef HAVE_FILE_AIO
+    p_sys->aio = NULL;
+#endif
 
     if (S_ISREG (st.st_mode) || S_ISBLK (st.st_mode))
     {
@@ -231,6 +277,16 @@ int FileOpen( vlc_object_t *p_this )
             fcntl (fd, F_RDAHEAD, 0);
         else
             fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef HAVE_FILE_AIO
+        if (S_ISREG (st.st_mode))
+            p_sys->aio = AsyncOpen (p_access, fd);
+        if (p_sys->aio != NULL)
+        {
+            p_access->pf_read = NULL;
+            p_access->pf_block = AsyncBlock;
+            p_access->pf_seek = AsyncSeek;
+        }
 #endif
     }
     else
@@ -253,7 +309,7 @@ void FileClose (vlc_object_t * p_this)
 {
     stream_t     *p_access = (stream_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_readdir != NULL)
     {
         DirClose (p_this);
         return;
@@ -261,6 +317,19 @@ void FileClose (vlc_object_t * p_this)
 
     access_sys_t *p_sys = p_access->p_sys;
 
+#ifdef HAVE_FILE_AIO
+    if (p_sys->aio != NULL)
+    {
+        struct vlc_file_aio_stats stats;
+
+        vlc_file_aio_GetStats (p_sys->aio, &stats);
+        msg_Dbg (p_access, "%"PRIu64" KiB in %"PRIu64" reads (%"PRIu64
+                 " synchronous), waited %"PRId64" ms", stats.bytes >> 10,
+                 stats.reads, stats.sync_reads,
+                 MS_FROM_VLC_TICK(stats.blocked));
+        vlc_file_aio_Delete (p_sys->aio);
+    }
+#endif
     vlc_close (p_sys->fd);
 }
 
@@ -287,6 +356,35 @@ static ssize_t Read (stream_t *p_access, void *p_buffer, size_t i_len)
     return val;
 }
 
+#ifdef HAVE_FILE_AIO
+static block_t *AsyncBlock (stream_t *p_access, bool *restrict eof)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    block_t *block;
+
+    ssize_t val = vlc_file_aio_Read (p_sys->aio, &block);
+    if (val > 0)
+        return block;
+
+    if (val < 0)
+    {
+        if (errno == EINTR)
+            return NULL;
+        msg_Err (p_access, "read error: %s", vlc_strerror_c(errno));
+    }
+    *eof = true;
+    return NULL;
+}
+
+static int AsyncSeek (stream_t *p_access, uint64_t i_pos)
+{
+    access_sys_t *sys = p_access->p_sys;
+
+    vlc_file_aio_Seek (sys->aio, i_pos);
+    return VLC_SUCCESS;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
@@ -339,6 +437,16 @@ static int FileControl( stream_t *p_access, int i_query, va_list args )
             break;
         }
 
+        case STREAM_GET_FD:
+        {
+            struct stat st;
+
+            if (fstat (p_sys->fd, &st) || !S_ISREG(st.st_mode))
+                return VLC_EGENERIC;
+            *va_arg( args, int * ) = p_sys->fd;
+            break;
+        }
+
         case STREAM_GET_PTS_DELAY:
             pi_64 = va_arg( args, vlc_tick_t * );
             if (IsRemote (p_sys->fd, p_access->psz_filepath))
@@ -0,0 +1,955 @@
+/*****************************************************************************
+ * file_aio.c: asynchronous file read-ahead
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef HAVE_LINUX_IO_URING_H
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+# ifdef __NR_io_uring_setup
+#  define HAVE_IO_URING 1
+# endif
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_interrupt.h>
+
+#include "file_aio.h"
+
+#ifndef HAVE_POSIX_FADVISE
+# define posix_fadvise(fd, off, len, adv)
+#endif
+
+#define AIO_MAX_THREADS 4
+
+/*** Buffer pool ***/
+
+/* The pool outlives the engine as long as some of its blocks are in use. */
+struct aio_pool;
+
+struct aio_block
+{
+    block_t self;
+    struct aio_pool *pool;
+    unsigned index;
+};
+
+struct aio_pool
+{
+    vlc_mutex_t lock;
+    unsigned refs;
+    unsigned char *base;
+    size_t buf_size;
+    unsigned count;
+    unsigned avail;
+    unsigned *free;
+    struct aio_block blocks[];
+};
+
+static struct aio_pool *aio_pool_New(size_t buf_size, unsigned count)
+{
+    struct aio_pool *pool = malloc(sizeof (*pool)
+                                   + count * sizeof (pool->blocks[0]));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    pool->base = aligned_alloc(4096, buf_size * count);
+    pool->free = malloc(count * sizeof (*pool->free));
+    if (unlikely(pool->base == NULL || pool->free == NULL))
+    {
+        aligned_free(pool->base);
+        free(pool->free);
+        free(pool);
+        return NULL;
+    }
+
+    vlc_mutex_init(&pool->lock);
+    pool->refs = 1;
+    pool->buf_size = buf_size;
+    pool->count = count;
+    pool->avail = count;
+    for (unsigned i = 0; i < count; i++)
+        pool->free[i] = count - 1 - i;
+    return pool;
+}
+
+static void aio_pool_Release(struct aio_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(pool->refs > 0);
+    bool last = --pool->refs == 0;
+    vlc_mutex_unlock(&pool->lock);
+
+    if (!last)
+        return;
+
+    assert(pool->avail == pool->count);
+    vlc_mutex_destroy(&pool->lock);
+    aligned_free(pool->base);
+    free(pool->free);
+    free(pool);
+}
+
+static unsigned char *aio_pool_Buffer(const struct aio_pool *pool,
+                                      unsigned index)
+{
+    return pool->base + index * pool->buf_size;
+}
+
+static int aio_pool_Get(struct aio_pool *pool, unsigned *index)
+{
+    int ret = -1;
+
+    vlc_mutex_lock(&pool->lock);
+    if (pool->avail > 0)
+    {
+        *index = pool->free[--pool->avail];
+        ret = 0;
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+static void aio_pool_Put(struct aio_pool *pool, unsigned index)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(pool->avail < pool->count);
+    pool->free[pool->avail++] = index;
+    vlc_mutex_unlock(&pool->lock);
+}
+
+static void aio_block_Free(block_t *block)
+{
+    struct aio_block *b = container_of(block, struct aio_block, self);
+    struct aio_pool *pool = b->pool;
+
+    aio_pool_Put(pool, b->index);
+    aio_pool_Release(pool);
+}
+
+static const struct vlc_block_callbacks aio_block_cbs =
+{
+    aio_block_Free,
+};
+
+/* Wraps a buffer into a block; the buffer comes back on release. */
+static block_t *aio_pool_Lend(struct aio_pool *pool, unsigned index,
+                              size_t skip, size_t len)
+{
+    struct aio_block *b = &pool->blocks[index];
+    block_t *block = block_Init(&b->self, &aio_block_cbs,
+                                aio_pool_Buffer(pool, index), pool->buf_size);
+
+    b->pool = pool;
+    b->index = index;
+    block->p_buffer += skip;
+    block->i_buffer = len;
+
+    vlc_mutex_lock(&pool->lock);
+    pool->refs++;
+    vlc_mutex_unlock(&pool->lock);
+    return block;
+}
+
+/*** Engine ***/
+
+struct aio_req
+{
+    struct aio_req *next; /* in the thread pool queue */
+    uint64_t offset;
+    size_t len;
+    unsigned buf;
+    ssize_t result; /* size, or minus the error number */
+    bool pending; /* submitted, not completed yet */
+    bool wanted; /* in the read-ahead queue */
+    bool started; /* taken by a thread */
+    struct iovec iov;
+};
+
+struct aio_ops
+{
+    const char *name;
+    void (*submit)(struct vlc_file_aio *, struct aio_req *);
+    void (*cancel)(struct vlc_file_aio *, struct aio_req *);
+    void (*reap)(struct vlc_file_aio *);
+    int (*wait)(struct vlc_file_aio *);
+    void (*destroy)(struct vlc_file_aio *);
+};
+
+struct aio_threads
+{
+    vlc_thread_t threads[AIO_MAX_THREADS];
+    unsigned count;
+    struct aio_req *head;
+    struct aio_req **tailp;
+    vlc_cond_t wait_work;
+    bool closing;
+    bool interrupted;
+};
+
+#ifdef HAVE_IO_URING
+struct aio_uring
+{
+    int fd;
+    bool fixed; /* buffers registered */
+    unsigned to_submit;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+};
+#endif
+
+struct vlc_file_aio
+{
+    int fd;
+    size_t read_size;
+    unsigned depth;
+    uint64_t size; /* last known file size */
+    uint64_t offset; /* next byte to return */
+    uint64_t next; /* next byte to submit */
+
+    /* Read-ahead queue, in file order */
+    struct aio_req **queue;
+    unsigned first;
+    unsigned count;
+
+    /* Requests, including abandoned ones still pending */
+    struct aio_req *reqs;
+    unsigned nreqs;
+    unsigned pending;
+
+    struct aio_pool *pool;
+    struct vlc_file_aio_stats stats;
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait_done;
+
+    const struct aio_ops *ops;
+    union
+    {
+        struct aio_threads threads;
+#ifdef HAVE_IO_URING
+        struct aio_uring uring;
+#endif
+    };
+};
+
+/* Records the completion of a request. Called with the lock held. */
+static void aio_req_Complete(struct vlc_file_aio *aio, struct aio_req *req,
+                             ssize_t result)
+{
+    assert(req->pending);
+    req->pending = false;
+    req->result = result;
+    aio->pending--;
+
+    if (!req->wanted)
+        aio_pool_Put(aio->pool, req->buf);
+}
+
+/* Removes a request from the read-ahead queue. Called with the lock held. */
+static void aio_req_Abandon(struct vlc_file_aio *aio, struct aio_req *req)
+{
+    assert(req->wanted);
+    req->wanted = false;
+
+    if (req->pending)
+        aio->ops->cancel(aio, req);
+    else
+        aio_pool_Put(aio->pool, req->buf);
+}
+
+static void aio_Flush(struct vlc_file_aio *aio)
+{
+    while (aio->count > 0)
+    {
+        aio_req_Abandon(aio, aio->queue[aio->first]);
+        aio->first = (aio->first + 1) % aio->depth;
+        aio->count--;
+    }
+    aio->next = aio->offset;
+}
+
+static struct aio_req *aio_req_Find(struct vlc_file_aio *aio)
+{
+    for (unsigned i = 0; i < aio->nreqs; i++)
+    {
+        struct aio_req *req = &aio->reqs[i];
+
+        if (!req->pending && !req->wanted)
+            return req;
+    }
+    return NULL;
+}
+
+/* Keeps the read-ahead queue full. Called with the lock held. */
+static void aio_Refill(struct vlc_file_aio *aio)
+{
+    aio->ops->reap(aio);
+
+    while (aio->count < aio->depth && aio->next < aio->size)
+    {
+        struct aio_req *req = aio_req_Find(aio);
+        unsigned buf;
+
+        if (req == NULL || aio_pool_Get(aio->pool, &buf))
+            break;
+
+        /* After a seek, the first read ends at the next boundary, so that
+         * all the following ones are aligned. */
+        req->offset = aio->next;
+        req->len = aio->read_size - (aio->next % aio->read_size);
+        req->buf = buf;
+        req->pending = true;
+        req->wanted = true;
+        req->started = false;
+        req->iov.iov_base = aio_pool_Buffer(aio->pool, buf);
+        req->iov.iov_len = req->len;
+        aio->pending++;
+        aio->ops->submit(aio, req);
+
+        aio->queue[(aio->first + aio->count) % aio->depth] = req;
+        aio->count++;
+        aio->next += req->len;
+    }
+}
+
+/*** Thread pool backend ***/
+
+static void *aio_threads_Run(void *data)
+{
+    struct vlc_file_aio *aio = data;
+    struct aio_threads *t = &aio->threads;
+
+    vlc_mutex_lock(&aio->lock);
+    for (;;)
+    {
+        while (t->head == NULL && !t->closing)
+            vlc_cond_wait(&t->wait_work, &aio->lock);
+
+        struct aio_req *req = t->head;
+        if (req == NULL)
+            break;
+
+        t->head = req->next;
+        if (t->head == NULL)
+            t->tailp = &t->head;
+        req->started = true;
+        vlc_mutex_unlock(&aio->lock);
+
+        ssize_t val = pread(aio->fd, req->iov.iov_base, req->len,
+                            req->offset);
+        if (val < 0)
+            val = -errno;
+
+        vlc_mutex_lock(&aio->lock);
+        aio_req_Complete(aio, req, val);
+        vlc_cond_broadcast(&aio->wait_done);
+    }
+    vlc_mutex_unlock(&aio->lock);
+    return NULL;
+}
+
+static void aio_threads_Submit(struct vlc_file_aio *aio, struct aio_req *req)
+{
+    struct aio_threads *t = &aio->threads;
+
+    req->next = NULL;
+    *(t->tailp) = req;
+    t->tailp = &req->next;
+    vlc_cond_signal(&t->wait_work);
+}
+
+static void aio_threads_Cancel(struct vlc_file_aio *aio, struct aio_req *req)
+{
+    struct aio_threads *t = &aio->threads;
+
+    if (req->started)
+        return; /* the thread will put the buffer back */
+
+    for (struct aio_req **pp = &t->head; *pp != NULL; pp = &(*pp)->next)
+        if (*pp == req)
+        {
+            *pp = req->next;
+            if (*pp == NULL)
+                t->tailp = pp;
+            aio_req_Complete(aio, req, -ECANCELED);
+            return;
+        }
+    vlc_assert_unreachable();
+}
+
+static void aio_threads_Reap(struct vlc_file_aio *aio)
+{
+    (void) aio; /* completions are recorded by the threads */
+}
+
+static void aio_threads_WakeUp(void *data)
+{
+    struct vlc_file_aio *aio = data;
+
+    vlc_mutex_lock(&aio->lock);
+    aio->threads.interrupted = true;
+    vlc_cond_signal(&aio->wait_done);
+    vlc_mutex_unlock(&aio->lock);
+}
+
+static int aio_threads_Wait(struct vlc_file_aio *aio)
+{
+    struct aio_threads *t = &aio->threads;
+    unsigned pending = aio->pending;
+
+    t->interrupted = false;
+    vlc_mutex_unlock(&aio->lock);
+    vlc_interrupt_register(aio_threads_WakeUp, aio);
+    vlc_mutex_lock(&aio->lock);
+
+    while (aio->pending == pending && !t->interrupted)
+        vlc_cond_wait(&aio->wait_done, &aio->lock);
+
+    vlc_mutex_unlock(&aio->lock);
+    vlc_interrupt_unregister();
+    vlc_mutex_lock(&aio->lock);
+
+    if (aio->pending == pending)
+    {
+        errno = EINTR;
+        return -1;
+    }
+    return 0;
+}
+
+static void aio_threads_Destroy(struct vlc_file_aio *aio)
+{
+    struct aio_threads *t = &aio->threads;
+
+    vlc_mutex_lock(&aio->lock);
+    t->closing = true;
+    vlc_cond_broadcast(&t->wait_work);
+    vlc_mutex_unlock(&aio->lock);
+
+    for (unsigned i = 0; i < t->count; i++)
+        vlc_join(t->threads[i], NULL);
+    vlc_cond_destroy(&t->wait_work);
+}
+
+static const struct aio_ops aio_threads_ops =
+{
+    "threads",
+    aio_threads_Submit,
+    aio_threads_Cancel,
+    aio_threads_Reap,
+    aio_threads_Wait,
+    aio_threads_Destroy,
+};
+
+static int aio_threads_Init(struct vlc_file_aio *aio)
+{
+    struct aio_threads *t = &aio->threads;
+
+    t->head = NULL;
+    t->tailp = &t->head;
+    t->closing = false;
+    t->count = 0;
+    vlc_cond_init(&t->wait_work);
+    aio->ops = &aio_threads_ops;
+
+    unsigned count = aio->depth < AIO_MAX_THREADS ? aio->depth
+                                                  : AIO_MAX_THREADS;
+    while (t->count < count)
+    {
+        if (vlc_clone(&t->threads[t->count], aio_threads_Run, aio,
+                      VLC_THREAD_PRIORITY_INPUT))
+            break;
+        t->count++;
+    }
+
+    if (t->count == 0)
+    {
+        vlc_cond_destroy(&t->wait_work);
+        return -1;
+    }
+    return 0;
+}
+
+/*** io_uring backend ***/
+
+#ifdef HAVE_IO_URING
+static int aio_uring_Enter(struct aio_uring *u, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int val = syscall(__NR_io_uring_enter, u->fd, u->to_submit, min_complete,
+                      flags, NULL, 0);
+    if (val < 0)
+        return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+
+    assert((unsigned)val <= u->to_submit);
+    u->to_submit -= val;
+    return 0;
+}
+
+static void aio_uring_Reap(struct vlc_file_aio *aio)
+{
+    struct aio_uring *u = &aio->uring;
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+        struct aio_req *req = (struct aio_req *)(uintptr_t)cqe->user_data;
+
+        aio_req_Complete(aio, req, cqe->res);
+        head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void aio_uring_Submit(struct vlc_file_aio *aio, struct aio_req *req)
+{
+    struct aio_uring *u = &aio->uring;
+    unsigned tail = *u->sq_tail;
+    unsigned index = tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+
+    memset(sqe, 0, sizeof (*sqe));
+    sqe->fd = aio->fd;
+    sqe->off = req->offset;
+    if (u->fixed)
+    {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uintptr_t)req->iov.iov_base;
+        sqe->len = req->len;
+        sqe->buf_index = req->buf;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (uintptr_t)&req->iov;
+        sqe->len = 1;
+    }
+    sqe->user_data = (uintptr_t)req;
+
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+
+    /* Errors are retried on the next wait. */
+    aio_uring_Enter(u, 0);
+}
+
+static void aio_uring_Cancel(struct vlc_file_aio *aio, struct aio_req *req)
+{
+    /* The buffer is put back when the request completes. */
+    (void) aio; (void) req;
+}
+
+static int aio_uring_Wait(struct vlc_file_aio *aio)
+{
+    struct aio_uring *u = &aio->uring;
+    unsigned pending = aio->pending;
+
+    aio_uring_Reap(aio);
+    while (aio->pending == pending)
+    {
+        if (u->to_submit > 0 && aio_uring_Enter(u, 0))
+            return -1;
+
+        /* The ring is readable when completions are available. */
+        struct pollfd ufd = { .fd = u->fd, .events = POLLIN };
+
+        vlc_mutex_unlock(&aio->lock);
+        int val = vlc_poll_i11e(&ufd, 1, -1);
+        vlc_mutex_lock(&aio->lock);
+
+        if (val < 0)
+            return -1;
+        aio_uring_Reap(aio);
+    }
+    return 0;
+}
+
+static void aio_uring_Close(struct aio_uring *u)
+{
+    if (u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != MAP_FAILED)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    vlc_close(u->fd);
+}
+
+static void aio_uring_Destroy(struct vlc_file_aio *aio)
+{
+    struct aio_uring *u = &aio->uring;
+
+    vlc_mutex_lock(&aio->lock);
+    while (aio->pending > 0)
+    {
+        if (aio_uring_Enter(u, 1))
+            break; /* cannot happen short of a kernel bug */
+        aio_uring_Reap(aio);
+    }
+    vlc_mutex_unlock(&aio->lock);
+
+    aio_uring_Close(u);
+}
+
+static const struct aio_ops aio_uring_ops =
+{
+    "io_uring",
+    aio_uring_Submit,
+    aio_uring_Cancel,
+    aio_uring_Reap,
+    aio_uring_Wait,
+    aio_uring_Destroy,
+};
+
+static int aio_uring_Init(struct vlc_file_aio *aio)
+{
+    struct aio_uring *u = &aio->uring;
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof (p));
+    u->fd = syscall(__NR_io_uring_setup, aio->nreqs, &p);
+    if (u->fd < 0)
+        return -1;
+
+    fcntl(u->fd, F_SETFD, FD_CLOEXEC);
+    u->to_submit = 0;
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    u->cq_ring_size = p.cq_off.cqes
+                    + p.cq_entries * sizeof (struct io_uring_cqe);
+    u->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED
+     || u->sqes == MAP_FAILED)
+    {
+        aio_uring_Close(u);
+        return -1;
+    }
+
+    unsigned char *sq = u->sq_ring, *cq = u->cq_ring;
+
+    u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    u->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + p.sq_off.array);
+    u->cq_head = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* Registered buffers spare the kernel from mapping the pages of each
+     * read. This can fail for lack of locked memory, and is optional. */
+    struct aio_pool *pool = aio->pool;
+    struct iovec iov[pool->count];
+
+    for (unsigned i = 0; i < pool->count; i++)
+    {
+        iov[i].iov_base = aio_pool_Buffer(pool, i);
+        iov[i].iov_len = pool->buf_size;
+    }
+    u->fixed = syscall(__NR_io_uring_register, u->fd,
+                       IORING_REGISTER_BUFFERS, iov, pool->count) == 0;
+
+    aio->ops = &aio_uring_ops;
+    return 0;
+}
+#endif
+
+/*** Interface ***/
+
+struct vlc_file_aio *vlc_file_aio_New(int fd, uint64_t offset,
+                                      size_t read_size, unsigned depth,
+                                      bool uring)
+{
+    struct stat st;
+
+    assert(read_size > 0 && (read_size % 4096) == 0);
+    assert(depth > 0);
+
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+        return NULL;
+
+    struct vlc_file_aio *aio = malloc(sizeof (*aio));
+    if (unlikely(aio == NULL))
+        return NULL;
+
+    aio->fd = fd;
+    aio->read_size = read_size;
+    aio->depth = depth;
+    aio->size = st.st_size;
+    aio->offset = offset;
+    aio->next = offset;
+    aio->first = 0;
+    aio->count = 0;
+    /* Twice as many requests and buffers as the depth, so that a whole
+     * window can be abandoned on seek while another one is submitted, and
+     * so that the reader can hold on to a few blocks. */
+    aio->nreqs = 2 * depth;
+    aio->pending = 0;
+    memset(&aio->stats, 0, sizeof (aio->stats));
+
+    aio->queue = malloc(depth * sizeof (*aio->queue));
+    aio->reqs = calloc(aio->nreqs, sizeof (*aio->reqs));
+    aio->pool = aio_pool_New(read_size, 2 * depth);
+    if (unlikely(aio->queue == NULL || aio->reqs == NULL
+              || aio->pool == NULL))
+        goto error;
+
+    vlc_mutex_init(&aio->lock);
+    vlc_cond_init(&aio->wait_done);
+
+#ifdef HAVE_IO_URING
+    if (!uring || aio_uring_Init(aio))
+#else
+    (void) uring;
+#endif
+    if (aio_threads_Init(aio))
+    {
+        vlc_cond_destroy(&aio->wait_done);
+        vlc_mutex_destroy(&aio->lock);
+        goto error;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return aio;
+
+error:
+    if (aio->pool != NULL)
+        aio_pool_Release(aio->pool);
+    free(aio->reqs);
+    free(aio->queue);
+    free(aio);
+    return NULL;
+}
+
+void vlc_file_aio_Delete(struct vlc_file_aio *aio)
+{
+    vlc_mutex_lock(&aio->lock);
+    aio_Flush(aio);
+    vlc_mutex_unlock(&aio->lock);
+
+    aio->ops->destroy(aio);
+    assert(aio->pending == 0);
+
+    vlc_cond_destroy(&aio->wait_done);
+    vlc_mutex_destroy(&aio->lock);
+    aio_pool_Release(aio->pool);
+    free(aio->reqs);
+    free(aio->queue);
+    free(aio);
+}
+
+const char *vlc_file_aio_GetBackend(const struct vlc_file_aio *aio)
+{
+    return aio->ops->name;
+}
+
+/* Reads synchronously into a new block, when all buffers are in use. */
+static ssize_t aio_ReadSync(struct vlc_file_aio *aio, block_t **blockp)
+{
+    size_t len = aio->read_size - (aio->offset % aio->read_size);
+    block_t *block = block_Alloc(len);
+    if (unlikely(block == NULL))
+        return -1;
+
+    ssize_t val = pread(aio->fd, block->p_buffer, len, aio->offset);
+    if (val <= 0)
+    {
+        block_Release(block);
+        return val;
+    }
+
+    block->i_buffer = val;
+    *blockp = block;
+    return val;
+}
+
+ssize_t vlc_file_aio_Read(struct vlc_file_aio *aio, block_t **blockp)
+{
+    ssize_t val;
+
+    vlc_mutex_lock(&aio->lock);
+    for (;;)
+    {
+        aio_Refill(aio);
+
+        if (aio->count == 0)
+        {
+            struct stat st;
+
+            assert(aio->next == aio->offset);
+
+            if (aio->offset >= aio->size)
+            {   /* The file may be growing */
+                if (fstat(aio->fd, &st) == 0
+                 && (uint64_t)st.st_size > aio->size)
+                {
+                    aio->size = st.st_size;
+                    continue;
+                }
+                val = 0;
+                break;
+            }
+
+            val = aio_ReadSync(aio, blockp);
+            if (val > 0)
+            {
+                aio->offset += val;
+                aio->next = aio->offset;
+                aio->stats.sync_reads++;
+            }
+            break;
+        }
+
+        struct aio_req *req = aio->queue[aio->first];
+
+        if (req->pending)
+        {
+            vlc_tick_t start = vlc_tick_now();
+            int ret = aio->ops->wait(aio);
+
+            aio->stats.blocked += vlc_tick_now() - start;
+            if (ret)
+            {
+                val = -1;
+                break;
+            }
+            continue;
+        }
+
+        aio->first = (aio->first + 1) % aio->depth;
+        aio->count--;
+        req->wanted = false;
+        aio->stats.reads++;
+
+        assert(req->offset <= aio->offset);
+        val = req->result;
+
+        size_t skip = aio->offset - req->offset;
+
+        if (val < 0 || (size_t)val <= skip)
+        {   /* Error or end of file */
+            aio_pool_Put(aio->pool, req->buf);
+            if (val < 0)
+                errno = -val;
+            else
+            {
+                aio->size = req->offset + val;
+                val = 0;
+            }
+            aio_Flush(aio);
+            break;
+        }
+
+        if ((size_t)val < req->len)
+        {   /* Short read: the end of file, at least for now */
+            aio->size = req->offset + val;
+            aio->offset = aio->size;
+            aio_Flush(aio);
+        }
+        else
+            aio->offset = req->offset + val;
+
+        val -= skip;
+        *blockp = aio_pool_Lend(aio->pool, req->buf, skip, val);
+        aio_Refill(aio);
+        break;
+    }
+
+    if (val > 0)
+        aio->stats.bytes += val;
+    vlc_mutex_unlock(&aio->lock);
+    return val;
+}
+
+void vlc_file_aio_Seek(struct vlc_file_aio *aio, uint64_t offset)
+{
+    vlc_mutex_lock(&aio->lock);
+
+    /* Drop reads before the new offset */
+    while (aio->count > 0)
+    {
+        struct aio_req *req = aio->queue[aio->first];
+
+        if (req->offset + req->len > offset)
+        {
+            if (req->offset > offset)
+            {   /* Backward seek */
+                aio->offset = offset;
+                aio_Flush(aio);
+            }
+            break;
+        }
+
+        aio_req_Abandon(aio, req);
+        aio->first = (aio->first + 1) % aio->depth;
+        aio->count--;
+    }
+
+    aio->offset = offset;
+    if (aio->count == 0)
+    {
+        aio->next = offset;
+        /* Tell the kernel about the new window right away. The reads will
+         * be submitted on the next read call. */
+        posix_fadvise(aio->fd, offset, aio->depth * aio->read_size,
+                      POSIX_FADV_WILLNEED);
+    }
+    vlc_mutex_unlock(&aio->lock);
+}
+
+void vlc_file_aio_GetStats(const struct vlc_file_aio *aio,
+                           struct vlc_file_aio_stats *stats)
+{
+    *stats = aio->stats;
+}
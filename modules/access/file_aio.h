@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * file_aio.h: asynchronous file read-ahead
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_ACCESS_FILE_AIO_H
+#define VLC_ACCESS_FILE_AIO_H
+
+/**
+ * Asynchronous read-ahead engine for regular files.
+ *
+ * Keeps several reads in flight ahead of the current offset, each into its
+ * own buffer from a fixed pool. Completed buffers are handed out as blocks
+ * without copying, and return to the pool when the blocks are released.
+ *
+ * Reads are submitted through io_uring on Linux, with the buffers registered
+ * to the kernel, or else through a small pool of threads calling pread().
+ *
+ * All functions except the block release callbacks must be called from the
+ * same thread.
+ */
+struct vlc_file_aio;
+
+struct vlc_file_aio_stats
+{
+    uint64_t reads;     /**< asynchronous reads completed */
+    uint64_t sync_reads; /**< synchronous reads, for lack of free buffers */
+    uint64_t bytes;     /**< bytes returned */
+    vlc_tick_t blocked; /**< time spent waiting for data in vlc_file_aio_Read() */
+};
+
+/**
+ * Creates a read-ahead engine.
+ *
+ * \param fd regular file descriptor (not owned)
+ * \param offset initial read offset
+ * \param read_size size of each read in bytes, multiple of 4096;
+ *                  reads are aligned to that size
+ * \param depth number of reads in flight ahead of the offset
+ * \param uring whether to try io_uring first
+ * \return an engine, or NULL on error
+ */
+struct vlc_file_aio *vlc_file_aio_New(int fd, uint64_t offset,
+                                      size_t read_size, unsigned depth,
+                                      bool uring);
+
+/**
+ * Destroys a read-ahead engine.
+ *
+ * Waits for pending reads. Blocks handed out earlier remain valid.
+ */
+void vlc_file_aio_Delete(struct vlc_file_aio *);
+
+/**
+ * Gets the name of the backend in use ("io_uring" or "threads").
+ */
+const char *vlc_file_aio_GetBackend(const struct vlc_file_aio *);
+
+/**
+ * Reads the next block of data.
+ *
+ * Waits for the oldest read in flight if it has not completed yet.
+ * The wait can be interrupted with vlc_interrupt_kill().
+ *
+ * \param blockp where to store the data block [OUT]
+ * \return the size of the block, 0 at end of file, or -1 on error
+ *         (errno is EINTR if interrupted)
+ */
+ssize_t vlc_file_aio_Read(struct vlc_file_aio *, block_t **blockp);
+
+/**
+ * Sets the read offset.
+ *
+ * Reads in flight after the new offset are kept, others are abandoned.
+ * The operating system is told about the new window with posix_fadvise().
+ */
+void vlc_file_aio_Seek(struct vlc_file_aio *, uint64_t offset);
+
+void vlc_file_aio_GetStats(const struct vlc_file_aio *,
+                           struct vlc_file_aio_stats *);
+
+#endif
@@ -0,0 +1,300 @@
+/*****************************************************************************
+ * file_aio_test.c: asynchronous file read-ahead test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Checks the data returned by each backend across seeks, and compares the
+ * throughput and the time spent blocked in read calls with plain read()
+ * on a file evicted from the page cache.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+
+#include "file_aio.h"
+
+#define KiB 1024
+#define MiB (1024 * 1024)
+
+#define FILE_SIZE  (64 * MiB + 777) /* not a multiple of the read size */
+#define READ_SIZE  (256 * KiB)
+#define DEPTH      4
+
+static uint8_t file_byte(uint64_t offset)
+{
+    return offset ^ (offset >> 8) ^ (offset >> 19);
+}
+
+static void fill(uint8_t *buf, uint64_t offset, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        buf[i] = file_byte(offset + i);
+}
+
+static void check(const uint8_t *buf, uint64_t offset, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        assert(buf[i] == file_byte(offset + i));
+}
+
+static int create_file(char *path)
+{
+    static uint8_t buf[1 * MiB];
+    int fd = mkstemp(path);
+    assert(fd != -1);
+
+    for (uint64_t offset = 0; offset < FILE_SIZE; offset += sizeof (buf))
+    {
+        size_t len = sizeof (buf);
+        if (len > FILE_SIZE - offset)
+            len = FILE_SIZE - offset;
+        fill(buf, offset, len);
+        assert(write(fd, buf, len) == (ssize_t)len);
+    }
+    return fd;
+}
+
+/* Evicts the file from the page cache, as far as we are allowed to. */
+static void drop_cache(int fd)
+{
+    fsync(fd);
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+static const char *const backends[] = { "threads", "io_uring" };
+
+static struct vlc_file_aio *open_aio(int fd, uint64_t offset, bool uring)
+{
+    struct vlc_file_aio *aio = vlc_file_aio_New(fd, offset, READ_SIZE,
+                                                DEPTH, uring);
+    assert(aio != NULL);
+    return aio;
+}
+
+/* Reads up to len bytes from offset and checks them */
+static uint64_t read_check(struct vlc_file_aio *aio, uint64_t offset,
+                           uint64_t len)
+{
+    uint64_t end = (len < UINT64_MAX - offset) ? offset + len : UINT64_MAX;
+
+    while (offset < end)
+    {
+        block_t *block;
+        ssize_t val = vlc_file_aio_Read(aio, &block);
+
+        assert(val >= 0);
+        if (val == 0)
+            break;
+        assert((size_t)val == block->i_buffer);
+        check(block->p_buffer, offset, block->i_buffer);
+        offset += block->i_buffer;
+        block_Release(block);
+    }
+    return offset;
+}
+
+static void test_seek(int fd, bool uring)
+{
+    struct vlc_file_aio *aio = open_aio(fd, 0, uring);
+    uint64_t offset;
+
+    if (uring && strcmp(vlc_file_aio_GetBackend(aio), "io_uring"))
+    {
+        printf("io_uring not available\n");
+        vlc_file_aio_Delete(aio);
+        return;
+    }
+
+    /* Within the first read, then within the window */
+    offset = read_check(aio, 0, 1000);
+    assert(offset >= 1000);
+    vlc_file_aio_Seek(aio, 5000);
+    read_check(aio, 5000, READ_SIZE);
+    vlc_file_aio_Seek(aio, 2 * READ_SIZE + 77);
+    read_check(aio, 2 * READ_SIZE + 77, 3 * READ_SIZE);
+
+    /* Backward, then far forward: unaligned reads come first */
+    vlc_file_aio_Seek(aio, 12345);
+    read_check(aio, 12345, READ_SIZE);
+    vlc_file_aio_Seek(aio, FILE_SIZE / 2 + 1);
+    read_check(aio, FILE_SIZE / 2 + 1, 5 * READ_SIZE);
+
+    /* Random seeks with short reads, as a demuxer probing an index */
+    srand(42);
+    for (unsigned i = 0; i < 200; i++)
+    {
+        offset = ((uint64_t)rand() * 4099) % FILE_SIZE;
+        vlc_file_aio_Seek(aio, offset);
+        read_check(aio, offset, 1 + rand() % (2 * READ_SIZE));
+    }
+
+    /* Up to and past the end */
+    vlc_file_aio_Seek(aio, FILE_SIZE - 100);
+    assert(read_check(aio, FILE_SIZE - 100, UINT64_MAX) == FILE_SIZE);
+    vlc_file_aio_Seek(aio, FILE_SIZE + 100);
+    assert(read_check(aio, FILE_SIZE + 100, UINT64_MAX) == FILE_SIZE + 100);
+
+    /* Abandon reads in flight */
+    vlc_file_aio_Seek(aio, 0);
+    read_check(aio, 0, 1);
+    vlc_file_aio_Delete(aio);
+}
+
+/* The reader holds on to more blocks than there are buffers, and keeps some
+ * after the engine is gone. */
+static void test_hold(int fd, bool uring)
+{
+    struct vlc_file_aio *aio = open_aio(fd, 3, uring);
+    block_t *held[4 * DEPTH];
+    uint64_t offset = 3;
+
+    for (unsigned i = 0; i < ARRAY_SIZE(held); i++)
+    {
+        assert(vlc_file_aio_Read(aio, &held[i]) > 0);
+        check(held[i]->p_buffer, offset, held[i]->i_buffer);
+        offset += held[i]->i_buffer;
+    }
+
+    struct vlc_file_aio_stats stats;
+    vlc_file_aio_GetStats(aio, &stats);
+    assert(stats.sync_reads > 0);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(held) / 2; i++)
+        block_Release(held[i]);
+    assert(read_check(aio, offset, 10 * READ_SIZE) >= offset + 10 * READ_SIZE);
+    vlc_file_aio_Delete(aio);
+
+    for (unsigned i = ARRAY_SIZE(held) / 2; i < ARRAY_SIZE(held); i++)
+        block_Release(held[i]);
+}
+
+/* Data appended to the file after the end was reached */
+static void test_grow(bool uring)
+{
+    char path[] = "/tmp/vlc-file-aio-XXXXXX";
+    uint8_t buf[10000];
+    int fd = mkstemp(path);
+
+    assert(fd != -1);
+    unlink(path);
+    fill(buf, 0, sizeof (buf));
+    assert(write(fd, buf, 5000) == 5000);
+
+    struct vlc_file_aio *aio = open_aio(fd, 0, uring);
+    assert(read_check(aio, 0, UINT64_MAX) == 5000);
+    assert(write(fd, buf + 5000, 5000) == 5000);
+    assert(read_check(aio, 5000, UINT64_MAX) == 10000);
+    vlc_file_aio_Delete(aio);
+    vlc_close(fd);
+}
+
+/* Demultiplexing work between reads: the data is checked, byte per byte */
+static void bench_report(const char *name, vlc_tick_t elapsed,
+                         vlc_tick_t blocked)
+{
+    printf("%-8s %4"PRId64" MB/s, blocked %4"PRId64" ms out of %4"PRId64
+           " ms\n", name, (int64_t)FILE_SIZE * CLOCK_FREQ / elapsed / 1000000,
+           MS_FROM_VLC_TICK(blocked), MS_FROM_VLC_TICK(elapsed));
+}
+
+static void bench_sync(int fd)
+{
+    static uint8_t buf[READ_SIZE];
+    uint64_t offset = 0;
+    vlc_tick_t blocked = 0;
+
+    drop_cache(fd);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+
+    vlc_tick_t start = vlc_tick_now();
+    for (;;)
+    {
+        vlc_tick_t t = vlc_tick_now();
+        ssize_t val = read(fd, buf, sizeof (buf));
+        blocked += vlc_tick_now() - t;
+
+        assert(val >= 0);
+        if (val == 0)
+            break;
+        check(buf, offset, val);
+        offset += val;
+    }
+    assert(offset == FILE_SIZE);
+    bench_report("read()", vlc_tick_now() - start, blocked);
+}
+
+static void bench_aio(int fd, bool uring)
+{
+    drop_cache(fd);
+
+    vlc_tick_t start = vlc_tick_now();
+    struct vlc_file_aio *aio = open_aio(fd, 0, uring);
+    assert(read_check(aio, 0, UINT64_MAX) == FILE_SIZE);
+
+    struct vlc_file_aio_stats stats;
+    vlc_file_aio_GetStats(aio, &stats);
+    assert(stats.bytes == FILE_SIZE);
+    if (!uring || !strcmp(vlc_file_aio_GetBackend(aio), "io_uring"))
+        bench_report(vlc_file_aio_GetBackend(aio), vlc_tick_now() - start,
+                     stats.blocked);
+    vlc_file_aio_Delete(aio);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/vlc-file-aio-XXXXXX";
+    int fd = create_file(path);
+
+    unlink(path);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(backends); i++)
+    {
+        bool uring = i > 0;
+
+        printf("%s:\n", backends[i]);
+        test_seek(fd, uring);
+        test_hold(fd, uring);
+        test_grow(uring);
+    }
+
+    bench_sync(fd);
+    for (unsigned i = 0; i < ARRAY_SIZE(backends); i++)
+        bench_aio(fd, i > 0);
+
+    vlc_close(fd);
+    return 0;
+}
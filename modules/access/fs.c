@@ -40,6 +40,20 @@ vlc_module_begin ()
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
 
+    add_integer( "file-read-ahead", 4, N_("Read-ahead"),
+                 N_("Number of asynchronous reads kept in flight ahead of "
+                    "the current position in regular files (0 to disable)."),
+                 true )
+        change_integer_range( 0, 64 )
+    add_integer( "file-read-size", 256, N_("Read size"),
+                 N_("Size of each asynchronous read (KiB)."), true )
+        change_integer_range( 4, 16384 )
+#ifdef __linux__
+    add_bool( "file-io-uring", true, N_("Use io_uring"),
+              N_("Submit asynchronous reads through io_uring, if the kernel "
+                 "supports it, rather than through helper threads."), true )
+#endif
+
     add_submodule()
     set_section( N_("Directory" ), NULL )
     set_capability( "access", 55 )
@@ -52,5 +66,10 @@ vlc_module_begin ()
 
     add_bool("list-special-files", false, N_("List special files"),
              N_("Include devices and pipes when listing directories"), true)
+    add_integer("directory-stat-threads", 8, N_("Listing threads"),
+                N_("Number of threads looking up the type of directory "
+                   "entries in parallel, when the file system does not "
+                   "report it (0 to disable)."), true)
+        change_integer_range(0, 16)
     add_obsolete_string("directory-sort") /* since 3.0.0 */
 vlc_module_end ()
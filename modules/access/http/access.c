@@ -38,13 +38,26 @@
 
 #include "connmgr.h"
 #include "resource.h"
+#include "message.h"
 #include "file.h"
 #include "live.h"
+#include "parallel.h"
+#include "diskcache.h"
+
+#define PARALLEL_CHUNK_SIZE (1 << 20)
+#define CACHE_READ_SIZE (128 << 10)
 
 typedef struct
 {
     struct vlc_http_mgr *manager;
     struct vlc_http_resource *resource;
+    struct vlc_http_parallel *parallel;
+    struct vlc_http_dcache *cache;
+    struct vlc_http_dcache_entry *entry;
+    block_t *(*net_read)(stream_t *, bool *);
+    int (*net_seek)(stream_t *, uint64_t);
+    uint64_t offset;
+    uint64_t net_offset;
 } access_sys_t;
 
 static block_t *FileRead(stream_t *access, bool *restrict eof)
@@ -66,6 +79,135 @@ static int FileSeek(stream_t *access, uint64_t pos)
     return VLC_SUCCESS;
 }
 
+static block_t *ParallelRead(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+
+    block_t *b = vlc_http_parallel_read(sys->parallel);
+    if (b == NULL)
+        *eof = true;
+    return b;
+}
+
+static int ParallelSeek(stream_t *access, uint64_t pos)
+{
+    access_sys_t *sys = access->p_sys;
+
+    if (vlc_http_parallel_seek(sys->parallel, pos))
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
+
+static block_t *CacheRead(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+    block_t *b = block_Alloc(CACHE_READ_SIZE);
+
+    if (unlikely(b == NULL))
+        return NULL;
+
+    ssize_t val = vlc_http_dcache_read(sys->entry, sys->offset, b->p_buffer,
+                                       b->i_buffer);
+    if (val >= 0)
+    {
+        if (val == 0)
+        {
+            block_Release(b);
+            *eof = true;
+            return NULL;
+        }
+        b->i_buffer = val;
+        sys->offset += val;
+        return b;
+    }
+    block_Release(b);
+
+    /* Not cached: fetch from the network, from where reading stopped, or
+     * from the new position after a seek. */
+    if (sys->net_offset != sys->offset)
+    {
+        if (sys->net_seek(access, sys->offset))
+        {
+            *eof = true;
+            return NULL;
+        }
+        sys->net_offset = sys->offset;
+    }
+
+    b = sys->net_read(access, eof);
+    if (b != NULL)
+    {
+        vlc_http_dcache_write(sys->entry, sys->offset, b->p_buffer,
+                              b->i_buffer);
+        sys->offset += b->i_buffer;
+        sys->net_offset = sys->offset;
+    }
+    return b;
+}
+
+static int CacheSeek(stream_t *access, uint64_t pos)
+{
+    access_sys_t *sys = access->p_sys;
+
+    /* Deferred until data is found missing from the cache */
+    sys->offset = pos;
+    return VLC_SUCCESS;
+}
+
+static void CacheOpen(stream_t *access)
+{
+    access_sys_t *sys = access->p_sys;
+    const struct vlc_http_msg *resp = sys->resource->response;
+
+    if (!vlc_http_file_can_seek(sys->resource))
+        return;
+
+    sys->cache = vlc_http_dcache_create(VLC_OBJECT(access));
+    if (sys->cache == NULL)
+        return;
+
+    sys->entry = vlc_http_dcache_open(sys->cache, access->psz_url);
+    if (sys->entry == NULL)
+    {
+        vlc_http_dcache_destroy(sys->cache);
+        sys->cache = NULL;
+        return;
+    }
+
+    /* The validators of the response tell if the cached data is current */
+    const struct vlc_http_dcache_info info = {
+        .etag = vlc_http_msg_get_header(resp, "ETag"),
+        .last_modified = vlc_http_msg_get_header(resp, "Last-Modified"),
+        .cache_control = vlc_http_msg_get_header(resp, "Cache-Control"),
+        .content_type = vlc_http_msg_get_header(resp, "Content-Type"),
+        .size = vlc_http_file_get_size(sys->resource),
+    };
+
+    vlc_http_dcache_update(sys->entry, &info);
+    sys->net_read = access->pf_block;
+    sys->net_seek = access->pf_seek;
+    sys->offset = sys->net_offset = 0;
+    access->pf_block = CacheRead;
+    access->pf_seek = CacheSeek;
+}
+
+static void CacheClose(stream_t *access)
+{
+    access_sys_t *sys = access->p_sys;
+    struct vlc_http_dcache_stats stats;
+
+    vlc_http_dcache_close(sys->entry);
+    vlc_http_dcache_get_stats(sys->cache, &stats);
+    vlc_http_dcache_destroy(sys->cache);
+
+    uintmax_t total = stats.hit_bytes + stats.miss_bytes;
+    if (total > 0)
+        msg_Dbg(access, "disk cache: %ju%% hit ratio, %ju KiB saved, "
+                "%ju KiB stored, %ju KiB evicted",
+                stats.hit_bytes * 100 / total, stats.hit_bytes >> 10,
+                stats.stored_bytes >> 10, stats.evicted_bytes >> 10);
+}
+
 static int FileControl(stream_t *access, int query, va_list args)
 {
     access_sys_t *sys = access->p_sys;
@@ -169,6 +311,9 @@ static int Open(vlc_object_t *obj)
 
     sys->manager = NULL;
     sys->resource = NULL;
+    sys->parallel = NULL;
+    sys->cache = NULL;
+    sys->entry = NULL;
 
     void *jar = NULL;
     if (var_InheritBool(obj, "http-forward-cookies"))
@@ -258,11 +403,32 @@ static int Open(vlc_object_t *obj)
     }
     else
     {
-        access->pf_block = FileRead;
-        access->pf_seek = FileSeek;
+        unsigned conns = var_InheritInteger(obj, "http-connections");
+
+        /* With parallel reads, the initial response only serves for its
+         * headers (size, type and entity validators). */
+        if (conns > 1)
+            sys->parallel = vlc_http_parallel_create(obj, jar,
+                                                     access->psz_url,
+                                                     sys->resource, conns,
+                                                     PARALLEL_CHUNK_SIZE);
+        if (sys->parallel != NULL)
+        {
+            msg_Dbg(access, "using up to %u connections", conns);
+            access->pf_block = ParallelRead;
+            access->pf_seek = ParallelSeek;
+        }
+        else
+        {
+            access->pf_block = FileRead;
+            access->pf_seek = FileSeek;
+        }
         access->pf_control = FileControl;
     }
     access->p_sys = sys;
+
+    if (!live)
+        CacheOpen(access);
     return VLC_SUCCESS;
 
 error:
@@ -282,6 +448,10 @@ static void Close(vlc_object_t *obj)
     stream_t *access = (stream_t *)obj;
     access_sys_t *sys = access->p_sys;
 
+    if (sys->cache != NULL)
+        CacheClose(access);
+    if (sys->parallel != NULL)
+        vlc_http_parallel_destroy(sys->parallel);
     vlc_http_res_destroy(sys->resource);
     vlc_http_mgr_destroy(sys->manager);
     free(sys);
@@ -300,6 +470,12 @@ vlc_module_begin()
              N_("Keep reading a resource that keeps being updated."), true)
         change_safe()
         change_volatile()
+    add_integer("http-connections", 1, N_("Parallel connections"),
+                N_("Maximum number of connections to fetch a file with, "
+                   "using concurrent range requests. This can improve "
+                   "throughput on high latency links."), true)
+        change_integer_range(1, 16)
+        change_safe()
     add_bool("http-forward-cookies", true, N_("Cookies forwarding"),
              N_("Forward cookies across HTTP redirections."), true)
     add_string("http-referrer", NULL, N_("Referrer"),
@@ -314,4 +490,13 @@ vlc_module_begin()
                   "e.g. \"FooBar/1.2.3\"."), true)
         change_safe()
         change_private()
+    add_integer("http-disk-cache-size", 0, N_("Disk cache size (MiB)"),
+                N_("Maximum size of the persistent cache of HTTP resources "
+                   "on local storage, also used for adaptive streaming "
+                   "segments. 0 disables the cache."), true)
+        change_integer_range(0, 1048576)
+    add_string("http-disk-cache-dir", NULL, N_("Disk cache directory"),
+               N_("Directory for the persistent HTTP cache. By default, "
+                  "a subdirectory of the user cache directory is used."),
+               true)
 vlc_module_end()
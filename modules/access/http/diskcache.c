@@ -0,0 +1,853 @@
+/*****************************************************************************
+ * diskcache.c: persistent HTTP cache
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_configuration.h>
+#include <vlc_fs.h>
+#include <vlc_md5.h>
+#include <vlc_strings.h>
+#include "diskcache.h"
+
+#define PAGE_SIZE VLC_HTTP_DCACHE_PAGE_SIZE
+
+struct vlc_http_dcache
+{
+    char *dir;
+    uintmax_t budget;
+    vlc_mutex_t lock;
+    uintmax_t used; /* page bytes on disk, as far as we know */
+    struct vlc_http_dcache_stats stats;
+};
+
+struct vlc_http_dcache_entry
+{
+    struct vlc_http_dcache *cache;
+    char *path; /* entry directory */
+    char *url;
+    char *etag;
+    char *last_modified;
+    char *content_type;
+    uintmax_t size;
+    time_t expires; /* 0 if the entry must be revalidated */
+    bool stored; /* metadata on disk */
+    bool storable; /* allowed to store */
+    bool used; /* read or written since opened */
+
+    /* Page being read */
+    int fd;
+    uintmax_t fd_index;
+    size_t fd_size;
+
+    /* Page being assembled */
+    unsigned char *page;
+    uintmax_t page_index;
+    size_t page_length;
+};
+
+/*** Files ***/
+
+static bool dcache_empty(const char *str)
+{
+    return str == NULL || str[0] == '\0';
+}
+
+static char *dcache_path(const char *dir, const char *name)
+{
+    char *path;
+
+    if (asprintf(&path, "%s"DIR_SEP"%s", dir, name) < 0)
+        path = NULL;
+    return path;
+}
+
+static char *dcache_page_path(const struct vlc_http_dcache_entry *e,
+                              uintmax_t index)
+{
+    char *path;
+
+    if (asprintf(&path, "%s"DIR_SEP"%ju", e->path, index) < 0)
+        path = NULL;
+    return path;
+}
+
+static bool dcache_is_page(const char *name)
+{
+    if (!isdigit((unsigned char)*name))
+        return false;
+    while (isdigit((unsigned char)*name))
+        name++;
+    return *name == '\0';
+}
+
+/* Creates a directory and its missing parents */
+static int dcache_mkdir(const char *dir)
+{
+    if (vlc_mkdir(dir, 0700) == 0 || errno == EEXIST)
+        return 0;
+    if (errno != ENOENT)
+        return -1;
+
+    char *parent = strdup(dir);
+    if (unlikely(parent == NULL))
+        return -1;
+
+    char *sep = strrchr(parent, DIR_SEP_CHAR);
+    int ret = -1;
+
+    if (sep != NULL && sep != parent)
+    {
+        *sep = '\0';
+        if (dcache_mkdir(parent) == 0)
+            ret = (vlc_mkdir(dir, 0700) == 0 || errno == EEXIST) ? 0 : -1;
+    }
+    free(parent);
+    return ret;
+}
+
+/* Writes a whole file atomically */
+static int dcache_write_file(const char *path, const void *buf, size_t len)
+{
+    char *tmp;
+
+    if (asprintf(&tmp, "%s.XXXXXX", path) < 0)
+        return -1;
+
+    int fd = vlc_mkstemp(tmp);
+    if (fd == -1)
+    {
+        free(tmp);
+        return -1;
+    }
+
+    const unsigned char *p = buf;
+    int ret = 0;
+
+    while (len > 0)
+    {
+        ssize_t val = vlc_write(fd, p, len);
+        if (val < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ret = -1;
+            break;
+        }
+        p += val;
+        len -= val;
+    }
+
+    if (vlc_close(fd) || ret || vlc_rename(tmp, path))
+    {
+        vlc_unlink(tmp);
+        ret = -1;
+    }
+    free(tmp);
+    return ret;
+}
+
+/* Removes the pages of an entry, and the entry itself if whole is true.
+ * Returns the number of page bytes removed. */
+static uintmax_t dcache_remove(const char *path, bool whole)
+{
+    DIR *dir = vlc_opendir(path);
+    if (dir == NULL)
+        return 0;
+
+    uintmax_t removed = 0;
+    const char *name;
+
+    while ((name = vlc_readdir(dir)) != NULL)
+    {
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+
+        bool page = dcache_is_page(name);
+        if (!page && !whole)
+            continue;
+
+        char *file = dcache_path(path, name);
+        if (file == NULL)
+            continue;
+
+        struct stat st;
+        if (page && vlc_stat(file, &st) == 0)
+            removed += st.st_size;
+        vlc_unlink(file);
+        free(file);
+    }
+    closedir(dir);
+
+    if (whole)
+        rmdir(path);
+    return removed;
+}
+
+/* Sums the sizes of the pages of an entry */
+static uintmax_t dcache_entry_usage(const char *path)
+{
+    DIR *dir = vlc_opendir(path);
+    if (dir == NULL)
+        return 0;
+
+    uintmax_t total = 0;
+    const char *name;
+
+    while ((name = vlc_readdir(dir)) != NULL)
+    {
+        if (!dcache_is_page(name))
+            continue;
+
+        char *file = dcache_path(path, name);
+        struct stat st;
+
+        if (file != NULL && vlc_stat(file, &st) == 0)
+            total += st.st_size;
+        free(file);
+    }
+    closedir(dir);
+    return total;
+}
+
+/*** Eviction ***/
+
+struct dcache_victim
+{
+    char *path;
+    time_t mtime;
+    uintmax_t size;
+};
+
+static int dcache_victim_cmp(const void *a, const void *b)
+{
+    const struct dcache_victim *va = a, *vb = b;
+
+    return (va->mtime > vb->mtime) - (va->mtime < vb->mtime);
+}
+
+/* Scans the cache directory, and evicts the least recently used entries
+ * (but keep) until the cache is back under 90% of its budget.
+ * Called with the lock held. */
+static void dcache_evict(struct vlc_http_dcache *cache, const char *keep)
+{
+    DIR *dir = vlc_opendir(cache->dir);
+    if (dir == NULL)
+        return;
+
+    struct dcache_victim *tab = NULL;
+    size_t count = 0, alloc = 0;
+    uintmax_t total = 0;
+    const char *name;
+
+    while ((name = vlc_readdir(dir)) != NULL)
+    {
+        if (name[0] == '.')
+            continue;
+
+        char *path = dcache_path(cache->dir, name);
+        if (path == NULL)
+            continue;
+
+        struct stat st;
+        char *meta = dcache_path(path, "meta");
+        if (meta == NULL || vlc_stat(meta, &st))
+            st.st_mtime = 0; /* incomplete entries go first */
+        free(meta);
+
+        uintmax_t size = dcache_entry_usage(path);
+        total += size;
+
+        if ((keep != NULL && !strcmp(path, keep)) || count >= SIZE_MAX / 2)
+        {
+            free(path);
+            continue;
+        }
+
+        if (count == alloc)
+        {
+            size_t n = alloc ? 2 * alloc : 64;
+            struct dcache_victim *ntab = realloc(tab, n * sizeof (*tab));
+            if (unlikely(ntab == NULL))
+            {
+                free(path);
+                break;
+            }
+            tab = ntab;
+            alloc = n;
+        }
+        tab[count].path = path;
+        tab[count].mtime = st.st_mtime;
+        tab[count].size = size;
+        count++;
+    }
+    closedir(dir);
+
+    if (count > 0)
+        qsort(tab, count, sizeof (*tab), dcache_victim_cmp);
+
+    const uintmax_t target = cache->budget / 10 * 9;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (total > target)
+        {
+            uintmax_t removed = dcache_remove(tab[i].path, true);
+            total -= (removed < total) ? removed : total;
+            cache->stats.evicted_bytes += removed;
+        }
+        free(tab[i].path);
+    }
+    free(tab);
+    cache->used = total;
+}
+
+static void dcache_account(struct vlc_http_dcache *cache, uintmax_t added,
+                           uintmax_t removed, const char *keep)
+{
+    vlc_mutex_lock(&cache->lock);
+    cache->used += added;
+    cache->used -= (removed < cache->used) ? removed : cache->used;
+    cache->stats.stored_bytes += added;
+    if (cache->used > cache->budget)
+        dcache_evict(cache, keep);
+    vlc_mutex_unlock(&cache->lock);
+}
+
+/*** Cache ***/
+
+struct vlc_http_dcache *vlc_http_dcache_create(vlc_object_t *obj)
+{
+    int64_t size = var_InheritInteger(obj, "http-disk-cache-size");
+    if (size <= 0)
+        return NULL;
+
+    struct vlc_http_dcache *cache = malloc(sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    cache->dir = var_InheritString(obj, "http-disk-cache-dir");
+    if (cache->dir == NULL)
+    {
+        char *base = config_GetUserDir(VLC_CACHE_DIR);
+        if (base != NULL)
+        {
+            cache->dir = dcache_path(base, "http");
+            free(base);
+        }
+    }
+
+    if (cache->dir == NULL || dcache_mkdir(cache->dir))
+    {
+        free(cache->dir);
+        free(cache);
+        return NULL;
+    }
+
+    cache->budget = (uintmax_t)size << 20;
+    vlc_mutex_init(&cache->lock);
+    memset(&cache->stats, 0, sizeof (cache->stats));
+
+    vlc_mutex_lock(&cache->lock);
+    dcache_evict(cache, NULL);
+    vlc_mutex_unlock(&cache->lock);
+    return cache;
+}
+
+void vlc_http_dcache_destroy(struct vlc_http_dcache *cache)
+{
+    vlc_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    free(cache);
+}
+
+void vlc_http_dcache_get_stats(struct vlc_http_dcache *cache,
+                               struct vlc_http_dcache_stats *stats)
+{
+    vlc_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    vlc_mutex_unlock(&cache->lock);
+}
+
+/*** Metadata ***/
+
+static void dcache_load_meta(struct vlc_http_dcache_entry *e)
+{
+    char *path = dcache_path(e->path, "meta");
+    if (path == NULL)
+        return;
+
+    FILE *stream = vlc_fopen(path, "rt");
+    free(path);
+    if (stream == NULL)
+        return;
+
+    char *line = NULL;
+    size_t linelen = 0;
+    char *url = NULL;
+    ssize_t len;
+
+    while ((len = getline(&line, &linelen, stream)) >= 0)
+    {
+        char *value = strchr(line, ' ');
+        if (value == NULL)
+            continue;
+        *(value++) = '\0';
+        value[strcspn(value, "\r\n")] = '\0';
+
+        if (!strcmp(line, "url:"))
+            url = strdup(value);
+        else if (!strcmp(line, "etag:"))
+            e->etag = strdup(value);
+        else if (!strcmp(line, "last-modified:"))
+            e->last_modified = strdup(value);
+        else if (!strcmp(line, "content-type:"))
+            e->content_type = strdup(value);
+        else if (!strcmp(line, "size:"))
+            e->size = strtoumax(value, NULL, 10);
+        else if (!strcmp(line, "expires:"))
+            e->expires = strtoll(value, NULL, 10);
+    }
+    free(line);
+    fclose(stream);
+
+    /* Mismatching URL: digest collision, or garbage */
+    if (url != NULL && !strcmp(url, e->url))
+        e->stored = e->storable = true;
+    else
+    {
+        free(e->etag);
+        free(e->last_modified);
+        free(e->content_type);
+        e->etag = e->last_modified = e->content_type = NULL;
+        e->size = UINTMAX_MAX;
+        e->expires = 0;
+    }
+    free(url);
+}
+
+static int dcache_store_meta(struct vlc_http_dcache_entry *e)
+{
+    char *path = dcache_path(e->path, "meta");
+    char *str;
+    int len;
+
+    if (path == NULL)
+        return -1;
+
+    len = asprintf(&str, "url: %s\netag: %s\nlast-modified: %s\n"
+                   "content-type: %s\nsize: %ju\nexpires: %lld\n", e->url,
+                   e->etag ? e->etag : "",
+                   e->last_modified ? e->last_modified : "",
+                   e->content_type ? e->content_type : "", e->size,
+                   (long long)e->expires);
+    if (len < 0)
+    {
+        free(path);
+        return -1;
+    }
+
+    int ret = -1;
+    if (dcache_mkdir(e->path) == 0)
+        ret = dcache_write_file(path, str, len);
+    free(str);
+    free(path);
+
+    if (ret == 0)
+        e->stored = true;
+    return ret;
+}
+
+/*** Entries ***/
+
+struct vlc_http_dcache_entry *vlc_http_dcache_open(struct vlc_http_dcache *c,
+                                                   const char *url)
+{
+    struct vlc_http_dcache_entry *e = malloc(sizeof (*e));
+    if (unlikely(e == NULL))
+        return NULL;
+
+    struct md5_s md5;
+    InitMD5(&md5);
+    AddMD5(&md5, url, strlen(url));
+    EndMD5(&md5);
+
+    char *key = psz_md5_hash(&md5);
+    e->path = (key != NULL) ? dcache_path(c->dir, key) : NULL;
+    e->url = strdup(url);
+    free(key);
+    if (unlikely(e->path == NULL || e->url == NULL))
+    {
+        free(e->url);
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+
+    e->cache = c;
+    e->etag = e->last_modified = e->content_type = NULL;
+    e->size = UINTMAX_MAX;
+    e->expires = 0;
+    e->stored = e->storable = e->used = false;
+    e->fd = -1;
+    e->page = NULL;
+    e->page_length = 0;
+
+    dcache_load_meta(e);
+    return e;
+}
+
+void vlc_http_dcache_close(struct vlc_http_dcache_entry *e)
+{
+    /* Rewriting the metadata marks the entry as recently used */
+    if (e->used && e->storable)
+        dcache_store_meta(e);
+
+    if (e->fd != -1)
+        vlc_close(e->fd);
+    free(e->page);
+    free(e->content_type);
+    free(e->last_modified);
+    free(e->etag);
+    free(e->url);
+    free(e->path);
+    free(e);
+}
+
+bool vlc_http_dcache_is_fresh(const struct vlc_http_dcache_entry *e)
+{
+    return e->stored && e->expires > time(NULL);
+}
+
+char *vlc_http_dcache_get_type(const struct vlc_http_dcache_entry *e)
+{
+    return !dcache_empty(e->content_type) ? strdup(e->content_type) : NULL;
+}
+
+uintmax_t vlc_http_dcache_get_size(const struct vlc_http_dcache_entry *e)
+{
+    return e->size;
+}
+
+/* Expected length of a stored page */
+static size_t dcache_page_length(const struct vlc_http_dcache_entry *e,
+                                 uintmax_t index)
+{
+    if (e->size != UINTMAX_MAX && e->size / PAGE_SIZE == index)
+        return e->size % PAGE_SIZE;
+    return PAGE_SIZE;
+}
+
+/* Opens a stored page for reading */
+static int dcache_open_page(struct vlc_http_dcache_entry *e, uintmax_t index)
+{
+    if (e->fd != -1 && e->fd_index == index)
+        return 0;
+
+    if (e->fd != -1)
+    {
+        vlc_close(e->fd);
+        e->fd = -1;
+    }
+
+    if (!e->stored)
+        return -1;
+
+    char *path = dcache_page_path(e, index);
+    if (path == NULL)
+        return -1;
+
+    int fd = vlc_open(path, O_RDONLY);
+    free(path);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size != dcache_page_length(e, index))
+    {
+        vlc_close(fd);
+        return -1;
+    }
+
+    e->fd = fd;
+    e->fd_index = index;
+    e->fd_size = st.st_size;
+    return 0;
+}
+
+bool vlc_http_dcache_has(const struct vlc_http_dcache_entry *e,
+                         uintmax_t offset, uintmax_t length)
+{
+    uintmax_t end;
+
+    if (!e->stored)
+        return false;
+
+    if (length == UINTMAX_MAX || length > UINTMAX_MAX - offset)
+    {
+        if (e->size == UINTMAX_MAX)
+            return false;
+        end = e->size;
+    }
+    else
+        end = offset + length;
+
+    if (e->size != UINTMAX_MAX && end > e->size)
+        end = e->size;
+
+    for (uintmax_t index = offset / PAGE_SIZE; index * PAGE_SIZE < end;
+         index++)
+    {
+        char *path = dcache_page_path(e, index);
+        struct stat st;
+        bool ok = path != NULL && vlc_stat(path, &st) == 0
+               && (size_t)st.st_size == dcache_page_length(e, index);
+
+        free(path);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+ssize_t vlc_http_dcache_read(struct vlc_http_dcache_entry *e,
+                             uintmax_t offset, void *buf, size_t len)
+{
+    if (e->size != UINTMAX_MAX && offset >= e->size)
+        return 0;
+
+    uintmax_t index = offset / PAGE_SIZE;
+    size_t pos = offset % PAGE_SIZE;
+
+    if (dcache_open_page(e, index) || pos >= e->fd_size)
+        return -1;
+
+    if (len > e->fd_size - pos)
+        len = e->fd_size - pos;
+
+    if (lseek(e->fd, pos, SEEK_SET) != (off_t)pos)
+        return -1;
+
+    ssize_t val = read(e->fd, buf, len);
+    if (val <= 0)
+        return -1;
+
+    e->used = true;
+    vlc_mutex_lock(&e->cache->lock);
+    e->cache->stats.hit_bytes += val;
+    vlc_mutex_unlock(&e->cache->lock);
+    return val;
+}
+
+static void dcache_purge(struct vlc_http_dcache_entry *e, bool whole)
+{
+    if (e->fd != -1)
+    {
+        vlc_close(e->fd);
+        e->fd = -1;
+    }
+    e->page_length = 0;
+
+    dcache_account(e->cache, 0, dcache_remove(e->path, whole), NULL);
+    if (whole)
+        e->stored = false;
+}
+
+static bool dcache_differ(const char *a, const char *b)
+{
+    return a == NULL || b == NULL || strcmp(a, b);
+}
+
+void vlc_http_dcache_update(struct vlc_http_dcache_entry *e,
+                            const struct vlc_http_dcache_info *info)
+{
+    bool no_store = false, no_cache = false;
+    long long max_age = -1;
+
+    if (info->cache_control != NULL)
+    {
+        const char *p = info->cache_control;
+
+        while (*p != '\0')
+        {
+            p += strspn(p, " \t,");
+
+            size_t len = strcspn(p, " \t,=");
+            if (len == 8 && !vlc_ascii_strncasecmp(p, "no-store", 8))
+                no_store = true;
+            else
+            if (len == 8 && !vlc_ascii_strncasecmp(p, "no-cache", 8))
+                no_cache = true;
+            else
+            if (len == 7 && !vlc_ascii_strncasecmp(p, "max-age", 7)
+             && p[7] == '=')
+                max_age = strtoll(p + 8, NULL, 10);
+            p += len;
+            p += strcspn(p, ",");
+        }
+    }
+
+    if (no_cache)
+        max_age = -1;
+
+    const char *etag = info->etag;
+    const char *last_modified = info->last_modified;
+
+    if (e->stored)
+    {
+        bool changed;
+
+        /* Strong comparison of the validators */
+        if (etag != NULL || !dcache_empty(e->etag))
+            changed = dcache_differ(etag, e->etag);
+        else if (last_modified != NULL || !dcache_empty(e->last_modified))
+            changed = dcache_differ(last_modified, e->last_modified);
+        else
+            changed = max_age <= 0;
+
+        if (info->size != UINTMAX_MAX && e->size != UINTMAX_MAX
+         && info->size != e->size)
+            changed = true;
+
+        if (changed)
+        {
+            dcache_purge(e, false);
+            e->size = UINTMAX_MAX;
+        }
+    }
+
+    if (no_store || (etag == NULL && last_modified == NULL && max_age <= 0))
+    {
+        /* Cannot be used later */
+        if (e->stored)
+            dcache_purge(e, true);
+        e->storable = false;
+        return;
+    }
+
+    free(e->etag);
+    free(e->last_modified);
+    e->etag = strdup(etag != NULL ? etag : "");
+    e->last_modified = strdup(last_modified != NULL ? last_modified : "");
+    if (info->content_type != NULL)
+    {
+        free(e->content_type);
+        e->content_type = strdup(info->content_type);
+    }
+    if (info->size != UINTMAX_MAX)
+        e->size = info->size;
+    e->expires = (max_age > 0) ? time(NULL) + max_age : 0;
+
+    if (unlikely(e->etag == NULL || e->last_modified == NULL))
+    {
+        e->storable = false;
+        return;
+    }
+
+    e->storable = dcache_store_meta(e) == 0;
+}
+
+static void dcache_store_page(struct vlc_http_dcache_entry *e)
+{
+    char *path = dcache_page_path(e, e->page_index);
+
+    if (path != NULL
+     && dcache_write_file(path, e->page, e->page_length) == 0)
+    {
+        e->used = true;
+        dcache_account(e->cache, e->page_length, 0, e->path);
+    }
+    free(path);
+    e->page_length = 0;
+}
+
+void vlc_http_dcache_write(struct vlc_http_dcache_entry *e, uintmax_t offset,
+                           const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+
+    vlc_mutex_lock(&e->cache->lock);
+    e->cache->stats.miss_bytes += len;
+    vlc_mutex_unlock(&e->cache->lock);
+
+    if (!e->storable)
+        return;
+
+    if (e->page == NULL)
+    {
+        e->page = malloc(PAGE_SIZE);
+        if (unlikely(e->page == NULL))
+            return;
+    }
+
+    while (len > 0)
+    {
+        uintmax_t index = offset / PAGE_SIZE;
+        size_t pos = offset % PAGE_SIZE;
+        size_t copy = PAGE_SIZE - pos;
+
+        if (copy > len)
+            copy = len;
+
+        if (e->page_length == 0 || e->page_index != index
+         || e->page_length != pos)
+        {
+            e->page_length = 0;
+
+            /* Pages are only stored whole */
+            if (pos != 0)
+            {
+                offset += copy;
+                p += copy;
+                len -= copy;
+                continue;
+            }
+            e->page_index = index;
+        }
+
+        memcpy(e->page + pos, p, copy);
+        e->page_length += copy;
+        offset += copy;
+        p += copy;
+        len -= copy;
+
+        if (e->page_length == PAGE_SIZE
+         || (e->size != UINTMAX_MAX && offset == e->size))
+            dcache_store_page(e);
+    }
+}
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * diskcache.h: persistent HTTP cache
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_HTTP_DISKCACHE_H
+#define VLC_HTTP_DISKCACHE_H 1
+
+#include <stdint.h>
+
+/**
+ * \defgroup http_dcache Disk cache
+ * Persistent cache of HTTP resources on local storage
+ * \ingroup http
+ *
+ * Each resource is stored under the MD5 digest of its URL, as fixed-size
+ * pages. Pages are stored as soon as they are complete, so that partially
+ * downloaded resources and byte ranges are cached as well. Cached pages are
+ * dropped when the entity validators (ETag, Last-Modified) or the size
+ * change. The least recently used resources are evicted to stay within the
+ * configured size.
+ *
+ * The cache directory may be shared by several cache instances, including
+ * from different processes: each file is replaced atomically.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VLC_HTTP_DCACHE_PAGE_SIZE (1 << 20)
+
+struct vlc_http_dcache;
+struct vlc_http_dcache_entry;
+
+/** Response metadata */
+struct vlc_http_dcache_info
+{
+    const char *etag; /**< ETag header, or NULL */
+    const char *last_modified; /**< Last-Modified header, or NULL */
+    const char *cache_control; /**< Cache-Control header, or NULL */
+    const char *content_type; /**< Content-Type header, or NULL */
+    uintmax_t size; /**< total size, or UINTMAX_MAX if unknown */
+};
+
+struct vlc_http_dcache_stats
+{
+    uintmax_t hit_bytes; /**< bytes read from the cache */
+    uintmax_t miss_bytes; /**< bytes fetched from the network */
+    uintmax_t stored_bytes; /**< bytes written to the cache */
+    uintmax_t evicted_bytes; /**< bytes evicted from the cache */
+};
+
+/**
+ * Opens the disk cache.
+ *
+ * The cache directory and size are taken from the http-disk-cache-dir and
+ * http-disk-cache-size options of the given object.
+ *
+ * @return a cache instance, or NULL if disabled or on error
+ */
+struct vlc_http_dcache *vlc_http_dcache_create(vlc_object_t *obj);
+
+/**
+ * Closes the disk cache.
+ *
+ * All entries must have been closed.
+ */
+void vlc_http_dcache_destroy(struct vlc_http_dcache *);
+
+void vlc_http_dcache_get_stats(struct vlc_http_dcache *,
+                               struct vlc_http_dcache_stats *);
+
+/**
+ * Opens a cache entry.
+ *
+ * Loads the metadata of an already cached resource, if any. An entry is
+ * returned even if nothing is cached yet for the URL.
+ *
+ * @param url resource URL
+ * @return a cache entry, or NULL on memory error
+ */
+struct vlc_http_dcache_entry *vlc_http_dcache_open(struct vlc_http_dcache *,
+                                                   const char *url);
+
+/**
+ * Closes a cache entry.
+ *
+ * Any incomplete page is discarded, except the last page of a resource of
+ * known size.
+ */
+void vlc_http_dcache_close(struct vlc_http_dcache_entry *);
+
+/**
+ * Checks if the cached data can be used without revalidation.
+ *
+ * This is the case if the resource was stored with a Cache-Control max-age
+ * that has not expired yet, and without no-cache.
+ */
+bool vlc_http_dcache_is_fresh(const struct vlc_http_dcache_entry *);
+
+/**
+ * Checks if a byte range is fully cached.
+ *
+ * @param offset start offset
+ * @param length range length, or UINTMAX_MAX for the rest of the resource
+ *               (which requires the size to be known)
+ */
+bool vlc_http_dcache_has(const struct vlc_http_dcache_entry *,
+                         uintmax_t offset, uintmax_t length);
+
+/**
+ * Gets the content type stored with the entry.
+ *
+ * @return a heap-allocated string, or NULL if unknown
+ */
+char *vlc_http_dcache_get_type(const struct vlc_http_dcache_entry *);
+
+/**
+ * Gets the resource size stored with the entry.
+ *
+ * @return the size, or UINTMAX_MAX if unknown
+ */
+uintmax_t vlc_http_dcache_get_size(const struct vlc_http_dcache_entry *);
+
+/**
+ * Updates the entry from a network response.
+ *
+ * Drops the cached data if the entity validators or size differ from the
+ * stored ones. Storing is disabled if the response forbids it (no-store)
+ * or cannot be revalidated later (no validators nor max-age).
+ */
+void vlc_http_dcache_update(struct vlc_http_dcache_entry *,
+                            const struct vlc_http_dcache_info *);
+
+/**
+ * Reads cached data.
+ *
+ * Reads up to the end of the page containing the offset.
+ *
+ * @return the number of bytes read, 0 at the known end of the resource,
+ *         or -1 if the data is not cached
+ */
+ssize_t vlc_http_dcache_read(struct vlc_http_dcache_entry *,
+                             uintmax_t offset, void *buf, size_t len);
+
+/**
+ * Stores data fetched from the network.
+ *
+ * Data is assembled into pages, which are stored once complete.
+ * Data must be written contiguously; a discontinuity discards the current
+ * incomplete page. This has no effect until vlc_http_dcache_update() has
+ * allowed storing.
+ */
+void vlc_http_dcache_write(struct vlc_http_dcache_entry *,
+                           uintmax_t offset, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
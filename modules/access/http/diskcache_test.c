@@ -0,0 +1,283 @@
+/*****************************************************************************
+ * diskcache_test.c: HTTP disk cache test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include "diskcache.h"
+
+#define PAGE VLC_HTTP_DCACHE_PAGE_SIZE
+#define SIZE (5 * PAGE / 2)
+
+static char dir[] = "/tmp/vlc-http-dcache-XXXXXX";
+static unsigned char data[SIZE];
+
+int var_Inherit(vlc_object_t *obj, const char *name, int type,
+                vlc_value_t *val)
+{
+    (void) obj; (void) type;
+
+    if (!strcmp(name, "http-disk-cache-size"))
+        val->i_int = 16; /* MiB */
+    else if (!strcmp(name, "http-disk-cache-dir"))
+        val->psz_string = strdup(dir);
+    else
+        assert(!"unexpected variable");
+    return VLC_SUCCESS;
+}
+
+static const struct vlc_http_dcache_info info = {
+    .etag = "\"v1\"",
+    .last_modified = "Mon, 01 Jan 2018 00:00:00 GMT",
+    .cache_control = "public, max-age=3600",
+    .content_type = "video/mp4",
+    .size = SIZE,
+};
+
+static void write_range(struct vlc_http_dcache_entry *e, size_t offset,
+                        size_t length)
+{
+    /* Odd chunk sizes, as from the network */
+    while (length > 0)
+    {
+        size_t len = length < 3001 ? length : 3001;
+
+        vlc_http_dcache_write(e, offset, data + offset, len);
+        offset += len;
+        length -= len;
+    }
+}
+
+static void check_range(struct vlc_http_dcache_entry *e, size_t offset,
+                        size_t length)
+{
+    static unsigned char buf[PAGE];
+
+    while (length > 0)
+    {
+        ssize_t val = vlc_http_dcache_read(e, offset, buf, sizeof (buf));
+
+        assert(val > 0);
+        if ((size_t)val > length)
+            val = length;
+        assert(!memcmp(buf, data + offset, val));
+        offset += val;
+        length -= val;
+    }
+}
+
+static void test_whole(struct vlc_http_dcache *cache)
+{
+    struct vlc_http_dcache_entry *e;
+    char *type;
+
+    e = vlc_http_dcache_open(cache, "http://example.com/whole");
+    assert(e != NULL);
+    assert(!vlc_http_dcache_is_fresh(e));
+    assert(!vlc_http_dcache_has(e, 0, 1));
+    assert(vlc_http_dcache_get_size(e) == UINTMAX_MAX);
+    assert(vlc_http_dcache_read(e, 0, data, 1) == -1);
+
+    /* Not stored before the response is known */
+    write_range(e, 0, PAGE);
+    assert(!vlc_http_dcache_has(e, 0, 1));
+
+    vlc_http_dcache_update(e, &info);
+    write_range(e, 0, SIZE);
+    assert(vlc_http_dcache_has(e, 0, UINTMAX_MAX));
+    vlc_http_dcache_close(e);
+
+    e = vlc_http_dcache_open(cache, "http://example.com/whole");
+    assert(e != NULL);
+    assert(vlc_http_dcache_is_fresh(e));
+    assert(vlc_http_dcache_get_size(e) == SIZE);
+    type = vlc_http_dcache_get_type(e);
+    assert(type != NULL && !strcmp(type, "video/mp4"));
+    free(type);
+    assert(vlc_http_dcache_has(e, 0, UINTMAX_MAX));
+    assert(vlc_http_dcache_has(e, SIZE - 10, 1000));
+    check_range(e, 0, SIZE);
+    check_range(e, PAGE + 123, 4567);
+    assert(vlc_http_dcache_read(e, SIZE, data, 1) == 0);
+
+    /* Same entity: kept */
+    vlc_http_dcache_update(e, &info);
+    assert(vlc_http_dcache_has(e, 0, UINTMAX_MAX));
+
+    /* Changed entity: dropped */
+    struct vlc_http_dcache_info changed = info;
+    changed.etag = "\"v2\"";
+    vlc_http_dcache_update(e, &changed);
+    assert(!vlc_http_dcache_has(e, 0, 1));
+    assert(vlc_http_dcache_read(e, 0, data, 1) == -1);
+    vlc_http_dcache_close(e);
+}
+
+static void test_range(struct vlc_http_dcache *cache)
+{
+    struct vlc_http_dcache_entry *e;
+
+    e = vlc_http_dcache_open(cache, "http://example.com/range");
+    assert(e != NULL);
+    vlc_http_dcache_update(e, &info);
+
+    /* The incomplete first page is not stored */
+    write_range(e, PAGE / 2, 3 * PAGE / 2);
+    assert(!vlc_http_dcache_has(e, PAGE / 2, 1));
+    assert(vlc_http_dcache_has(e, PAGE, PAGE / 2));
+    assert(!vlc_http_dcache_has(e, PAGE, PAGE + 1));
+
+    /* Discontinuity */
+    write_range(e, 2 * PAGE, 1000);
+    write_range(e, 2 * PAGE + 2000, SIZE - 2 * PAGE - 2000);
+    assert(!vlc_http_dcache_has(e, 2 * PAGE, 1));
+
+    /* The last page is shorter */
+    write_range(e, 2 * PAGE, SIZE - 2 * PAGE);
+    assert(vlc_http_dcache_has(e, PAGE, UINTMAX_MAX));
+    check_range(e, PAGE, SIZE - PAGE);
+    vlc_http_dcache_close(e);
+}
+
+static void test_no_store(struct vlc_http_dcache *cache)
+{
+    struct vlc_http_dcache_entry *e;
+    struct vlc_http_dcache_info nostore = info;
+
+    e = vlc_http_dcache_open(cache, "http://example.com/nostore");
+    assert(e != NULL);
+    nostore.cache_control = "no-store";
+    vlc_http_dcache_update(e, &nostore);
+    write_range(e, 0, SIZE);
+    assert(!vlc_http_dcache_has(e, 0, 1));
+    vlc_http_dcache_close(e);
+
+    /* No validators, must be revalidated: useless */
+    e = vlc_http_dcache_open(cache, "http://example.com/nocache");
+    assert(e != NULL);
+    nostore.etag = nostore.last_modified = NULL;
+    nostore.cache_control = "no-cache, max-age=60";
+    vlc_http_dcache_update(e, &nostore);
+    write_range(e, 0, SIZE);
+    assert(!vlc_http_dcache_has(e, 0, 1));
+    vlc_http_dcache_close(e);
+
+    /* Validators, must be revalidated: stored but not fresh */
+    e = vlc_http_dcache_open(cache, "http://example.com/nocache");
+    assert(e != NULL);
+    nostore.etag = "\"x\"";
+    vlc_http_dcache_update(e, &nostore);
+    write_range(e, 0, SIZE);
+    assert(vlc_http_dcache_has(e, 0, UINTMAX_MAX));
+    assert(!vlc_http_dcache_is_fresh(e));
+    vlc_http_dcache_close(e);
+}
+
+static void test_evict(struct vlc_http_dcache *cache)
+{
+    struct vlc_http_dcache_stats stats;
+    char url[64];
+
+    for (unsigned i = 0; i < 8; i++)
+    {
+        snprintf(url, sizeof (url), "http://example.com/evict/%u", i);
+
+        struct vlc_http_dcache_entry *e = vlc_http_dcache_open(cache, url);
+        assert(e != NULL);
+        vlc_http_dcache_update(e, &info);
+        write_range(e, 0, SIZE);
+        /* The entry being written is never evicted */
+        assert(vlc_http_dcache_has(e, 0, UINTMAX_MAX));
+        vlc_http_dcache_close(e);
+    }
+
+    vlc_http_dcache_get_stats(cache, &stats);
+    assert(stats.evicted_bytes > 0);
+}
+
+static void remove_tree(const char *path)
+{
+    DIR *d = opendir(path);
+    struct dirent *ent;
+
+    if (d == NULL)
+    {
+        unlink(path);
+        return;
+    }
+
+    while ((ent = readdir(d)) != NULL)
+    {
+        char *sub;
+
+        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+            continue;
+        if (asprintf(&sub, "%s/%s", path, ent->d_name) >= 0)
+        {
+            remove_tree(sub);
+            free(sub);
+        }
+    }
+    closedir(d);
+    rmdir(path);
+}
+
+int main(void)
+{
+    struct vlc_http_dcache *cache;
+    struct vlc_http_dcache_stats stats;
+
+    for (size_t i = 0; i < sizeof (data); i++)
+        data[i] = i ^ (i >> 8) ^ (i >> 16);
+
+    assert(mkdtemp(dir) != NULL);
+
+    cache = vlc_http_dcache_create(NULL);
+    assert(cache != NULL);
+
+    test_whole(cache);
+    test_range(cache);
+    test_no_store(cache);
+    vlc_http_dcache_get_stats(cache, &stats);
+    assert(stats.hit_bytes > 0);
+    assert(stats.miss_bytes > 0);
+    assert(stats.evicted_bytes == 0);
+    test_evict(cache);
+    vlc_http_dcache_destroy(cache);
+
+    /* Reopening trims the cache to size */
+    cache = vlc_http_dcache_create(NULL);
+    assert(cache != NULL);
+    vlc_http_dcache_destroy(cache);
+
+    remove_tree(dir);
+    return 0;
+}
@@ -276,10 +276,11 @@ int main(void)
 #include "h2frame.h"
 
 struct vlc_h2_frame *
-vlc_h2_frame_headers(uint_fast32_t id, uint_fast32_t mtu, bool eos,
+vlc_h2_frame_headers(struct hpack_encoder *enc, uint_fast32_t id,
+                     uint_fast32_t mtu, bool eos,
                      unsigned count, const char *const tab[][2])
 {
-    (void) id; (void) mtu; (void) count, (void) tab;
+    (void) enc; (void) id; (void) mtu; (void) count, (void) tab;
     assert(!eos);
     return NULL;
 }
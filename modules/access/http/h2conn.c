@@ -26,6 +26,8 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
@@ -39,6 +41,7 @@
 
 #include "h2frame.h"
 #include "h2output.h"
+#include "hpack.h"
 #include "conn.h"
 #include "message.h"
 
@@ -50,10 +53,13 @@ struct vlc_h2_conn
 {
     struct vlc_http_conn conn;
     struct vlc_h2_output *out; /**< Send thread */
+    struct hpack_encoder *encoder; /**< Header compression state */
     void *opaque;
 
     struct vlc_h2_stream *streams; /**< List of open streams */
     uint32_t next_id; /**< Next free stream identifier */
+    uint32_t last_push_id; /**< Latest promised stream identifier */
+    unsigned pushes; /**< Number of unclaimed pushed streams */
     bool released; /**< Connection released by owner */
 
     vlc_mutex_t lock; /**< State machine lock */
@@ -70,6 +76,7 @@ struct vlc_h2_stream
     struct vlc_h2_stream *older; /**< Previous open stream in connection */
     struct vlc_h2_stream *newer; /**< Next open stream in connection */
     uint32_t id; /**< Stream 31-bits identifier */
+    struct vlc_http_msg *push_req; /**< Promised request if unclaimed push */
 
     bool interrupted;
     bool recv_end; /**< End-of-stream flag */
@@ -329,21 +336,11 @@ static block_t *vlc_h2_stream_read(struct vlc_http_stream *stream)
     return block;
 }
 
-/**
- * Terminates a stream.
- *
- * Sends an HTTP/2 stream reset, removes the stream from the HTTP/2 connection
- * and deletes any stream resource.
- */
-static void vlc_h2_stream_close(struct vlc_http_stream *stream, bool aborted)
+/** Removes a stream from the connection (with the lock held). */
+static void vlc_h2_stream_unlink(struct vlc_h2_stream *s)
 {
-    struct vlc_h2_stream *s =
-        container_of(stream, struct vlc_h2_stream, stream);
     struct vlc_h2_conn *conn = s->conn;
-    bool destroy = false;
-    uint_fast32_t code = VLC_H2_NO_ERROR;
 
-    vlc_mutex_lock(&conn->lock);
     if (s->older != NULL)
         s->older->newer = s->newer;
     if (s->newer != NULL)
@@ -352,16 +349,27 @@ static void vlc_h2_stream_close(struct vlc_http_stream *stream, bool aborted)
     {
         assert(conn->streams == s);
         conn->streams = s->older;
-        destroy = (conn->streams == NULL) && conn->released;
     }
-    vlc_mutex_unlock(&conn->lock);
+
+    if (s->push_req != NULL)
+    {
+        assert(conn->pushes > 0);
+        conn->pushes--;
+    }
+}
+
+/** Resets and deletes an unlinked stream. */
+static void vlc_h2_stream_destroy(struct vlc_h2_stream *s)
+{
+    uint_fast32_t code = VLC_H2_NO_ERROR;
 
     if (s->recv_hdr != NULL || s->recv_head != NULL || !s->recv_end)
         code = VLC_H2_CANCEL;
-    (void) aborted;
 
-    vlc_h2_stream_error(conn, s->id, code);
+    vlc_h2_stream_error(s->conn, s->id, code);
 
+    if (s->push_req != NULL)
+        vlc_http_msg_destroy(s->push_req);
     if (s->recv_hdr != NULL)
         vlc_http_msg_destroy(s->recv_hdr);
 
@@ -373,6 +381,28 @@ static void vlc_h2_stream_close(struct vlc_http_stream *stream, bool aborted)
 
     vlc_cond_destroy(&s->recv_wait);
     free(s);
+}
+
+/**
+ * Terminates a stream.
+ *
+ * Sends an HTTP/2 stream reset, removes the stream from the HTTP/2 connection
+ * and deletes any stream resource.
+ */
+static void vlc_h2_stream_close(struct vlc_http_stream *stream, bool aborted)
+{
+    struct vlc_h2_stream *s =
+        container_of(stream, struct vlc_h2_stream, stream);
+    struct vlc_h2_conn *conn = s->conn;
+    bool destroy;
+
+    vlc_mutex_lock(&conn->lock);
+    vlc_h2_stream_unlink(s);
+    destroy = (conn->streams == NULL) && conn->released;
+    vlc_mutex_unlock(&conn->lock);
+    (void) aborted;
+
+    vlc_h2_stream_destroy(s);
 
     if (destroy)
         vlc_h2_conn_destroy(conn);
@@ -385,22 +415,72 @@ static const struct vlc_http_stream_cbs vlc_h2_stream_callbacks =
     vlc_h2_stream_close,
 };
 
+/* Server push */
+
 /**
- * Creates a stream.
- *
- * Allocates a locally-initiated stream identifier on an HTTP/2 connection and
- * queue stream headers for sending.
+ * Checks if a promised request can serve a request.
  *
- * Headers are sent asynchronously. To obtain the result and answer from the
- * other end, use vlc_http_stream_recv_headers().
+ * Pushed responses are complete representations, so they can serve requests
+ * for the whole resource, which the file resource sends as a range from
+ * offset zero.
+ */
+static bool vlc_h2_push_match(const struct vlc_http_msg *promise,
+                              const struct vlc_http_msg *req)
+{
+    const char *method = vlc_http_msg_get_method(req);
+    const char *a, *b;
+
+    if (method == NULL || strcmp(method, vlc_http_msg_get_method(promise)))
+        return false;
+
+    a = vlc_http_msg_get_scheme(req);
+    b = vlc_http_msg_get_scheme(promise);
+    if (a == NULL || b == NULL || strcasecmp(a, b))
+        return false;
+
+    a = vlc_http_msg_get_authority(req);
+    b = vlc_http_msg_get_authority(promise);
+    if (a == NULL || b == NULL || strcasecmp(a, b))
+        return false;
+
+    a = vlc_http_msg_get_path(req);
+    b = vlc_http_msg_get_path(promise);
+    if (a == NULL || b == NULL || strcmp(a, b))
+        return false;
+
+    const char *range = vlc_http_msg_get_header(req, "Range");
+    return range == NULL || !strcmp(range, "bytes=0-");
+}
+
+/**
+ * Claims a pushed stream (with the lock held).
  *
- * \param msg HTTP message headers (including response status or request)
- * \return an HTTP stream, or NULL on error
+ * Looks for an unclaimed pushed stream whose promised request matches a
+ * request. The stream is then owned by the caller, as if it had been opened
+ * with that request.
  */
-static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
-                                                const struct vlc_http_msg *msg)
+static struct vlc_h2_stream *vlc_h2_push_claim(struct vlc_h2_conn *conn,
+                                               const struct vlc_http_msg *req)
+{
+    if (conn->pushes == 0)
+        return NULL;
+
+    for (struct vlc_h2_stream *s = conn->streams; s != NULL; s = s->older)
+        if (s->push_req != NULL && vlc_h2_push_match(s->push_req, req))
+        {
+            vlc_http_dbg(CO(conn), "stream %"PRIu32" pushed for %s",
+                         s->id, vlc_http_msg_get_path(req));
+            vlc_http_msg_destroy(s->push_req);
+            s->push_req = NULL;
+            conn->pushes--;
+            return s;
+        }
+
+    return NULL;
+}
+
+static struct vlc_h2_stream *vlc_h2_stream_alloc(struct vlc_h2_conn *conn)
 {
-    struct vlc_h2_conn *conn = container_of(c, struct vlc_h2_conn, conn);
     struct vlc_h2_stream *s = malloc(sizeof (*s));
     if (unlikely(s == NULL))
         return NULL;
@@ -408,6 +488,7 @@ static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
     s->stream.cbs = &vlc_h2_stream_callbacks;
     s->conn = conn;
     s->newer = NULL;
+    s->push_req = NULL;
     s->recv_end = false;
     s->recv_err = 0;
     s->recv_hdr = NULL;
@@ -415,10 +496,52 @@ static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
     s->recv_head = NULL;
     s->recv_tailp = &s->recv_head;
     vlc_cond_init(&s->recv_wait);
+    return s;
+}
+
+/** Adds a stream to the connection (with the lock held). */
+static void vlc_h2_stream_link(struct vlc_h2_stream *s)
+{
+    struct vlc_h2_conn *conn = s->conn;
+
+    s->older = conn->streams;
+    if (s->older != NULL)
+        s->older->newer = s;
+    conn->streams = s;
+}
+
+/**
+ * Creates a stream.
+ *
+ * Allocates a locally-initiated stream identifier on an HTTP/2 connection and
+ * queue stream headers for sending.
+ *
+ * Headers are sent asynchronously. To obtain the result and answer from the
+ * other end, use vlc_http_stream_recv_headers().
+ *
+ * \param msg HTTP message headers (including response status or request)
+ * \return an HTTP stream, or NULL on error
+ */
+static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
+                                                const struct vlc_http_msg *msg)
+{
+    struct vlc_h2_conn *conn = container_of(c, struct vlc_h2_conn, conn);
+    struct vlc_h2_stream *s = vlc_h2_stream_alloc(conn);
+    if (unlikely(s == NULL))
+        return NULL;
 
     vlc_mutex_lock(&conn->lock);
     assert(!conn->released); /* Caller is buggy! */
 
+    struct vlc_h2_stream *pushed = vlc_h2_push_claim(conn, msg);
+    if (pushed != NULL)
+    {
+        vlc_mutex_unlock(&conn->lock);
+        vlc_cond_destroy(&s->recv_wait);
+        free(s);
+        return &pushed->stream;
+    }
+
     if (conn->next_id > 0x7ffffff)
     {   /* Out of stream identifiers */
         vlc_http_dbg(CO(conn), "no more stream identifiers");
@@ -428,16 +551,13 @@ static struct vlc_http_stream *vlc_h2_stream_open(struct vlc_http_conn *c,
     s->id = conn->next_id;
     conn->next_id += 2;
 
-    struct vlc_h2_frame *f = vlc_http_msg_h2_frame(msg, s->id, true);
+    struct vlc_h2_frame *f = vlc_http_msg_h2_frame(msg, conn->encoder, s->id,
+                                                   true);
     if (f == NULL)
         goto error;
 
     vlc_h2_conn_queue(conn, f);
-
-    s->older = conn->streams;
-    if (s->older != NULL)
-        s->older->newer = s;
-    conn->streams = s;
+    vlc_h2_stream_link(s);
     vlc_mutex_unlock(&conn->lock);
     return &s->stream;
 
@@ -457,6 +577,9 @@ static void vlc_h2_setting(void *ctx, uint_fast16_t id, uint_fast32_t value)
 
     vlc_http_dbg(CO(conn), "setting: %s (0x%04"PRIxFAST16"): %"PRIuFAST32,
                  vlc_h2_setting_name(id), id, value);
+
+    if (id == VLC_H2_SETTING_HEADER_TABLE_SIZE)
+        hpack_encode_resize(conn->encoder, value);
 }
 
 /** Reports end of HTTP/2 peer settings */
@@ -486,8 +609,7 @@ static void vlc_h2_error(void *ctx, uint_fast32_t code)
                      vlc_h2_strerror(code), code);
     else
         vlc_http_dbg(CO(conn), "local shutdown");
-    /* NOTE: currently, the peer cannot create a stream, so ID=0 */
-    vlc_h2_conn_queue(conn, vlc_h2_frame_goaway(0, code));
+    vlc_h2_conn_queue(conn, vlc_h2_frame_goaway(conn->last_push_id, code));
 }
 
 /** Reports a remote HTTP/2 connection error */
@@ -499,8 +621,8 @@ static int vlc_h2_reset(void *ctx, uint_fast32_t last_seq, uint_fast32_t code)
                  vlc_h2_strerror(code), code);
     vlc_http_dbg(CO(conn), "last stream: %"PRIuFAST32, last_seq);
 
-    /* NOTE: currently, the peer cannot create a stream, so ID=0 */
-    vlc_h2_conn_queue(conn, vlc_h2_frame_goaway(0, VLC_H2_NO_ERROR));
+    vlc_h2_conn_queue(conn, vlc_h2_frame_goaway(conn->last_push_id,
+                                                VLC_H2_NO_ERROR));
 
     /* Prevent adding new streams on this end. */
     conn->next_id = 0x80000000;
@@ -513,6 +635,61 @@ static int vlc_h2_reset(void *ctx, uint_fast32_t last_seq, uint_fast32_t code)
     return 0;
 }
 
+/**
+ * Reports a stream promised by the HTTP/2 peer.
+ *
+ * Accepts the pushed stream if its promised request can later be matched
+ * with a request, up to the concurrent streams limit of our settings.
+ * Otherwise refuses it.
+ */
+static int vlc_h2_push_promise(void *ctx, uint_fast32_t id,
+                               uint_fast32_t promised, unsigned count,
+                               const char *const hdrs[][2])
+{
+    struct vlc_h2_conn *conn = ctx;
+
+    if (promised <= conn->last_push_id)
+    {   /* Stream identifiers must increase */
+        vlc_h2_error(conn, VLC_H2_PROTOCOL_ERROR);
+        return -1;
+    }
+    conn->last_push_id = promised;
+
+    vlc_http_dbg(CO(conn), "stream %"PRIuFAST32" promised on stream "
+                 "%"PRIuFAST32, promised, id);
+
+    struct vlc_http_msg *req = vlc_http_msg_h2_headers(count, hdrs);
+    const char *method = (req != NULL) ? vlc_http_msg_get_method(req) : NULL;
+
+    /* Only safe methods can be pushed, and the request must be complete to
+     * be matched. */
+    if (method == NULL
+     || (strcmp(method, "GET") && strcmp(method, "HEAD"))
+     || vlc_http_msg_get_scheme(req) == NULL
+     || vlc_http_msg_get_authority(req) == NULL
+     || vlc_http_msg_get_path(req) == NULL
+     || vlc_h2_stream_lookup(conn, id) == NULL
+     || conn->pushes >= VLC_H2_MAX_STREAMS || conn->released)
+    {
+        if (req != NULL)
+            vlc_http_msg_destroy(req);
+        return vlc_h2_stream_error(conn, promised, VLC_H2_REFUSED_STREAM);
+    }
+
+    struct vlc_h2_stream *s = vlc_h2_stream_alloc(conn);
+    if (unlikely(s == NULL))
+    {
+        vlc_http_msg_destroy(req);
+        return vlc_h2_stream_error(conn, promised, VLC_H2_REFUSED_STREAM);
+    }
+
+    s->id = promised;
+    s->push_req = req;
+    vlc_h2_stream_link(s);
+    conn->pushes++;
+    return 0;
+}
+
 static void vlc_h2_window_status(void *ctx, uint32_t *restrict rcwd)
 {
     struct vlc_h2_conn *conn = ctx;
@@ -540,6 +717,7 @@ static const struct vlc_h2_parser_cbs vlc_h2_parser_callbacks =
     vlc_h2_stream_data,
     vlc_h2_stream_end,
     vlc_h2_stream_reset,
+    vlc_h2_push_promise,
 };
 
 /**
@@ -694,21 +872,44 @@ static void vlc_h2_conn_destroy(struct vlc_h2_conn *conn)
     vlc_tls_Shutdown(conn->conn.tls, true);
 
     vlc_tls_Close(conn->conn.tls);
+    hpack_encode_destroy(conn->encoder);
     free(conn);
 }
 
 static void vlc_h2_conn_release(struct vlc_http_conn *c)
 {
     struct vlc_h2_conn *conn = container_of(c, struct vlc_h2_conn, conn);
+    struct vlc_h2_stream *unclaimed = NULL;
     bool destroy;
 
     vlc_mutex_lock(&conn->lock);
     assert(!conn->released);
 
     conn->released = true;
+
+    /* Nobody can claim pushed streams anymore */
+    for (struct vlc_h2_stream *s = conn->streams, *older; s != NULL; s = older)
+    {
+        older = s->older;
+        if (s->push_req != NULL)
+        {
+            vlc_h2_stream_unlink(s);
+            s->older = unclaimed;
+            unclaimed = s;
+        }
+    }
+
     destroy = (conn->streams == NULL);
     vlc_mutex_unlock(&conn->lock);
 
+    while (unclaimed != NULL)
+    {
+        struct vlc_h2_stream *s = unclaimed;
+
+        unclaimed = s->older;
+        vlc_h2_stream_destroy(s);
+    }
+
     if (destroy)
         vlc_h2_conn_destroy(conn);
 }
@@ -728,12 +929,15 @@ struct vlc_http_conn *vlc_h2_conn_create(void *ctx, struct vlc_tls *tls)
     conn->conn.cbs = &vlc_h2_conn_callbacks;
     conn->conn.tls = tls;
     conn->out = vlc_h2_output_create(tls, true);
+    conn->encoder = hpack_encode_init(VLC_H2_DEFAULT_MAX_HEADER_TABLE);
     conn->opaque = ctx;
     conn->streams = NULL;
     conn->next_id = 1; /* TODO: server side */
+    conn->last_push_id = 0;
+    conn->pushes = 0;
     conn->released = false;
 
-    if (unlikely(conn->out == NULL))
+    if (unlikely(conn->out == NULL || conn->encoder == NULL))
         goto error;
 
     vlc_mutex_init(&conn->lock);
@@ -743,11 +947,14 @@ struct vlc_http_conn *vlc_h2_conn_create(void *ctx, struct vlc_tls *tls)
                   VLC_THREAD_PRIORITY_INPUT))
     {
         vlc_mutex_destroy(&conn->lock);
-        vlc_h2_output_destroy(conn->out);
         goto error;
     }
     return &conn->conn;
 error:
+    if (conn->encoder != NULL)
+        hpack_encode_destroy(conn->encoder);
+    if (conn->out != NULL)
+        vlc_h2_output_destroy(conn->out);
     free(conn);
     return NULL;
 }
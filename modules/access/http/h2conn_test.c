@@ -115,10 +115,10 @@ static void conn_destroy(void)
     vlc_tls_SessionDelete(external_tls);
 }
 
-static struct vlc_http_stream *stream_open(void)
+static struct vlc_http_stream *stream_open_path(const char *path)
 {
     struct vlc_http_msg *m = vlc_http_req_create("GET", "https",
-                                                 "www.example.com", "/");
+                                                 "www.example.com", path);
     assert(m != NULL);
 
     struct vlc_http_stream *s = vlc_http_stream_open(conn, m);
@@ -126,13 +126,18 @@ static struct vlc_http_stream *stream_open(void)
     return s;
 }
 
+static struct vlc_http_stream *stream_open(void)
+{
+    return stream_open_path("/");
+}
+
 static void stream_reply(uint_fast32_t id, bool nodata)
 {
     struct vlc_http_msg *m = vlc_http_resp_create(200);
     assert(m != NULL);
     vlc_http_msg_add_agent(m, "VLC-h2-tester");
 
-    conn_send(vlc_http_msg_h2_frame(m, id, nodata));
+    conn_send(vlc_http_msg_h2_frame(m, NULL, id, nodata));
     vlc_http_msg_destroy(m);
 }
 
@@ -142,7 +147,8 @@ static void stream_continuation(uint_fast32_t id)
         { ":status", "100" },
     };
 
-    conn_send(vlc_h2_frame_headers(id, VLC_H2_DEFAULT_MAX_FRAME, false, 1, h));
+    conn_send(vlc_h2_frame_headers(NULL, id, VLC_H2_DEFAULT_MAX_FRAME, false,
+                                   1, h));
 }
 
 static void stream_data(uint_fast32_t id, const char *str, bool eos)
@@ -150,6 +156,20 @@ static void stream_data(uint_fast32_t id, const char *str, bool eos)
     conn_send(vlc_h2_frame_data(id, str, strlen(str), eos));
 }
 
+static void stream_push(uint_fast32_t id, uint_fast32_t promised,
+                        const char *method, const char *path)
+{
+    const char *h[][2] = {
+        { ":method", method },
+        { ":scheme", "https" },
+        { ":authority", "www.example.com" },
+        { ":path", path },
+    };
+
+    conn_send(vlc_h2_frame_push_promise(id, promised,
+                                        VLC_H2_DEFAULT_MAX_FRAME, 4, h));
+}
+
 /* TODO: check messages coming from the connection under test */
 
 int main(void)
@@ -275,6 +295,48 @@ int main(void)
     conn_expect(RST_STREAM);
     /* might or might not seen one or two extra RST_STREAM now */
 
+    /* Test accepted server push */
+    sid += 2;
+    s = stream_open();
+    assert(s != NULL);
+    stream_push(sid, 2, "GET", "/pushed");
+    stream_reply(2, false);
+    stream_data(2, "Pushed", true);
+    stream_reply(sid, true);
+    m = vlc_http_msg_get_initial(s); /* promise received by now */
+    assert(m != NULL);
+    vlc_http_msg_destroy(m);
+    s = stream_open_path("/pushed");
+    assert(s != NULL);
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+    assert(vlc_http_msg_get_status(m) == 200);
+    b = vlc_http_msg_read(m);
+    assert(b != NULL);
+    assert(b->i_buffer == 6 && !memcmp(b->p_buffer, "Pushed", 6));
+    block_Release(b);
+    b = vlc_http_msg_read(m);
+    assert(b == NULL);
+    vlc_http_msg_destroy(m);
+
+    conn_expect(HEADERS); /* only for the first request */
+    conn_expect(RST_STREAM);
+    conn_expect(RST_STREAM);
+
+    /* Test refused server push */
+    sid += 2;
+    s = stream_open();
+    assert(s != NULL);
+    conn_expect(HEADERS);
+    stream_push(sid, 4, "POST", "/form");
+    conn_expect(RST_STREAM);
+    stream_push(sid, 6, "GET", "/unclaimed");
+    stream_reply(sid, true);
+    m = vlc_http_msg_get_initial(s);
+    assert(m != NULL);
+    vlc_http_msg_destroy(m);
+    conn_expect(RST_STREAM);
+
     /* Test graceful connection termination */
     sid += 2;
     s = stream_open();
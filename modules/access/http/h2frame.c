@@ -151,24 +151,39 @@ enum {
     VLC_H2_CONTINUATION_END_HEADERS = 0x04,
 };
 
-struct vlc_h2_frame *
-vlc_h2_frame_headers(uint_fast32_t stream_id, uint_fast32_t mtu, bool eos,
-                     unsigned count, const char *const headers[][2])
+/**
+ * Formats a headers block as a HEADERS or PUSH_PROMISE frame, and as many
+ * CONTINUATION frames as needed. A PUSH_PROMISE payload starts with the
+ * promised stream identifier.
+ */
+static struct vlc_h2_frame *
+vlc_h2_frame_header_block(struct hpack_encoder *enc, uint_fast8_t type,
+                          uint_fast8_t flags, uint_fast32_t stream_id,
+                          uint_fast32_t promised_id, uint_fast32_t mtu,
+                          unsigned count, const char *const headers[][2])
 {
     struct vlc_h2_frame *f;
-    uint8_t flags = eos ? VLC_H2_HEADERS_END_STREAM : 0;
-
-    size_t len = hpack_encode(NULL, 0, headers, count);
+    size_t prefix = (type == VLC_H2_FRAME_PUSH_PROMISE) ? 4 : 0;
+    /* With an encoder, this is an upper bound */
+    size_t len = prefix + hpack_encode(enc, NULL, 0, headers, count);
 
     if (likely(len <= mtu))
     {   /* Most common case: single frame - with zero copy */
-        flags |= VLC_H2_HEADERS_END_HEADERS;
+        flags |= (type == VLC_H2_FRAME_PUSH_PROMISE)
+                 ? VLC_H2_PUSH_PROMISE_END_HEADERS : VLC_H2_HEADERS_END_HEADERS;
 
-        f = vlc_h2_frame_alloc(VLC_H2_FRAME_HEADERS, flags, stream_id, len);
+        f = vlc_h2_frame_alloc(type, flags, stream_id, len);
         if (unlikely(f == NULL))
             return NULL;
 
-        hpack_encode(vlc_h2_frame_payload(f), len, headers, count);
+        uint8_t *p = vlc_h2_frame_payload(f);
+        if (prefix)
+            SetDWBE(p, promised_id);
+        len = prefix + hpack_encode(enc, p + prefix, len - prefix, headers,
+                                    count);
+        f->data[0] = len >> 16;
+        f->data[1] = len >> 8;
+        f->data[2] = len;
         return f;
     }
 
@@ -177,11 +192,13 @@ vlc_h2_frame_headers(uint_fast32_t stream_id, uint_fast32_t mtu, bool eos,
     if (unlikely(payload == NULL))
         return NULL;
 
-    hpack_encode(payload, len, headers, count);
+    if (prefix)
+        SetDWBE(payload, promised_id);
+    len = prefix + hpack_encode(enc, payload + prefix, len - prefix, headers,
+                                count);
 
     struct vlc_h2_frame **pp = &f, *n;
     const uint8_t *offset = payload;
-    uint_fast8_t type = VLC_H2_FRAME_HEADERS;
 
     f = NULL;
 
@@ -224,6 +241,27 @@ error:
     return NULL;
 }
 
+struct vlc_h2_frame *
+vlc_h2_frame_headers(struct hpack_encoder *enc, uint_fast32_t stream_id,
+                     uint_fast32_t mtu, bool eos,
+                     unsigned count, const char *const headers[][2])
+{
+    uint8_t flags = eos ? VLC_H2_HEADERS_END_STREAM : 0;
+
+    return vlc_h2_frame_header_block(enc, VLC_H2_FRAME_HEADERS, flags,
+                                     stream_id, 0, mtu, count, headers);
+}
+
+struct vlc_h2_frame *
+vlc_h2_frame_push_promise(uint_fast32_t stream_id, uint_fast32_t promised_id,
+                          uint_fast32_t mtu, unsigned count,
+                          const char *const headers[][2])
+{
+    return vlc_h2_frame_header_block(NULL, VLC_H2_FRAME_PUSH_PROMISE, 0,
+                                     stream_id, promised_id, mtu, count,
+                                     headers);
+}
+
 struct vlc_h2_frame *
 vlc_h2_frame_data(uint_fast32_t stream_id, const void *buf, size_t len,
                   bool eos)
@@ -274,7 +312,7 @@ struct vlc_h2_frame *vlc_h2_frame_settings(void)
 #endif
 
     SetWBE(p, VLC_H2_SETTING_ENABLE_PUSH);
-    SetDWBE(p + 2, 0);
+    SetDWBE(p + 2, VLC_H2_ENABLE_PUSH);
     p += 6;
 
 #if defined(VLC_H2_MAX_STREAMS)
@@ -456,6 +494,7 @@ struct vlc_h2_parser
     struct
     {
         uint32_t sid; /*< Ongoing stream identifier */
+        uint32_t promised; /*< Promised stream identifier (or 0) */
         bool eos; /*< End of stream after headers block */
         size_t len; /*< Compressed headers buffer length */
         uint8_t *buf; /*< Compressed headers buffer base address */
@@ -489,13 +528,15 @@ static void *vlc_h2_stream_lookup(struct vlc_h2_parser *p, uint_fast32_t id)
 }
 
 static void vlc_h2_parse_headers_start(struct vlc_h2_parser *p,
-                                       uint_fast32_t sid, bool eos)
+                                       uint_fast32_t sid,
+                                       uint_fast32_t promised, bool eos)
 {
     assert(sid != 0);
     assert(p->headers.sid == 0);
 
     p->parser = vlc_h2_parse_headers_block;
     p->headers.sid = sid;
+    p->headers.promised = promised;
     p->headers.eos = eos;
     p->headers.len = 0;
 }
@@ -537,16 +578,21 @@ static int vlc_h2_parse_headers_end(struct vlc_h2_parser *p)
     if (n < 0)
         return vlc_h2_parse_error(p, VLC_H2_COMPRESSION_ERROR);
 
-    void *s = vlc_h2_stream_lookup(p, p->headers.sid);
+    const char *ch[n ? n : 1][2];
+    void *s;
     int val = 0;
 
-    if (s != NULL)
-    {
-        const char *ch[n ? n : 1][2];
-
-        for (int i = 0; i < n; i++)
-            ch[i][0] = headers[i][0], ch[i][1] = headers[i][1];
+    for (int i = 0; i < n; i++)
+        ch[i][0] = headers[i][0], ch[i][1] = headers[i][1];
 
+    if (p->headers.promised != 0)
+        /* The connection decides whether to accept the promised stream,
+         * whether the associated stream still exists or not. */
+        val = p->cbs->push_promise(p->opaque, p->headers.sid,
+                                   p->headers.promised, n, ch);
+    else
+    if ((s = vlc_h2_stream_lookup(p, p->headers.sid)) != NULL)
+    {
         p->cbs->stream_headers(s, n, ch);
 
         if (p->headers.eos)
@@ -666,7 +712,7 @@ static int vlc_h2_parse_frame_headers(struct vlc_h2_parser *p,
         len -= 5;
     }
 
-    vlc_h2_parse_headers_start(p, id, flags & VLC_H2_HEADERS_END_STREAM);
+    vlc_h2_parse_headers_start(p, id, 0, flags & VLC_H2_HEADERS_END_STREAM);
 
     int ret = vlc_h2_parse_headers_append(p, ptr, len);
 
@@ -690,7 +736,7 @@ static int vlc_h2_parse_frame_priority(struct vlc_h2_parser *p,
     if (len != 5)
         return vlc_h2_stream_error(p, id, VLC_H2_FRAME_SIZE_ERROR);
 
-    /* Ignore priorities for now as we do not upload much. */
+    /* Ignore the peer priorities as we do not upload much. */
     return 0;
 }
 
@@ -787,9 +833,29 @@ static int vlc_h2_parse_frame_push_promise(struct vlc_h2_parser *p,
         ptr++;
     }
 
-    /* Not permitted by our settings. */
+    if (len < 4)
+    {
+        free(f);
+        return vlc_h2_parse_error(p, VLC_H2_FRAME_SIZE_ERROR);
+    }
+
+    /* Server-initiated streams have even identifiers. */
+    uint_fast32_t promised = GetDWBE(ptr) & 0x7FFFFFFF;
+    if (promised == 0 || (promised & 1))
+    {
+        free(f);
+        return vlc_h2_parse_error(p, VLC_H2_PROTOCOL_ERROR);
+    }
+
+    vlc_h2_parse_headers_start(p, id, promised, false);
+
+    int ret = vlc_h2_parse_headers_append(p, ptr + 4, len - 4);
+
+    if (ret == 0 && (flags & VLC_H2_PUSH_PROMISE_END_HEADERS))
+        ret = vlc_h2_parse_headers_end(p);
+
     free(f);
-    return vlc_h2_parse_error(p, VLC_H2_PROTOCOL_ERROR);
+    return ret;
 }
 
 /** Parses an HTTP/2 PING frame */
@@ -1021,6 +1087,7 @@ struct vlc_h2_parser *vlc_h2_parse_init(void *ctx,
     p->cbs = cbs;
     p->parser = vlc_h2_parse_preface;
     p->headers.sid = 0;
+    p->headers.promised = 0;
     p->headers.buf = NULL;
     p->headers.len = 0;
     p->headers.decoder = hpack_decode_init(VLC_H2_MAX_HEADER_TABLE);
@@ -35,10 +35,23 @@ struct vlc_h2_frame
 
 size_t vlc_h2_frame_size(const struct vlc_h2_frame *);
 
+struct hpack_encoder;
+
+/**
+ * Formats a header block as HEADERS and CONTINUATION frames.
+ *
+ * @param enc HPACK encoder state of the connection, or NULL not to use the
+ *            dynamic table
+ */
 struct vlc_h2_frame *
-vlc_h2_frame_headers(uint_fast32_t stream_id, uint_fast32_t mtu, bool eos,
+vlc_h2_frame_headers(struct hpack_encoder *enc, uint_fast32_t stream_id,
+                     uint_fast32_t mtu, bool eos,
                      unsigned count, const char *const headers[][2]);
 struct vlc_h2_frame *
+vlc_h2_frame_push_promise(uint_fast32_t stream_id, uint_fast32_t promised_id,
+                          uint_fast32_t mtu, unsigned count,
+                          const char *const headers[][2]);
+struct vlc_h2_frame *
 vlc_h2_frame_data(uint_fast32_t stream_id, const void *buf, size_t len,
                   bool eos);
 struct vlc_h2_frame *
@@ -86,7 +99,8 @@ const char *vlc_h2_setting_name(uint_fast16_t);
 
 /* Our settings */
 #define VLC_H2_MAX_HEADER_TABLE   4096 /* Header (compression) table size */
-#define VLC_H2_MAX_STREAMS           0 /* Concurrent peer-initiated streams */
+#define VLC_H2_ENABLE_PUSH           1 /* Server push */
+#define VLC_H2_MAX_STREAMS           8 /* Concurrent peer-initiated streams */
 #define VLC_H2_INIT_WINDOW     1048575 /* Initial congestion window size */
 #define VLC_H2_MAX_FRAME       1048576 /* Frame size */
 #define VLC_H2_MAX_HEADER_LIST   65536 /* Header (decompressed) list size */
@@ -113,6 +127,8 @@ struct vlc_h2_parser_cbs
     int  (*stream_data)(void *ctx, struct vlc_h2_frame *f);
     void (*stream_end)(void *ctx);
     int  (*stream_reset)(void *ctx, uint_fast32_t code);
+    int  (*push_promise)(void *ctx, uint_fast32_t id, uint_fast32_t promised,
+                         unsigned count, const char *const headers[][2]);
 };
 
 struct vlc_h2_parser *vlc_h2_parse_init(void *ctx,
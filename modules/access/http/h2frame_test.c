@@ -64,7 +64,7 @@ static void vlc_h2_setting(void *ctx, uint_fast16_t id, uint_fast32_t value)
             assert(value == VLC_H2_MAX_HEADER_TABLE);
             break;
         case VLC_H2_SETTING_ENABLE_PUSH:
-            assert(value == 0);
+            assert(value == VLC_H2_ENABLE_PUSH);
             break;
         case VLC_H2_SETTING_MAX_CONCURRENT_STREAMS:
             assert(value == VLC_H2_MAX_STREAMS);
@@ -209,6 +209,35 @@ static int vlc_h2_stream_reset(void *ctx, uint_fast32_t code)
     return 0;
 }
 
+static const char *const req_hdrv[][2] = {
+    { ":method",    "GET" },
+    { ":scheme",    "https" },
+    { ":authority", "www.example.com" },
+    { ":path",      "/style.css" },
+};
+static const unsigned req_hdrc = sizeof (req_hdrv) / sizeof (req_hdrv[0]);
+
+static unsigned push_promises;
+
+static int vlc_h2_push_promise(void *ctx, uint_fast32_t id,
+                               uint_fast32_t promised, unsigned count,
+                               const char *const hdrs[][2])
+{
+    assert(ctx == CTX);
+    assert(id == STREAM_ID);
+    assert(promised == STREAM_ID + 4);
+    assert(count == req_hdrc);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        assert(!strcmp(hdrs[i][0], req_hdrv[i][0]));
+        assert(!strcmp(hdrs[i][1], req_hdrv[i][1]));
+    }
+
+    push_promises++;
+    return 0;
+}
+
 /* Frame formatting */
 static struct vlc_h2_frame *resize(struct vlc_h2_frame *f, size_t size)
 {   /* NOTE: increasing size would require realloc() */
@@ -248,7 +277,8 @@ static struct vlc_h2_frame *localize(struct vlc_h2_frame *f)
 static struct vlc_h2_frame *response(bool eos)
 {
     /* Use ridiculously small MTU to test headers fragmentation */
-    return vlc_h2_frame_headers(STREAM_ID, 16, eos, resp_hdrc, resp_hdrv);
+    return vlc_h2_frame_headers(NULL, STREAM_ID, 16, eos, resp_hdrc,
+                                resp_hdrv);
 }
 
 static struct vlc_h2_frame *data(bool eos)
@@ -261,6 +291,12 @@ static struct vlc_h2_frame *priority(void)
     return localize(resize(retype(data(false), 0x2), 5));
 }
 
+static struct vlc_h2_frame *push_promise(void)
+{
+    return vlc_h2_frame_push_promise(STREAM_ID, STREAM_ID + 4, 16,
+                                     req_hdrc, req_hdrv);
+}
+
 static struct vlc_h2_frame *rst_stream(void)
 {
     return vlc_h2_frame_rst_stream(STREAM_ID, VLC_H2_CANCEL);
@@ -322,6 +358,7 @@ static const struct vlc_h2_parser_cbs vlc_h2_frame_test_callbacks =
     vlc_h2_stream_data,
     vlc_h2_stream_end,
     vlc_h2_stream_reset,
+    vlc_h2_push_promise,
 };
 
 static unsigned test_seq(void *ctx, ...)
@@ -334,6 +371,7 @@ static unsigned test_seq(void *ctx, ...)
     pings = 0;
     remote_error = -1;
     stream_header_tables = stream_blocks = stream_ends = 0;
+    push_promises = 0;
 
     p = vlc_h2_parse_init(ctx, &vlc_h2_frame_test_callbacks);
     assert(p != NULL);
@@ -435,7 +473,7 @@ int main(void)
 
     ret = test_seq(CTX, rst_stream(),
                         vlc_h2_frame_window_update(0, 0x1000),
-                        vlc_h2_frame_headers(STREAM_ID + 2,
+                        vlc_h2_frame_headers(NULL, STREAM_ID + 2,
                                              VLC_H2_DEFAULT_MAX_FRAME, true,
                                              resp_hdrc, resp_hdrv),
                         NULL);
@@ -445,6 +483,14 @@ int main(void)
     assert(stream_blocks == 0);
     assert(stream_ends == 0);
 
+    ret = test_seq(CTX, response(false), push_promise(), priority(),
+                        data(true), NULL);
+    assert(ret == 4);
+    assert(push_promises == 1);
+    assert(stream_header_tables == 1);
+    assert(stream_blocks == 1);
+    assert(stream_ends == 1);
+
     test_preface_fail();
     test_header_block_fail();
 
@@ -461,7 +507,13 @@ int main(void)
     test_bad_seq(CTX, localize(goaway()), NULL);
     test_bad_seq(CTX, resize(goaway(), 7), NULL);
 
-    /* TODO: PUSH_PROMISE, PRIORITY, padding, unknown, invalid stuff... */
+    test_bad_seq(CTX, globalize(push_promise()), NULL);
+    test_bad_seq(CTX, resize(push_promise(), 3), NULL);
+    test_bad_seq(CTX, vlc_h2_frame_push_promise(STREAM_ID, STREAM_ID + 3,
+                                                VLC_H2_DEFAULT_MAX_FRAME,
+                                                req_hdrc, req_hdrv), NULL);
+
+    /* TODO: padding, unknown, invalid stuff... */
 
     /* Dummy API test */
     assert(vlc_h2_frame_data(1, NULL, 1 << 28, false) == NULL);
@@ -61,12 +61,60 @@ static const char hpack_values[][14] =
     "206", "304", "400", "404", "500", "", "gzip, deflate"
 };
 
+#define HPACK_STATIC_ENTRIES (sizeof (hpack_names) / sizeof (hpack_names[0]))
+
+/** Compares a header name, in any case, with a lower case name. */
+static bool hpack_name_equal(const char *name, const char *lower)
+{
+    unsigned char c;
+
+    do
+    {
+        c = *(name++);
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != (unsigned char)*lower)
+            return false;
+    }
+    while (*(lower++) != '\0');
+
+    return true;
+}
+
+unsigned hpack_lookup_static(const char *name, const char *value,
+                             bool *restrict exact)
+{
+    unsigned found = 0;
+
+    for (unsigned i = 0; i < HPACK_STATIC_ENTRIES; i++)
+    {
+        if (!hpack_name_equal(name, hpack_names[i]))
+            continue;
+
+        const char *v = "";
+        if (i < sizeof (hpack_values) / sizeof (hpack_values[0]))
+            v = hpack_values[i];
+
+        if (!strcmp(value, v))
+        {
+            *exact = true;
+            return i + 1;
+        }
+        if (found == 0)
+            found = i + 1;
+    }
+
+    *exact = false;
+    return found;
+}
+
 struct hpack_decoder
 {
     char **table;
     size_t entries;
     size_t size;
     size_t max_size;
+    size_t limit;
 };
 
 struct hpack_decoder *hpack_decode_init(size_t header_table_size)
@@ -78,7 +126,7 @@ struct hpack_decoder *hpack_decode_init(size_t header_table_size)
     dec->table = NULL;
     dec->entries = 0;
     dec->size = 0;
-    dec->max_size = header_table_size;
+    dec->max_size = dec->limit = header_table_size;
     return dec;
 }
 
@@ -153,130 +201,201 @@ static char *hpack_decode_str_raw(const uint8_t *data, size_t length)
     return s;
 }
 
-static int hpack_decode_byte_huffman(const uint8_t *restrict end,
-                                     int *restrict bit_offset)
-{
-    static const unsigned char tab[256] = {
-        /*  5 bits */
-         48,  49,  50,  97,  99, 101, 105, 111, 115, 116,
-        /*  6 bits */
-         32,  37,  45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
-         95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
-        /*  7 bits */
-         58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,
-         79,  80,  81,  82,  83,  84,  85,  86,  87,  89, 106, 107, 113, 118,
-        119, 120, 121, 122,
-        /*  8 bits */
-         38,  42,  44,  59,  88,  90,
-        /* 10 bits */
-         33,  34,  40,  41,  63,
-        /* 11 bits */
-         39,  43, 124,
-        /* 12 bits */
-         35,  62,
-        /* 13 bits */
-          0,  36,  64,  91,  93, 126,
-        /* 14 bits */
-         94, 125,
-        /* 15 bits */
-         60,  96, 123,
-        /* 19 bits */
-         92, 195, 208,
-        /* 20 bits */
-        128, 130, 131, 162, 184, 194, 224, 226,
-        /* 21 bits */
-        153, 161, 167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230,
-        /* 22 bits */
-        129, 132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170, 173,
-        178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232, 233,
-        /* 23 bits */
-          1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155,
-        157, 158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231,
-        239,
-        /* 24 bits */
-          9, 142, 144, 145, 148, 159, 171, 206, 215, 225, 236, 237,
-        /* 25 bits */
-        199, 207, 234, 235,
-        /* 26 bits */
-        192, 193, 200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
-        255,
-        /* 27 bits */
-        203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248,
-        250, 251, 252, 253, 254,
-        /* 28 bits */
-          2,   3,   4,   5,   6,   7,   8,  11,  12,  14,  15,  16,  17,  18,
-         19,  20,  21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
-        249,
-        /* 30 bits */
-         10,  13,  22,
-    };
-    static const unsigned char values[30] = {
-        0,  0,  0,  0, 10, 26, 32,  6,  0,  5,  3,  2,  6,  2,  3,
-        0,  0,  0,  3,  8, 13, 26, 29, 12,  4, 15, 19, 29,  0,  3
-    };
-    const unsigned char *p = tab;
-    uint_fast32_t code = 0, offset = 0;
-    unsigned shift = -*bit_offset;
+/**
+ * Static Huffman code symbols, by code length then code value.
+ *
+ * As the code is canonical, this and the number of codes of each length
+ * fully define it.
+ */
+static const unsigned char hpack_huff_syms[256] = {
+    /*  5 bits */
+     48,  49,  50,  97,  99, 101, 105, 111, 115, 116,
+    /*  6 bits */
+     32,  37,  45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
+     95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+    /*  7 bits */
+     58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,
+     79,  80,  81,  82,  83,  84,  85,  86,  87,  89, 106, 107, 113, 118,
+    119, 120, 121, 122,
+    /*  8 bits */
+     38,  42,  44,  59,  88,  90,
+    /* 10 bits */
+     33,  34,  40,  41,  63,
+    /* 11 bits */
+     39,  43, 124,
+    /* 12 bits */
+     35,  62,
+    /* 13 bits */
+      0,  36,  64,  91,  93, 126,
+    /* 14 bits */
+     94, 125,
+    /* 15 bits */
+     60,  96, 123,
+    /* 19 bits */
+     92, 195, 208,
+    /* 20 bits */
+    128, 130, 131, 162, 184, 194, 224, 226,
+    /* 21 bits */
+    153, 161, 167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230,
+    /* 22 bits */
+    129, 132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170, 173,
+    178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232, 233,
+    /* 23 bits */
+      1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155,
+    157, 158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231,
+    239,
+    /* 24 bits */
+      9, 142, 144, 145, 148, 159, 171, 206, 215, 225, 236, 237,
+    /* 25 bits */
+    199, 207, 234, 235,
+    /* 26 bits */
+    192, 193, 200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255,
+    /* 27 bits */
+    203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248,
+    250, 251, 252, 253, 254,
+    /* 28 bits */
+      2,   3,   4,   5,   6,   7,   8,  11,  12,  14,  15,  16,  17,  18,
+     19,  20,  21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
+    249,
+    /* 30 bits */
+     10,  13,  22,
+};
 
-    for (unsigned i = 0; i < 30; i++)
-    {
-        code <<= 1;
+/** Number of Huffman codes of each length, from 1 to 30 bits */
+static const unsigned char hpack_huff_counts[30] = {
+    0,  0,  0,  0, 10, 26, 32,  6,  0,  5,  3,  2,  6,  2,  3,
+    0,  0,  0,  3,  8, 13, 26, 29, 12,  4, 15, 19, 29,  0,  3
+};
 
-        /* Read one bit */
-        if (*bit_offset)
-        {
-            shift = (shift - 1) & 7;
-            code |= (end[*bit_offset >> 3] >> shift) & 1;
-            (*bit_offset)++;
-        }
-        else
-            code |= 1; /* EOS is all ones */
+/**
+ * Huffman decoding table for codes of up to 8 bits.
+ *
+ * Indexed by the next 8 bits of input, each entry holds the code length
+ * (upper byte) and the symbol (lower byte), or zero if the code is longer.
+ * Those codes cover all characters commonly found in headers.
+ */
+static const uint16_t hpack_huff_fast[256] = {
+    0x0530, 0x0530, 0x0530, 0x0530, 0x0530, 0x0530, 0x0530, 0x0530,
+    0x0531, 0x0531, 0x0531, 0x0531, 0x0531, 0x0531, 0x0531, 0x0531,
+    0x0532, 0x0532, 0x0532, 0x0532, 0x0532, 0x0532, 0x0532, 0x0532,
+    0x0561, 0x0561, 0x0561, 0x0561, 0x0561, 0x0561, 0x0561, 0x0561,
+    0x0563, 0x0563, 0x0563, 0x0563, 0x0563, 0x0563, 0x0563, 0x0563,
+    0x0565, 0x0565, 0x0565, 0x0565, 0x0565, 0x0565, 0x0565, 0x0565,
+    0x0569, 0x0569, 0x0569, 0x0569, 0x0569, 0x0569, 0x0569, 0x0569,
+    0x056f, 0x056f, 0x056f, 0x056f, 0x056f, 0x056f, 0x056f, 0x056f,
+    0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573, 0x0573,
+    0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574, 0x0574,
+    0x0620, 0x0620, 0x0620, 0x0620, 0x0625, 0x0625, 0x0625, 0x0625,
+    0x062d, 0x062d, 0x062d, 0x062d, 0x062e, 0x062e, 0x062e, 0x062e,
+    0x062f, 0x062f, 0x062f, 0x062f, 0x0633, 0x0633, 0x0633, 0x0633,
+    0x0634, 0x0634, 0x0634, 0x0634, 0x0635, 0x0635, 0x0635, 0x0635,
+    0x0636, 0x0636, 0x0636, 0x0636, 0x0637, 0x0637, 0x0637, 0x0637,
+    0x0638, 0x0638, 0x0638, 0x0638, 0x0639, 0x0639, 0x0639, 0x0639,
+    0x063d, 0x063d, 0x063d, 0x063d, 0x0641, 0x0641, 0x0641, 0x0641,
+    0x065f, 0x065f, 0x065f, 0x065f, 0x0662, 0x0662, 0x0662, 0x0662,
+    0x0664, 0x0664, 0x0664, 0x0664, 0x0666, 0x0666, 0x0666, 0x0666,
+    0x0667, 0x0667, 0x0667, 0x0667, 0x0668, 0x0668, 0x0668, 0x0668,
+    0x066c, 0x066c, 0x066c, 0x066c, 0x066d, 0x066d, 0x066d, 0x066d,
+    0x066e, 0x066e, 0x066e, 0x066e, 0x0670, 0x0670, 0x0670, 0x0670,
+    0x0672, 0x0672, 0x0672, 0x0672, 0x0675, 0x0675, 0x0675, 0x0675,
+    0x073a, 0x073a, 0x0742, 0x0742, 0x0743, 0x0743, 0x0744, 0x0744,
+    0x0745, 0x0745, 0x0746, 0x0746, 0x0747, 0x0747, 0x0748, 0x0748,
+    0x0749, 0x0749, 0x074a, 0x074a, 0x074b, 0x074b, 0x074c, 0x074c,
+    0x074d, 0x074d, 0x074e, 0x074e, 0x074f, 0x074f, 0x0750, 0x0750,
+    0x0751, 0x0751, 0x0752, 0x0752, 0x0753, 0x0753, 0x0754, 0x0754,
+    0x0755, 0x0755, 0x0756, 0x0756, 0x0757, 0x0757, 0x0759, 0x0759,
+    0x076a, 0x076a, 0x076b, 0x076b, 0x0771, 0x0771, 0x0776, 0x0776,
+    0x0777, 0x0777, 0x0778, 0x0778, 0x0779, 0x0779, 0x077a, 0x077a,
+    0x0826, 0x082a, 0x082c, 0x083b, 0x0858, 0x085a, 0x0000, 0x0000,
+};
+
+/**
+ * Decodes a Huffman code longer than 8 bits.
+ *
+ * @param window next 32 bits of input, left-aligned
+ * @param bits number of valid bits in the window
+ * @return the symbol, or -1 if the input is truncated or contains EOS
+ */
+static int hpack_decode_huffman_slow(uint_fast32_t window, unsigned bits,
+                                     unsigned *restrict lenp)
+{
+    const unsigned char *p = hpack_huff_syms;
+    uint_fast32_t offset = 0;
+
+    for (unsigned i = 0; i < 30 && i < bits; i++)
+    {
+        uint_fast32_t code = window >> (31 - i);
 
         assert(code >= offset);
-        if ((code - offset) < values[i])
+        if ((code - offset) < hpack_huff_counts[i])
+        {
+            *lenp = i + 1;
             return p[code - offset];
-        p += values[i];
-        offset = (offset + values[i]) * 2;
+        }
+        p += hpack_huff_counts[i];
+        offset = (offset + hpack_huff_counts[i]) * 2;
     }
-
-    assert(p - tab == 256);
-
-    if (code == 0x3fffffff)
-        return 256; /* EOS */
-
-    errno = EINVAL;
     return -1;
 }
 
 /**
  * Decodes an Huffman-encoded string literal.
+ *
+ * The input is consumed a byte at a time through a bit accumulator, and
+ * each code of up to 8 bits is decoded with a single table look-up.
  */
 static char *hpack_decode_str_huffman(const uint8_t *data, size_t length)
 {
-    unsigned char *str = malloc(length * 2 + 1);
+    /* Codes are at least 5 bits long */
+    unsigned char *str = malloc(length * 8 / 5 + 1);
     if (str == NULL)
         return NULL;
 
+    uint_fast64_t acc = 0; /* Input bits, left-aligned */
+    unsigned bits = 0; /* Number of valid bits in acc */
     size_t len = 0;
-    int bit_offset = -8 * length;
-    data += length;
 
     for (;;)
     {
-        int c = hpack_decode_byte_huffman(data, &bit_offset);
-        if (c < 0)
+        while (bits <= 56 && length > 0)
         {
-            errno = EINVAL;
-            goto error;
+            acc |= (uint_fast64_t)*(data++) << (56 - bits);
+            bits += 8;
+            length--;
         }
 
-        /* NOTE: EOS (256) is converted to nul terminator */
-        str[len++] = c;
+        if (bits == 0)
+            break;
 
-        if (c == 256)
+        unsigned entry = hpack_huff_fast[(acc >> 56) & 0xff];
+        unsigned codelen = entry >> 8;
+        int c;
+
+        if (codelen != 0)
+            c = (codelen <= bits) ? (int)(entry & 0xff) : -1;
+        else
+            c = hpack_decode_huffman_slow((acc >> 32) & 0xffffffff, bits,
+                                          &codelen);
+
+        if (c < 0)
+        {   /* Padding must be a prefix of EOS, i.e. less than 8 one bits */
+            uint_fast64_t pad = (UINT64_C(1) << bits) - 1;
+
+            if (length > 0 || bits >= 8 || (acc >> (64 - bits)) != pad)
+            {
+                errno = EINVAL;
+                goto error;
+            }
             break;
+        }
+
+        str[len++] = c;
+        acc = (acc << codelen) & UINT64_C(0xffffffffffffffff);
+        bits -= codelen;
     }
 
+    str[len] = '\0';
     return (char *)str;
 
 error:
@@ -534,8 +653,8 @@ static int hpack_decode_tbl_update(struct hpack_decoder *dec,
     if (max < 0)
         return -1;
 
-    if ((size_t)max > dec->max_size)
-    {   /* Increasing the maximum is not permitted per the specification */
+    if ((size_t)max > dec->limit)
+    {   /* Exceeding the setting is not permitted per the specification */
         errno = EINVAL;
         return -1;
     }
@@ -616,6 +735,7 @@ error:
 #ifdef DEC_TEST
 # include <stdarg.h>
 # include <stdio.h>
+# include <time.h>
 
 static void test_integer(unsigned n, const uint8_t *buf, size_t len,
                          int_fast32_t value)
@@ -835,6 +955,112 @@ static void test_resps_huffman(void)
     hpack_decode_destroy(dec);
 }
 
+static void test_huffman_str(const char *in, size_t len, const char *out)
+{
+    const uint8_t *buf = (const uint8_t *)in;
+    char *str = hpack_decode_str(&buf, &len);
+
+    if (out == NULL)
+        assert(str == NULL);
+    else
+    {
+        assert(str != NULL);
+        assert(!strcmp(str, out));
+        assert(len == 0);
+        free(str);
+    }
+}
+
+static void test_huffman(void)
+{
+    test_huffman_str("\x80", 1, "");
+    test_huffman_str("\x81\x1f", 2, "a"); /* 00011 + 111 padding */
+    test_huffman_str("\x81\x18", 2, NULL); /* zero padding */
+    test_huffman_str("\x82\x1f\xff", 3, NULL); /* padding too long */
+    test_huffman_str("\x84\xff\xff\xff\xff", 5, NULL); /* EOS */
+    test_huffman_str("\x83\xff\xff\xb1", 4, "\x01"); /* 23-bits code */
+    test_huffman_str("\x84\xff\xff\xff\xf3", 5, "\x0a"); /* 30-bits */
+}
+
+/* Reference bit-by-bit decoder */
+static int hpack_decode_byte_huffman_ref(const uint8_t *restrict end,
+                                         int *restrict bit_offset)
+{
+    const unsigned char *p = hpack_huff_syms;
+    uint_fast32_t code = 0, offset = 0;
+    unsigned shift = -*bit_offset;
+
+    for (unsigned i = 0; i < 30; i++)
+    {
+        code <<= 1;
+
+        if (*bit_offset)
+        {
+            shift = (shift - 1) & 7;
+            code |= (end[*bit_offset >> 3] >> shift) & 1;
+            (*bit_offset)++;
+        }
+        else
+            code |= 1; /* EOS is all ones */
+
+        if ((code - offset) < hpack_huff_counts[i])
+            return p[code - offset];
+        p += hpack_huff_counts[i];
+        offset = (offset + hpack_huff_counts[i]) * 2;
+    }
+    return 256;
+}
+
+static char *hpack_decode_str_huffman_ref(const uint8_t *data, size_t length)
+{
+    unsigned char *str = malloc(length * 2 + 1);
+    size_t len = 0;
+    int bit_offset = -8 * length;
+    int c;
+
+    assert(str != NULL);
+    data += length;
+
+    do
+        str[len++] = c = hpack_decode_byte_huffman_ref(data, &bit_offset);
+    while (c != 256);
+
+    return (char *)str;
+}
+
+static void bench_huffman(void)
+{
+    /* set-cookie value from the RFC 7541 examples */
+    static const uint8_t in[] =
+        "\x94\xe7\x82\x1d\xd7\xf2\xe6\xc7\xb3\x35\xdf\xdf\xcd\x5b\x39"
+        "\x60\xd5\xaf\x27\x08\x7f\x36\x72\xc1\xab\x27\x0f\xb5\x29\x1f"
+        "\x95\x87\x31\x60\x65\xc0\x03\xed\x4e\xe5\xb1\x06\x3d\x50\x07";
+    const size_t len = sizeof (in) - 1;
+    const unsigned loops = 200000;
+    char *(*const decoders[])(const uint8_t *, size_t) = {
+        hpack_decode_str_huffman_ref, hpack_decode_str_huffman,
+    };
+    static const char *const names[] = { "bit-by-bit", "table" };
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        clock_t start = clock();
+
+        for (unsigned j = 0; j < loops; j++)
+        {
+            char *str = decoders[i](in, len);
+
+            assert(!strcmp(str, "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; "
+                                "max-age=3600; version=1"));
+            free(str);
+        }
+
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (secs > 0.)
+            printf("Huffman decoding (%s): %.1f MB/s\n", names[i],
+                   loops * len / secs / 1e6);
+    }
+}
 
 int main(void)
 {
@@ -844,5 +1070,7 @@ int main(void)
     test_reqs_huffman();
     test_resps();
     test_resps_huffman();
+    test_huffman();
+    bench_huffman();
 }
 #endif /* TEST */
@@ -33,9 +33,54 @@ void hpack_decode_destroy(struct hpack_decoder *);
 int hpack_decode(struct hpack_decoder *dec, const uint8_t *data,
                  size_t length, char *headers[][2], unsigned max);
 
+/**
+ * Looks a header field up in the static table.
+ *
+ * @param name header name (case insensitive)
+ * @param exact set to true if the value matches too
+ * @return the index of an entry with the same name and value, or failing
+ *         that, with the same name, or 0 if the name is not in the table
+ */
+unsigned hpack_lookup_static(const char *name, const char *value,
+                             bool *restrict exact);
+
+struct hpack_encoder;
+
+/**
+ * Creates an encoder state (dynamic table).
+ *
+ * @param header_table_size own limit for the dynamic table size
+ */
+struct hpack_encoder *hpack_encode_init(size_t header_table_size);
+void hpack_encode_destroy(struct hpack_encoder *);
+
+/**
+ * Applies the peer decoder dynamic table size (HTTP/2 setting).
+ *
+ * The change is signaled at the start of the next header block.
+ */
+void hpack_encode_resize(struct hpack_encoder *, size_t max);
+
 size_t hpack_encode_hdr_neverindex(uint8_t *restrict buf, size_t size,
                                    const char *name, const char *value);
-size_t hpack_encode(uint8_t *restrict buf, size_t size,
-                    const char *const headers[][2], unsigned count);
+
+/**
+ * Encodes a header block.
+ *
+ * Without encoder state, the result only depends on the headers. The
+ * required length is returned even if the buffer is too small, so that the
+ * function can be called with a NULL buffer first.
+ *
+ * With encoder state, the dynamic table is updated, and the encoded block
+ * must reach the peer decoder, in order with other blocks. A NULL buffer
+ * yields an upper bound of the encoded length without updating the state.
+ * Otherwise the buffer must be at least that large.
+ *
+ * @param enc encoder state or NULL
+ * @return the encoded length in bytes
+ */
+size_t hpack_encode(struct hpack_encoder *enc, uint8_t *restrict buf,
+                    size_t size, const char *const headers[][2],
+                    unsigned count);
 
 /** @} */
@@ -409,11 +409,15 @@ char *vlc_http_msg_format(const struct vlc_http_msg *m, size_t *restrict lenp,
 struct vlc_http_msg *vlc_http_msg_headers(const char *msg) VLC_USED;
 
 struct vlc_h2_frame;
+struct hpack_encoder;
 
 /**
  * Formats an HTTP 2.0 HEADER frame.
+ *
+ * @param enc HPACK encoder state of the connection (or NULL)
  */
 struct vlc_h2_frame *vlc_http_msg_h2_frame(const struct vlc_http_msg *m,
+                                           struct hpack_encoder *enc,
                                            uint_fast32_t stream_id, bool eos);
 
 /**
@@ -0,0 +1,682 @@
+/*****************************************************************************
+ * parallel.c: HTTP parallel ranged reads
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_interrupt.h>
+#include "message.h"
+#include "resource.h"
+#include "file.h"
+#include "connmgr.h"
+#include "conn.h"
+#include "parallel.h"
+
+#pragma GCC visibility push(default)
+
+/*
+ * The file is split into chunks of fixed size. A window of consecutive
+ * chunks, starting from the chunk of the read offset, is fetched by a pool
+ * of workers, each with its own connection manager and thus its own TCP
+ * connection. On high latency links, this works around the throughput limit
+ * of a single TCP flow (receive window over round trip time).
+ *
+ * Chunks are delivered in order: the reader consumes the data of the first
+ * chunk of the window as it arrives, then slides the window.
+ */
+#define VLC_HTTP_PARALLEL_RETRIES 3
+
+struct vlc_http_parallel;
+
+struct vlc_http_chunk
+{
+    uintmax_t index;    /**< chunk number */
+    uintmax_t pos;      /**< file offset of the first queued byte */
+    uintmax_t received; /**< file offset past the last received byte */
+    uintmax_t end;      /**< file offset past the last byte of the chunk */
+    block_t *head;
+    block_t **tailp;
+    struct vlc_http_worker *owner; /**< worker fetching the chunk, if any */
+    unsigned failures;
+    bool done;
+};
+
+struct vlc_http_worker
+{
+    struct vlc_http_parallel *parallel;
+    struct vlc_http_mgr *manager;
+    struct vlc_http_resource *resource;
+    vlc_interrupt_t *interrupt;
+    vlc_thread_t thread;
+};
+
+struct vlc_http_parallel
+{
+    vlc_object_t *obj;
+    vlc_mutex_t lock;
+    vlc_cond_t wait_data; /**< reader waits for data */
+    vlc_cond_t wait_work; /**< workers wait for a chunk to fetch */
+
+    /* Entity */
+    uintmax_t size;
+    char *etag;
+    time_t mtime;
+
+    /* Read side */
+    uintmax_t offset;
+    uintmax_t first; /**< first chunk of the window */
+    bool error;
+    bool interrupted;
+    bool closing;
+
+    /* Chunks window (ring buffer indexed by chunk number) */
+    size_t chunk_size;
+    unsigned slots;
+    struct vlc_http_chunk *chunks;
+
+    /* Connections */
+    unsigned active; /**< allowed concurrent requests */
+    unsigned loading; /**< current requests */
+    unsigned max_conns;
+    struct vlc_http_worker *workers;
+
+    /* Throughput measurement */
+    vlc_tick_t sample_start;
+    uint64_t sample_bytes;
+    unsigned sample_chunks;
+    bool sample_starved; /**< workers ran out of chunks to fetch */
+    uint64_t rate; /**< bytes per second of the previous sample */
+    int step;
+};
+
+/*** Ranged requests ***/
+
+struct vlc_http_range
+{
+    uintmax_t start;
+    uintmax_t end; /**< last byte, inclusive */
+};
+
+struct vlc_http_range_resource
+{
+    struct vlc_http_resource resource;
+    const struct vlc_http_parallel *parallel;
+};
+
+static int vlc_http_range_req(const struct vlc_http_resource *res,
+                              struct vlc_http_msg *req, void *opaque)
+{
+    const struct vlc_http_range_resource *rr =
+        container_of(res, struct vlc_http_range_resource, resource);
+    const struct vlc_http_parallel *p = rr->parallel;
+    const struct vlc_http_range *range = opaque;
+
+    /* All chunks must come from the same entity */
+    if (p->etag != NULL)
+        vlc_http_msg_add_header(req, "If-Match", "%s", p->etag);
+    else if (p->mtime != -1)
+        vlc_http_msg_add_time(req, "If-Unmodified-Since", &p->mtime);
+
+    return vlc_http_msg_add_header(req, "Range",
+                                   "bytes=%" PRIuMAX "-%" PRIuMAX,
+                                   range->start, range->end);
+}
+
+static int vlc_http_range_resp(const struct vlc_http_resource *res,
+                               const struct vlc_http_msg *resp, void *opaque)
+{
+    const struct vlc_http_range *range = opaque;
+    uintmax_t start, end;
+
+    if (vlc_http_msg_get_status(resp) != 206)
+        goto fail;
+
+    const char *str = vlc_http_msg_get_header(resp, "Content-Range");
+    if (str == NULL
+     || sscanf(str, "bytes %" SCNuMAX "-%" SCNuMAX, &start, &end) != 2
+     || start != range->start || end < start)
+        goto fail;
+
+    (void) res;
+    return 0;
+
+fail:
+    errno = EIO;
+    return -1;
+}
+
+static const struct vlc_http_resource_cbs vlc_http_range_callbacks =
+{
+    vlc_http_range_req,
+    vlc_http_range_resp,
+};
+
+static struct vlc_http_resource *
+vlc_http_range_create(struct vlc_http_parallel *p, struct vlc_http_mgr *mgr,
+                      const char *url, const struct vlc_http_resource *file)
+{
+    struct vlc_http_range_resource *rr = malloc(sizeof (*rr));
+    if (unlikely(rr == NULL))
+        return NULL;
+
+    if (vlc_http_res_init(&rr->resource, &vlc_http_range_callbacks, mgr, url,
+                          file->agent, file->referrer))
+    {
+        free(rr);
+        return NULL;
+    }
+
+    rr->parallel = p;
+    rr->resource.negotiate = file->negotiate;
+    if (file->username != NULL)
+        vlc_http_res_set_login(&rr->resource, file->username, file->password);
+    return &rr->resource;
+}
+
+/*** Chunks window ***/
+
+static struct vlc_http_chunk *vlc_http_chunk_get(struct vlc_http_parallel *p,
+                                                 uintmax_t index)
+{
+    return &p->chunks[index % p->slots];
+}
+
+static void vlc_http_chunk_reset(struct vlc_http_parallel *p,
+                                 struct vlc_http_chunk *c, uintmax_t index,
+                                 uintmax_t start)
+{
+    block_ChainRelease(c->head);
+    c->head = NULL;
+    c->tailp = &c->head;
+
+    c->index = index;
+    c->pos = start;
+    c->received = start;
+    c->end = (index + 1) * p->chunk_size;
+    if (c->end > p->size || c->end < start /* overflow */)
+        c->end = p->size;
+    c->owner = NULL; /* a worker fetching it will give up */
+    c->failures = 0;
+    c->done = start >= c->end;
+}
+
+/** Finds the first chunk of the window that nobody fetches yet */
+static struct vlc_http_chunk *vlc_http_chunk_next(struct vlc_http_parallel *p)
+{
+    if (p->loading >= p->active || p->error)
+        return NULL;
+
+    for (unsigned i = 0; i < p->slots; i++)
+    {
+        struct vlc_http_chunk *c = vlc_http_chunk_get(p, p->first + i);
+
+        if (!c->done && c->owner == NULL)
+            return c;
+    }
+
+    p->sample_starved = true;
+    return NULL;
+}
+
+/**
+ * Adjusts the number of concurrent requests to the measured throughput.
+ *
+ * This is a simple hill climbing: keep going in the same direction as long
+ * as the throughput improves, go back if it degrades.
+ */
+static void vlc_http_parallel_adapt(struct vlc_http_parallel *p)
+{
+    if (++p->sample_chunks < p->active)
+        return;
+
+    vlc_tick_t now = vlc_tick_now();
+    vlc_tick_t elapsed = now - p->sample_start;
+    uint64_t bytes = p->sample_bytes;
+    bool starved = p->sample_starved;
+
+    p->sample_start = now;
+    p->sample_bytes = 0;
+    p->sample_chunks = 0;
+    p->sample_starved = false;
+
+    /* If the reader is the bottleneck, the sample says nothing about the
+     * network. */
+    if (starved || elapsed <= 0)
+        return;
+
+    uint64_t rate = bytes * CLOCK_FREQ / elapsed;
+
+    if (p->rate != 0)
+    {
+        if (rate * 10 < p->rate * 9)
+            p->step = -p->step; /* worse: go back */
+        else if (rate * 10 <= p->rate * 11)
+        {   /* no significant change: stay */
+            p->rate = rate;
+            return;
+        }
+    }
+    p->rate = rate;
+
+    if (p->step < 0 ? p->active <= 1 : p->active >= p->max_conns)
+        return;
+
+    p->active += p->step;
+    vlc_http_dbg(p->obj, "%" PRIu64 " kB/s, using %u connection(s)",
+                 rate / 1000, p->active);
+    vlc_cond_broadcast(&p->wait_work);
+}
+
+/*** Workers ***/
+
+/**
+ * Fetches (the rest of) a chunk. Called and returns with the lock held.
+ *
+ * @return true if the fetch failed, false if it completed or was abandoned
+ */
+static bool vlc_http_worker_fetch(struct vlc_http_worker *w,
+                                  struct vlc_http_chunk *c)
+{
+    struct vlc_http_parallel *p = w->parallel;
+    const uintmax_t index = c->index;
+    struct vlc_http_range range = { c->received, c->end - 1 };
+    bool failed = false;
+
+    vlc_mutex_unlock(&p->lock);
+    struct vlc_http_msg *resp = vlc_http_res_open(w->resource, &range);
+    vlc_mutex_lock(&p->lock);
+
+    if (resp == NULL)
+        return true;
+
+    while (c->owner == w && c->index == index)
+    {
+        vlc_mutex_unlock(&p->lock);
+        block_t *block = vlc_http_msg_read(resp);
+        vlc_mutex_lock(&p->lock);
+
+        if (block == NULL || block == vlc_http_error)
+        {   /* The chunk is not complete */
+            failed = true;
+            break;
+        }
+
+        if (c->owner != w || c->index != index)
+        {   /* Seek: the chunk is not wanted anymore */
+            block_Release(block);
+            break;
+        }
+
+        if (block->i_buffer > c->end - c->received)
+            block->i_buffer = c->end - c->received;
+
+        *c->tailp = block;
+        c->tailp = &block->p_next;
+        c->received += block->i_buffer;
+        p->sample_bytes += block->i_buffer;
+        vlc_cond_signal(&p->wait_data);
+
+        if (c->received >= c->end)
+        {
+            c->done = true;
+            c->owner = NULL;
+            vlc_http_parallel_adapt(p);
+            break;
+        }
+    }
+
+    vlc_mutex_unlock(&p->lock);
+    vlc_http_msg_destroy(resp);
+    vlc_mutex_lock(&p->lock);
+    return failed;
+}
+
+static void *vlc_http_worker_thread(void *data)
+{
+    struct vlc_http_worker *w = data;
+    struct vlc_http_parallel *p = w->parallel;
+
+    vlc_interrupt_set(w->interrupt);
+
+    vlc_mutex_lock(&p->lock);
+    while (!p->closing)
+    {
+        struct vlc_http_chunk *c = vlc_http_chunk_next(p);
+        if (c == NULL)
+        {
+            vlc_cond_wait(&p->wait_work, &p->lock);
+            continue;
+        }
+
+        c->owner = w;
+        p->loading++;
+
+        bool failed = vlc_http_worker_fetch(w, c);
+
+        p->loading--;
+        if (c->owner == w)
+        {   /* Let another worker, or this one, resume from where it stopped */
+            c->owner = NULL;
+            if (failed && ++c->failures >= VLC_HTTP_PARALLEL_RETRIES
+             && !p->closing)
+            {
+                vlc_http_err(p->obj, "cannot fetch bytes %" PRIuMAX
+                             "-%" PRIuMAX, c->received, c->end - 1);
+                p->error = true;
+                vlc_cond_signal(&p->wait_data);
+            }
+        }
+        vlc_cond_broadcast(&p->wait_work);
+    }
+    vlc_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/*** Reader ***/
+
+static void vlc_http_parallel_wake_up(void *data)
+{
+    struct vlc_http_parallel *p = data;
+
+    vlc_mutex_lock(&p->lock);
+    p->interrupted = true;
+    vlc_cond_signal(&p->wait_data);
+    vlc_mutex_unlock(&p->lock);
+}
+
+block_t *vlc_http_parallel_read(struct vlc_http_parallel *p)
+{
+    block_t *block = NULL;
+
+    p->interrupted = false;
+    vlc_interrupt_register(vlc_http_parallel_wake_up, p);
+    vlc_mutex_lock(&p->lock);
+
+    while (p->offset < p->size && !p->interrupted)
+    {
+        struct vlc_http_chunk *c = vlc_http_chunk_get(p, p->first);
+
+        assert(c->index == p->first);
+
+        if (c->head != NULL)
+        {
+            block = c->head;
+            c->head = block->p_next;
+            if (c->head == NULL)
+                c->tailp = &c->head;
+            block->p_next = NULL;
+
+            uintmax_t start = c->pos;
+
+            c->pos += block->i_buffer;
+            if (c->pos <= p->offset)
+            {   /* Before the seek offset */
+                block_Release(block);
+                block = NULL;
+                continue;
+            }
+
+            if (start < p->offset)
+            {
+                block->p_buffer += p->offset - start;
+                block->i_buffer -= p->offset - start;
+            }
+            p->offset += block->i_buffer;
+            break;
+        }
+
+        if (c->done)
+        {   /* Slide the window */
+            vlc_http_chunk_reset(p, c, p->first + p->slots,
+                                 (p->first + p->slots) * p->chunk_size);
+            p->first++;
+            vlc_cond_broadcast(&p->wait_work);
+            continue;
+        }
+
+        if (p->error)
+            break;
+
+        vlc_cond_wait(&p->wait_data, &p->lock);
+    }
+
+    vlc_mutex_unlock(&p->lock);
+    vlc_interrupt_unregister();
+    return block;
+}
+
+int vlc_http_parallel_seek(struct vlc_http_parallel *p, uintmax_t offset)
+{
+    const uintmax_t first = offset / p->chunk_size;
+
+    vlc_mutex_lock(&p->lock);
+
+    /* Keep the chunks still within the window */
+    for (unsigned i = 0; i < p->slots; i++)
+    {
+        struct vlc_http_chunk *c = vlc_http_chunk_get(p, first + i);
+
+        if (c->index != first + i)
+            vlc_http_chunk_reset(p, c, first + i,
+                                 (first + i) * p->chunk_size);
+    }
+
+    /* Do not fetch the start of the first chunk unless already there */
+    struct vlc_http_chunk *c = vlc_http_chunk_get(p, first);
+    if (offset < c->pos || offset > c->received)
+        vlc_http_chunk_reset(p, c, first, offset);
+
+    p->first = first;
+    p->offset = offset;
+    p->error = false;
+
+    /* Wait for the new window to fill before measuring */
+    p->sample_start = vlc_tick_now();
+    p->sample_bytes = 0;
+    p->sample_chunks = 0;
+    p->sample_starved = true;
+
+    vlc_cond_broadcast(&p->wait_work);
+    vlc_mutex_unlock(&p->lock);
+    return 0;
+}
+
+unsigned vlc_http_parallel_get_conns(struct vlc_http_parallel *p)
+{
+    vlc_mutex_lock(&p->lock);
+    unsigned n = p->active;
+    vlc_mutex_unlock(&p->lock);
+    return n;
+}
+
+/*** Setup ***/
+
+static void vlc_http_parallel_stop(struct vlc_http_parallel *p, unsigned n)
+{
+    vlc_mutex_lock(&p->lock);
+    p->closing = true;
+    vlc_cond_broadcast(&p->wait_work);
+    vlc_mutex_unlock(&p->lock);
+
+    for (unsigned i = 0; i < n; i++)
+        vlc_interrupt_kill(p->workers[i].interrupt);
+    for (unsigned i = 0; i < n; i++)
+        vlc_join(p->workers[i].thread, NULL);
+}
+
+static void vlc_http_parallel_free(struct vlc_http_parallel *p, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++)
+    {
+        struct vlc_http_worker *w = &p->workers[i];
+
+        vlc_interrupt_destroy(w->interrupt);
+        vlc_http_res_destroy(w->resource);
+        vlc_http_mgr_destroy(w->manager);
+    }
+
+    for (unsigned i = 0; i < p->slots; i++)
+        block_ChainRelease(p->chunks[i].head);
+
+    vlc_cond_destroy(&p->wait_work);
+    vlc_cond_destroy(&p->wait_data);
+    vlc_mutex_destroy(&p->lock);
+    free(p->workers);
+    free(p->chunks);
+    free(p->etag);
+    free(p);
+}
+
+struct vlc_http_parallel *vlc_http_parallel_create(vlc_object_t *obj,
+                                                   struct vlc_http_cookie_jar_t *jar,
+                                                   const char *url,
+                                                   struct vlc_http_resource *file,
+                                                   unsigned max_conns,
+                                                   size_t chunk_size)
+{
+    assert(max_conns > 0 && chunk_size > 0);
+
+    if (!vlc_http_file_can_seek(file))
+        return NULL;
+
+    uintmax_t size = vlc_http_file_get_size(file);
+    if (size == (uintmax_t)-1)
+        return NULL;
+
+    struct vlc_http_parallel *p = malloc(sizeof (*p));
+    if (unlikely(p == NULL))
+        return NULL;
+
+    p->obj = obj;
+    p->size = size;
+    p->etag = NULL;
+    p->mtime = vlc_http_msg_get_mtime(file->response);
+
+    const char *etag = vlc_http_msg_get_header(file->response, "ETag");
+    if (etag != NULL)
+    {
+        if (!memcmp(etag, "W/", 2))
+            etag += 2; /* skip weak mark */
+        p->etag = strdup(etag);
+    }
+
+    p->offset = 0;
+    p->first = 0;
+    p->error = false;
+    p->interrupted = false;
+    p->closing = false;
+
+    /* Two chunks more than connections, so that the reader does not wait
+     * for a new chunk to be requested when it completes one. */
+    p->chunk_size = chunk_size;
+    p->slots = max_conns + 2;
+    p->chunks = malloc(p->slots * sizeof (*p->chunks));
+    p->workers = malloc(max_conns * sizeof (*p->workers));
+
+    p->active = max_conns > 1 ? 2 : 1;
+    p->loading = 0;
+    p->max_conns = max_conns;
+
+    p->sample_start = vlc_tick_now();
+    p->sample_bytes = 0;
+    p->sample_chunks = 0;
+    p->sample_starved = false;
+    p->rate = 0;
+    p->step = 1;
+
+    vlc_mutex_init(&p->lock);
+    vlc_cond_init(&p->wait_data);
+    vlc_cond_init(&p->wait_work);
+
+    if (unlikely(p->chunks == NULL || p->workers == NULL))
+    {
+        p->slots = 0;
+        vlc_http_parallel_free(p, 0);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < p->slots; i++)
+    {
+        p->chunks[i].head = NULL;
+        vlc_http_chunk_reset(p, &p->chunks[i], i, i * chunk_size);
+    }
+
+    unsigned n;
+    for (n = 0; n < max_conns; n++)
+    {
+        struct vlc_http_worker *w = &p->workers[n];
+
+        w->parallel = p;
+        w->manager = vlc_http_mgr_create(obj, jar);
+        if (w->manager == NULL)
+            break;
+
+        w->resource = vlc_http_range_create(p, w->manager, url, file);
+        if (w->resource == NULL)
+        {
+            vlc_http_mgr_destroy(w->manager);
+            break;
+        }
+
+        w->interrupt = vlc_interrupt_create();
+        if (unlikely(w->interrupt == NULL))
+        {
+            vlc_http_res_destroy(w->resource);
+            vlc_http_mgr_destroy(w->manager);
+            break;
+        }
+
+        if (vlc_clone(&w->thread, vlc_http_worker_thread, w,
+                      VLC_THREAD_PRIORITY_LOW))
+        {
+            vlc_interrupt_destroy(w->interrupt);
+            vlc_http_res_destroy(w->resource);
+            vlc_http_mgr_destroy(w->manager);
+            break;
+        }
+    }
+
+    if (n < max_conns)
+    {
+        vlc_http_parallel_stop(p, n);
+        vlc_http_parallel_free(p, n);
+        return NULL;
+    }
+    return p;
+}
+
+void vlc_http_parallel_destroy(struct vlc_http_parallel *p)
+{
+    vlc_http_parallel_stop(p, p->max_conns);
+    vlc_http_dbg(p->obj, "last throughput %" PRIu64 " kB/s with %u "
+                 "connection(s)", p->rate / 1000, p->active);
+    vlc_http_parallel_free(p, p->max_conns);
+}
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * parallel.h: HTTP parallel ranged reads
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdint.h>
+
+/**
+ * \defgroup http_parallel Parallel reads
+ * HTTP read-only files fetched over several connections
+ * \ingroup http_file
+ * @{
+ */
+
+struct vlc_http_cookie_jar_t;
+struct vlc_http_resource;
+struct vlc_http_parallel;
+struct block_t;
+
+/**
+ * Creates a parallel reader.
+ *
+ * Splits the remote file ahead of the read offset into chunks, and fetches
+ * them with concurrent range requests, each over its own connection.
+ * The number of concurrent requests starts low and adapts to the measured
+ * throughput, up to the given maximum.
+ *
+ * @param obj parent VLC object (for the connections and logging)
+ * @param jar HTTP cookies jar (NULL to disable cookies)
+ * @param url URL of the file to read
+ * @param file HTTP file already opened at that URL, to take the size,
+ *             credentials and entity validators from; it must be seekable and
+ *             of known size
+ * @param max_conns maximum number of concurrent requests
+ * @param chunk_size size of each range request in bytes
+ *
+ * @return a parallel reader, or NULL on error
+ */
+struct vlc_http_parallel *vlc_http_parallel_create(vlc_object_t *obj,
+                                                   struct vlc_http_cookie_jar_t *jar,
+                                                   const char *url,
+                                                   struct vlc_http_resource *file,
+                                                   unsigned max_conns,
+                                                   size_t chunk_size);
+
+/**
+ * Destroys a parallel reader.
+ *
+ * Aborts all pending requests and closes the connections.
+ */
+void vlc_http_parallel_destroy(struct vlc_http_parallel *);
+
+/**
+ * Reads data.
+ *
+ * Returns the next data block in order, waiting for it if needed.
+ *
+ * @return a data block, or NULL on end of file, error or interruption
+ */
+struct block_t *vlc_http_parallel_read(struct vlc_http_parallel *);
+
+/**
+ * Sets the read offset.
+ *
+ * Chunks already fetched or being fetched at or after the new offset are
+ * kept, others are discarded.
+ */
+int vlc_http_parallel_seek(struct vlc_http_parallel *, uintmax_t offset);
+
+/**
+ * Gets the current number of concurrent requests.
+ */
+unsigned vlc_http_parallel_get_conns(struct vlc_http_parallel *);
+
+/** @} */
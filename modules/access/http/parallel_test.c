@@ -0,0 +1,371 @@
+/*****************************************************************************
+ * parallel_test.c: HTTP parallel ranged reads test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include "resource.h"
+#include "file.h"
+#include "message.h"
+#include "parallel.h"
+
+static const char url[] = "https://www.example.com:8443/dir/file.ext";
+static const char ua[] = PACKAGE_NAME "/" PACKAGE_VERSION " (test suite)";
+
+/*
+ * The server emulates a long fat link: each request takes one round trip,
+ * and each TCP flow delivers at most one receive window per round trip.
+ * The link itself is capped, so that more connections stop helping at some
+ * point.
+ */
+#define FILE_SIZE   (6 * 1024 * 1024 + 4321)
+#define CHUNK_SIZE  (256 * 1024)
+#define RTT         VLC_TICK_FROM_MS(10)
+#define WINDOW      (32 * 1024)
+#define LINK_RATE   (12 * 1000 * 1000) /* bytes per second */
+
+static uint8_t file_byte(uintmax_t offset)
+{
+    return offset ^ (offset >> 9) ^ (offset >> 17);
+}
+
+static vlc_mutex_t server_lock = VLC_STATIC_MUTEX;
+static vlc_tick_t link_free;
+static unsigned requests, concurrent, peak;
+/* Concurrent chunk requests, i.e. not counting the initial file request */
+static unsigned ranged, ranged_peak;
+
+/* Callback for vlc_http_msg_h2_frame */
+#include "h2frame.h"
+
+struct vlc_h2_frame *
+vlc_h2_frame_headers(struct hpack_encoder *enc, uint_fast32_t id,
+                     uint_fast32_t mtu, bool eos,
+                     unsigned count, const char *const tab[][2])
+{
+    (void) enc; (void) id; (void) mtu; (void) count, (void) tab;
+    assert(!eos);
+    return NULL;
+}
+
+/* Callbacks for the HTTP streams */
+struct server_stream
+{
+    struct vlc_http_stream stream;
+    uintmax_t start;
+    uintmax_t offset;
+    uintmax_t end; /* inclusive */
+    bool ranged; /* bounded range, i.e. a chunk */
+    vlc_tick_t next; /* when the next window is sent */
+};
+
+static struct vlc_http_msg *stream_read_headers(struct vlc_http_stream *s)
+{
+    struct server_stream *ss = container_of(s, struct server_stream, stream);
+    char *str;
+
+    if (asprintf(&str, "HTTP/1.1 206 Partial Content\r\n"
+                 "Content-Range: bytes %" PRIuMAX "-%" PRIuMAX "/%u\r\n"
+                 "Content-Length: %" PRIuMAX "\r\n"
+                 "ETag: \"foobar42\"\r\n"
+                 "Accept-Ranges: bytes\r\n\r\n", ss->start, ss->end,
+                 FILE_SIZE, ss->end - ss->start + 1) < 0)
+        abort();
+
+    struct vlc_http_msg *m = vlc_http_msg_headers(str);
+    assert(m != NULL);
+    free(str);
+    vlc_http_msg_attach(m, s);
+    return m;
+}
+
+static struct block_t *stream_read(struct vlc_http_stream *s)
+{
+    struct server_stream *ss = container_of(s, struct server_stream, stream);
+
+    if (ss->offset > ss->end)
+        return NULL;
+
+    size_t len = WINDOW;
+    if (len > ss->end + 1 - ss->offset)
+        len = ss->end + 1 - ss->offset;
+
+    /* Wait for the flow window, then for the shared link */
+    vlc_tick_wait(ss->next);
+    vlc_mutex_lock(&server_lock);
+    vlc_tick_t now = vlc_tick_now();
+    if (link_free < now)
+        link_free = now;
+    link_free += vlc_tick_from_samples(len, LINK_RATE);
+    vlc_tick_t deadline = link_free;
+    vlc_mutex_unlock(&server_lock);
+    vlc_tick_wait(deadline);
+    ss->next = vlc_tick_now() + RTT;
+
+    block_t *block = block_Alloc(len);
+    assert(block != NULL);
+    for (size_t i = 0; i < len; i++)
+        block->p_buffer[i] = file_byte(ss->offset + i);
+    ss->offset += len;
+    return block;
+}
+
+static void stream_close(struct vlc_http_stream *s, bool abort)
+{
+    struct server_stream *ss = container_of(s, struct server_stream, stream);
+
+    (void) abort;
+    vlc_mutex_lock(&server_lock);
+    concurrent--;
+    if (ss->ranged)
+        ranged--;
+    vlc_mutex_unlock(&server_lock);
+    free(ss);
+}
+
+static const struct vlc_http_stream_cbs stream_callbacks =
+{
+    stream_read_headers,
+    stream_read,
+    stream_close,
+};
+
+/* Callbacks for the HTTP connection manager */
+#include "connmgr.h"
+
+struct vlc_http_mgr
+{
+    bool connected;
+};
+
+struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
+                                          const char *host, unsigned port,
+                                          const struct vlc_http_msg *req)
+{
+    const char *str;
+    char *end;
+
+    assert(https);
+    assert(!strcmp(host, "www.example.com"));
+    assert(port == 8443);
+    str = vlc_http_msg_get_agent(req);
+    assert(str != NULL && !strcmp(str, ua));
+
+    struct server_stream *ss = malloc(sizeof (*ss));
+    assert(ss != NULL);
+    ss->stream.cbs = &stream_callbacks;
+
+    str = vlc_http_msg_get_header(req, "Range");
+    assert(str != NULL && !strncmp(str, "bytes=", 6));
+    ss->start = strtoumax(str + 6, &end, 10);
+    assert(*end == '-');
+    ss->ranged = end[1] != '\0';
+    if (ss->ranged)
+        ss->end = strtoumax(end + 1, NULL, 10);
+    else
+        ss->end = FILE_SIZE - 1;
+    assert(ss->start <= ss->end && ss->end < FILE_SIZE);
+    ss->offset = ss->start;
+
+    str = vlc_http_msg_get_header(req, "If-Match");
+
+    vlc_mutex_lock(&server_lock);
+    /* Only the first request may come without validator */
+    assert(requests == 0 || (str != NULL && !strcmp(str, "\"foobar42\"")));
+    requests++;
+    if (++concurrent > peak)
+        peak = concurrent;
+    if (ss->ranged && ++ranged > ranged_peak)
+        ranged_peak = ranged;
+    vlc_mutex_unlock(&server_lock);
+
+    /* TCP (and TLS) handshake on new connections, then the request */
+    vlc_tick_t delay = mgr->connected ? RTT : 3 * RTT;
+    vlc_tick_sleep(delay);
+    mgr->connected = true;
+    ss->next = vlc_tick_now();
+
+    return vlc_http_msg_get_initial(&ss->stream);
+}
+
+struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *mgr)
+{
+    (void) mgr;
+    return NULL;
+}
+
+struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
+                                         struct vlc_http_cookie_jar_t *jar)
+{
+    struct vlc_http_mgr *mgr = malloc(sizeof (*mgr));
+    assert(mgr != NULL);
+    (void) obj; (void) jar;
+    mgr->connected = false;
+    return mgr;
+}
+
+void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
+{
+    free(mgr);
+}
+
+void vlc_http_err(void *ctx, const char *fmt, ...)
+{
+    (void) ctx; (void) fmt;
+}
+
+void vlc_http_dbg(void *ctx, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    (void) ctx;
+}
+
+/* Test cases */
+static struct vlc_http_resource *file;
+static struct vlc_http_mgr *file_mgr;
+
+static struct vlc_http_parallel *open_parallel(unsigned conns)
+{
+    requests = concurrent = peak = ranged = ranged_peak = 0;
+
+    file_mgr = vlc_http_mgr_create(NULL, NULL);
+    file = vlc_http_file_create(file_mgr, url, ua, NULL);
+    assert(file != NULL);
+    assert(vlc_http_file_get_status(file) == 206);
+    assert(vlc_http_file_get_size(file) == FILE_SIZE);
+
+    struct vlc_http_parallel *p = vlc_http_parallel_create(NULL, NULL, url,
+                                                           file, conns,
+                                                           CHUNK_SIZE);
+    assert(p != NULL);
+    return p;
+}
+
+static void close_parallel(struct vlc_http_parallel *p)
+{
+    vlc_http_parallel_destroy(p);
+    vlc_http_file_destroy(file);
+    vlc_http_mgr_destroy(file_mgr);
+}
+
+/* Reads up to len bytes from offset and checks them */
+static uintmax_t read_check(struct vlc_http_parallel *p, uintmax_t offset,
+                            uintmax_t len)
+{
+    uintmax_t end = (len < UINTMAX_MAX - offset) ? offset + len : UINTMAX_MAX;
+
+    while (offset < end)
+    {
+        block_t *block = vlc_http_parallel_read(p);
+        if (block == NULL)
+            break;
+
+        for (size_t i = 0; i < block->i_buffer; i++)
+            assert(block->p_buffer[i] == file_byte(offset + i));
+        offset += block->i_buffer;
+        block_Release(block);
+    }
+    return offset;
+}
+
+static void test_read(unsigned conns)
+{
+    struct vlc_http_parallel *p = open_parallel(conns);
+    vlc_tick_t start = vlc_tick_now();
+
+    assert(read_check(p, 0, UINTMAX_MAX) == FILE_SIZE);
+    assert(vlc_http_parallel_read(p) == NULL);
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    unsigned final = vlc_http_parallel_get_conns(p);
+
+    assert(peak <= conns + 1 /* the initial file request */);
+    assert(ranged_peak <= conns);
+    /* Start with two connections when allowed, each fetching its chunk */
+    assert(ranged_peak >= (conns > 1 ? 2u : 1u));
+    /* The timing depends on the machine load: report it only */
+    printf("up to %2u connection(s): %4"PRId64" ms, %3"PRIu64" kB/s, "
+           "%u requests, up to %u in parallel, ended with %u "
+           "connection(s)\n", conns, MS_FROM_VLC_TICK(elapsed),
+           (uint64_t)FILE_SIZE * CLOCK_FREQ / elapsed / 1000, requests,
+           ranged_peak, final);
+    close_parallel(p);
+}
+
+static void test_seek(void)
+{
+    struct vlc_http_parallel *p = open_parallel(4);
+    uintmax_t offset;
+
+    /* Within the first chunk, already being fetched */
+    offset = read_check(p, 0, 1000);
+    assert(vlc_http_parallel_seek(p, 5000) == 0);
+    offset = read_check(p, 5000, CHUNK_SIZE);
+    assert(offset >= 5000 + CHUNK_SIZE);
+
+    /* Backward, within the same chunk */
+    assert(vlc_http_parallel_seek(p, 100) == 0);
+    offset = read_check(p, 100, 10);
+
+    /* Forward, within the window */
+    assert(vlc_http_parallel_seek(p, 2 * CHUNK_SIZE + 77) == 0);
+    offset = read_check(p, 2 * CHUNK_SIZE + 77, CHUNK_SIZE);
+
+    /* Far forward and back */
+    assert(vlc_http_parallel_seek(p, FILE_SIZE / 2 + 1) == 0);
+    offset = read_check(p, FILE_SIZE / 2 + 1, 3 * CHUNK_SIZE);
+    assert(vlc_http_parallel_seek(p, 12345) == 0);
+    offset = read_check(p, 12345, CHUNK_SIZE);
+
+    /* Up to and past the end */
+    assert(vlc_http_parallel_seek(p, FILE_SIZE - 100) == 0);
+    offset = read_check(p, FILE_SIZE - 100, UINTMAX_MAX);
+    assert(offset == FILE_SIZE);
+    assert(vlc_http_parallel_seek(p, FILE_SIZE + 100) == 0);
+    assert(vlc_http_parallel_read(p) == NULL);
+
+    /* Abandon chunks in flight */
+    assert(vlc_http_parallel_seek(p, 0) == 0);
+    close_parallel(p);
+}
+
+int main(void)
+{
+    test_read(1);
+    test_read(8);
+    test_seek();
+    return 0;
+}
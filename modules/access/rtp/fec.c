@@ -0,0 +1,263 @@
+/**
+ * @file fec.c
+ * @brief SMPTE 2022-1 forward error correction
+ */
+/*****************************************************************************
+ * Copyright © 2018 VLC authors and VideoLAN
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ ****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "rtp.h"
+
+/*
+ * SMPTE 2022-1 protects a matrix of L columns by D rows of media packets
+ * with one XOR parity packet per column (sent on the media port + 2) and
+ * optionally one per row (media port + 4). Each FEC packet carries, after
+ * its own RTP header:
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |      SNBase low bits          |        Length recovery        |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |E| PT recovery |                    Mask                       |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                          TS recovery                          |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |N|D|type |index|    Offset     |      NA       |SNBase ext bits|
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * followed by the XOR of the payloads of the NA media packets with sequence
+ * numbers SNBase + i * Offset. Anything after the fixed RTP header of a
+ * media packet counts as payload, as 2022-1 does not recover the CSRC count
+ * nor the extension bit.
+ */
+#define FEC_HEADER_SIZE 16
+#define FEC_MAX_PACKETS 128
+
+typedef struct
+{
+    block_t *block; /* FEC packet, starting from the FEC header */
+    uint16_t base;
+    uint8_t  offset;
+    uint8_t  count;
+} rtp_fec_packet_t;
+
+struct rtp_fec_t
+{
+    unsigned         count;
+    rtp_fec_packet_t packets[FEC_MAX_PACKETS];
+};
+
+rtp_fec_t *rtp_fec_create (void)
+{
+    rtp_fec_t *fec = malloc (sizeof (*fec));
+    if (fec != NULL)
+        fec->count = 0;
+    return fec;
+}
+
+void rtp_fec_destroy (rtp_fec_t *fec)
+{
+    for (unsigned i = 0; i < fec->count; i++)
+        block_Release (fec->packets[i].block);
+    free (fec);
+}
+
+static void rtp_fec_remove (rtp_fec_t *fec, unsigned i)
+{
+    assert (i < fec->count);
+    block_Release (fec->packets[i].block);
+    fec->packets[i] = fec->packets[--fec->count];
+}
+
+/**
+ * Stores an FEC packet for later recovery.
+ *
+ * @param block FEC packet including the RTP header (always consumed)
+ * @return 0 on success, EINVAL if the packet is malformed or uses an
+ * unsupported FEC scheme.
+ */
+int rtp_fec_add (rtp_fec_t *fec, block_t *block)
+{
+    if (block->i_buffer < 12 + FEC_HEADER_SIZE
+     || (block->p_buffer[0] >> 6) != 2)
+        goto error;
+
+    size_t skip = 12u + (block->p_buffer[0] & 0x0F) * 4;
+    if (block->i_buffer < skip + FEC_HEADER_SIZE)
+        goto error;
+
+    const uint8_t *hdr = block->p_buffer + skip;
+    if ((hdr[12] & 0x80) /* N: extension (2022-5) */
+     || (hdr[12] & 0x38) /* type: only XOR is defined */
+     || hdr[13] == 0 || hdr[14] == 0)
+        goto error;
+
+    if (fec->count == FEC_MAX_PACKETS)
+        rtp_fec_remove (fec, 0); /* make room */
+
+    block->p_buffer += skip;
+    block->i_buffer -= skip;
+
+    rtp_fec_packet_t *p = &fec->packets[fec->count++];
+    p->block = block;
+    p->base = GetWBE (hdr);
+    p->offset = hdr[13];
+    p->count = hdr[14];
+    return 0;
+
+error:
+    block_Release (block);
+    return EINVAL;
+}
+
+/**
+ * Rebuilds the only missing media packet protected by an FEC packet.
+ */
+static block_t *rtp_fec_rebuild (const rtp_fec_packet_t *p, uint16_t seq,
+                                 void *opaque,
+                                 block_t *(*get) (void *, uint16_t))
+{
+    const uint8_t *hdr = p->block->p_buffer;
+    size_t len = GetWBE (hdr + 2);
+    uint8_t ptype = hdr[4] & 0x7F;
+    uint32_t ts = GetDWBE (hdr + 8);
+    uint32_t ssrc = 0;
+
+    for (unsigned i = 0; i < p->count; i++)
+    {
+        const block_t *media = get (opaque, p->base + i * p->offset);
+        if (media == NULL)
+            continue;
+
+        len ^= media->i_buffer - 12;
+        ptype ^= media->p_buffer[1] & 0x7F;
+        ts ^= GetDWBE (media->p_buffer + 4);
+        ssrc = GetDWBE (media->p_buffer + 8);
+    }
+
+    if (len > p->block->i_buffer - FEC_HEADER_SIZE)
+        return NULL; /* inconsistent FEC group */
+
+    block_t *block = block_Alloc (12 + len);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    uint8_t *buf = block->p_buffer;
+    buf[0] = 0x80;
+    buf[1] = ptype; /* marker bit cannot be recovered */
+    SetWBE (buf + 2, seq);
+    SetDWBE (buf + 4, ts);
+    SetDWBE (buf + 8, ssrc);
+    memcpy (buf + 12, hdr + FEC_HEADER_SIZE, len);
+
+    for (unsigned i = 0; i < p->count; i++)
+    {
+        const block_t *media = get (opaque, p->base + i * p->offset);
+        if (media == NULL)
+            continue;
+
+        size_t n = media->i_buffer - 12;
+        if (n > len)
+            n = len;
+        for (size_t j = 0; j < n; j++)
+            buf[12 + j] ^= media->p_buffer[12 + j];
+    }
+    return block;
+}
+
+/**
+ * Rebuilds missing media packets from the stored FEC packets.
+ * Recovering a packet from a column can complete a row, and conversely,
+ * so this iterates until no further progress can be made.
+ *
+ * @param first sequence number of the oldest media packet still wanted;
+ * FEC packets protecting older packets are discarded
+ * @param get callback returning the queued media packet with a given
+ * sequence number, or NULL if it is missing
+ * @param put callback receiving each rebuilt media packet
+ * @return the number of rebuilt media packets
+ */
+unsigned rtp_fec_recover (rtp_fec_t *fec, uint16_t first, void *opaque,
+                          block_t *(*get) (void *, uint16_t),
+                          void (*put) (void *, block_t *))
+{
+    unsigned recovered = 0;
+    bool progress;
+
+    do
+    {
+        progress = false;
+
+        for (unsigned i = 0; i < fec->count;)
+        {
+            const rtp_fec_packet_t *p = &fec->packets[i];
+
+            if ((uint16_t)(p->base - first) >= 0x8000)
+            {   /* Some protected packets were already dequeued */
+                rtp_fec_remove (fec, i);
+                continue;
+            }
+
+            unsigned missing = 0;
+            uint16_t seq = 0;
+
+            for (unsigned j = 0; j < p->count && missing < 2; j++)
+            {
+                uint16_t s = p->base + j * p->offset;
+                if (get (opaque, s) == NULL)
+                {
+                    seq = s;
+                    missing++;
+                }
+            }
+
+            if (missing >= 2)
+            {
+                i++;
+                continue;
+            }
+
+            if (missing == 1)
+            {
+                block_t *block = rtp_fec_rebuild (p, seq, opaque, get);
+                if (block != NULL)
+                {
+                    put (opaque, block);
+                    recovered++;
+                    progress = true;
+                }
+            }
+            rtp_fec_remove (fec, i);
+        }
+    }
+    while (progress);
+
+    return recovered;
+}
@@ -0,0 +1,355 @@
+/*
+ * RTP session re-ordering and FEC recovery test
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "rtp.h"
+
+/* SMPTE 2022-1 matrix of COLUMNS x ROWS media packets */
+#define COLUMNS  10
+#define ROWS     5
+#define MATRICES 20
+#define COUNT    (COLUMNS * ROWS * MATRICES)
+#define SEQ0     65000 /* exercise sequence number wrap-around */
+#define PTYPE    33
+#define FEC_PTYPE 96
+
+static unsigned out[COUNT];
+static unsigned outc;
+static unsigned discontinuities;
+
+static uint8_t payload_byte (unsigned n, size_t i)
+{
+    return n * 31 + i * 7;
+}
+
+static size_t payload_size (unsigned n)
+{
+    return 1316 - (n % 4) * 188;
+}
+
+static block_t *media_packet (unsigned n)
+{
+    size_t len = payload_size (n);
+    block_t *block = block_Alloc (12 + len);
+    assert (block != NULL);
+
+    uint8_t *buf = block->p_buffer;
+    buf[0] = 0x80;
+    buf[1] = PTYPE;
+    SetWBE (buf + 2, SEQ0 + n);
+    SetDWBE (buf + 4, n * 3000);
+    SetDWBE (buf + 8, 0x12345678);
+    for (size_t i = 0; i < len; i++)
+        buf[12 + i] = payload_byte (n, i);
+    SetDWBE (buf + 12, n); /* tag for decode() */
+    return block;
+}
+
+/* Builds the FEC packet protecting count packets from n, offset apart */
+static block_t *fec_packet (unsigned n, unsigned offset, unsigned count,
+                            bool row)
+{
+    block_t *block = block_Alloc (12 + 16 + 1316);
+    assert (block != NULL);
+
+    uint8_t *buf = block->p_buffer;
+    memset (buf, 0, block->i_buffer);
+    buf[0] = 0x80;
+    buf[1] = FEC_PTYPE;
+    SetDWBE (buf + 8, 0);
+
+    uint8_t *hdr = buf + 12;
+    uint16_t len = 0;
+    uint32_t ts = 0;
+    uint8_t ptype = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        block_t *media = media_packet (n + i * offset);
+
+        len ^= media->i_buffer - 12;
+        ptype ^= media->p_buffer[1] & 0x7F;
+        ts ^= GetDWBE (media->p_buffer + 4);
+        for (size_t j = 12; j < media->i_buffer; j++)
+            hdr[16 + j - 12] ^= media->p_buffer[j];
+        block_Release (media);
+    }
+
+    SetWBE (hdr, SEQ0 + n);
+    SetWBE (hdr + 2, len);
+    hdr[4] = 0x80 | ptype;
+    SetDWBE (hdr + 8, ts);
+    hdr[12] = row ? 0x40 : 0x00;
+    hdr[13] = offset;
+    hdr[14] = count;
+    return block;
+}
+
+static void decode (demux_t *demux, void *data, block_t *block)
+{
+    (void) demux; (void) data;
+    assert (block->i_buffer >= 4);
+
+    unsigned n = GetDWBE (block->p_buffer);
+    assert (n < COUNT);
+    assert (block->i_buffer == payload_size (n));
+    for (size_t i = 4; i < block->i_buffer; i++)
+        assert (block->p_buffer[i] == payload_byte (n, i));
+
+    bool gap = (outc > 0) ? (n != out[outc - 1] + 1) : (n != 0);
+    assert (!!(block->i_flags & BLOCK_FLAG_DISCONTINUITY) == (outc > 0 && gap));
+    if (block->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        discontinuities++;
+
+    assert (outc < COUNT);
+    out[outc++] = n;
+    block_Release (block);
+}
+
+static demux_sys_t sys;
+static demux_t demux;
+
+static rtp_session_t *session_create (vlc_tick_t latency)
+{
+    memset (&sys, 0, sizeof (sys));
+    sys.timeout = VLC_TICK_FROM_SEC(60);
+    sys.latency = latency;
+    sys.max_dropout = 3000;
+    sys.max_misorder = 100;
+    sys.max_src = 1;
+
+    memset (&demux, 0, sizeof (demux));
+    demux.obj.flags = OBJECT_FLAGS_QUIET;
+    demux.p_sys = &sys;
+
+    rtp_session_t *session = rtp_session_create (&demux);
+    assert (session != NULL);
+
+    const rtp_pt_t pt = {
+        .decode = decode,
+        .frequency = 90000,
+        .number = PTYPE,
+    };
+    int val = rtp_add_type (&demux, session, &pt);
+    assert (val == 0);
+
+    outc = 0;
+    discontinuities = 0;
+    return session;
+}
+
+/* Media packet n is lost in transit */
+static bool is_lost (unsigned n)
+{
+    unsigned m = n / (COLUMNS * ROWS);
+    unsigned r = (n / COLUMNS) % ROWS;
+    unsigned c = n % COLUMNS;
+
+    switch (m)
+    {
+        case 1: /* single loss */
+            return r == 2 && c == 3;
+        case 3: /* burst of a row, rebuilt from columns */
+            return r == 1;
+        case 5: /* column, rebuilt from rows */
+            return c == 4;
+        case 7: /* 2x2 square, unrecoverable */
+            return r < 2 && c < 2;
+        case 9: /* single loss, but its FEC packets are lost as well */
+            return r == 0 && c == 0;
+        case 11: /* rebuilt in turns from columns and rows */
+            return (r == 1 && (c == 1 || c == 2)) || (r == 2 && c == 1);
+    }
+    return false;
+}
+
+static bool is_unrecoverable (unsigned n)
+{
+    unsigned m = n / (COLUMNS * ROWS);
+    return (m == 7 || m == 9) && is_lost (n);
+}
+
+/* Replays the trace of a 2022-1 sender with loss and re-ordering */
+static void replay (rtp_session_t *session, bool fec)
+{
+    block_t *trace[2 * COUNT];
+    unsigned len = 0;
+    vlc_tick_t deadline;
+
+    for (unsigned m = 0; m < MATRICES; m++)
+    {
+        unsigned base = m * COLUMNS * ROWS;
+
+        for (unsigned r = 0; r < ROWS; r++)
+        {
+            for (unsigned c = 0; c < COLUMNS; c++)
+            {
+                unsigned n = base + r * COLUMNS + c;
+                if (!fec || !is_lost (n))
+                    trace[len++] = media_packet (n);
+            }
+            if (fec && !(m == 9 && r == 0))
+                trace[len++] = fec_packet (base + r * COLUMNS, 1, COLUMNS,
+                                           true);
+        }
+
+        for (unsigned c = 0; fec && c < COLUMNS; c++)
+            if (!(m == 9 && c == 0))
+                trace[len++] = fec_packet (base + c, COLUMNS, ROWS, false);
+    }
+
+    /* Swap some neighbouring packets, and delay some by a few packets.
+     * The first packet must come first, as it starts the sequence. */
+    for (unsigned i = 5; i + 1 < len; i += 7)
+    {
+        block_t *tmp = trace[i];
+        trace[i] = trace[i + 1];
+        trace[i + 1] = tmp;
+    }
+    for (unsigned i = 3; i + 5 < len; i += 23)
+    {
+        block_t *tmp = trace[i];
+        memmove (trace + i, trace + i + 1, 4 * sizeof (*trace));
+        trace[i + 4] = tmp;
+    }
+
+    for (unsigned i = 0; i < len; i++)
+    {
+        block_t *block = trace[i];
+
+        if ((block->p_buffer[1] & 0x7F) == FEC_PTYPE)
+            rtp_queue_fec (&demux, session, block);
+        else
+            rtp_queue (&demux, session, block);
+        rtp_dequeue (&demux, session, &deadline);
+    }
+}
+
+static void check_output (bool fec)
+{
+    unsigned lost = 0, runs = 0;
+    unsigned i = 0;
+
+    for (unsigned n = 0; n < COUNT; n++)
+    {
+        if (fec && is_unrecoverable (n))
+        {
+            if (n == 0 || !is_unrecoverable (n - 1))
+                runs++;
+            lost++;
+            continue;
+        }
+        assert (i < outc);
+        assert (out[i] == n);
+        i++;
+    }
+    assert (i == outc);
+    assert (discontinuities == runs);
+    printf ("%u packets decoded, %u lost in %u gaps\n", outc, lost, runs);
+}
+
+/* Re-ordering without loss, decoded as soon as in sequence */
+static void test_reorder (void)
+{
+    rtp_session_t *session = session_create (0);
+    vlc_tick_t deadline;
+
+    replay (session, false);
+    assert (!rtp_dequeue (&demux, session, &deadline));
+    check_output (false);
+    rtp_session_destroy (&demux, session);
+}
+
+/* Loss without FEC, given up on after the adaptive delay */
+static void test_loss (void)
+{
+    rtp_session_t *session = session_create (0);
+    vlc_tick_t deadline;
+
+    for (unsigned n = 0; n < 10; n++)
+        if (n != 5)
+            rtp_queue (&demux, session, media_packet (n));
+
+    assert (rtp_dequeue (&demux, session, &deadline));
+    assert (outc == 5);
+    vlc_tick_wait (deadline);
+    assert (!rtp_dequeue (&demux, session, &deadline));
+    assert (outc == 9 && discontinuities == 1 && out[5] == 6);
+
+    /* Too late now */
+    rtp_queue (&demux, session, media_packet (5));
+    rtp_dequeue_force (&demux, session);
+    assert (outc == 9);
+    rtp_session_destroy (&demux, session);
+}
+
+/* Fixed latency: even in sequence packets are held */
+static void test_latency (void)
+{
+    rtp_session_t *session = session_create (VLC_TICK_FROM_MS(20));
+    vlc_tick_t start = vlc_tick_now ();
+    vlc_tick_t deadline;
+
+    for (unsigned n = 0; n < 3; n++)
+        rtp_queue (&demux, session, media_packet (n));
+
+    assert (rtp_dequeue (&demux, session, &deadline));
+    assert (deadline >= start + VLC_TICK_FROM_MS(20));
+    if (vlc_tick_now () < start + VLC_TICK_FROM_MS(20))
+        assert (outc == 0);
+    vlc_tick_wait (deadline);
+    assert (!rtp_dequeue (&demux, session, &deadline));
+    assert (outc == 3);
+    rtp_session_destroy (&demux, session);
+}
+
+/* Loss and re-ordering, rebuilt from column and row FEC */
+static void test_fec (void)
+{
+    /* Long enough not to give up on anything while the trace is fed */
+    rtp_session_t *session = session_create (VLC_TICK_FROM_SEC(60));
+
+    replay (session, true);
+    assert (outc == 0);
+    rtp_dequeue_force (&demux, session);
+    check_output (true);
+    rtp_session_destroy (&demux, session);
+}
+
+int main (void)
+{
+    test_reorder ();
+    test_loss ();
+    test_latency ();
+    test_fec ();
+    return 0;
+}
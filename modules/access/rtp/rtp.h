@@ -56,8 +56,19 @@ void rtp_session_destroy (demux_t *, rtp_session_t *);
 void rtp_queue (demux_t *, rtp_session_t *, block_t *);
 bool rtp_dequeue (demux_t *, const rtp_session_t *, vlc_tick_t *);
 void rtp_dequeue_force (demux_t *, const rtp_session_t *);
+void rtp_queue_fec (demux_t *, rtp_session_t *, block_t *);
 int rtp_add_type (demux_t *demux, rtp_session_t *ses, const rtp_pt_t *pt);
 
+/** @section SMPTE 2022-1 forward error correction */
+typedef struct rtp_fec_t rtp_fec_t;
+
+rtp_fec_t *rtp_fec_create (void);
+void rtp_fec_destroy (rtp_fec_t *);
+int rtp_fec_add (rtp_fec_t *, block_t *);
+unsigned rtp_fec_recover (rtp_fec_t *, uint16_t first, void *opaque,
+                          block_t *(*get) (void *, uint16_t),
+                          void (*put) (void *, block_t *));
+
 void *rtp_dgram_thread (void *data);
 void *rtp_stream_thread (void *data);
 
@@ -71,9 +82,11 @@ typedef struct
 #endif
     int           fd;
     int           rtcp_fd;
+    int           fec_fd[2]; /**< SMPTE 2022-1 column and row FEC sockets */
     vlc_thread_t  thread;
 
     vlc_tick_t    timeout;
+    vlc_tick_t    latency; /**< Fixed de-jitter delay, 0 if adaptive */
     uint16_t      max_dropout; /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
     uint8_t       max_src; /**< Max simultaneous RTP sources */
@@ -25,6 +25,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -42,6 +43,7 @@ struct rtp_session_t
     unsigned       srcc;
     uint8_t        ptc;
     rtp_pt_t      *ptv;
+    uint16_t       ring_mask; /* re-ordering buffer size minus one */
 };
 
 static rtp_source_t *
@@ -49,6 +51,9 @@ rtp_source_create (demux_t *, const rtp_session_t *, uint32_t, uint16_t);
 static void
 rtp_source_destroy (demux_t *, const rtp_session_t *, rtp_source_t *);
 
+static void rtp_source_flush (const rtp_session_t *, rtp_source_t *);
+static void rtp_source_insert (demux_t *, const rtp_session_t *,
+                               rtp_source_t *, block_t *);
 static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
 
 /**
@@ -66,7 +71,13 @@ rtp_session_create (demux_t *demux)
     session->ptc = 0;
     session->ptv = NULL;
 
-    (void)demux;
+    /* The re-ordering buffer is indexed by sequence number, it must hold
+     * at least as many packets as may be received ahead of sequence. */
+    demux_sys_t *p_sys = demux->p_sys;
+    unsigned size = 64;
+    while (size <= p_sys->max_dropout)
+        size <<= 1;
+    session->ring_mask = size - 1;
     return session;
 }
 
@@ -148,8 +159,19 @@ struct rtp_source_t
     uint16_t bad_seq; /* tentatively next expected sequence for resync */
     uint16_t max_seq; /* next expected sequence */
 
-    uint16_t last_seq; /* sequence of the next dequeued packet */
-    block_t *blocks; /* re-ordered blocks queue */
+    uint16_t last_seq; /* sequence of the last dequeued packet */
+    unsigned pending; /* number of queued packets */
+    block_t **ring; /* re-ordering buffer, indexed by sequence number */
+    rtp_fec_t *fec; /* SMPTE 2022-1 FEC packets */
+
+    struct
+    {
+        uint64_t received;
+        uint64_t lost;
+        uint64_t recovered;
+        uint64_t late;
+        uint64_t duplicate;
+    } stats;
     void    *opaque[]; /* Per-source private payload data */
 };
 
@@ -172,7 +194,16 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
     source->ref_ntp = UINT64_C (1) << 62;
     source->max_seq = source->bad_seq = init_seq;
     source->last_seq = init_seq - 1;
-    source->blocks = NULL;
+    source->pending = 0;
+    source->fec = NULL;
+    memset (&source->stats, 0, sizeof (source->stats));
+
+    source->ring = calloc (session->ring_mask + 1u, sizeof (block_t *));
+    if (source->ring == NULL)
+    {
+        free (source);
+        return NULL;
+    }
 
     /* Initializes all payload */
     for (unsigned i = 0; i < session->ptc; i++)
@@ -183,6 +214,24 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
 }
 
 
+/**
+ * Discards all queued packets of an RTP source.
+ */
+static void
+rtp_source_flush (const rtp_session_t *session, rtp_source_t *source)
+{
+    for (unsigned i = 0; source->pending > 0; i++)
+    {
+        assert (i <= session->ring_mask);
+        if (source->ring[i] != NULL)
+        {
+            block_Release (source->ring[i]);
+            source->ring[i] = NULL;
+            source->pending--;
+        }
+    }
+}
+
 /**
  * Destroys an RTP source and its associated streams.
  */
@@ -190,11 +239,19 @@ static void
 rtp_source_destroy (demux_t *demux, const rtp_session_t *session,
                     rtp_source_t *source)
 {
-    msg_Dbg (demux, "removing RTP source (%08x)", source->ssrc);
+    msg_Dbg (demux, "removing RTP source (%08x): %"PRIu64" received, "
+             "%"PRIu64" lost, %"PRIu64" recovered, %"PRIu64" late, "
+             "%"PRIu64" duplicate packets", source->ssrc,
+             source->stats.received, source->stats.lost,
+             source->stats.recovered, source->stats.late,
+             source->stats.duplicate);
 
     for (unsigned i = 0; i < session->ptc; i++)
         session->ptv[i].destroy (demux, source->opaque[i]);
-    block_ChainRelease (source->blocks);
+    rtp_source_flush (session, source);
+    if (source->fec != NULL)
+        rtp_fec_destroy (source->fec);
+    free (source->ring);
     free (source);
 }
 
@@ -335,10 +392,9 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         if (seq == src->bad_seq)
         {
             src->max_seq = src->bad_seq = seq + 1;
-            src->last_seq = seq - 0x7fffe; /* hack for rtp_decode() */
+            src->last_seq = seq - 1;
             msg_Warn (demux, "sequence resynchronized");
-            block_ChainRelease (src->blocks);
-            src->blocks = NULL;
+            rtp_source_flush (session, src);
         }
         else
         {
@@ -350,39 +406,174 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     if (delta_seq >= 0)
         src->max_seq = seq + 1;
 
-    /* Queues the block in sequence order,
-     * hence there is a single queue for all payload types. */
-    block_t **pp = &src->blocks;
-    for (block_t *prev = *pp; prev != NULL; prev = *pp)
+    src->stats.received++;
+    rtp_source_insert (demux, session, src, block);
+    return;
+
+drop:
+    block_Release (block);
+}
+
+/**
+ * Queues an RTP packet in sequence order, hence there is a single queue for
+ * all payload types. This is O(1): the re-ordering buffer is a ring indexed
+ * by sequence number, starting after the last dequeued packet.
+ */
+static void
+rtp_source_insert (demux_t *demux, const rtp_session_t *session,
+                   rtp_source_t *src, block_t *block)
+{
+    const uint16_t seq = rtp_seq (block);
+    uint16_t offset = seq - (uint16_t)(src->last_seq + 1);
+
+    if (offset >= 0x8000)
+    {   /* Trash too late packets (and PIM Assert duplicates) */
+        msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")", seq);
+        src->stats.late++;
+        goto drop;
+    }
+
+    /* Too far ahead: give up waiting on the oldest missing packets */
+    while (offset > session->ring_mask)
     {
-        delta_seq = seq - rtp_seq (prev);
-        if (delta_seq < 0)
-            break;
-        if (delta_seq == 0)
+        if (src->pending > 0)
+            rtp_decode (demux, session, src);
+        else
         {
-            msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
-            goto drop; /* duplicate */
+            uint16_t lost = offset - session->ring_mask;
+
+            msg_Warn (demux, "%"PRIu16" packet(s) lost", lost);
+            src->stats.lost += lost;
+            src->last_seq += lost;
         }
-        pp = &prev->p_next;
+        offset = seq - (uint16_t)(src->last_seq + 1);
     }
-    block->p_next = *pp;
-    *pp = block;
 
-    /*rtp_decode (demux, session, src);*/
+    block_t **slot = &src->ring[seq & session->ring_mask];
+    if (*slot != NULL)
+    {
+        msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
+        src->stats.duplicate++;
+        goto drop;
+    }
+    *slot = block;
+    src->pending++;
     return;
 
 drop:
     block_Release (block);
 }
 
+struct rtp_fec_ctx
+{
+    const rtp_session_t *session;
+    rtp_source_t *src;
+    vlc_tick_t now;
+};
 
-static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
+static block_t *rtp_source_get (void *opaque, uint16_t seq)
+{
+    struct rtp_fec_ctx *ctx = opaque;
+    rtp_source_t *src = ctx->src;
+
+    if ((uint16_t)(seq - (src->last_seq + 1)) > ctx->session->ring_mask)
+        return NULL;
+    return src->ring[seq & ctx->session->ring_mask];
+}
+
+static void rtp_source_put (void *opaque, block_t *block)
+{
+    struct rtp_fec_ctx *ctx = opaque;
+    rtp_source_t *src = ctx->src;
+    const uint16_t seq = rtp_seq (block);
+
+    assert (rtp_source_get (opaque, seq) == NULL);
+    if ((uint16_t)(seq - (src->last_seq + 1)) > ctx->session->ring_mask)
+    {
+        block_Release (block);
+        return;
+    }
+
+    block->i_pts = ctx->now;
+    src->ring[seq & ctx->session->ring_mask] = block;
+    src->pending++;
+    src->stats.recovered++;
+}
+
+/**
+ * Rebuilds missing packets of an RTP source from its FEC packets, if any.
+ */
+static void
+rtp_source_recover (const rtp_session_t *session, rtp_source_t *src)
+{
+    if (src->fec == NULL)
+        return;
+
+    struct rtp_fec_ctx ctx = { session, src, vlc_tick_now () };
+
+    rtp_fec_recover (src->fec, src->last_seq + 1, &ctx,
+                     rtp_source_get, rtp_source_put);
+}
+
+/**
+ * Receives an SMPTE 2022-1 FEC packet, stores it, and rebuilds any missing
+ * media packet it completes. Not a cancellation point.
+ *
+ * @param demux VLC demux object
+ * @param session RTP session receiving the packet
+ * @param block FEC packet including the RTP header
+ */
+void
+rtp_queue_fec (demux_t *demux, rtp_session_t *session, block_t *block)
+{
+    /* 2022-1 protects a single stream: match it with the first source */
+    if (session->srcc == 0)
+    {
+        block_Release (block);
+        return;
+    }
+
+    rtp_source_t *src = session->srcv[0];
+    if (src->fec == NULL)
+    {
+        src->fec = rtp_fec_create ();
+        if (unlikely(src->fec == NULL))
+        {
+            block_Release (block);
+            return;
+        }
+    }
+
+    if (rtp_fec_add (src->fec, block))
+    {
+        msg_Dbg (demux, "unsupported or invalid FEC packet");
+        return;
+    }
+    rtp_source_recover (session, src);
+}
+
+/**
+ * Returns the queued packet with the lowest sequence number.
+ */
+static block_t *rtp_source_first (const rtp_session_t *session,
+                                  const rtp_source_t *src)
+{
+    assert (src->pending > 0);
+
+    for (uint16_t seq = src->last_seq + 1;; seq++)
+    {
+        block_t *block = src->ring[seq & session->ring_mask];
+        if (block != NULL)
+            return block;
+    }
+}
 
 /**
  * Dequeues RTP packets and pass them to decoder. Not cancellation-safe(?).
  * A packet is decoded if it is the next in sequence order, or if we have
  * given up waiting on the missing packets (time out) from the last one
- * already decoded.
+ * already decoded. If a fixed latency is configured, every packet is held
+ * for that long, so that FEC packets have time to arrive.
  *
  * @param demux VLC demux object
  * @param session RTP session receiving the packet
@@ -393,6 +584,7 @@ static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
 bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
                   vlc_tick_t *restrict deadlinep)
 {
+    demux_sys_t *p_sys = demux->p_sys;
     vlc_tick_t now = vlc_tick_now ();
     bool pending = false;
 
@@ -401,7 +593,6 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
     for (unsigned i = 0, max = session->srcc; i < max; i++)
     {
         rtp_source_t *src = session->srcv[i];
-        block_t *block;
 
         /* Because of IP packet delay variation (IPDV), we need to guesstimate
          * how long to wait for a missing packet in the RTP sequence
@@ -419,27 +610,36 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
          * LibVLC E/S-out clock synchronization. Here, we need to bother about
          * re-ordering packets, as decoders can't cope with mis-ordered data.
          */
-        while (((block = src->blocks)) != NULL)
+        while (src->pending > 0)
         {
-            if ((int16_t)(rtp_seq (block) - (src->last_seq + 1)) <= 0)
-            {   /* Next (or earlier) block ready, no need to wait */
-                rtp_decode (demux, session, src);
-                continue;
-            }
-
-            /* Wait for 3 times the inter-arrival delay variance (about 99.7%
-             * match for random gaussian jitter).
-             */
+            block_t *block = rtp_source_first (session, src);
             vlc_tick_t deadline;
-            const rtp_pt_t *pt = rtp_find_ptype (session, src, block, NULL);
-            if (pt)
-                deadline = vlc_tick_from_samples(3 * src->jitter, pt->frequency);
-            else
-                deadline = 0; /* no jitter estimate with no frequency :( */
 
-            /* Make sure we wait at least for 25 msec */
-            if (deadline < VLC_TICK_FROM_MS(25))
-                deadline = VLC_TICK_FROM_MS(25);
+            if (p_sys->latency > 0)
+                deadline = p_sys->latency;
+            else
+            {
+                if (rtp_seq (block) == (uint16_t)(src->last_seq + 1))
+                {   /* Next block ready, no need to wait */
+                    rtp_decode (demux, session, src);
+                    continue;
+                }
+
+                /* Wait for 3 times the inter-arrival delay variance (about
+                 * 99.7% match for random gaussian jitter).
+                 */
+                const rtp_pt_t *pt = rtp_find_ptype (session, src, block,
+                                                     NULL);
+                if (pt)
+                    deadline = vlc_tick_from_samples(3 * src->jitter,
+                                                     pt->frequency);
+                else
+                    deadline = 0; /* no jitter estimate with no frequency :( */
+
+                /* Make sure we wait at least for 25 msec */
+                if (deadline < VLC_TICK_FROM_MS(25))
+                    deadline = VLC_TICK_FROM_MS(25);
+            }
 
             /* Additionnaly, we implicitly wait for the packetization time
              * multiplied by the number of missing packets. block is the first
@@ -470,40 +670,39 @@ void rtp_dequeue_force (demux_t *demux, const rtp_session_t *session)
     for (unsigned i = 0, max = session->srcc; i < max; i++)
     {
         rtp_source_t *src = session->srcv[i];
-        block_t *block;
 
-        while (((block = src->blocks)) != NULL)
+        while (src->pending > 0)
             rtp_decode (demux, session, src);
     }
 }
 
 /**
- * Decodes one RTP packet.
+ * Decodes the queued RTP packet with the lowest sequence number.
+ * Missing packets before it are rebuilt with FEC if possible, or
+ * given up on.
  */
 static void
 rtp_decode (demux_t *demux, const rtp_session_t *session, rtp_source_t *src)
 {
-    block_t *block = src->blocks;
+    uint16_t seq = src->last_seq + 1;
+
+    if (src->ring[seq & session->ring_mask] == NULL)
+        rtp_source_recover (session, src);
+
+    block_t *block = rtp_source_first (session, src);
 
-    assert (block);
-    src->blocks = block->p_next;
-    block->p_next = NULL;
+    src->ring[rtp_seq (block) & session->ring_mask] = NULL;
+    src->pending--;
 
     /* Discontinuity detection */
-    uint16_t delta_seq = rtp_seq (block) - (src->last_seq + 1);
+    uint16_t delta_seq = rtp_seq (block) - seq;
     if (delta_seq != 0)
     {
-        if (delta_seq >= 0x8000)
-        {   /* Trash too late packets (and PIM Assert duplicates) */
-            msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")",
-                      rtp_seq (block));
-            goto drop;
-        }
         msg_Warn (demux, "%"PRIu16" packet(s) lost", delta_seq);
+        src->stats.lost += delta_seq;
         block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
     }
     src->last_seq = rtp_seq (block);
-
     /* Match the payload type */
     void *pt_data;
     const rtp_pt_t *pt = rtp_find_ptype (session, src, block, &pt_data);
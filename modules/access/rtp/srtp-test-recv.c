@@ -26,19 +26,150 @@
 #include "srtp.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #undef NDEBUG
 #include <assert.h>
 
 
+static const char key[] =
+    "123456789ABCDEF0" "123456789ABCDEF0";
+static const char salt[] =
+    "1234567890" "1234567890" "12345678";
+
+#define BATCH_COUNT 64
+#define BATCH_SIZE  1400
+
+static srtp_session_t *batch_session (void)
+{
+    srtp_session_t *s = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                     10, SRTP_PRF_AES_CM, 0);
+    assert (s != NULL);
+    int val = srtp_setkeystring (s, key, salt);
+    assert (val == 0);
+    return s;
+}
+
+static void batch_fill (uint8_t *buf, srtp_packet_t *pktv, uint16_t seq)
+{
+    for (unsigned i = 0; i < BATCH_COUNT; i++)
+    {
+        uint8_t *p = buf + i * BATCH_SIZE;
+        size_t len = 12 + (i * 97) % (BATCH_SIZE - 12 - 10);
+
+        memset (p, 0, 12);
+        p[0] = 0x80;
+        p[2] = (seq + i) >> 8;
+        p[3] = seq + i;
+        for (size_t j = 12; j < len; j++)
+            p[j] = j + i;
+        pktv[i] = (srtp_packet_t){ p, len, BATCH_SIZE, -1 };
+    }
+}
+
+static double elapsed (const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec)
+         + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Batched processing must match packet per packet processing */
+static void test_batch (void)
+{
+    srtp_session_t *se = batch_session (), *sb = batch_session ();
+    srtp_session_t *sd = batch_session ();
+    uint8_t *ref = malloc (BATCH_COUNT * BATCH_SIZE);
+    uint8_t *buf = malloc (BATCH_COUNT * BATCH_SIZE);
+    srtp_packet_t refv[BATCH_COUNT], pktv[BATCH_COUNT];
+    unsigned n;
+
+    assert (ref != NULL && buf != NULL);
+
+    /* Sequence wraps in the middle of the batch */
+    batch_fill (ref, refv, 0xfff0);
+    batch_fill (buf, pktv, 0xfff0);
+    /* Malformed packet */
+    pktv[3].buf[0] = refv[3].buf[0] = 0x40;
+
+    for (unsigned i = 0; i < BATCH_COUNT; i++)
+    {
+        int val = srtp_send (se, refv[i].buf, &refv[i].len, refv[i].size);
+        assert (val == (i == 3 ? EINVAL : 0));
+    }
+    n = srtp_send_batch (sb, pktv, BATCH_COUNT);
+    assert (n == BATCH_COUNT - 1);
+    for (unsigned i = 0; i < BATCH_COUNT; i++)
+    {
+        assert (pktv[i].error == (i == 3 ? EINVAL : 0));
+        if (i == 3)
+            continue;
+        assert (pktv[i].len == refv[i].len);
+        assert (!memcmp (pktv[i].buf, refv[i].buf, refv[i].len));
+    }
+
+    /* Tampered packet */
+    pktv[5].buf[20] ^= 1;
+    n = srtp_recv_batch (sd, pktv, BATCH_COUNT);
+    assert (n == BATCH_COUNT - 2);
+    batch_fill (ref, refv, 0xfff0);
+    for (unsigned i = 0; i < BATCH_COUNT; i++)
+    {
+        if (i == 3 || i == 5)
+        {
+            assert (pktv[i].error == EACCES);
+            continue;
+        }
+        assert (pktv[i].error == 0);
+        assert (pktv[i].len == refv[i].len);
+        assert (!memcmp (pktv[i].buf, refv[i].buf, refv[i].len));
+    }
+
+    /* Replayed batch */
+    n = srtp_recv_batch (sd, pktv, BATCH_COUNT);
+    assert (n == 0);
+
+    /* Throughput */
+    const unsigned rounds = 500;
+    struct timespec start;
+    double single, batch;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (unsigned r = 0; r < rounds; r++)
+    {
+        batch_fill (buf, pktv, 0x100 + r * BATCH_COUNT);
+        for (unsigned i = 0; i < BATCH_COUNT; i++)
+            srtp_send (se, pktv[i].buf, &pktv[i].len, pktv[i].size);
+    }
+    single = elapsed (&start);
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (unsigned r = 0; r < rounds; r++)
+    {
+        batch_fill (buf, pktv, 0x100 + r * BATCH_COUNT);
+        n = srtp_send_batch (sb, pktv, BATCH_COUNT);
+        assert (n == BATCH_COUNT);
+    }
+    batch = elapsed (&start);
+
+    printf ("SRTP send, %u packets: %.0f packets/s single, "
+            "%.0f packets/s batched\n", rounds * BATCH_COUNT,
+            rounds * BATCH_COUNT / single, rounds * BATCH_COUNT / batch);
+
+    free (buf);
+    free (ref);
+    srtp_destroy (sd);
+    srtp_destroy (sb);
+    srtp_destroy (se);
+}
+
 int main (void)
 {
-    static const char key[] =
-        "123456789ABCDEF0" "123456789ABCDEF0";
-    static const char salt[] =
-        "1234567890" "1234567890" "12345678";
     int val;
     srtp_session_t *sd, *se;
 
@@ -168,5 +299,7 @@ int main (void)
 
     srtp_destroy (se);
     srtp_destroy (sd);
+
+    test_batch ();
     return 0;
 }
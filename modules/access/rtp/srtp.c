@@ -388,6 +388,29 @@ void srtp_setrcc_rate (srtp_session_t *s, uint16_t rate)
 }
 
 
+/** Pending counter mode operation */
+typedef struct
+{
+    uint32_t counter[4];
+    uint8_t *data;
+    size_t   len;
+} srtp_ctr_t;
+
+#define SRTP_BATCH_MAX 64
+
+
+/** AES-CM counter for RTP (salt = 14 bytes + 2 nul bytes) */
+static void
+rtp_counter (uint32_t *counter, uint32_t ssrc, uint32_t roc, uint16_t seq,
+             const uint32_t *salt)
+{
+    counter[0] = salt[0];
+    counter[1] = salt[1] ^ ssrc;
+    counter[2] = salt[2] ^ htonl (roc);
+    counter[3] = salt[3] ^ htonl ((uint32_t)seq << 16);
+}
+
+
 /** AES-CM for RTP (salt = 14 bytes + 2 nul bytes) */
 static int
 rtp_crypt (gcry_cipher_hd_t hd, uint32_t ssrc, uint32_t roc, uint16_t seq,
@@ -395,10 +418,7 @@ rtp_crypt (gcry_cipher_hd_t hd, uint32_t ssrc, uint32_t roc, uint16_t seq,
 {
     /* Determines cryptographic counter (IV) */
     uint32_t counter[4];
-    counter[0] = salt[0];
-    counter[1] = salt[1] ^ ssrc;
-    counter[2] = salt[2] ^ htonl (roc);
-    counter[3] = salt[3] ^ htonl (seq << 16);
+    rtp_counter (counter, ssrc, roc, seq, salt);
 
     /* Encryption */
     return do_ctr_crypt (hd, counter, data, len);
@@ -447,18 +467,55 @@ rtp_digest (gcry_md_hd_t md, const uint8_t *data, size_t len,
 
 
 /**
- * Encrypts/decrypts a RTP packet and updates SRTP context
- * (CTR block cypher mode of operation has identical encryption and
- * decryption function).
+ * Determines the length of the authentication tag and of the carried
+ * Roll-Over-Counter of a RTP packet.
+ */
+static size_t
+srtp_tag_len (const srtp_session_t *s, const uint8_t *buf, size_t *roc_len)
+{
+    size_t tag_len = s->tag_len;
+
+    *roc_len = 0;
+    if (s->flags & SRTP_UNAUTHENTICATED)
+        return 0;
+
+    if (rcc_mode (s))
+    {
+        assert (tag_len >= 4);
+        assert (s->rtp_rcc != 0);
+        if ((rtp_seq (buf) % s->rtp_rcc) == 0)
+        {
+            *roc_len = 4;
+            if (rcc_mode (s) == 3)
+                tag_len = 0; /* RCC mode 3 -> no auth*/
+            else
+                tag_len -= 4; /* RCC mode 1 or 2 -> auth*/
+        }
+        else
+        {
+            if (rcc_mode (s) & 1)
+                tag_len = 0; /* RCC mode 1 or 3 -> no auth */
+        }
+    }
+    return tag_len;
+}
+
+
+/**
+ * Checks a RTP packet and updates SRTP context, then determines the
+ * encrypted part of the packet and its cryptographic counter.
  *
- * @param buf RTP packet to be en-/decrypted
+ * @param buf RTP packet
  * @param len RTP packet length
+ * @param ctr counter mode operation to perform [OUT]
+ * @param rocp Roll-Over-Counter of the packet [OUT]
  *
  * @return 0 on success, in case of error:
  *  EINVAL  malformatted RTP packet
  *  EACCES  replayed packet or out-of-window or sync lost
  */
-static int srtp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
+static int srtp_update (srtp_session_t *s, uint8_t *buf, size_t len,
+                        srtp_ctr_t *ctr, uint32_t *rocp)
 {
     assert (s != NULL);
     assert (len >= 12u);
@@ -495,7 +552,7 @@ static int srtp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
     if (diff > 0)
     {
         /* Sequence in the future, good */
-        s->rtp.window = s->rtp.window << diff;
+        s->rtp.window = (diff < 64) ? s->rtp.window << diff : 0;
         s->rtp.window |= UINT64_C(1);
         s->rtp_seq = seq, s->rtp_roc = roc;
     }
@@ -508,12 +565,40 @@ static int srtp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
         s->rtp.window |= UINT64_C(1) << diff;
     }
 
+    rtp_counter (ctr->counter, ssrc, roc, seq, s->rtp.salt);
+    ctr->data = buf + offset;
+    ctr->len = len - offset;
+    *rocp = roc;
+    return 0;
+}
+
+
+/**
+ * Encrypts/decrypts a RTP packet and updates SRTP context
+ * (CTR block cypher mode of operation has identical encryption and
+ * decryption function).
+ *
+ * @param buf RTP packet to be en-/decrypted
+ * @param len RTP packet length
+ *
+ * @return 0 on success, in case of error:
+ *  EINVAL  malformatted RTP packet
+ *  EACCES  replayed packet or out-of-window or sync lost
+ */
+static int srtp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
+{
+    srtp_ctr_t ctr;
+    uint32_t roc;
+
+    int val = srtp_update (s, buf, len, &ctr, &roc);
+    if (val)
+        return val;
+
     /* Encrypt/Decrypt */
     if (s->flags & SRTP_UNENCRYPTED)
         return 0;
 
-    if (rtp_crypt (s->rtp.cipher, ssrc, roc, seq, s->rtp.salt,
-                   buf + offset, len - offset))
+    if (do_ctr_crypt (s->rtp.cipher, ctr.counter, ctr.data, ctr.len))
         return EINVAL;
 
     return 0;
@@ -521,89 +606,230 @@ static int srtp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
 
 
 /**
- * Turns a RTP packet into a SRTP packet: encrypt it, then computes
- * the authentication tag and appends it.
- * Note that you can encrypt packet in disorder.
+ * Encrypts/decrypts the packets prepared by srtp_update(), with the same
+ * cipher handle. Packets that failed have a zero length operation.
+ */
+static int srtp_crypt_batch (srtp_session_t *s, const srtp_ctr_t *ctrv,
+                             unsigned count)
+{
+    if (s->flags & SRTP_UNENCRYPTED)
+        return 0;
+
+    for (unsigned i = 0; i < count; i++)
+        if (ctrv[i].len > 0
+         && do_ctr_crypt (s->rtp.cipher, ctrv[i].counter, ctrv[i].data,
+                          ctrv[i].len))
+            return -1;
+    return 0;
+}
+
+
+/**
+ * Turns RTP packets into SRTP packets, as srtp_send() would for each of
+ * them in order. The context is updated for the whole batch first, then
+ * all payloads are encrypted and authenticated with the same cipher and
+ * MAC handles. An error on one packet does not affect the others.
  *
- * @param buf RTP packet to be encrypted/digested
- * @param lenp pointer to the RTP packet length on entry,
- *             set to the SRTP length on exit (undefined on non-ENOSPC error)
- * @param bufsize size (bytes) of the packet buffer
+ * @param pktv array of packets; on return, the length of each successful
+ *             packet is its SRTP length, and each error field is set
+ * @param count number of packets
  *
- * @return 0 on success, in case of error:
- *  EINVAL  malformatted RTP packet or internal error
- *  ENOSPC  bufsize is too small to add authentication tag
- *          (<lenp> will hold the required byte size)
- *  EACCES  packet would trigger a replay error on receiver
+ * @return the number of successfully processed packets
  */
-int
-srtp_send (srtp_session_t *s, uint8_t *buf, size_t *lenp, size_t bufsize)
+unsigned
+srtp_send_batch (srtp_session_t *s, srtp_packet_t *pktv, unsigned count)
 {
-    size_t len = *lenp;
-    size_t tag_len;
-    size_t roc_len = 0;
-
-    /* Compute required buffer size */
-    if (len < 12u)
-        return EINVAL;
+    unsigned done = 0;
 
-    if (!(s->flags & SRTP_UNAUTHENTICATED))
+    while (count > 0)
     {
-        tag_len = s->tag_len;
+        unsigned n = (count < SRTP_BATCH_MAX) ? count : SRTP_BATCH_MAX;
+        srtp_ctr_t ctrv[SRTP_BATCH_MAX];
+        uint32_t rocv[SRTP_BATCH_MAX];
 
-        if (rcc_mode (s))
+        for (unsigned i = 0; i < n; i++)
         {
-            assert (tag_len >= 4);
-            assert (s->rtp_rcc != 0);
-            if ((rtp_seq (buf) % s->rtp_rcc) == 0)
+            srtp_packet_t *p = pktv + i;
+            size_t roc_len, tag_len;
+
+            ctrv[i].len = 0;
+            if (p->len < 12u)
             {
-                roc_len = 4;
-                if (rcc_mode (s) == 3)
-                    tag_len = 0; /* RCC mode 3 -> no auth*/
-                else
-                    tag_len -= 4; /* RCC mode 1 or 2 -> auth*/
+                p->error = EINVAL;
+                continue;
             }
-            else
+
+            /* Compute required buffer size */
+            tag_len = srtp_tag_len (s, p->buf, &roc_len);
+            if (p->size < p->len + roc_len + tag_len)
+            {
+                p->len += roc_len + tag_len;
+                p->error = ENOSPC;
+                continue;
+            }
+
+            p->error = srtp_update (s, p->buf, p->len, ctrv + i, rocv + i);
+            if (p->error)
+                ctrv[i].len = 0;
+        }
+
+        /* Encrypt payloads */
+        int val = srtp_crypt_batch (s, ctrv, n);
+
+        /* Authenticate payloads */
+        for (unsigned i = 0; i < n; i++)
+        {
+            srtp_packet_t *p = pktv + i;
+
+            if (p->error)
+                continue;
+            if (val)
+            {
+                p->error = EINVAL;
+                continue;
+            }
+
+            if (!(s->flags & SRTP_UNAUTHENTICATED))
             {
-                if (rcc_mode (s) & 1)
-                    tag_len = 0; /* RCC mode 1 or 3 -> no auth */
+                size_t roc_len, tag_len = srtp_tag_len (s, p->buf, &roc_len);
+                const uint8_t *tag = rtp_digest (s->rtp.mac, p->buf, p->len,
+                                                 rocv[i]);
+
+                if (roc_len)
+                {
+                    memcpy (p->buf + p->len, &(uint32_t){ htonl (rocv[i]) }, 4);
+                    p->len += 4;
+                }
+                memcpy (p->buf + p->len, tag, tag_len);
+                p->len += tag_len;
             }
+            done++;
         }
 
-        *lenp = len + roc_len + tag_len;
+        pktv += n;
+        count -= n;
     }
-    else
-        tag_len = 0;
+    return done;
+}
 
-    if (bufsize < *lenp)
-        return ENOSPC;
 
-    /* Encrypt payload */
-    int val = srtp_crypt (s, buf, len);
-    if (val)
-        return val;
+/**
+ * Turns SRTP packets into RTP packets, as srtp_recv() would for each of
+ * them in order. All packets are authenticated and the context updated
+ * first, then the payloads are decrypted together. An error on one packet
+ * does not affect the others.
+ *
+ * @param pktv array of packets; on return, the length of each successful
+ *             packet is its RTP length, and each error field is set
+ * @param count number of packets
+ *
+ * @return the number of successfully processed packets
+ */
+unsigned
+srtp_recv_batch (srtp_session_t *s, srtp_packet_t *pktv, unsigned count)
+{
+    unsigned done = 0;
 
-    /* Authenticate payload */
-    if (!(s->flags & SRTP_UNAUTHENTICATED))
+    while (count > 0)
     {
-        uint32_t roc = srtp_compute_roc (s, rtp_seq (buf));
-        const uint8_t *tag = rtp_digest (s->rtp.mac, buf, len, roc);
+        unsigned n = (count < SRTP_BATCH_MAX) ? count : SRTP_BATCH_MAX;
+        srtp_ctr_t ctrv[SRTP_BATCH_MAX];
 
-        if (roc_len)
+        for (unsigned i = 0; i < n; i++)
         {
-            memcpy (buf + len, &(uint32_t){ htonl (s->rtp_roc) }, 4);
-            len += 4;
+            srtp_packet_t *p = pktv + i;
+            size_t len = p->len;
+            uint32_t roc;
+
+            ctrv[i].len = 0;
+            p->error = EINVAL;
+            if (len < 12u)
+                continue;
+
+            if (!(s->flags & SRTP_UNAUTHENTICATED))
+            {
+                size_t roc_len, tag_len = srtp_tag_len (s, p->buf, &roc_len);
+
+                if (len < (12u + roc_len + tag_len))
+                    continue;
+                len -= roc_len + tag_len;
+
+                uint32_t rcc;
+                roc = srtp_compute_roc (s, rtp_seq (p->buf));
+                if (roc_len)
+                {
+                    assert (roc_len == 4);
+                    memcpy (&rcc, p->buf + len, 4);
+                    rcc = ntohl (rcc);
+                }
+                else
+                    rcc = roc;
+
+                const uint8_t *tag = rtp_digest (s->rtp.mac, p->buf, len, rcc);
+                if (memcmp (p->buf + len + roc_len, tag, tag_len))
+                {
+                    p->error = EACCES;
+                    continue;
+                }
+
+                if (roc_len)
+                {
+                    /* Authenticated packet carried a Roll-Over-Counter */
+                    s->rtp_roc += rcc - roc;
+                    assert (srtp_compute_roc (s, rtp_seq (p->buf)) == rcc);
+                }
+                p->len = len;
+            }
+
+            p->error = srtp_update (s, p->buf, len, ctrv + i, &roc);
+            if (p->error)
+                ctrv[i].len = 0;
         }
-        memcpy (buf + len, tag, tag_len);
-#if 0
-        printf ("Sent    : 0x");
-        for (unsigned i = 0; i < tag_len; i++)
-            printf ("%02x", tag[i]);
-        puts ("");
-#endif
+
+        /* Decrypt payloads */
+        int val = srtp_crypt_batch (s, ctrv, n);
+
+        for (unsigned i = 0; i < n; i++)
+        {
+            if (pktv[i].error)
+                continue;
+            if (val)
+                pktv[i].error = EINVAL;
+            else
+                done++;
+        }
+
+        pktv += n;
+        count -= n;
     }
+    return done;
+}
 
-    return 0;
+
+/**
+ * Turns a RTP packet into a SRTP packet: encrypt it, then computes
+ * the authentication tag and appends it.
+ * Note that you can encrypt packet in disorder.
+ *
+ * @param buf RTP packet to be encrypted/digested
+ * @param lenp pointer to the RTP packet length on entry,
+ *             set to the SRTP length on exit (undefined on non-ENOSPC error)
+ * @param bufsize size (bytes) of the packet buffer
+ *
+ * @return 0 on success, in case of error:
+ *  EINVAL  malformatted RTP packet or internal error
+ *  ENOSPC  bufsize is too small to add authentication tag
+ *          (<lenp> will hold the required byte size)
+ *  EACCES  packet would trigger a replay error on receiver
+ */
+int
+srtp_send (srtp_session_t *s, uint8_t *buf, size_t *lenp, size_t bufsize)
+{
+    srtp_packet_t pkt = { buf, *lenp, bufsize, 0 };
+
+    srtp_send_batch (s, &pkt, 1);
+    *lenp = pkt.len;
+    return pkt.error;
 }
 
 
@@ -622,67 +848,11 @@ srtp_send (srtp_session_t *s, uint8_t *buf, size_t *lenp, size_t bufsize)
 int
 srtp_recv (srtp_session_t *s, uint8_t *buf, size_t *lenp)
 {
-    size_t len = *lenp;
-    if (len < 12u)
-        return EINVAL;
-
-    if (!(s->flags & SRTP_UNAUTHENTICATED))
-    {
-        size_t tag_len = s->tag_len, roc_len = 0;
-        if (rcc_mode (s))
-        {
-            if ((rtp_seq (buf) % s->rtp_rcc) == 0)
-            {
-                roc_len = 4;
-                if (rcc_mode (s) == 3)
-                    tag_len = 0;
-                else
-                    tag_len -= 4;
-            }
-            else
-            {
-                if (rcc_mode (s) & 1)
-                    tag_len = 0; // RCC mode 1 or 3: no auth
-            }
-        }
-
-        if (len < (12u + roc_len + tag_len))
-            return EINVAL;
-        len -= roc_len + tag_len;
-
-        uint32_t roc = srtp_compute_roc (s, rtp_seq (buf)), rcc;
-        if (roc_len)
-        {
-            assert (roc_len == 4);
-            memcpy (&rcc, buf + len, 4);
-            rcc = ntohl (rcc);
-        }
-        else
-            rcc = roc;
-
-        const uint8_t *tag = rtp_digest (s->rtp.mac, buf, len, rcc);
-#if 0
-        printf ("Computed: 0x");
-        for (unsigned i = 0; i < tag_len; i++)
-            printf ("%02x", tag[i]);
-        printf ("\nReceived: 0x");
-        for (unsigned i = 0; i < tag_len; i++)
-            printf ("%02x", buf[len + roc_len + i]);
-        puts ("");
-#endif
-        if (memcmp (buf + len + roc_len, tag, tag_len))
-            return EACCES;
+    srtp_packet_t pkt = { buf, *lenp, 0, 0 };
 
-        if (roc_len)
-        {
-            /* Authenticated packet carried a Roll-Over-Counter */
-            s->rtp_roc += rcc - roc;
-            assert (srtp_compute_roc (s, rtp_seq (buf)) == rcc);
-        }
-        *lenp = len;
-    }
-
-    return srtp_crypt (s, buf, len);
+    srtp_recv_batch (s, &pkt, 1);
+    *lenp = pkt.len;
+    return pkt.error;
 }
 
 
@@ -72,6 +72,20 @@ void srtp_setrcc_rate (srtp_session_t *s, uint16_t rate);
 
 int srtp_send (srtp_session_t *s, uint8_t *buf, size_t *lenp, size_t maxsize);
 int srtp_recv (srtp_session_t *s, uint8_t *buf, size_t *lenp);
+
+/** Packet for the SRTP batch functions */
+typedef struct srtp_packet_t
+{
+    uint8_t *buf;   //< packet buffer
+    size_t   len;   //< packet length, updated as with srtp_send()/srtp_recv()
+    size_t   size;  //< buffer size (send only)
+    int      error; //< 0 or error code as with srtp_send()/srtp_recv()
+} srtp_packet_t;
+
+unsigned srtp_send_batch (srtp_session_t *s, srtp_packet_t *pktv,
+                          unsigned count);
+unsigned srtp_recv_batch (srtp_session_t *s, srtp_packet_t *pktv,
+                          unsigned count);
 int srtcp_send (srtp_session_t *s, uint8_t *buf, size_t *lenp, size_t maxsiz);
 int srtcp_recv (srtp_session_t *s, uint8_t *buf, size_t *lenp);
 
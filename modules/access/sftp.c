@@ -58,6 +58,10 @@ static void Close( vlc_object_t* );
 #define PASS_TEXT N_("Password")
 #define PASS_LONGTEXT N_("Password that will be used for the connection, " \
         "if no username or password are set in URL.")
+#define BITRATE_TEXT N_("Target bitrate")
+#define BITRATE_LONGTEXT N_("Throughput to sustain from the server (kb/s). " \
+        "Together with the round-trip time, it sets how much data is " \
+        "requested ahead of the playback position.")
 
 vlc_module_begin ()
     set_shortname( "SFTP" )
@@ -68,6 +72,9 @@ vlc_module_begin ()
     add_integer( "sftp-port", 22, PORT_TEXT, PORT_LONGTEXT, true )
     add_string( "sftp-user", NULL, USER_TEXT, USER_LONGTEXT, false )
     add_password("sftp-pwd", NULL, PASS_TEXT, PASS_LONGTEXT)
+    add_integer( "sftp-bitrate", 100000, BITRATE_TEXT, BITRATE_LONGTEXT,
+                 true )
+        change_integer_range( 1000, 10000000 )
     add_shortcut( "sftp" )
     set_callbacks( Open, Close )
 vlc_module_end ()
@@ -90,8 +97,33 @@ typedef struct
     LIBSSH2_SFTP_HANDLE* file;
     uint64_t filesize;
     char *psz_base_url;
+
+    /* Read-ahead window */
+    uint64_t offset; /* of the first unread byte */
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t buffer_start; /* first unread byte */
+    size_t buffer_end; /* first free byte */
 } access_sys_t;
 
+/* libssh2 splits each read into requests of about 30 kB, and keeps the ones
+ * not answered yet outstanding across calls. Reading a whole window at once
+ * thus keeps up to a window worth of requests in flight. */
+#define SFTP_WINDOW_MIN (256 << 10)
+#define SFTP_WINDOW_MAX (32 << 20)
+
+static size_t WindowSize( stream_t *p_access, vlc_tick_t rtt )
+{
+    uint64_t bitrate = var_InheritInteger( p_access, "sftp-bitrate" );
+    uint64_t size = bitrate * 1000 / 8 * rtt / CLOCK_FREQ;
+
+    if( size < SFTP_WINDOW_MIN )
+        size = SFTP_WINDOW_MIN;
+    if( size > SFTP_WINDOW_MAX )
+        size = SFTP_WINDOW_MAX;
+    return size;
+}
+
 static int AuthKeyAgent( stream_t *p_access, const char *psz_username )
 {
     access_sys_t* p_sys = p_access->p_sys;
@@ -468,11 +500,14 @@ static int Open( vlc_object_t* p_this )
 
     /* Get some information */
     LIBSSH2_SFTP_ATTRIBUTES attributes;
+    vlc_tick_t rtt = vlc_tick_now();
     if( libssh2_sftp_stat( p_sys->sftp_session, psz_path, &attributes ) )
     {
         msg_Err( p_access, "Impossible to get information about the remote path %s", psz_path );
         goto error;
     }
+    /* A single request and its reply */
+    rtt = vlc_tick_now() - rtt;
 
     if( !LIBSSH2_SFTP_S_ISDIR( attributes.permissions ))
     {
@@ -480,6 +515,13 @@ static int Open( vlc_object_t* p_this )
         p_sys->file = libssh2_sftp_open( p_sys->sftp_session, psz_path, LIBSSH2_FXF_READ, 0 );
         p_sys->filesize = attributes.filesize;
 
+        p_sys->buffer_size = WindowSize( p_access, rtt );
+        p_sys->buffer = malloc( p_sys->buffer_size );
+        if( !p_sys->buffer )
+            goto error;
+        msg_Dbg( p_access, "round-trip time %"PRId64" ms, reading %zu KiB "
+                 "ahead", MS_FROM_VLC_TICK(rtt), p_sys->buffer_size >> 10 );
+
         ACCESS_SET_CALLBACKS( Read, NULL, Control, Seek );
     }
     else
@@ -535,6 +577,7 @@ static void Close( vlc_object_t* p_this )
         libssh2_sftp_shutdown( p_sys->sftp_session );
     SSHSessionDestroy( p_access );
 
+    free( p_sys->buffer );
     free( p_sys->psz_base_url );
 }
 
@@ -543,14 +586,30 @@ static ssize_t Read( stream_t *p_access, void *buf, size_t len )
 {
     access_sys_t *p_sys = p_access->p_sys;
 
-    ssize_t val = libssh2_sftp_read(  p_sys->file, buf, len );
-    if( val < 0 )
+    if( p_sys->buffer_start == p_sys->buffer_end )
     {
-        msg_Err( p_access, "read failed" );
-        return 0;
+        /* Returns as soon as the first requests are answered, leaving the
+         * others outstanding for the next calls. */
+        ssize_t val = libssh2_sftp_read( p_sys->file, (char *)p_sys->buffer,
+                                         p_sys->buffer_size );
+        if( val < 0 )
+        {
+            msg_Err( p_access, "read failed" );
+            return 0;
+        }
+
+        p_sys->buffer_start = 0;
+        p_sys->buffer_end = val;
     }
 
-    return val;
+    size_t avail = p_sys->buffer_end - p_sys->buffer_start;
+    if( len > avail )
+        len = avail;
+
+    memcpy( buf, p_sys->buffer + p_sys->buffer_start, len );
+    p_sys->buffer_start += len;
+    p_sys->offset += len;
+    return len;
 }
 
 
@@ -558,7 +617,20 @@ static int Seek( stream_t* p_access, uint64_t i_pos )
 {
     access_sys_t *sys = p_access->p_sys;
 
-    libssh2_sftp_seek( sys->file, i_pos );
+    /* Within the window, including the bytes already read */
+    uint64_t buffer_offset = sys->offset - sys->buffer_start;
+    if( i_pos >= buffer_offset
+     && i_pos <= buffer_offset + sys->buffer_end )
+    {
+        sys->buffer_start = i_pos - buffer_offset;
+        sys->offset = i_pos;
+        return VLC_SUCCESS;
+    }
+
+    /* Outstanding requests are abandoned, and their replies discarded */
+    libssh2_sftp_seek64( sys->file, i_pos );
+    sys->buffer_start = sys->buffer_end = 0;
+    sys->offset = i_pos;
     return VLC_SUCCESS;
 }
 
@@ -670,7 +742,17 @@ static int DirRead (stream_t *p_access, input_item_node_t *p_current_node)
         }
         free( psz_uri );
 
-        int i_type = LIBSSH2_SFTP_S_ISDIR( attrs.permissions ) ? ITEM_TYPE_DIRECTORY : ITEM_TYPE_FILE;
+        /* The type comes with the listing, except for symbolic links:
+         * leave those to be resolved when opened, rather than with one
+         * round trip per entry here. */
+        int i_type = ITEM_TYPE_UNKNOWN;
+        if( attrs.flags & LIBSSH2_SFTP_ATTR_PERMISSIONS )
+        {
+            if( LIBSSH2_SFTP_S_ISDIR( attrs.permissions ) )
+                i_type = ITEM_TYPE_DIRECTORY;
+            else if( LIBSSH2_SFTP_S_ISREG( attrs.permissions ) )
+                i_type = ITEM_TYPE_FILE;
+        }
         i_ret = vlc_readdir_helper_additem( &rdh, psz_full_uri, NULL, psz_file,
                                             i_type, ITEM_NET );
         free( psz_full_uri );
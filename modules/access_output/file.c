@@ -212,6 +212,18 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
             break;
         }
 
+        case ACCESS_OUT_GET_FD:
+        {
+            int *fdp = p_access->p_sys;
+#ifdef S_ISSOCK
+            /* Writing directly to a socket could raise SIGPIPE */
+            if (p_access->pf_write == Send)
+                return VLC_EGENERIC;
+#endif
+            *va_arg( args, int * ) = *fdp;
+            break;
+        }
+
         default:
             return VLC_EGENERIC;
     }
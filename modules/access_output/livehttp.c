@@ -35,6 +35,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <math.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -43,6 +44,8 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
+#include <vlc_memstream.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -105,6 +108,25 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define HTTPD_TEXT N_("Serve segments over HTTP")
+#define HTTPD_LONGTEXT N_("Keep the index and the last segments in memory "\
+                          "and serve them with the integrated HTTP server "\
+                          "instead of writing files. The index and segment "\
+                          "paths are then URL paths on the HTTP host.")
+
+#define FORMAT_TEXT N_("Segment format")
+#define FORMAT_LONGTEXT N_("Container of the segments. Fragmented MP4 "\
+                           "requires the mp4frag muxer.")
+
+#define PARTDUR_TEXT N_("Partial segment duration (ms)")
+#define PARTDUR_LONGTEXT N_("Publish partial segments of about this duration "\
+                            "for low-latency playback (0 to disable). "\
+                            "Only available when serving over HTTP.")
+
+static const char *const format_list[] = { "ts", "fmp4" };
+static const char *const format_list_text[] = {
+    N_("MPEG-TS"), N_("Fragmented MP4 (CMAF)") };
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +157,14 @@ vlc_module_begin ()
                  KEYFILE_TEXT, KEYFILE_LONGTEXT)
     add_loadfile(SOUT_CFG_PREFIX "key-loadfile", NULL,
                  KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT)
+    add_bool( SOUT_CFG_PREFIX "httpd", false,
+              HTTPD_TEXT, HTTPD_LONGTEXT, true )
+    add_string( SOUT_CFG_PREFIX "format", "ts",
+                FORMAT_TEXT, FORMAT_LONGTEXT, true )
+        change_string_list( format_list, format_list_text )
+    add_integer( SOUT_CFG_PREFIX "part-duration", 0,
+                 PARTDUR_TEXT, PARTDUR_LONGTEXT, true )
+        change_integer_range( 0, 10000 )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,12 +186,23 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "httpd",
+    "format",
+    "part-duration",
     NULL
 };
 
 static ssize_t Write( sout_access_out_t *, block_t * );
 static int Control( sout_access_out_t *, int, va_list );
 
+typedef struct
+{
+    size_t i_offset;
+    size_t i_size;
+    float f_end; /* end time, relative to the segment start */
+    bool b_independent;
+} segment_part_t;
+
 typedef struct output_segment
 {
     char *psz_filename;
@@ -171,6 +212,16 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+
+    /* In-memory segment, when serving over HTTP */
+    sout_access_out_t *p_access;
+    httpd_handler_t *p_handler;
+    uint8_t *p_data;
+    size_t i_data;
+    size_t i_alloc;
+    segment_part_t *p_parts;
+    size_t i_parts;
+    bool b_complete;
 } output_segment_t;
 
 typedef struct
@@ -204,6 +255,23 @@ typedef struct
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t segments_t;
+    uint32_t i_firstseg;
+    bool b_open;
+    bool b_fmp4;
+    char *psz_initPath;
+    char *psz_initUri;
+
+    /* HTTP serving */
+    bool b_httpd;
+    httpd_host_t *p_httpd_host;
+    httpd_handler_t *p_index_handler;
+    httpd_handler_t *p_init_handler;
+    vlc_mutex_t lock; /* published index, init and segments data */
+    char *psz_index;
+    size_t i_index;
+    block_t *p_init;
+    vlc_tick_t i_part_target;
+    vlc_tick_t i_partdts;
 } sout_access_out_sys_t;
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -211,6 +279,8 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static char *formatInitPath( const char *psz_path );
+static int HttpdSetup( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -248,8 +318,30 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_ratecontrol = var_GetBool( p_access, SOUT_CFG_PREFIX "ratecontrol") ;
     p_sys->b_caching = var_GetBool( p_access, SOUT_CFG_PREFIX "caching") ;
     p_sys->b_generate_iv = var_GetBool( p_access, SOUT_CFG_PREFIX "generate-iv") ;
+    p_sys->b_httpd = var_GetBool( p_access, SOUT_CFG_PREFIX "httpd" );
+    p_sys->i_part_target = VLC_TICK_FROM_MS(
+                var_GetInteger( p_access, SOUT_CFG_PREFIX "part-duration" ) );
     p_sys->b_segment_has_data = false;
 
+    char *psz_format = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "format" );
+    p_sys->b_fmp4 = psz_format && !strcmp( psz_format, "fmp4" );
+    free( psz_format );
+
+    if( p_sys->b_httpd )
+    {
+        /* The memory ring must stay bounded */
+        if( p_sys->i_numsegs == 0 )
+            p_sys->i_numsegs = 5;
+        p_sys->b_delsegs = true;
+    }
+    else if( p_sys->i_part_target )
+    {
+        msg_Warn( p_access, "partial segments require serving over HTTP" );
+        p_sys->i_part_target = 0;
+    }
+    if( p_sys->i_part_target >= p_sys->i_seglenm )
+        p_sys->i_part_target = 0;
+
     vlc_array_init( &p_sys->segments_t );
 
     p_sys->stuffing_size = 0;
@@ -268,10 +360,20 @@ static int Open( vlc_object_t *p_this )
             return VLC_ENOMEM;
         }
         p_sys->psz_indexPath = psz_tmp;
-        if( p_sys->i_initial_segment != 1 )
+        if( p_sys->i_initial_segment != 1 && !p_sys->b_httpd )
             vlc_unlink( p_sys->psz_indexPath );
     }
 
+    if( p_sys->b_httpd && ( p_access->psz_path[0] != '/' ||
+        !p_sys->psz_indexPath || p_sys->psz_indexPath[0] != '/' ) )
+    {
+        msg_Err( p_access, "serving over HTTP requires absolute URL paths "
+                           "for the segments and the index" );
+        free( p_sys->psz_indexPath );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
     p_sys->psz_indexUrl = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index-url" );
     p_sys->psz_keyfile  = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "key-loadfile" );
     p_sys->key_uri      = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "key-uri" );
@@ -295,9 +397,42 @@ static int Open( vlc_object_t *p_this )
         return VLC_EGENERIC;
     }
 
+    if( p_sys->i_part_target && p_sys->key_uri )
+    {
+        msg_Warn( p_access, "partial segments are not supported with encryption" );
+        p_sys->i_part_target = 0;
+    }
+
     p_sys->i_handle = -1;
+    p_sys->b_open = false;
     p_sys->i_segment = p_sys->i_initial_segment-1;
+    p_sys->i_firstseg = p_sys->i_initial_segment;
     p_sys->psz_cursegPath = NULL;
+    vlc_mutex_init( &p_sys->lock );
+
+    if( p_sys->b_fmp4 )
+    {
+        p_sys->psz_initPath = formatInitPath( p_access->psz_path );
+        p_sys->psz_initUri = formatInitPath( p_sys->psz_indexUrl ?
+                                             p_sys->psz_indexUrl : p_access->psz_path );
+    }
+
+    if( ( p_sys->b_fmp4 && ( !p_sys->psz_initPath || !p_sys->psz_initUri ) ) ||
+        ( p_sys->b_httpd && HttpdSetup( p_access, p_sys ) ) )
+    {
+        if( p_sys->key_uri )
+        {
+            gcry_cipher_close( p_sys->aes_ctx );
+            free( p_sys->key_uri );
+        }
+        vlc_mutex_destroy( &p_sys->lock );
+        free( p_sys->psz_initUri );
+        free( p_sys->psz_initPath );
+        free( p_sys->psz_indexUrl );
+        free( p_sys->psz_indexPath );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
 
     p_access->pf_write = Write;
     p_access->pf_control = Control;
@@ -502,8 +637,292 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg )
     return psz_result;
 }
 
+/*****************************************************************************
+ * formatInitPath: create the fMP4 initialization segment path name
+ *****************************************************************************/
+static char *formatInitPath( const char *psz_path )
+{
+    char *psz_result, *psz_newResult;
+    char *psz_firstNumSign;
+
+    if ( ! ( psz_result = vlc_strftime( psz_path ) ) )
+        return NULL;
+
+    psz_firstNumSign = psz_result + strcspn( psz_result, SEG_NUMBER_PLACEHOLDER );
+    int i_cnt = strspn( psz_firstNumSign, SEG_NUMBER_PLACEHOLDER );
+
+    *psz_firstNumSign = '\0';
+    if ( asprintf( &psz_newResult, "%sinit%s", psz_result, psz_firstNumSign + i_cnt ) < 0 )
+        psz_newResult = NULL;
+    free( psz_result );
+    return psz_newResult;
+}
+
+/*****************************************************************************
+ * HTTP serving: the index, the initialization segment and the segments are
+ * kept in memory and published with httpd handlers. Handlers run on the
+ * httpd threads, so anything they read is protected by p_sys->lock.
+ *****************************************************************************/
+static int HttpdReply( uint8_t **pp_data, int *pi_data, const char *psz_type,
+                       unsigned i_maxage, const uint8_t *p_body, size_t i_body )
+{
+    char *psz_header;
+    int i_header;
+
+    if( i_maxage > 0 )
+        i_header = asprintf( &psz_header, "Content-Type: %s\r\n"
+                             "Content-Length: %zu\r\n"
+                             "Cache-Control: public, max-age=%u\r\n\r\n",
+                             psz_type, i_body, i_maxage );
+    else
+        i_header = asprintf( &psz_header, "Content-Type: %s\r\n"
+                             "Content-Length: %zu\r\n"
+                             "Cache-Control: no-cache\r\n\r\n",
+                             psz_type, i_body );
+    if( i_header < 0 )
+        return VLC_ENOMEM;
+
+    uint8_t *p_data = realloc( psz_header, i_header + i_body );
+    if( unlikely( p_data == NULL ) )
+    {
+        free( psz_header );
+        return VLC_ENOMEM;
+    }
+    if( i_body > 0 )
+        memcpy( p_data + i_header, p_body, i_body );
+
+    *pp_data = p_data;
+    *pi_data = i_header + i_body;
+    return VLC_SUCCESS;
+}
+
+static int HttpdNotFound( uint8_t **pp_data, int *pi_data )
+{
+    static const char reply[] = "Status: 404\r\n"
+                                "Content-Length: 0\r\n"
+                                "Cache-Control: no-cache\r\n\r\n";
+
+    *pp_data = (uint8_t *)strdup( reply );
+    if( unlikely( *pp_data == NULL ) )
+        return VLC_ENOMEM;
+    *pi_data = sizeof( reply ) - 1;
+    return VLC_SUCCESS;
+}
+
+/* Segments and parts never change once published */
+static unsigned SegmentMaxAge( const sout_access_out_sys_t *p_sys )
+{
+    return p_sys->i_seglen * ( p_sys->i_numsegs + 1 );
+}
+
+static const char *SegmentType( const sout_access_out_sys_t *p_sys )
+{
+    return p_sys->b_fmp4 ? "video/mp4" : "video/mp2t";
+}
+
+static int IndexCallback( void *opaque, httpd_handler_t *handler,
+                          char *psz_url, uint8_t *psz_request, int i_type,
+                          uint8_t *p_in, int i_in, char *psz_remote_addr,
+                          char *psz_remote_host, uint8_t **pp_data,
+                          int *pi_data )
+{
+    sout_access_out_t *p_access = opaque;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    int ret;
+
+    VLC_UNUSED(handler); VLC_UNUSED(psz_url); VLC_UNUSED(psz_request);
+    VLC_UNUSED(i_type); VLC_UNUSED(p_in); VLC_UNUSED(i_in);
+    VLC_UNUSED(psz_remote_addr); VLC_UNUSED(psz_remote_host);
+
+    /* Low-latency clients must see new parts as soon as they exist */
+    unsigned i_maxage = p_sys->i_part_target ? 0 : p_sys->i_seglen / 2;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->psz_index != NULL )
+        ret = HttpdReply( pp_data, pi_data, "application/vnd.apple.mpegurl",
+                          i_maxage, (uint8_t *)p_sys->psz_index,
+                          p_sys->i_index );
+    else
+        ret = HttpdNotFound( pp_data, pi_data );
+    vlc_mutex_unlock( &p_sys->lock );
+    return ret;
+}
+
+static int InitCallback( void *opaque, httpd_handler_t *handler,
+                         char *psz_url, uint8_t *psz_request, int i_type,
+                         uint8_t *p_in, int i_in, char *psz_remote_addr,
+                         char *psz_remote_host, uint8_t **pp_data,
+                         int *pi_data )
+{
+    sout_access_out_t *p_access = opaque;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    int ret;
+
+    VLC_UNUSED(handler); VLC_UNUSED(psz_url); VLC_UNUSED(psz_request);
+    VLC_UNUSED(i_type); VLC_UNUSED(p_in); VLC_UNUSED(i_in);
+    VLC_UNUSED(psz_remote_addr); VLC_UNUSED(psz_remote_host);
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( p_sys->p_init != NULL )
+        ret = HttpdReply( pp_data, pi_data, "video/mp4", SegmentMaxAge( p_sys ),
+                          p_sys->p_init->p_buffer, p_sys->p_init->i_buffer );
+    else
+        ret = HttpdNotFound( pp_data, pi_data );
+    vlc_mutex_unlock( &p_sys->lock );
+    return ret;
+}
+
+static int SegmentCallback( void *opaque, httpd_handler_t *handler,
+                            char *psz_url, uint8_t *psz_request, int i_type,
+                            uint8_t *p_in, int i_in, char *psz_remote_addr,
+                            char *psz_remote_host, uint8_t **pp_data,
+                            int *pi_data )
+{
+    output_segment_t *segment = opaque;
+    sout_access_out_sys_t *p_sys = segment->p_access->p_sys;
+    unsigned i_part;
+    int ret;
+
+    VLC_UNUSED(handler); VLC_UNUSED(psz_url);
+    VLC_UNUSED(i_type); VLC_UNUSED(p_in); VLC_UNUSED(i_in);
+    VLC_UNUSED(psz_remote_addr); VLC_UNUSED(psz_remote_host);
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( psz_request != NULL &&
+        sscanf( (char *)psz_request, "part=%u", &i_part ) == 1 )
+    {
+        if( i_part < segment->i_parts )
+        {
+            const segment_part_t *part = &segment->p_parts[i_part];
+            ret = HttpdReply( pp_data, pi_data, SegmentType( p_sys ),
+                              SegmentMaxAge( p_sys ),
+                              segment->p_data + part->i_offset, part->i_size );
+        }
+        else
+            ret = HttpdNotFound( pp_data, pi_data );
+    }
+    else if( segment->b_complete )
+        ret = HttpdReply( pp_data, pi_data, SegmentType( p_sys ),
+                          SegmentMaxAge( p_sys ),
+                          segment->p_data, segment->i_data );
+    else
+        ret = HttpdNotFound( pp_data, pi_data );
+    vlc_mutex_unlock( &p_sys->lock );
+    return ret;
+}
+
+/*****************************************************************************
+ * HttpdSetup: start the HTTP host and publish the index
+ *****************************************************************************/
+static int HttpdSetup( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
+{
+    p_sys->p_httpd_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_httpd_host == NULL )
+    {
+        msg_Err( p_access, "cannot start HTTP server" );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_index_handler = httpd_HandlerNew( p_sys->p_httpd_host,
+                                               p_sys->psz_indexPath, NULL, NULL,
+                                               IndexCallback, p_access );
+    if( p_sys->p_index_handler == NULL )
+        goto error;
+
+    if( p_sys->b_fmp4 )
+    {
+        p_sys->p_init_handler = httpd_HandlerNew( p_sys->p_httpd_host,
+                                                  p_sys->psz_initPath, NULL, NULL,
+                                                  InitCallback, p_access );
+        if( p_sys->p_init_handler == NULL )
+        {
+            httpd_HandlerDelete( p_sys->p_index_handler );
+            goto error;
+        }
+    }
+    return VLC_SUCCESS;
+
+error:
+    msg_Err( p_access, "cannot serve %s", p_sys->psz_indexPath );
+    httpd_HostDelete( p_sys->p_httpd_host );
+    return VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * segmentAppend: append data to the in-memory current segment
+ *****************************************************************************/
+static ssize_t segmentAppend( sout_access_out_sys_t *p_sys, const uint8_t *p_buf, size_t i_len )
+{
+    output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
+    ssize_t ret = i_len;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( segment->i_alloc - segment->i_data < i_len )
+    {
+        size_t i_alloc = __MAX( 2 * segment->i_alloc, segment->i_data + i_len );
+        uint8_t *p_data = realloc( segment->p_data, i_alloc );
+        if( unlikely( p_data == NULL ) )
+        {
+            errno = ENOMEM;
+            ret = -1;
+            goto out;
+        }
+        segment->p_data = p_data;
+        segment->i_alloc = i_alloc;
+    }
+    memcpy( segment->p_data + segment->i_data, p_buf, i_len );
+    segment->i_data += i_len;
+out:
+    vlc_mutex_unlock( &p_sys->lock );
+    return ret;
+}
+
+static ssize_t segmentWrite( sout_access_out_sys_t *p_sys, const uint8_t *p_buf, size_t i_len )
+{
+    if( p_sys->b_httpd )
+        return segmentAppend( p_sys, p_buf, i_len );
+    return vlc_write( p_sys->i_handle, p_buf, i_len );
+}
+
+/*****************************************************************************
+ * addPart: publish the data written since the previous part
+ *****************************************************************************/
+static void addPart( sout_access_out_sys_t *p_sys, output_segment_t *segment )
+{
+    size_t i_offset = 0;
+
+    if( segment->i_parts > 0 )
+    {
+        const segment_part_t *last = &segment->p_parts[segment->i_parts - 1];
+        i_offset = last->i_offset + last->i_size;
+    }
+    if( segment->i_data <= i_offset )
+        return;
+
+    vlc_mutex_lock( &p_sys->lock );
+    segment_part_t *parts = realloc( segment->p_parts,
+                                     ( segment->i_parts + 1 ) * sizeof( *parts ) );
+    if( likely( parts != NULL ) )
+    {
+        parts[segment->i_parts] = (segment_part_t) {
+            .i_offset = i_offset,
+            .i_size = segment->i_data - i_offset,
+            .f_end = p_sys->f_seglen,
+            /* Parts start on the muxer headers, ahead of keyframes */
+            .b_independent = !p_sys->b_splitanywhere && !p_sys->b_fmp4,
+        };
+        segment->p_parts = parts;
+        segment->i_parts++;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
 static void destroySegment( output_segment_t *segment )
 {
+    if( segment->p_handler )
+        httpd_HandlerDelete( segment->p_handler );
+    free( segment->p_parts );
+    free( segment->p_data );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -554,132 +973,186 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
 }
 
 /************************************************************************
- * updateIndexAndDel: If necessary, update index file & delete old segments
+ * writeIndex: Build the index and publish it, or write it to the index file
  ************************************************************************/
-static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+static int writeIndex( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
+    if ( !p_sys->psz_indexPath )
+        return 0;
 
-    uint32_t i_firstseg;
-    unsigned i_index_offset = 0;
+    size_t i_count = vlc_array_count( &p_sys->segments_t );
+    if ( i_count == 0 )
+        return 0;
 
-    if ( p_sys->i_numsegs == 0 ||
-         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
-    {
-        i_firstseg = p_sys->i_initial_segment;
-    }
-    else
-    {
-        unsigned numsegs = segmentAmountNeeded( p_sys );
-        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
-        i_index_offset = vlc_array_count( &p_sys->segments_t ) - numsegs;
-    }
+    output_segment_t *first = vlc_array_item_at_index( &p_sys->segments_t, 0 );
+    size_t i_first = p_sys->i_firstseg - first->i_segment_number;
 
-    // First update index
-    if ( p_sys->psz_indexPath )
+    /* Parts are only listed for the last three target durations */
+    size_t i_parts_from = i_count;
+    if ( p_sys->i_part_target )
     {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
-
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
+        float duration = .0f;
+        while ( i_parts_from > i_first && duration < (float)( 3 * p_sys->i_seglen ) )
         {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
-            return -1;
+            output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, --i_parts_from );
+            if ( segment->psz_duration )
+                duration += segment->f_seglength;
         }
+    }
 
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
+    struct vlc_memstream ms;
+    vlc_memstream_open( &ms );
+
+    vlc_memstream_printf( &ms, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s"
+                          "%s\n", p_sys->i_seglen,
+                          ( p_sys->b_fmp4 || p_sys->i_part_target ) ? 6 : 3,
                           p_sys->b_caching ? "YES" : "NO",
-                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
-                          i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
-                          ) < 0 )
-        {
-            free( psz_idxTmp );
-            fclose( fp );
-            return -1;
-        }
-        char *psz_current_uri=NULL;
+                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT" );
+    if ( p_sys->i_part_target )
+    {
+        unsigned i_part_ms = MS_FROM_VLC_TICK( p_sys->i_part_target );
+        vlc_memstream_printf( &ms, "#EXT-X-PART-INF:PART-TARGET=%u.%03u\n"
+                              "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%u.%03u\n",
+                              i_part_ms / 1000, i_part_ms % 1000,
+                              3 * i_part_ms / 1000, 3 * i_part_ms % 1000 );
+    }
+    if ( p_sys->b_fmp4 )
+        vlc_memstream_printf( &ms, "#EXT-X-MAP:URI=\"%s\"\n", p_sys->psz_initUri );
+    vlc_memstream_printf( &ms, "#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_firstseg,
+                          ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == p_sys->i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : "" );
 
+    const char *psz_current_uri = NULL;
 
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    for ( size_t index = i_first; index < i_count; index++ )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, index );
+        if( p_sys->key_uri &&
+            ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
+          )
         {
-            //scale to i_index_offset..numsegs + i_index_offset
-            uint32_t index = i - i_firstseg + i_index_offset;
-
-            output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, index );
-            if( p_sys->key_uri &&
-                ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
-              )
+            psz_current_uri = segment->psz_key_uri;
+            if( p_sys->b_generate_iv )
             {
-                int ret = 0;
-                free( psz_current_uri );
-                psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
-                {
-                    unsigned long long iv_hi = segment->aes_ivs[0];
-                    unsigned long long iv_lo = segment->aes_ivs[8];
-                    for( unsigned short j = 1; j < 8; j++ )
-                    {
-                        iv_hi <<= 8;
-                        iv_hi |= segment->aes_ivs[j] & 0xff;
-                        iv_lo <<= 8;
-                        iv_lo |= segment->aes_ivs[8+j] & 0xff;
-                    }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
-
-                } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
-                }
-                if( ret < 0 )
+                unsigned long long iv_hi = segment->aes_ivs[0];
+                unsigned long long iv_lo = segment->aes_ivs[8];
+                for( unsigned short j = 1; j < 8; j++ )
                 {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
+                    iv_hi <<= 8;
+                    iv_hi |= segment->aes_ivs[j] & 0xff;
+                    iv_lo <<= 8;
+                    iv_lo |= segment->aes_ivs[8+j] & 0xff;
                 }
-            }
+                vlc_memstream_printf( &ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                                      segment->psz_key_uri, iv_hi, iv_lo );
 
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
-            {
-                free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
-                return -1;
+            } else {
+                vlc_memstream_printf( &ms, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
             }
         }
-        free( psz_current_uri );
 
-        if ( b_isend )
+        if ( index >= i_parts_from )
         {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
+            float f_start = .0f;
+            for ( size_t i = 0; i < segment->i_parts; i++ )
             {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
+                const segment_part_t *part = &segment->p_parts[i];
+                unsigned i_ms = lroundf( ( part->f_end - f_start ) * 1000.f );
 
+                vlc_memstream_printf( &ms, "#EXT-X-PART:DURATION=%u.%03u,URI=\"%s?part=%zu\"%s\n",
+                                      i_ms / 1000, i_ms % 1000, segment->psz_uri, i,
+                                      part->b_independent ? ",INDEPENDENT=YES" : "" );
+                f_start = part->f_end;
+            }
         }
-        fclose( fp );
 
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+        /* The segment being written only has its parts listed */
+        if ( segment->psz_duration )
+            vlc_memstream_printf( &ms, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri );
+    }
 
-        if ( val < 0 )
-        {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
-        }
-        else
-            msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+    if ( b_isend )
+        vlc_memstream_puts( &ms, STR_ENDLIST );
+
+    if ( vlc_memstream_close( &ms ) )
+        return -1;
+
+    if ( p_sys->b_httpd )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        free( p_sys->psz_index );
+        p_sys->psz_index = ms.ptr;
+        p_sys->i_index = ms.length;
+        vlc_mutex_unlock( &p_sys->lock );
+        return 0;
+    }
+
+    int val;
+    FILE *fp;
+    char *psz_idxTmp;
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+    {
+        free( ms.ptr );
+        return -1;
+    }
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        free( ms.ptr );
+        return -1;
+    }
 
+    val = fwrite( ms.ptr, 1, ms.length, fp ) == ms.length ? 0 : -1;
+    free( ms.ptr );
+    if ( fclose( fp ) || val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
         free( psz_idxTmp );
+        return -1;
     }
 
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    else
+        msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+
+    free( psz_idxTmp );
+    return 0;
+}
+
+/************************************************************************
+ * updateIndexAndDel: If necessary, update index file & delete old segments
+ ************************************************************************/
+static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
+
+    uint32_t i_firstseg;
+    unsigned i_index_offset = 0;
+
+    if ( p_sys->i_numsegs == 0 ||
+         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+    {
+        i_firstseg = p_sys->i_initial_segment;
+    }
+    else
+    {
+        unsigned numsegs = segmentAmountNeeded( p_sys );
+        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
+        i_index_offset = vlc_array_count( &p_sys->segments_t ) - numsegs;
+    }
+
+    // First update index
+    p_sys->i_firstseg = i_firstseg;
+    if ( writeIndex( p_access, p_sys, b_isend ) < 0 )
+        return -1;
+
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
     while( p_sys->b_delsegs && p_sys->i_numsegs &&
@@ -690,7 +1163,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          msg_Dbg( p_access, "Removing segment number %d", segment->i_segment_number );
          vlc_array_remove( &p_sys->segments_t, 0 );
 
-         if ( segment->psz_filename )
+         if ( segment->psz_filename && !p_sys->b_httpd )
          {
              vlc_unlink( segment->psz_filename );
          }
@@ -708,7 +1181,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( p_sys->b_open )
     {
         output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
 
@@ -722,7 +1195,7 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
                msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
             } else {
 
-            int ret = vlc_write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
+            ssize_t ret = segmentWrite( p_sys, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
                 msg_Err( p_access, "Couldn't write 16 bytes" );
             }
@@ -730,8 +1203,10 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        vlc_close( p_sys->i_handle );
+        if( !p_sys->b_httpd )
+            vlc_close( p_sys->i_handle );
         p_sys->i_handle = -1;
+        p_sys->b_open = false;
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
@@ -742,6 +1217,15 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
         segment->i_segment_number = p_sys->i_segment;
 
+        if( p_sys->b_httpd )
+        {
+            if( p_sys->i_part_target )
+                addPart( p_sys, segment );
+            vlc_mutex_lock( &p_sys->lock );
+            segment->b_complete = true;
+            vlc_mutex_unlock( &p_sys->lock );
+        }
+
         if ( p_sys->psz_cursegPath )
         {
             msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
@@ -802,11 +1286,19 @@ static void Close( vlc_object_t * p_this )
         free( p_sys->key_uri );
     }
 
+    if( p_sys->b_httpd )
+    {
+        httpd_HandlerDelete( p_sys->p_index_handler );
+        if( p_sys->p_init_handler )
+            httpd_HandlerDelete( p_sys->p_init_handler );
+    }
+
     while( vlc_array_count( &p_sys->segments_t ) > 0 )
     {
         output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, 0 );
         vlc_array_remove( &p_sys->segments_t, 0 );
-        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename )
+        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename &&
+            !p_sys->b_httpd )
         {
             msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
             vlc_unlink( segment->psz_filename );
@@ -815,6 +1307,15 @@ static void Close( vlc_object_t * p_this )
         destroySegment( segment );
     }
 
+    if( p_sys->b_httpd )
+        httpd_HostDelete( p_sys->p_httpd_host );
+    if( p_sys->p_init )
+        block_Release( p_sys->p_init );
+    free( p_sys->psz_index );
+    vlc_mutex_destroy( &p_sys->lock );
+
+    free( p_sys->psz_initUri );
+    free( p_sys->psz_initPath );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -847,7 +1348,7 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
  *****************************************************************************/
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
 {
-    int fd;
+    int fd = -1;
 
     uint32_t i_newseg = p_sys->i_segment + 1;
 
@@ -868,14 +1369,30 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    if ( p_sys->b_httpd )
     {
-        msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
-                 vlc_strerror_c(errno) );
-        destroySegment( segment );
-        return -1;
+        segment->p_access = p_access;
+        segment->p_handler = httpd_HandlerNew( p_sys->p_httpd_host,
+                                               segment->psz_filename, NULL, NULL,
+                                               SegmentCallback, segment );
+        if ( !segment->p_handler )
+        {
+            msg_Err( p_access, "cannot serve `%s'", segment->psz_filename );
+            destroySegment( segment );
+            return -1;
+        }
+    }
+    else
+    {
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+        if ( fd == -1 )
+        {
+            msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
+                     vlc_strerror_c(errno) );
+            destroySegment( segment );
+            return -1;
+        }
     }
 
     vlc_array_append_or_abort( &p_sys->segments_t, segment );
@@ -896,9 +1413,11 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
 
     p_sys->psz_cursegPath = strdup(segment->psz_filename);
     p_sys->i_handle = fd;
+    p_sys->b_open = true;
     p_sys->i_segment = i_newseg;
+    p_sys->i_partdts = p_sys->i_opendts;
     p_sys->b_segment_has_data = false;
-    return fd;
+    return 0;
 }
 /*****************************************************************************
  * CheckSegmentChange: Check if segment needs to be closed and new opened
@@ -908,7 +1427,11 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     ssize_t writevalue = 0;
 
-    if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+    /* Fragmented MP4 boxes carry no timestamps */
+    if( p_buffer->i_dts == VLC_TICK_INVALID )
+        return 0;
+
+    if( p_sys->b_open && p_sys->b_segment_has_data &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts ) >= p_sys->i_seglenm ) )
     {
         writevalue = writeSegment( p_access );
@@ -921,14 +1444,16 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         return writevalue;
     }
 
-    if ( unlikely( p_sys->i_handle < 0 ) )
+    if ( unlikely( !p_sys->b_open ) )
     {
         p_sys->i_opendts = p_buffer->i_dts;
 
-        if( p_sys->ongoing_segment && ( p_sys->ongoing_segment->i_dts < p_sys->i_opendts) )
+        if( p_sys->ongoing_segment && p_sys->ongoing_segment->i_dts != VLC_TICK_INVALID &&
+            ( p_sys->ongoing_segment->i_dts < p_sys->i_opendts) )
             p_sys->i_opendts = p_sys->ongoing_segment->i_dts;
 
-        if( p_sys->full_segments && ( p_sys->full_segments->i_dts < p_sys->i_opendts) )
+        if( p_sys->full_segments && p_sys->full_segments->i_dts != VLC_TICK_INVALID &&
+            ( p_sys->full_segments->i_dts < p_sys->i_opendts) )
             p_sys->i_opendts = p_sys->full_segments->i_dts;
 
         msg_Dbg( p_access, "Setting new opendts %"PRId64, p_sys->i_opendts );
@@ -961,6 +1486,10 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
     {
         if( p_sys->key_uri && !crypted )
         {
+            /* The segment is encrypted in place */
+            output = block_Unshare( output );
+            if( unlikely(!output) )
+                return VLC_ENOMEM;
             if( p_sys->stuffing_size )
             {
                 output = block_Realloc( output, p_sys->stuffing_size, output->i_buffer );
@@ -990,7 +1519,7 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
 
         }
 
-        ssize_t val = vlc_write( p_sys->i_handle, output->p_buffer, output->i_buffer );
+        ssize_t val = segmentWrite( p_sys, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
            if ( errno == EINTR )
@@ -998,8 +1527,9 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
            return -1;
         }
 
-        p_sys->f_seglen = secf_from_vlc_tick(output_last_length +
-                                    output->i_dts - p_sys->i_opendts);
+        if ( output->i_dts != VLC_TICK_INVALID )
+            p_sys->f_seglen = secf_from_vlc_tick(output_last_length +
+                                        output->i_dts - p_sys->i_opendts);
 
         if ( (size_t)val >= output->i_buffer )
         {
@@ -1018,6 +1548,38 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
     return i_write;
 }
 
+/*****************************************************************************
+ * storeInitSegment: Keep or write the fMP4 initialization segment
+ *****************************************************************************/
+static void storeInitSegment( sout_access_out_t *p_access, block_t *p_init )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->b_httpd )
+    {
+        vlc_mutex_lock( &p_sys->lock );
+        if( p_sys->p_init )
+            block_Release( p_sys->p_init );
+        p_sys->p_init = p_init;
+        vlc_mutex_unlock( &p_sys->lock );
+        return;
+    }
+
+    int fd = vlc_open( p_sys->psz_initPath, O_WRONLY | O_CREAT | O_LARGEFILE |
+                       O_TRUNC, 0666 );
+    if( fd == -1 )
+    {
+        msg_Err( p_access, "cannot open `%s' (%s)", p_sys->psz_initPath,
+                 vlc_strerror_c(errno) );
+        block_Release( p_init );
+        return;
+    }
+    if( vlc_write( fd, p_init->p_buffer, p_init->i_buffer ) != (ssize_t)p_init->i_buffer )
+        msg_Err( p_access, "cannot write `%s'", p_sys->psz_initPath );
+    vlc_close( fd );
+    block_Release( p_init );
+}
+
 /*****************************************************************************
  * Write: standard write on a file descriptor.
  *****************************************************************************/
@@ -1025,12 +1587,25 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 {
     size_t i_write = 0;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
+    /* Fragmented MP4 segments start on a movie fragment */
+    const uint32_t i_split_flag = p_sys->b_fmp4 ? BLOCK_FLAG_TYPE_I : BLOCK_FLAG_HEADER;
+
     while( p_buffer )
     {
+        block_t *p_temp = p_buffer->p_next;
+
+        if( p_sys->b_fmp4 && ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) )
+        {
+            p_buffer->p_next = NULL;
+            storeInitSegment( p_access, p_buffer );
+            p_buffer = p_temp;
+            continue;
+        }
+
         /* Check if current block is already past segment-length
             and we want to write gathered blocks into segment
             and update playlist */
-        if( p_sys->ongoing_segment && ( p_sys->b_splitanywhere  || ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) ) )
+        if( p_sys->ongoing_segment && ( p_sys->b_splitanywhere  || ( p_buffer->i_flags & i_split_flag ) ) )
         {
             msg_Dbg( p_access, "Moving ongoing segment to full segments-queue" );
             block_ChainLastAppend( &p_sys->full_segments_end, p_sys->ongoing_segment );
@@ -1047,7 +1622,26 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
         }
         i_write += ret;
 
-        block_t *p_temp = p_buffer->p_next;
+        /* Publish the completed data as a partial segment */
+        if( p_sys->i_part_target && p_sys->b_open && p_sys->full_segments &&
+            p_buffer->i_dts != VLC_TICK_INVALID &&
+            p_buffer->i_dts - p_sys->i_partdts >= p_sys->i_part_target )
+        {
+            ret = writeSegment( p_access );
+            if( ret < 0 )
+            {
+                msg_Err( p_access, "Error in write loop");
+                block_ChainRelease( p_buffer );
+                return ret;
+            }
+            i_write += ret;
+
+            output_segment_t *segment = vlc_array_item_at_index( &p_sys->segments_t, vlc_array_count( &p_sys->segments_t ) - 1 );
+            addPart( p_sys, segment );
+            writeIndex( p_access, p_sys, false );
+            p_sys->i_partdts = p_buffer->i_dts;
+        }
+
         p_buffer->p_next = NULL;
         block_ChainLastAppend( &p_sys->ongoing_segment_end, p_buffer );
         p_buffer = p_temp;
@@ -29,6 +29,7 @@
 #include "HTTPConnection.hpp"
 #include "HTTPConnectionManager.h"
 #include "Downloader.hpp"
+#include "../../../access/http/diskcache.h"
 
 #include <vlc_common.h>
 #include <vlc_block.h>
@@ -304,6 +305,9 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     eof = false;
     held = false;
     downloadstart = 0;
+    cacheEntry = NULL;
+    cacheOffset = 0;
+    fromCache = false;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -325,6 +329,8 @@ HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
     buffered = 0;
     vlc_mutex_unlock(&lock);
 
+    if(cacheEntry)
+        vlc_http_dcache_close(cacheEntry);
     vlc_cond_destroy(&avail);
 }
 
@@ -380,7 +386,21 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         vlc_tick_t time;
     } rate = {0,0};
 
-    ssize_t ret = connection->read(p_block->p_buffer, readsize);
+    ssize_t ret;
+    if(fromCache)
+    {
+        ret = readCache(p_block->p_buffer, readsize);
+    }
+    else
+    {
+        ret = connection->read(p_block->p_buffer, readsize);
+        if(ret > 0 && cacheEntry)
+        {
+            vlc_http_dcache_write(cacheEntry, cacheOffset, p_block->p_buffer, ret);
+            cacheOffset += ret;
+        }
+    }
+
     if(ret <= 0)
     {
         block_Release(p_block);
@@ -406,7 +426,8 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         }
     }
 
-    if(rate.size && rate.time)
+    /* Cached data says nothing about the network bandwidth */
+    if(rate.size && rate.time && !fromCache)
     {
         connManager->updateDownloadRate(sourceid, rate.size, rate.time);
     }
@@ -419,11 +440,112 @@ bool HTTPChunkBufferedSource::prepare()
     if(!prepared)
     {
         downloadstart = vlc_tick_now();
-        return HTTPChunkSource::prepare();
+        if(prepareCache())
+            return true;
+        if(!HTTPChunkSource::prepare())
+            return false;
+
+        if(cacheEntry)
+        {
+            const std::string &etag = connection->getEntityTag();
+            const std::string &lastmod = connection->getLastModified();
+            const std::string &cachectl = connection->getCacheControl();
+            const std::string &type = connection->getContentType();
+
+            /* Nothing to validate with (or the access caches by itself) */
+            if(etag.empty() && lastmod.empty() && cachectl.empty())
+            {
+                vlc_http_dcache_close(cacheEntry);
+                cacheEntry = NULL;
+                return true;
+            }
+
+            struct vlc_http_dcache_info info;
+            info.etag = etag.empty() ? NULL : etag.c_str();
+            info.last_modified = lastmod.empty() ? NULL : lastmod.c_str();
+            info.cache_control = cachectl.empty() ? NULL : cachectl.c_str();
+            info.content_type = type.empty() ? NULL : type.c_str();
+            info.size = (!bytesRange.isValid() && contentLength) ? contentLength
+                                                                 : UINTMAX_MAX;
+            vlc_http_dcache_update(cacheEntry, &info);
+        }
+    }
+    return true;
+}
+
+bool HTTPChunkBufferedSource::prepareCache()
+{
+    struct vlc_http_dcache *cache = connManager ? connManager->getDiskCache() : NULL;
+    if(!cache)
+        return false;
+
+    if(!cacheEntry)
+    {
+        cacheEntry = vlc_http_dcache_open(cache, params.getUrl().c_str());
+        if(!cacheEntry)
+            return false;
     }
+
+    uint64_t start = 0;
+    uintmax_t length = UINTMAX_MAX;
+    if(bytesRange.isValid())
+    {
+        start = bytesRange.getStartByte();
+        if(bytesRange.getEndByte())
+            length = bytesRange.getEndByte() - start + 1;
+    }
+    cacheOffset = start;
+
+    /* Only serve from the cache what needs no revalidation */
+    if(!vlc_http_dcache_is_fresh(cacheEntry) ||
+       !vlc_http_dcache_has(cacheEntry, start, length))
+        return false;
+
+    if(length == UINTMAX_MAX)
+    {
+        uintmax_t size = vlc_http_dcache_get_size(cacheEntry);
+        if(size <= start)
+            return false;
+        length = size - start;
+    }
+
+    contentLength = length;
+    requeststatus = RequestStatus::Success;
+    fromCache = true;
+    prepared = true;
     return true;
 }
 
+ssize_t HTTPChunkBufferedSource::readCache(uint8_t *buf, size_t len)
+{
+    size_t total = 0;
+    while(total < len)
+    {
+        ssize_t val = vlc_http_dcache_read(cacheEntry, cacheOffset,
+                                           &buf[total], len - total);
+        if(val <= 0)
+            break;
+        total += val;
+        cacheOffset += val;
+    }
+    return total;
+}
+
+std::string HTTPChunkBufferedSource::getContentType() const
+{
+    vlc_mutex_lock(&lock);
+    if(fromCache)
+    {
+        char *type = vlc_http_dcache_get_type(cacheEntry);
+        vlc_mutex_unlock(&lock);
+        std::string str = type ? type : "";
+        free(type);
+        return str;
+    }
+    vlc_mutex_unlock(&lock);
+    return HTTPChunkSource::getContentType();
+}
+
 bool HTTPChunkBufferedSource::hasMoreData() const
 {
     vlc_mutex_locker locker( &lock );
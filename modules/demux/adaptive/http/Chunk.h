@@ -33,6 +33,7 @@
 #include <stdint.h>
 
 typedef struct block_t block_t;
+struct vlc_http_dcache_entry;
 
 namespace adaptive
 {
@@ -109,10 +110,10 @@ namespace adaptive
                 bool                prepared;
                 bool                eof;
                 ID                  sourceid;
+                ConnectionParams    params;
 
             private:
                 bool init(const std::string &);
-                ConnectionParams    params;
         };
 
         class HTTPChunkBufferedSource : public HTTPChunkSource
@@ -126,6 +127,7 @@ namespace adaptive
                 virtual block_t *  readBlock       (); /* reimpl */
                 virtual block_t *  read            (size_t); /* reimpl */
                 virtual bool       hasMoreData     () const; /* impl */
+                virtual std::string getContentType () const; /* reimpl */
                 void               hold();
                 void               release();
 
@@ -133,6 +135,8 @@ namespace adaptive
                 virtual bool       prepare(); /* reimpl */
                 void               bufferize(size_t);
                 bool               isDone() const;
+                bool               prepareCache();
+                ssize_t            readCache(uint8_t *, size_t);
 
             private:
                 block_t            *p_head; /* read cache buffer */
@@ -143,6 +147,9 @@ namespace adaptive
                 vlc_tick_t          downloadstart;
                 vlc_cond_t          avail;
                 bool                held;
+                struct vlc_http_dcache_entry *cacheEntry;
+                uint64_t            cacheOffset;
+                bool                fromCache;
         };
 
         class HTTPChunk : public AbstractChunk
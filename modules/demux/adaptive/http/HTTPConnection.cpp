@@ -65,6 +65,21 @@ const std::string & AbstractConnection::getContentType() const
     return contentType;
 }
 
+const std::string & AbstractConnection::getEntityTag() const
+{
+    return entityTag;
+}
+
+const std::string & AbstractConnection::getLastModified() const
+{
+    return lastModified;
+}
+
+const std::string & AbstractConnection::getCacheControl() const
+{
+    return cacheControl;
+}
+
 HTTPConnection::HTTPConnection(vlc_object_t *p_object_, AuthStorage *auth,
                                Transport *socket_, const ConnectionParams &proxy, bool persistent)
     : AbstractConnection( p_object_ )
@@ -140,6 +155,9 @@ enum RequestStatus
     chunked = false;
     chunked_eof = false;
     chunkLength = 0;
+    entityTag = std::string();
+    lastModified = std::string();
+    cacheControl = std::string();
 
     /* Set new path for this query */
     params.setPath(path);
@@ -395,6 +413,18 @@ void HTTPConnection::onHeader(const std::string &key,
     {
         contentType = value;
     }
+    else if(Helper::icaseEquals(key, "ETag"))
+    {
+        entityTag = value;
+    }
+    else if(Helper::icaseEquals(key, "Last-Modified"))
+    {
+        lastModified = value;
+    }
+    else if(Helper::icaseEquals(key, "Cache-Control"))
+    {
+        cacheControl = value;
+    }
     else if(Helper::icaseEquals(key, "Location"))
     {
         locationparams = ConnectionParams();
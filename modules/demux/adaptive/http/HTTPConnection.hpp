@@ -52,6 +52,10 @@ namespace adaptive
 
                 virtual size_t  getContentLength() const;
                 virtual const std::string & getContentType() const;
+                /* Cache validators and directives, empty if unknown */
+                virtual const std::string & getEntityTag() const;
+                virtual const std::string & getLastModified() const;
+                virtual const std::string & getCacheControl() const;
                 virtual void    setUsed( bool ) = 0;
 
             protected:
@@ -60,6 +64,9 @@ namespace adaptive
                 bool               available;
                 size_t             contentLength;
                 std::string        contentType;
+                std::string        entityTag;
+                std::string        lastModified;
+                std::string        cacheControl;
                 BytesRange         bytesRange;
                 size_t             bytesRead;
         };
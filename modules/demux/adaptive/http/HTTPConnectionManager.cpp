@@ -30,6 +30,7 @@
 #include "ConnectionParams.hpp"
 #include "Transport.hpp"
 #include "Downloader.hpp"
+#include "../../../access/http/diskcache.h"
 #include <vlc_url.h>
 #include <vlc_http.h>
 
@@ -53,6 +54,11 @@ void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid,
         rateObserver->updateDownloadRate(sourceid, size, time);
 }
 
+struct vlc_http_dcache * AbstractConnectionManager::getDiskCache()
+{
+    return NULL;
+}
+
 void AbstractConnectionManager::setDownloadRateObserver(IDownloadRateObserver *obs)
 {
     rateObserver = obs;
@@ -65,6 +71,8 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Abstra
     downloader = new (std::nothrow) Downloader();
     downloader->start();
     factory = factory_;
+    diskCache = NULL;
+    diskCacheProbed = false;
 }
 
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, AuthStorage *storage)
@@ -74,6 +82,8 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, AuthSt
     downloader = new (std::nothrow) Downloader();
     downloader->start();
     factory = new ConnectionFactory(storage);
+    diskCache = NULL;
+    diskCacheProbed = false;
 }
 
 HTTPConnectionManager::~HTTPConnectionManager   ()
@@ -81,9 +91,31 @@ HTTPConnectionManager::~HTTPConnectionManager   ()
     delete downloader;
     delete factory;
     this->closeAllConnections();
+    if(diskCache)
+    {
+        struct vlc_http_dcache_stats stats;
+        vlc_http_dcache_get_stats(diskCache, &stats);
+        uintmax_t total = stats.hit_bytes + stats.miss_bytes;
+        if(total)
+            msg_Dbg(p_object, "disk cache: %ju%% hit ratio, %ju KiB saved",
+                    stats.hit_bytes * 100 / total, stats.hit_bytes >> 10);
+        vlc_http_dcache_destroy(diskCache);
+    }
     vlc_mutex_destroy(&lock);
 }
 
+struct vlc_http_dcache * HTTPConnectionManager::getDiskCache()
+{
+    /* Opened on first use only, as this scans the cache directory */
+    vlc_mutex_locker locker(&lock);
+    if(!diskCacheProbed)
+    {
+        diskCache = vlc_http_dcache_create(p_object);
+        diskCacheProbed = true;
+    }
+    return diskCache;
+}
+
 void HTTPConnectionManager::closeAllConnections      ()
 {
     vlc_mutex_lock(&lock);
@@ -32,6 +32,8 @@
 #include <vector>
 #include <string>
 
+struct vlc_http_dcache;
+
 namespace adaptive
 {
     namespace http
@@ -52,6 +54,7 @@ namespace adaptive
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
+                virtual struct vlc_http_dcache * getDiskCache();
 
                 virtual void updateDownloadRate(const ID &, size_t, vlc_tick_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
@@ -75,11 +78,14 @@ namespace adaptive
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
+                virtual struct vlc_http_dcache * getDiskCache() /* reimpl */;
 
             private:
                 void    releaseAllConnections ();
                 Downloader                                         *downloader;
                 vlc_mutex_t                                         lock;
+                struct vlc_http_dcache                             *diskCache;
+                bool                                                diskCacheProbed;
                 std::vector<AbstractConnection *>                   connectionPool;
                 AbstractConnectionFactory                          *factory;
                 AbstractConnection * reuseConnection(ConnectionParams &);
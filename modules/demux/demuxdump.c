@@ -24,11 +24,23 @@
 # include "config.h"
 #endif
 
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_SENDFILE
+# include <sys/sendfile.h>
+#endif
+
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_demux.h>
 #include <vlc_sout.h>
 
+#if defined (HAVE_COPY_FILE_RANGE) || defined (HAVE_SENDFILE)
+# define HAVE_DIRECT_COPY 1
+#endif
+
 #define ACCESS_TEXT N_("Dump module")
 #define FILE_TEXT N_("Dump filename")
 #define FILE_LONGTEXT N_( \
@@ -36,6 +48,10 @@
 #define APPEND_TEXT N_("Append to existing file")
 #define APPEND_LONGTEXT N_( \
     "If the file already exists, it will not be overwritten." )
+#define DIRECT_TEXT N_("Copy within the kernel")
+#define DIRECT_LONGTEXT N_( \
+    "Copy the data directly from the input file to the output, without " \
+    "going through user space, when both support it." )
 
 static int  Open( vlc_object_t * );
 static void Close ( vlc_object_t * );
@@ -52,11 +68,30 @@ vlc_module_begin ()
                  FILE_TEXT, FILE_LONGTEXT)
     add_bool( "demuxdump-append", false, APPEND_TEXT, APPEND_LONGTEXT,
               false )
+    add_bool( "demuxdump-direct", true, DIRECT_TEXT, DIRECT_LONGTEXT,
+              true )
     set_callbacks( Open, Close )
     add_shortcut( "dump" )
 vlc_module_end ()
 
 #define DUMP_BLOCKSIZE  16384
+#define DUMP_DIRECTSIZE (4 << 20)
+
+typedef struct
+{
+    sout_access_out_t *out;
+
+    /* Direct copy: the input stream is only seeked to the copy offset when
+     * it is needed, so that it does not read ahead in the mean time. */
+    bool copy_range;
+    bool sendfile;
+    bool desync;
+    uint64_t offset;
+
+    uint64_t bytes;
+    uint64_t direct_bytes;
+    vlc_tick_t cpu_time;
+} demux_sys_t;
 
 static int Demux( demux_t * );
 static int Control( demux_t *, int,va_list );
@@ -72,6 +107,10 @@ static int Open( vlc_object_t * p_this )
     if( !p_demux->obj.force )
         return VLC_EGENERIC;
 
+    demux_sys_t *p_sys = vlc_obj_malloc( p_this, sizeof( *p_sys ) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+
     char *access = var_InheritString( p_demux, "demuxdump-access" );
     if( access == NULL )
         return VLC_EGENERIC;
@@ -100,7 +139,25 @@ static int Open( vlc_object_t * p_this )
         return VLC_EGENERIC;
     }
 
-    p_demux->p_sys = (void *)out;
+    bool direct = var_InheritBool( p_demux, "demuxdump-direct" );
+    p_sys->out = out;
+#ifdef HAVE_COPY_FILE_RANGE
+    p_sys->copy_range = direct;
+#else
+    p_sys->copy_range = false;
+#endif
+#ifdef HAVE_SENDFILE
+    p_sys->sendfile = direct;
+#else
+    p_sys->sendfile = false;
+#endif
+    (void) direct;
+    p_sys->desync = false;
+    p_sys->bytes = 0;
+    p_sys->direct_bytes = 0;
+    p_sys->cpu_time = 0;
+
+    p_demux->p_sys = p_sys;
     p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
     return VLC_SUCCESS;
@@ -112,17 +169,147 @@ static int Open( vlc_object_t * p_this )
 static void Close( vlc_object_t *p_this )
 {
     demux_t *p_demux = (demux_t*)p_this;
-    sout_access_out_t *out = (void *)p_demux->p_sys;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->bytes > 0 )
+        msg_Dbg( p_demux, "dumped %"PRIu64" KiB (%"PRIu64" KiB copied "
+                 "directly), %.1f ms of CPU time per Gbit",
+                 p_sys->bytes >> 10, p_sys->direct_bytes >> 10,
+                 secf_from_vlc_tick( p_sys->cpu_time ) * 1000.
+                 * 125000000. / p_sys->bytes );
+
+    sout_AccessOutDelete( p_sys->out );
+}
+
+static vlc_tick_t CPUTime( void )
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+        return vlc_tick_from_timespec( &ts );
+#endif
+    return 0;
+}
+
+/**
+ * Seeks the input stream to where the direct copy stopped.
+ */
+static int Resync( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->desync )
+        return VLC_SUCCESS;
+
+    p_sys->desync = false;
+    if( vlc_stream_Seek( p_demux->s, p_sys->offset ) )
+    {
+        msg_Err( p_demux, "cannot resume reading" );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+#ifdef HAVE_DIRECT_COPY
+/**
+ * Copies data from the input file to the dump file within the kernel.
+ *
+ * \return the number of bytes copied, 0 at the end of the input, -1 on
+ * error, or -2 if direct copy is not possible
+ */
+static ssize_t DemuxDirect( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    int fd_in, fd_out;
+
+    if( !p_sys->copy_range && !p_sys->sendfile )
+        return -2;
+
+    /* Asked on every call: a stream filter may refuse it at any time. */
+    if( vlc_stream_Control( p_demux->s, STREAM_GET_FD, &fd_in )
+     || sout_AccessOutControl( p_sys->out, ACCESS_OUT_GET_FD, &fd_out ) )
+    {
+        p_sys->copy_range = p_sys->sendfile = false;
+        return -2;
+    }
+
+    if( !p_sys->desync )
+        p_sys->offset = vlc_stream_Tell( p_demux->s );
+
+    ssize_t val;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    if( p_sys->copy_range && p_sys->direct_bytes == 0 )
+    {
+        struct stat st_in, st_out;
+
+        /* Only worth it if the file system can share extents or copy on the
+         * server side; otherwise sendfile() is cheaper. */
+        if( fstat( fd_in, &st_in ) || fstat( fd_out, &st_out )
+         || st_in.st_dev != st_out.st_dev || !S_ISREG( st_out.st_mode ) )
+            p_sys->copy_range = false;
+    }
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+    /* May be offloaded to the file system or file server */
+    while( p_sys->copy_range )
+    {
+        off_t offset = p_sys->offset;
+
+        val = copy_file_range( fd_in, &offset, fd_out, NULL,
+                               DUMP_DIRECTSIZE, 0 );
+        if( val >= 0 )
+            goto done;
+        if( errno == EINTR )
+            continue;
+        if( errno != EXDEV && errno != EINVAL && errno != ENOSYS
+         && errno != EOPNOTSUPP && errno != EBADF )
+            goto error;
+        msg_Dbg( p_demux, "copy_file_range: %s", vlc_strerror_c( errno ) );
+        p_sys->copy_range = false;
+    }
+#endif
+#ifdef HAVE_SENDFILE
+    while( p_sys->sendfile )
+    {
+        off_t offset = p_sys->offset;
+
+        val = sendfile( fd_out, fd_in, &offset, DUMP_DIRECTSIZE );
+        if( val >= 0 )
+            goto done;
+        if( errno == EINTR )
+            continue;
+        if( errno != EINVAL && errno != ENOSYS && errno != EAGAIN )
+            goto error;
+        msg_Dbg( p_demux, "sendfile: %s", vlc_strerror_c( errno ) );
+        p_sys->sendfile = false;
+    }
+#endif
+    return -2;
+
+done:
+    p_sys->offset += val;
+    p_sys->desync = true;
+    p_sys->direct_bytes += val;
+    return val;
 
-    sout_AccessOutDelete( out );
+error:
+    msg_Err( p_demux, "cannot write data: %s", vlc_strerror_c( errno ) );
+    return -1;
 }
+#endif
 
 /**
  * Copy data from input stream to dump file.
  */
-static int Demux( demux_t *p_demux )
+static int DemuxCopy( demux_t *p_demux )
 {
-    sout_access_out_t *out = (void *)p_demux->p_sys;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( Resync( p_demux ) )
+        return -1;
 
     block_t *block = block_Alloc( DUMP_BLOCKSIZE );
     if( unlikely(block == NULL) )
@@ -136,16 +323,65 @@ static int Demux( demux_t *p_demux )
     }
     block->i_buffer = rd;
 
-    size_t wr = sout_AccessOutWrite( out, block );
+    size_t wr = sout_AccessOutWrite( p_sys->out, block );
     if( wr != (size_t)rd )
     {
         msg_Err( p_demux, "cannot write data" );
         return -1;
     }
+    p_sys->bytes += rd;
     return 1;
 }
 
+static int Demux( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    vlc_tick_t start = CPUTime();
+    int ret;
+
+#ifdef HAVE_DIRECT_COPY
+    ssize_t val = DemuxDirect( p_demux );
+    if( val > 0 )
+    {
+        p_sys->bytes += val;
+        ret = 1;
+    }
+    else if( val == -2 )
+        ret = DemuxCopy( p_demux );
+    else
+        ret = val;
+#else
+    ret = DemuxCopy( p_demux );
+#endif
+
+    p_sys->cpu_time += CPUTime() - start;
+    return ret;
+}
+
 static int Control( demux_t *p_demux, int i_query, va_list args )
 {
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->desync && i_query == DEMUX_GET_POSITION )
+    {   /* Polled frequently: do not disturb the input for that */
+        uint64_t size;
+
+        if( vlc_stream_GetSize( p_demux->s, &size ) || size == 0 )
+            return VLC_EGENERIC;
+        *va_arg( args, double * ) = (double)p_sys->offset / (double)size;
+        return VLC_SUCCESS;
+    }
+
+    switch( i_query )
+    {
+        case DEMUX_SET_POSITION:
+        case DEMUX_SET_TIME:
+            /* Leave the stream where the copy stopped if the seek fails */
+            if( Resync( p_demux ) )
+                return VLC_EGENERIC;
+            break;
+    }
+    /* Other queries do not read nor move the stream: without a bitrate,
+     * the time and length are unknown anyway. */
     return demux_vaControlHelper( p_demux->s, 0, -1, 0, 1, i_query, args );
 }
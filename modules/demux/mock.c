@@ -111,6 +111,7 @@ var_InheritFourcc(vlc_object_t *obj, const char *name)
     X(add_video_track_at, vlc_tick_t, add_integer, var_InheritInteger, VLC_TICK_INVALID ) \
     X(add_audio_track_at, vlc_tick_t, add_integer, var_InheritInteger, VLC_TICK_INVALID ) \
     X(add_spu_track_at, vlc_tick_t, add_integer, var_InheritInteger, VLC_TICK_INVALID ) \
+    X(pts_offset, vlc_tick_t, add_integer, var_InheritInteger, 0) \
 
 struct demux_sys
 {
@@ -242,6 +243,9 @@ Control(demux_t *demux, int query, va_list args)
             if (!sys->can_seek)
                 return VLC_EGENERIC;
             sys->pts = va_arg(args, double) * sys->length;
+            if (va_arg(args, int)) /* precise */
+                es_out_Control(demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME,
+                               sys->pts + sys->pts_offset);
             return VLC_SUCCESS;
         case DEMUX_GET_LENGTH:
             *va_arg(args, vlc_tick_t *) = sys->length;
@@ -253,6 +257,9 @@ Control(demux_t *demux, int query, va_list args)
             if (!sys->can_seek)
                 return VLC_EGENERIC;
             sys->pts = va_arg(args, vlc_tick_t);
+            if (va_arg(args, int)) /* precise */
+                es_out_Control(demux->out, ES_OUT_SET_NEXT_DISPLAY_TIME,
+                               sys->pts + sys->pts_offset);
             return VLC_SUCCESS;
         case DEMUX_GET_TITLE_INFO:
             if (sys->title_count > 0)
@@ -584,12 +591,12 @@ Demux(demux_t *demux)
         if (!block)
             return VLC_DEMUXER_EGENERIC;
         block->i_length = sys->step_length;
-        block->i_pts = block->i_dts = sys->pts;
+        block->i_pts = block->i_dts = sys->pts + sys->pts_offset;
         int ret = es_out_Send(demux->out, track->id, block);
         if (ret != VLC_SUCCESS)
             return VLC_DEMUXER_EGENERIC;
     }
-    es_out_SetPCR(demux->out, sys->pts);
+    es_out_SetPCR(demux->out, sys->pts + sys->pts_offset);
     sys->pts += sys->step_length;
     if (sys->pts > sys->length)
         sys->pts = sys->length;
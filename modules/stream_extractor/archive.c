@@ -513,6 +513,10 @@ static int Control( stream_extractor_t* p_extractor, int i_query, va_list args )
             *va_arg( args, uint64_t* ) = archive_entry_size( p_sys->p_entry );
             break;
 
+        case STREAM_GET_FD:
+            /* The descriptor is the archive, not the extracted entry */
+            return VLC_EGENERIC;
+
         default:
             return vlc_stream_vaControl( p_extractor->source, i_query, args );
     }
@@ -45,6 +45,8 @@ vlc_module_end()
 
 static int Control( stream_t *p_stream, int i_query, va_list args )
 {
+    if( i_query == STREAM_GET_FD )
+        return VLC_EGENERIC; /* the data is transformed */
     return vlc_stream_vaControl( p_stream->s, i_query, args );
 }
 
@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * cache_range.c: sparse multi-range read cache
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Unlike the cache and prefetch filters, which keep a single contiguous
+ * window and drop it on any long seek, this filter keeps every recently
+ * used region of the stream. This helps demuxers that jump back and forth
+ * between a few hot spots: MP4 with the moov atom at the end, Matroska with
+ * the cues at the end, or badly interleaved AVI, over slow seeking accesses
+ * such as HTTP or SMB.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_stream.h>
+
+#include "cache_range.h"
+
+typedef struct
+{
+    range_cache_t *cache;
+    uint64_t       offset;
+} stream_sys_t;
+
+static ssize_t ReadAt(void *opaque, uint64_t offset, void *buf, size_t len,
+                      bool *eof)
+{
+    stream_t *s = opaque;
+
+    if (vlc_stream_Tell(s->s) != offset && vlc_stream_Seek(s->s, offset))
+        return -1;
+
+    ssize_t val = vlc_stream_Read(s->s, buf, len);
+    if (val >= 0 && (size_t)val < len)
+        *eof = vlc_stream_Eof(s->s);
+    return val;
+}
+
+static ssize_t Read(stream_t *s, void *buf, size_t len)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    ssize_t val = range_cache_Read(sys->cache, sys->offset, buf, len);
+    if (val > 0)
+        sys->offset += val;
+    return val;
+}
+
+static int Seek(stream_t *s, uint64_t offset)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    /* The underlying stream is only moved on a cache miss */
+    sys->offset = offset;
+    return VLC_SUCCESS;
+}
+
+static int Control(stream_t *s, int query, va_list args)
+{
+    stream_sys_t *sys = s->p_sys;
+
+    switch (query)
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+        case STREAM_CAN_CONTROL_PACE:
+        case STREAM_GET_SIZE:
+        case STREAM_GET_PTS_DELAY:
+        case STREAM_GET_TITLE_INFO:
+        case STREAM_GET_TITLE:
+        case STREAM_GET_SEEKPOINT:
+        case STREAM_GET_META:
+        case STREAM_GET_CONTENT_TYPE:
+        case STREAM_GET_SIGNAL:
+        case STREAM_GET_TAGS:
+        case STREAM_SET_PAUSE_STATE:
+            return vlc_stream_vaControl(s->s, query, args);
+
+        case STREAM_SET_TITLE:
+        case STREAM_SET_SEEKPOINT:
+        {
+            int ret = vlc_stream_vaControl(s->s, query, args);
+            if (ret == VLC_SUCCESS)
+            {
+                range_cache_Flush(sys->cache);
+                sys->offset = vlc_stream_Tell(s->s);
+            }
+            return ret;
+        }
+
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static int Open(vlc_object_t *obj)
+{
+    stream_t *s = (stream_t *)obj;
+    bool can_seek, fast_seek;
+
+    if (s->s->pf_read == NULL)
+        return VLC_EGENERIC;
+
+    /* Without seeking, the access is linear anyway. With fast seeking,
+     * the operating system page cache does a better job. */
+    vlc_stream_Control(s->s, STREAM_CAN_SEEK, &can_seek);
+    vlc_stream_Control(s->s, STREAM_CAN_FASTSEEK, &fast_seek);
+    if (!can_seek || fast_seek)
+        return VLC_EGENERIC;
+
+    /* PID-filtered streams would need the cache to be flushed on each
+     * change of the PID set. */
+    if (vlc_stream_Control(s->s, STREAM_GET_PRIVATE_ID_STATE, 0,
+                           &(bool){ false }) == VLC_SUCCESS)
+        return VLC_EGENERIC;
+
+    stream_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    size_t page_size = var_InheritInteger(obj, "cache-range-page-size") << 10;
+    size_t budget = var_InheritInteger(obj, "cache-range-size") << 10;
+    unsigned prefetch = var_InheritInteger(obj, "cache-range-prefetch");
+
+    sys->cache = range_cache_New(page_size, budget, prefetch, ReadAt, s);
+    if (unlikely(sys->cache == NULL))
+    {
+        free(sys);
+        return VLC_ENOMEM;
+    }
+    sys->offset = vlc_stream_Tell(s->s);
+
+    msg_Dbg(s, "using %zu KiB pages, %zu KiB budget", page_size >> 10,
+            budget >> 10);
+
+    s->p_sys = sys;
+    s->pf_read = Read;
+    s->pf_seek = Seek;
+    s->pf_control = Control;
+    return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t *obj)
+{
+    stream_t *s = (stream_t *)obj;
+    stream_sys_t *sys = s->p_sys;
+    struct range_cache_stats stats;
+
+    range_cache_GetStats(sys->cache, &stats);
+    msg_Dbg(s, "%"PRIu64" hits, %"PRIu64" misses, %"PRIu64" KiB read, "
+            "%"PRIu64" pages evicted", stats.hits, stats.misses,
+            stats.bytes >> 10, stats.evictions);
+
+    range_cache_Delete(sys->cache);
+    free(sys);
+}
+
+vlc_module_begin()
+    set_category(CAT_INPUT)
+    set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
+    set_capability("stream_filter", 0)
+    add_shortcut("cache_range")
+
+    set_description(N_("Multi-range stream cache"))
+    set_callbacks(Open, Close)
+
+    add_integer("cache-range-size", 1 << 15, N_("Cache size"),
+                N_("Maximum memory used by the cached ranges (KiB)"), false)
+        change_integer_range(256, 1 << 22)
+    add_integer("cache-range-page-size", 64, N_("Page size"),
+                N_("Granularity of the cached ranges (KiB)"), true)
+        change_integer_range(4, 4096)
+    add_integer("cache-range-prefetch", 4, N_("Prefetch"),
+                N_("Number of pages read at once after a seek"), true)
+        change_integer_range(1, 256)
+vlc_module_end()
@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * cache_range.h: sparse byte range cache
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_CACHE_RANGE_H
+#define VLC_CACHE_RANGE_H
+
+/*
+ * The cache holds fixed size pages of the underlying stream, indexed by
+ * page number and evicted in least recently used order, so that any number
+ * of disjoint byte ranges can be cached at the same time.
+ *
+ * On a miss, a run of consecutive missing pages is fetched with a single
+ * underlying read. The run starts at the prefetch size after a jump, and
+ * doubles on each sequential miss.
+ */
+typedef struct range_cache range_cache_t;
+
+/**
+ * Reads from the underlying stream.
+ *
+ * @param offset absolute byte offset to read from
+ * @param eof set to true if the end of the stream was reached
+ * @return the number of bytes read (less than len only at the end of the
+ * stream or on error) or -1 on error
+ */
+typedef ssize_t (*range_cache_read_cb)(void *opaque, uint64_t offset,
+                                       void *buf, size_t len, bool *eof);
+
+struct range_cache_stats
+{
+    uint64_t hits;      /**< pages served from the cache */
+    uint64_t misses;    /**< runs of pages fetched */
+    uint64_t reads;     /**< underlying read calls */
+    uint64_t bytes;     /**< bytes read from the underlying stream */
+    uint64_t evictions; /**< pages dropped to stay within the budget */
+};
+
+/**
+ * Creates a cache.
+ *
+ * @param page_size page size in bytes
+ * @param budget maximum memory used by the pages in bytes
+ * @param prefetch number of pages fetched after a jump
+ */
+range_cache_t *range_cache_New(size_t page_size, size_t budget,
+                               unsigned prefetch, range_cache_read_cb read,
+                               void *opaque);
+void range_cache_Delete(range_cache_t *);
+
+/**
+ * Reads from the cache, filling it from the underlying stream as needed.
+ *
+ * @return the number of bytes read, 0 at the end of the stream,
+ * or -1 on error
+ */
+ssize_t range_cache_Read(range_cache_t *, uint64_t offset, void *buf,
+                         size_t len);
+
+/**
+ * Drops all cached pages, e.g. when the underlying content changes.
+ */
+void range_cache_Flush(range_cache_t *);
+
+void range_cache_GetStats(const range_cache_t *, struct range_cache_stats *);
+
+#endif
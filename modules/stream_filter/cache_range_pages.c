@@ -0,0 +1,343 @@
+/*****************************************************************************
+ * cache_range_pages.c: sparse byte range cache
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#include "cache_range.h"
+
+struct range_page
+{
+    uint64_t           index;
+    size_t             length; /* less than the page size only at the end */
+    struct range_page *hnext;  /* hash bucket chain */
+    struct range_page *prev;   /* more recently used */
+    struct range_page *next;   /* less recently used */
+    unsigned char      data[];
+};
+
+struct range_cache
+{
+    size_t      page_size;
+    unsigned    max_pages;
+    unsigned    pages;
+    unsigned    prefetch;
+    unsigned    max_window;
+    unsigned    window;       /* size of the last fetched run */
+    uint64_t    next_miss;    /* page following the last fetched run */
+    uint64_t    end;          /* stream size, UINT64_MAX if unknown yet */
+
+    struct range_page **buckets;
+    unsigned    hash_mask;
+    struct range_page *head;  /* most recently used */
+    struct range_page *tail;  /* least recently used */
+
+    unsigned char *buffer;    /* max_window pages */
+
+    range_cache_read_cb read;
+    void       *opaque;
+
+    struct range_cache_stats stats;
+};
+
+static struct range_page **Bucket(range_cache_t *rc, uint64_t index)
+{
+    return &rc->buckets[(index * UINT64_C(0x9E3779B97F4A7C15)) >> 32
+                        & rc->hash_mask];
+}
+
+static struct range_page *Lookup(range_cache_t *rc, uint64_t index)
+{
+    for (struct range_page *p = *Bucket(rc, index); p != NULL; p = p->hnext)
+        if (p->index == index)
+            return p;
+    return NULL;
+}
+
+static void Unlink(range_cache_t *rc, struct range_page *p)
+{
+    if (p->prev != NULL)
+        p->prev->next = p->next;
+    else
+        rc->head = p->next;
+    if (p->next != NULL)
+        p->next->prev = p->prev;
+    else
+        rc->tail = p->prev;
+}
+
+static void PushFront(range_cache_t *rc, struct range_page *p)
+{
+    p->prev = NULL;
+    p->next = rc->head;
+    if (rc->head != NULL)
+        rc->head->prev = p;
+    else
+        rc->tail = p;
+    rc->head = p;
+}
+
+static void Touch(range_cache_t *rc, struct range_page *p)
+{
+    if (rc->head != p)
+    {
+        Unlink(rc, p);
+        PushFront(rc, p);
+    }
+}
+
+static void Unhash(range_cache_t *rc, struct range_page *p)
+{
+    struct range_page **pp = Bucket(rc, p->index);
+
+    while (*pp != p)
+        pp = &(*pp)->hnext;
+    *pp = p->hnext;
+}
+
+/**
+ * Gets a free page, recycling the least recently used one if the budget is
+ * exhausted.
+ */
+static struct range_page *Alloc(range_cache_t *rc)
+{
+    struct range_page *p;
+
+    if (rc->pages < rc->max_pages)
+    {
+        p = malloc(sizeof (*p) + rc->page_size);
+        if (likely(p != NULL))
+        {
+            rc->pages++;
+            return p;
+        }
+        if (rc->tail == NULL)
+            return NULL;
+    }
+
+    p = rc->tail;
+    assert(p != NULL);
+    Unlink(rc, p);
+    Unhash(rc, p);
+    rc->stats.evictions++;
+    return p;
+}
+
+/**
+ * Fetches a run of pages starting from a missing one.
+ */
+static int Fill(range_cache_t *rc, uint64_t index)
+{
+    const size_t ps = rc->page_size;
+    unsigned count;
+
+    if (index == rc->next_miss)
+    {   /* Sequential access: widen the read-ahead */
+        count = rc->window * 2;
+        if (count > rc->max_window)
+            count = rc->max_window;
+    }
+    else
+        count = rc->prefetch;
+
+    /* Stop at the first page already cached or past the end */
+    unsigned n = 1;
+    while (n < count && Lookup(rc, index + n) == NULL
+        && (index + n) * ps < rc->end)
+        n++;
+
+    uint64_t offset = index * ps;
+    size_t size = n * ps;
+    if (rc->end - offset < size)
+        size = rc->end - offset;
+
+    bool eof = false;
+    ssize_t val = rc->read(rc->opaque, offset, rc->buffer, size, &eof);
+
+    rc->stats.reads++;
+    rc->stats.misses++;
+    if (val < 0)
+        return -1;
+    rc->stats.bytes += val;
+
+    size_t got = val;
+    if (got < size)
+    {
+        if (eof)
+            rc->end = offset + got;
+        else
+            got -= got % ps; /* keep only complete pages */
+    }
+    else if (eof)
+        rc->end = offset + got;
+
+    if (got == 0)
+        return eof ? 0 : -1;
+
+    rc->window = count;
+    rc->next_miss = index + n;
+
+    for (size_t done = 0; done < got; done += ps)
+    {
+        struct range_page *p = Alloc(rc);
+        if (unlikely(p == NULL))
+            return -1;
+
+        struct range_page **bucket = Bucket(rc, index);
+
+        p->index = index++;
+        p->length = (got - done < ps) ? got - done : ps;
+        memcpy(p->data, rc->buffer + done, p->length);
+        p->hnext = *bucket;
+        *bucket = p;
+        PushFront(rc, p);
+    }
+    return 0;
+}
+
+ssize_t range_cache_Read(range_cache_t *rc, uint64_t offset, void *buf,
+                         size_t len)
+{
+    unsigned char *out = buf;
+    size_t copied = 0;
+
+    while (copied < len && offset < rc->end)
+    {
+        uint64_t index = offset / rc->page_size;
+        size_t skip = offset % rc->page_size;
+        struct range_page *p = Lookup(rc, index);
+
+        if (p == NULL)
+        {
+            if (Fill(rc, index))
+                return (copied > 0) ? (ssize_t)copied : -1;
+
+            p = Lookup(rc, index);
+            if (p == NULL)
+                break; /* end of stream */
+        }
+        else
+            rc->stats.hits++;
+
+        Touch(rc, p);
+
+        if (skip >= p->length)
+            break;
+
+        size_t n = p->length - skip;
+        if (n > len - copied)
+            n = len - copied;
+
+        memcpy(out + copied, p->data + skip, n);
+        copied += n;
+        offset += n;
+    }
+    return copied;
+}
+
+void range_cache_Flush(range_cache_t *rc)
+{
+    while (rc->head != NULL)
+    {
+        struct range_page *p = rc->head;
+
+        rc->head = p->next;
+        free(p);
+    }
+    rc->tail = NULL;
+    rc->pages = 0;
+    memset(rc->buckets, 0, (rc->hash_mask + 1) * sizeof (*rc->buckets));
+
+    rc->window = rc->prefetch;
+    rc->next_miss = UINT64_MAX;
+    rc->end = UINT64_MAX;
+}
+
+range_cache_t *range_cache_New(size_t page_size, size_t budget,
+                               unsigned prefetch, range_cache_read_cb read,
+                               void *opaque)
+{
+    assert(page_size > 0);
+
+    range_cache_t *rc = malloc(sizeof (*rc));
+    if (unlikely(rc == NULL))
+        return NULL;
+
+    rc->page_size = page_size;
+    rc->max_pages = budget / page_size;
+    if (rc->max_pages < 4)
+        rc->max_pages = 4;
+
+    /* A run must never evict its own pages */
+    if (prefetch < 1)
+        prefetch = 1;
+    if (prefetch > rc->max_pages / 2)
+        prefetch = rc->max_pages / 2;
+    rc->prefetch = prefetch;
+    rc->max_window = rc->max_pages / 4;
+    if (rc->max_window < prefetch)
+        rc->max_window = prefetch;
+
+    unsigned buckets = 1;
+    while (buckets < rc->max_pages)
+        buckets <<= 1;
+    rc->hash_mask = buckets - 1;
+
+    rc->buckets = calloc(buckets, sizeof (*rc->buckets));
+    rc->buffer = vlc_alloc(rc->max_window, page_size);
+    if (unlikely(rc->buckets == NULL || rc->buffer == NULL))
+    {
+        free(rc->buffer);
+        free(rc->buckets);
+        free(rc);
+        return NULL;
+    }
+
+    rc->pages = 0;
+    rc->head = rc->tail = NULL;
+    rc->window = prefetch;
+    rc->next_miss = UINT64_MAX;
+    rc->end = UINT64_MAX;
+    rc->read = read;
+    rc->opaque = opaque;
+    memset(&rc->stats, 0, sizeof (rc->stats));
+    return rc;
+}
+
+void range_cache_Delete(range_cache_t *rc)
+{
+    range_cache_Flush(rc);
+    free(rc->buffer);
+    free(rc->buckets);
+    free(rc);
+}
+
+void range_cache_GetStats(const range_cache_t *rc,
+                          struct range_cache_stats *stats)
+{
+    *stats = rc->stats;
+}
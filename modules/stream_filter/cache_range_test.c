@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * cache_range_test.c: sparse byte range cache test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Replays the access patterns of a few demuxers against a virtual file,
+ * and counts the reads reaching the underlying stream.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+
+#include "cache_range.h"
+
+#define KiB 1024
+#define MiB (1024 * 1024)
+
+#define FILE_SIZE  (256 * MiB + 12345) /* not a multiple of the page size */
+#define PAGE_SIZE  (64 * KiB)
+#define PAGES      ((FILE_SIZE + PAGE_SIZE - 1) / PAGE_SIZE)
+
+static uint8_t file_byte(uint64_t offset)
+{
+    return offset ^ (offset >> 11) ^ (offset >> 23);
+}
+
+/* Underlying stream */
+static struct
+{
+    uint64_t position;
+    unsigned reads;
+    unsigned seeks;
+    unsigned fetched[PAGES]; /* times each page was read */
+} source;
+
+static ssize_t source_read(void *opaque, uint64_t offset, void *buf,
+                           size_t len, bool *eof)
+{
+    (void) opaque;
+
+    if (offset != source.position)
+        source.seeks++;
+    source.reads++;
+
+    if (offset >= FILE_SIZE)
+    {
+        *eof = true;
+        return 0;
+    }
+    if (len > FILE_SIZE - offset)
+    {
+        len = FILE_SIZE - offset;
+        *eof = true;
+    }
+
+    uint8_t *p = buf;
+    for (size_t i = 0; i < len; i++)
+        p[i] = file_byte(offset + i);
+    for (uint64_t page = offset / PAGE_SIZE;
+         page * PAGE_SIZE < offset + len; page++)
+        source.fetched[page]++;
+
+    source.position = offset + len;
+    return len;
+}
+
+/* Demuxer side */
+static range_cache_t *cache;
+static uint64_t position;
+static unsigned demux_seeks;
+
+static void demux_seek(uint64_t offset)
+{
+    if (offset != position)
+        demux_seeks++;
+    position = offset;
+}
+
+static void demux_read(size_t len)
+{
+    static uint8_t buf[4 * MiB];
+    size_t want = len;
+
+    assert(len <= sizeof (buf));
+    if (position >= FILE_SIZE)
+        want = 0;
+    else if (want > FILE_SIZE - position)
+        want = FILE_SIZE - position;
+
+    ssize_t val = range_cache_Read(cache, position, buf, len);
+    assert(val == (ssize_t)want);
+    for (size_t i = 0; i < want; i++)
+        assert(buf[i] == file_byte(position + i));
+    position += want;
+}
+
+static void start(size_t budget)
+{
+    memset(&source, 0, sizeof (source));
+    position = 0;
+    demux_seeks = 0;
+    cache = range_cache_New(PAGE_SIZE, budget, 4, source_read, NULL);
+    assert(cache != NULL);
+}
+
+static unsigned refetched(void)
+{
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < PAGES; i++)
+        if (source.fetched[i] > 1)
+            count += source.fetched[i] - 1;
+    return count;
+}
+
+static void stop(const char *name, bool fits)
+{
+    struct range_cache_stats stats;
+
+    range_cache_GetStats(cache, &stats);
+    assert(stats.reads == source.reads);
+    printf("%-12s %5u demux seeks, %5u reads, %5u seeks, %4"PRIu64" MiB, "
+           "%6"PRIu64" hits, %5u pages fetched again\n", name, demux_seeks,
+           source.reads, source.seeks, stats.bytes / MiB, stats.hits,
+           refetched());
+
+    /* Each underlying seek serves at least one demuxer seek */
+    assert(source.seeks <= demux_seeks + 1);
+    /* With a large enough budget, nothing is ever fetched twice */
+    if (fits)
+        assert(refetched() == 0);
+    range_cache_Delete(cache);
+}
+
+/* Reads n samples of size bytes, from offset on */
+static void play(uint64_t offset, unsigned n, size_t size)
+{
+    demux_seek(offset);
+    for (unsigned i = 0; i < n; i++)
+        demux_read(size);
+}
+
+/* MP4 with the moov atom at the end: the demuxer checks the first atoms,
+ * skips the mdat to parse the moov, comes back to play, and the user seeks
+ * a few times, which only moves within the mdat. */
+static void test_mp4(void)
+{
+    const uint64_t moov = FILE_SIZE - 3 * MiB;
+
+    start(32 * MiB);
+    play(0, 1, 8);              /* ftyp header */
+    play(8, 1, 24);             /* ftyp */
+    play(32, 1, 16);            /* mdat header (64-bits size) */
+    play(moov, 1, 8);           /* moov header */
+    play(moov + 8, 3 * 256 - 1, 4 * KiB); /* moov */
+
+    for (unsigned k = 0; k < 4; k++)
+    {
+        play(48 + k * 32 * MiB, 400, 5000);
+        play(moov + 1 * MiB, 4, 4 * KiB); /* stbl lookups on seek */
+    }
+    play(48, 400, 5000); /* back to the beginning */
+    stop("mp4", true);
+}
+
+/* Matroska with the cues at the end: the seek head points to the cues,
+ * and each seek reads the cues again to locate the target cluster. */
+static void test_mkv(void)
+{
+    const uint64_t cues = FILE_SIZE - 512 * KiB;
+
+    start(32 * MiB);
+    play(0, 1, 40);             /* EBML header */
+    play(40, 1, 4096);          /* segment info, seek head, tracks */
+    play(cues, 128, 4 * KiB);   /* cues */
+    play(4136, 1000, 188 * 7);  /* first clusters */
+
+    for (unsigned k = 1; k < 10; k++)
+    {
+        play(cues + k * 40 * KiB, 4, 1 * KiB);
+        play((uint64_t)k * 25 * MiB, 200, 188 * 7);
+    }
+    /* Seeks back to already played clusters */
+    for (unsigned k = 9; k > 0; k -= 3)
+    {
+        play(cues + k * 40 * KiB, 4, 1 * KiB);
+        play((uint64_t)k * 25 * MiB, 100, 188 * 7);
+    }
+    stop("mkv", true);
+}
+
+/* Non-interleaved AVI: audio and video chunks stored in two distant
+ * regions of the movi list, read alternately, plus the idx1 at the end. */
+static void test_avi(void)
+{
+    const uint64_t video = 2 * KiB;
+    const uint64_t audio = 200 * MiB;
+    const uint64_t idx1 = FILE_SIZE - 1 * MiB;
+
+    start(32 * MiB);
+    play(0, 1, 2 * KiB);        /* hdrl */
+    play(idx1, 256, 4 * KiB);   /* idx1 */
+
+    for (unsigned i = 0; i < 2000; i++)
+    {
+        play(video + i * 24 * KiB, 1, 24 * KiB);
+        play(audio + i * 4 * KiB, 1, 4 * KiB);
+    }
+    stop("avi", true);
+}
+
+/* Same as AVI, but with a budget too small to keep both regions around the
+ * current position: pages are evicted and fetched again, yet the data
+ * stays correct. */
+static void test_budget(void)
+{
+    start(512 * KiB);
+    for (unsigned k = 0; k < 4; k++)
+        for (unsigned i = 0; i < 100; i++)
+        {
+            play(i * 24 * KiB, 1, 24 * KiB);
+            play(FILE_SIZE - 2 * MiB + i * 4 * KiB, 1, 4 * KiB);
+            play(FILE_SIZE / 2 + i * 64 * KiB, 1, 3 * KiB);
+        }
+
+    struct range_cache_stats stats;
+    range_cache_GetStats(cache, &stats);
+    assert(stats.evictions > 0);
+    stop("budget", false);
+}
+
+/* Reads crossing page boundaries and the end of the stream */
+static void test_edges(void)
+{
+    start(1 * MiB);
+    play(PAGE_SIZE - 10, 1, 20);
+    play(3 * PAGE_SIZE - 1, 1, 3 * PAGE_SIZE + 2);
+    play(FILE_SIZE - 100, 1, 1000); /* truncated */
+    play(FILE_SIZE - 100, 1, 50);   /* from the cache */
+    play(FILE_SIZE, 1, 10);         /* end of stream */
+    play(FILE_SIZE + PAGE_SIZE, 1, 10);
+
+    unsigned reads = source.reads;
+    play(FILE_SIZE - 3 * KiB, 1, 3 * KiB);
+    assert(source.reads == reads);
+
+    range_cache_Flush(cache);
+    play(0, 1, 10);
+    assert(source.reads == reads + 1);
+    stop("edges", false);
+}
+
+int main(void)
+{
+    test_mp4();
+    test_mkv();
+    test_avi();
+    test_budget();
+    test_edges();
+    return 0;
+}
@@ -24,90 +24,65 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_stream.h>
 
+#include "inflate_index.h"
+
+/* Uncompressed distance between two access points (32 KiB each) */
+#define INFLATE_SPACING (1 << 20)
+
 typedef struct
 {
-    z_stream zstream;
-    bool eof;
-    unsigned char buffer[16384];
+    struct vlc_inflate *inflate;
+    bool error;
 } stream_sys_t;
 
-static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
+static ssize_t ReadCompressed(void *opaque, uint64_t offset, void *buf,
+                              size_t len)
 {
-    stream_sys_t *sys = stream->p_sys;
-    ssize_t val;
-
-    if (sys->eof || unlikely(buflen == 0))
-        return 0;
-
-    sys->zstream.next_out = buf;
-    sys->zstream.avail_out = buflen;
-
-    if (sys->zstream.avail_in == 0)
-        sys->zstream.next_in = sys->buffer;
+    stream_t *stream = opaque;
 
-    val = (sys->buffer + sizeof (sys->buffer))
-        - (sys->zstream.next_in + sys->zstream.avail_in);
+    if (vlc_stream_Tell(stream->s) != offset
+     && vlc_stream_Seek(stream->s, offset))
+        return -1;
+    return vlc_stream_Read(stream->s, buf, len);
+}
 
-    if (val > 0)
-    {   /* Fill input buffer if there is space left */
-        val = vlc_stream_Read(stream->s,
-                          sys->zstream.next_in + sys->zstream.avail_in, val);
-        if (val >= 0)
-            sys->zstream.avail_in += val;
-    }
+static ssize_t Read(stream_t *stream, void *buf, size_t buflen)
+{
+    stream_sys_t *sys = stream->p_sys;
 
-    if (sys->zstream.avail_in == 0)
-    {
-        msg_Err(stream, "unexpected end of stream");
+    if (sys->error)
         return 0;
-    }
 
-    val = inflate(&sys->zstream, Z_SYNC_FLUSH);
-    switch (val)
+    ssize_t val = vlc_inflate_Read(sys->inflate, buf, buflen);
+    if (val < 0)
     {
-        case Z_STREAM_END:
-            msg_Dbg(stream, "end of stream");
-            sys->eof = true;
-            /* fall through */
-        case Z_OK:
-            return buflen - sys->zstream.avail_out;
-        case Z_DATA_ERROR:
-            msg_Err(stream, "corrupt stream");
-            sys->eof = true;
-            return -1;
-        case Z_BUF_ERROR:
-            if (sys->zstream.next_in == sys->buffer)
-                break;
-
-            memmove(sys->buffer, sys->zstream.next_in, sys->zstream.avail_in);
-            sys->zstream.next_in = sys->buffer;
-            return Read(stream, buf, buflen);
+        msg_Err(stream, "corrupt stream");
+        sys->error = true;
     }
-
-    msg_Err(stream, "unhandled decompression error (%zd)", val);
-    return -1;
+    return val;
 }
 
 static int Seek(stream_t *stream, uint64_t offset)
 {
-    (void) stream; (void) offset;
-    return -1;
+    stream_sys_t *sys = stream->p_sys;
+
+    sys->error = false;
+    return vlc_inflate_Seek(sys->inflate, offset) ? -1 : 0;
 }
 
 static int Control(stream_t *stream, int query, va_list args)
 {
     switch (query)
     {
-        case STREAM_CAN_SEEK:
         case STREAM_CAN_FASTSEEK:
             *va_arg(args, bool *) = false;
             break;
+        case STREAM_CAN_SEEK: /* the access points need a seekable source */
         case STREAM_CAN_PAUSE:
         case STREAM_CAN_CONTROL_PACE:
         case STREAM_GET_PTS_DELAY:
@@ -125,6 +100,7 @@ static int Control(stream_t *stream, int query, va_list args)
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
+        case STREAM_GET_FD:
             return VLC_EGENERIC;
         default:
             msg_Err(stream, "unimplemented query (%d) in control", query);
@@ -137,17 +113,17 @@ static int Open(vlc_object_t *obj)
 {
     stream_t *stream = (stream_t *)obj;
     const uint8_t *peek;
-    int bits;
+    enum vlc_inflate_format format;
 
     /* See IETF RFC6713 */
     if (vlc_stream_Peek(stream->s, &peek, 2) < 2)
         return VLC_EGENERIC;
 
     if ((peek[0] & 0xF) == 8 && (peek[0] >> 4) < 8 && (U16_AT(peek) % 31) == 0)
-        bits = 15; /* zlib */
+        format = VLC_INFLATE_ZLIB;
     else
     if (!memcmp(peek, "\x1F\x8B", 2))
-        bits = 15 + 32; /* gzip */
+        format = VLC_INFLATE_GZIP;
     else
         return VLC_EGENERIC;
 
@@ -155,19 +131,15 @@ static int Open(vlc_object_t *obj)
     if (unlikely(sys == NULL))
         return VLC_ENOMEM;
 
-    sys->zstream.next_in = sys->buffer;
-    sys->zstream.avail_in = 0;
-    sys->zstream.zalloc = Z_NULL;
-    sys->zstream.zfree = Z_NULL;
-    sys->zstream.opaque = Z_NULL;
-    sys->eof = false;
-
-    int ret = inflateInit2(&sys->zstream, bits);
-    if (ret != Z_OK)
+    /* The reading thread decompresses too */
+    sys->inflate = vlc_inflate_New(format, ReadCompressed, stream,
+                                   INFLATE_SPACING, vlc_GetCPUCount() - 1);
+    if (unlikely(sys->inflate == NULL))
     {
         free(sys);
-        return (ret == Z_MEM_ERROR) ? VLC_ENOMEM : VLC_EGENERIC;
+        return VLC_ENOMEM;
     }
+    sys->error = false;
 
     stream->p_sys = sys;
     stream->pf_read = Read;
@@ -180,8 +152,13 @@ static void Close (vlc_object_t *obj)
 {
     stream_t *stream = (stream_t *)obj;
     stream_sys_t *sys = stream->p_sys;
+    struct vlc_inflate_stats stats;
 
-    inflateEnd(&sys->zstream);
+    vlc_inflate_GetStats(sys->inflate, &stats);
+    msg_Dbg(stream, "%u member(s), %u access point(s), %u thread(s), "
+            "%"PRIu64" bytes decompressed for seeking", stats.members,
+            stats.points, stats.threads, stats.skipped);
+    vlc_inflate_Delete(sys->inflate);
     free(sys);
 }
 
@@ -0,0 +1,1033 @@
+/*****************************************************************************
+ * inflate_index.c: seekable zlib/gzip decompression
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <vlc_common.h>
+
+#include "inflate_index.h"
+
+#define INFLATE_WINDOW 32768
+/* Large enough for a whole BGZF member */
+#define INFLATE_IN_SIZE 65536
+#define INFLATE_SKIP_SIZE 65536
+/* Past that many windows (32 MiB), every other one is dropped */
+#define INFLATE_MAX_WINDOWS 1024
+#define INFLATE_MAX_THREADS 16
+#define BGZF_MAX_SIZE 65536
+
+enum
+{
+    ST_HEADER,
+    ST_DATA,
+    ST_TRAILER,
+    ST_END,
+    ST_ERROR,
+};
+
+enum
+{
+    JOB_QUEUED,
+    JOB_TAKEN,
+    JOB_DONE,
+    JOB_FAILED,
+};
+
+struct inflate_point
+{
+    uint64_t out; /* uncompressed offset */
+    uint64_t in; /* compressed offset of the member or of the next byte */
+    unsigned char *window; /* NULL at the start of a member */
+    unsigned window_len;
+    unsigned char bits; /* unused bits of the byte before "in" */
+};
+
+/* One BGZF member */
+struct inflate_job
+{
+    uint64_t out;
+    unsigned char *cdata; /* raw deflate data */
+    size_t clen;
+    uint32_t crc;
+    unsigned char *data;
+    size_t len;
+    size_t pos; /* consumed bytes */
+    unsigned char state;
+};
+
+struct vlc_inflate
+{
+    enum vlc_inflate_format format;
+    vlc_inflate_read_cb read;
+    void *opaque;
+    size_t spacing;
+    unsigned max_threads;
+    bool probed;
+
+    /* Raw deflate, the headers and trailers are handled here */
+    z_stream z;
+    unsigned char *inbuf;
+    uint64_t in_end; /* compressed offset after the buffered input */
+    int state;
+    uint64_t out;
+    uint64_t member_out; /* uncompressed offset of the current member */
+    uint32_t check; /* CRC-32 or Adler-32 */
+    bool check_valid; /* false if not started from the member start */
+    unsigned char *scratch;
+
+    struct inflate_point *points;
+    size_t count;
+    size_t alloc;
+    unsigned windows;
+    unsigned members;
+    uint64_t last_member; /* compressed offset of the last member seen */
+    uint64_t skipped;
+
+    /* Parallel decompression of BGZF members */
+    bool parallel;
+    uint64_t par_in; /* next member to queue */
+    uint64_t par_out;
+    uint64_t par_skip; /* members ending before this are not decompressed */
+    bool par_end;
+    bool par_fallback; /* the next member is not BGZF */
+
+    z_stream job_z; /* for the jobs done by the reader */
+    struct inflate_job *jobs;
+    unsigned depth;
+    unsigned ahead; /* jobs to queue, ramping up after a seek */
+    unsigned head; /* next job to consume */
+    unsigned queued;
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait_job;
+    vlc_cond_t wait_done;
+    bool closing;
+    unsigned thread_count;
+    vlc_thread_t threads[INFLATE_MAX_THREADS];
+};
+
+static uint64_t inflate_InPos(const struct vlc_inflate *inf)
+{
+    return inf->in_end - inf->z.avail_in;
+}
+
+/* Drops the buffered input, and resumes reading at the given offset. */
+static void inflate_Restart(struct vlc_inflate *inf, uint64_t offset)
+{
+    inf->z.next_in = inf->inbuf;
+    inf->z.avail_in = 0;
+    inf->in_end = offset;
+}
+
+/* Buffers at least want bytes of input, unless the end is reached. */
+static ssize_t inflate_Fill(struct vlc_inflate *inf, size_t want)
+{
+    assert(want <= INFLATE_IN_SIZE);
+
+    if (inf->z.avail_in >= want)
+        return inf->z.avail_in;
+
+    memmove(inf->inbuf, inf->z.next_in, inf->z.avail_in);
+    inf->z.next_in = inf->inbuf;
+
+    while (inf->z.avail_in < want)
+    {
+        ssize_t val = inf->read(inf->opaque, inf->in_end,
+                                inf->inbuf + inf->z.avail_in,
+                                INFLATE_IN_SIZE - inf->z.avail_in);
+        if (val < 0)
+            return -1;
+        if (val == 0)
+            break;
+        inf->z.avail_in += val;
+        inf->in_end += val;
+    }
+    return inf->z.avail_in;
+}
+
+static void inflate_Consume(struct vlc_inflate *inf, size_t len)
+{
+    assert(len <= inf->z.avail_in);
+    inf->z.next_in += len;
+    inf->z.avail_in -= len;
+}
+
+static struct inflate_point *inflate_Append(struct vlc_inflate *inf)
+{
+    if (inf->count == inf->alloc)
+    {
+        size_t alloc = inf->alloc ? 2 * inf->alloc : 16;
+        struct inflate_point *points =
+            realloc(inf->points, alloc * sizeof (*points));
+        if (unlikely(points == NULL))
+            return NULL;
+        inf->points = points;
+        inf->alloc = alloc;
+    }
+    return &inf->points[inf->count++];
+}
+
+/* Last access point at or before an uncompressed offset */
+static const struct inflate_point *inflate_Find(const struct vlc_inflate *inf,
+                                                uint64_t offset)
+{
+    size_t lo = 0, hi = inf->count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+
+        if (inf->points[mid].out <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo > 0) ? &inf->points[lo - 1] : NULL;
+}
+
+static void inflate_AddMember(struct vlc_inflate *inf, uint64_t in,
+                              uint64_t out)
+{
+    if (inf->members > 0 && in <= inf->last_member)
+        return; /* seen before */
+
+    inf->members++;
+    inf->last_member = in;
+
+    /* Empty members do not need a point of their own */
+    if (inf->count > 0 && out <= inf->points[inf->count - 1].out)
+        return;
+
+    struct inflate_point *p = inflate_Append(inf);
+    if (likely(p != NULL))
+    {
+        p->out = out;
+        p->in = in;
+        p->window = NULL;
+        p->window_len = 0;
+        p->bits = 0;
+    }
+}
+
+/* Halves the number of windows, and doubles their spacing. */
+static void inflate_Thin(struct vlc_inflate *inf)
+{
+    size_t j = 0;
+    unsigned n = 0;
+
+    for (size_t i = 0; i < inf->count; i++)
+    {
+        struct inflate_point *p = &inf->points[i];
+
+        if (p->window != NULL && (n++ & 1))
+        {
+            free(p->window);
+            continue;
+        }
+        inf->points[j++] = *p;
+    }
+    inf->count = j;
+    inf->windows = (n + 1) / 2;
+    inf->spacing *= 2;
+}
+
+/* Called at a deflate block boundary */
+static void inflate_AddWindow(struct vlc_inflate *inf)
+{
+    if (inf->spacing == 0 || inf->count == 0
+     || inf->out < inf->points[inf->count - 1].out + inf->spacing)
+        return; /* too close to the last point, or already indexed */
+
+    unsigned char *window = malloc(INFLATE_WINDOW);
+    uInt len = INFLATE_WINDOW;
+
+    if (unlikely(window == NULL))
+        return;
+    if (inflateGetDictionary(&inf->z, window, &len) != Z_OK)
+    {
+        free(window);
+        return;
+    }
+
+    struct inflate_point *p = inflate_Append(inf);
+    if (unlikely(p == NULL))
+    {
+        free(window);
+        return;
+    }
+    p->out = inf->out;
+    p->in = inflate_InPos(inf);
+    p->window = window;
+    p->window_len = len;
+    p->bits = inf->z.data_type & 7;
+
+    if (++inf->windows > INFLATE_MAX_WINDOWS)
+        inflate_Thin(inf);
+}
+
+/* Skips a NUL-terminated header field. */
+static int inflate_SkipString(struct vlc_inflate *inf, size_t *lenp)
+{
+    size_t len = *lenp;
+
+    for (;;)
+    {
+        if (len >= INFLATE_IN_SIZE)
+            return -1;
+
+        ssize_t avail = inflate_Fill(inf, len + 1);
+        if (avail < (ssize_t)(len + 1))
+            return -1;
+
+        const unsigned char *nul = memchr(inf->z.next_in + len, 0,
+                                          avail - len);
+        if (nul != NULL)
+        {
+            *lenp = nul + 1 - inf->z.next_in;
+            return 0;
+        }
+        len = avail;
+    }
+}
+
+/**
+ * Parses a gzip member header.
+ * \return 1 on success, 0 if there are no other members, -1 on error
+ */
+static int inflate_GzipHeader(struct vlc_inflate *inf)
+{
+    ssize_t avail = inflate_Fill(inf, 10);
+    if (avail < 0)
+        return -1;
+
+    const unsigned char *p = inf->z.next_in;
+
+    if (avail < 10 || memcmp(p, "\x1F\x8B\x08", 3) || (p[3] & 0xE0))
+        /* Trailing garbage is ignored, as gzip does */
+        return (inflate_InPos(inf) > 0) ? 0 : -1;
+
+    unsigned flags = p[3];
+    size_t len = 10;
+
+    if (flags & 0x04) /* FEXTRA */
+    {
+        if (inflate_Fill(inf, len + 2) < (ssize_t)(len + 2))
+            return -1;
+        len += 2 + GetWLE(inf->z.next_in + len);
+    }
+    if ((flags & 0x08) && inflate_SkipString(inf, &len)) /* FNAME */
+        return -1;
+    if ((flags & 0x10) && inflate_SkipString(inf, &len)) /* FCOMMENT */
+        return -1;
+    if (flags & 0x02) /* FHCRC */
+        len += 2;
+
+    if (len > INFLATE_IN_SIZE || inflate_Fill(inf, len) < (ssize_t)len)
+        return -1;
+    inflate_Consume(inf, len);
+    return 1;
+}
+
+static int inflate_ZlibHeader(struct vlc_inflate *inf)
+{
+    if (inflate_Fill(inf, 2) < 2)
+        return -1;
+
+    const unsigned char *p = inf->z.next_in;
+
+    /* Preset dictionaries are not supported */
+    if ((p[0] & 0xF) != 8 || (p[0] >> 4) > 7 || (U16_AT(p) % 31)
+     || (p[1] & 0x20))
+        return -1;
+    inflate_Consume(inf, 2);
+    return 1;
+}
+
+static int inflate_Trailer(struct vlc_inflate *inf)
+{
+    const bool gzip = inf->format == VLC_INFLATE_GZIP;
+    const size_t len = gzip ? 8 : 4;
+
+    if (inflate_Fill(inf, len) < (ssize_t)len)
+        return -1;
+
+    const unsigned char *p = inf->z.next_in;
+
+    if (inf->check_valid)
+    {
+        if (gzip ? (GetDWLE(p) != inf->check
+                 || GetDWLE(p + 4) != (uint32_t)(inf->out - inf->member_out))
+                 : (GetDWBE(p) != inf->check))
+            return -1;
+    }
+    inflate_Consume(inf, len);
+    return 0;
+}
+
+static ssize_t inflate_ReadSequential(struct vlc_inflate *inf,
+                                      unsigned char *buf, size_t len)
+{
+    const bool gzip = inf->format == VLC_INFLATE_GZIP;
+
+    for (;;)
+    {
+        switch (inf->state)
+        {
+            case ST_HEADER:
+            {
+                uint64_t in = inflate_InPos(inf);
+                int val = gzip ? inflate_GzipHeader(inf)
+                               : inflate_ZlibHeader(inf);
+                if (val <= 0)
+                {
+                    inf->state = val ? ST_ERROR : ST_END;
+                    return val;
+                }
+
+                inflate_AddMember(inf, in, inf->out);
+                inflateReset(&inf->z);
+                inf->member_out = inf->out;
+                inf->check = gzip ? crc32(0, NULL, 0) : adler32(0, NULL, 0);
+                inf->check_valid = true;
+                inf->state = ST_DATA;
+                break;
+            }
+
+            case ST_DATA:
+            {
+                if (inf->z.avail_in == 0 && inflate_Fill(inf, 1) <= 0)
+                {
+                    inf->state = ST_ERROR; /* truncated */
+                    return -1;
+                }
+
+                inf->z.next_out = buf;
+                inf->z.avail_out = len;
+
+                /* Stop at block boundaries, to index them */
+                int val = inflate(&inf->z, Z_BLOCK);
+                size_t got = len - inf->z.avail_out;
+
+                if (inf->check_valid)
+                    inf->check = gzip ? crc32(inf->check, buf, got)
+                                      : adler32(inf->check, buf, got);
+                inf->out += got;
+
+                switch (val)
+                {
+                    case Z_STREAM_END:
+                        inf->state = ST_TRAILER;
+                        break;
+                    case Z_OK:
+                        if ((inf->z.data_type & 128)
+                         && !(inf->z.data_type & 64))
+                            inflate_AddWindow(inf);
+                        break;
+                    case Z_BUF_ERROR: /* needs more input */
+                    {
+                        ssize_t avail = inf->z.avail_in;
+
+                        if (got == 0 && (avail >= INFLATE_IN_SIZE
+                                      || inflate_Fill(inf, avail + 1) <= avail))
+                        {
+                            inf->state = ST_ERROR;
+                            return -1;
+                        }
+                        break;
+                    }
+                    default:
+                        inf->state = ST_ERROR;
+                        return -1;
+                }
+
+                if (got > 0)
+                    return got;
+                break;
+            }
+
+            case ST_TRAILER:
+                if (inflate_Trailer(inf))
+                {
+                    inf->state = ST_ERROR;
+                    return -1;
+                }
+                inf->state = gzip ? ST_HEADER : ST_END;
+                break;
+
+            case ST_END:
+                return 0;
+
+            default:
+                return -1;
+        }
+    }
+}
+
+/* Decompresses and discards data up to an uncompressed offset. */
+static int inflate_SkipTo(struct vlc_inflate *inf, uint64_t offset)
+{
+    while (inf->out < offset)
+    {
+        if (inf->scratch == NULL)
+        {
+            inf->scratch = malloc(INFLATE_SKIP_SIZE);
+            if (unlikely(inf->scratch == NULL))
+                return -1;
+        }
+
+        uint64_t left = offset - inf->out;
+        ssize_t val = inflate_ReadSequential(inf, inf->scratch,
+            (left < INFLATE_SKIP_SIZE) ? left : INFLATE_SKIP_SIZE);
+        if (val < 0)
+            return -1;
+        if (val == 0)
+        {   /* Beyond the end */
+            inf->out = offset;
+            break;
+        }
+        inf->skipped += val;
+    }
+    return 0;
+}
+
+/* Resumes decompression at an access point (NULL for the start). */
+static int inflate_Restore(struct vlc_inflate *inf,
+                           const struct inflate_point *p)
+{
+    inflateReset(&inf->z);
+
+    if (p == NULL || p->window == NULL)
+    {
+        inflate_Restart(inf, (p != NULL) ? p->in : 0);
+        inf->out = (p != NULL) ? p->out : 0;
+        inf->state = ST_HEADER;
+        return 0;
+    }
+
+    inflate_Restart(inf, p->in - (p->bits ? 1 : 0));
+    inf->out = p->out;
+    inf->check_valid = false;
+    inf->state = ST_ERROR;
+
+    if (p->bits)
+    {
+        if (inflate_Fill(inf, 1) < 1)
+            return -1;
+
+        int c = inf->z.next_in[0];
+
+        inflate_Consume(inf, 1);
+        inflatePrime(&inf->z, p->bits, c >> (8 - p->bits));
+    }
+    if (inflateSetDictionary(&inf->z, p->window, p->window_len) != Z_OK)
+        return -1;
+    inf->state = ST_DATA;
+    return 0;
+}
+
+static int inflate_SeekSequential(struct vlc_inflate *inf, uint64_t offset)
+{
+    const struct inflate_point *p = inflate_Find(inf, offset);
+
+    /* Going forward is faster from an access point ahead, if any */
+    if (offset < inf->out || inf->state == ST_ERROR
+     || (p != NULL && p->out > inf->out))
+        if (inflate_Restore(inf, p))
+            return -1;
+
+    return inflate_SkipTo(inf, offset);
+}
+
+/*** Parallel decompression ***/
+
+/**
+ * Checks for a BGZF member at the current input position.
+ * \return the member size, or 0 if it is not a BGZF member
+ */
+static size_t inflate_BgzfSize(struct vlc_inflate *inf)
+{
+    if (inflate_Fill(inf, 12) < 12)
+        return 0;
+
+    const unsigned char *p = inf->z.next_in;
+
+    if (memcmp(p, "\x1F\x8B\x08\x04", 4)) /* FEXTRA only */
+        return 0;
+
+    size_t xlen = GetWLE(p + 10);
+
+    if (12 + xlen > INFLATE_IN_SIZE
+     || inflate_Fill(inf, 12 + xlen) < (ssize_t)(12 + xlen))
+        return 0;
+
+    p = inf->z.next_in + 12;
+
+    for (size_t i = 0; i + 4 <= xlen;)
+    {
+        size_t slen = GetWLE(p + i + 2);
+
+        if (p[i] == 'B' && p[i + 1] == 'C' && slen == 2 && i + 6 <= xlen)
+        {
+            size_t size = GetWLE(p + i + 4) + 1;
+
+            return (size >= 12 + xlen + 8) ? size : 0;
+        }
+        i += 4 + slen;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next BGZF member into a job.
+ * \return 1 on success, 0 if there are no other BGZF members, -1 on error
+ */
+static int inflate_ReadMember(struct vlc_inflate *inf, struct inflate_job *job)
+{
+    ssize_t avail = inflate_Fill(inf, 1);
+    if (avail < 0)
+        return -1;
+    if (avail == 0 && inflate_InPos(inf) > 0)
+    {
+        inf->par_end = true;
+        return 0;
+    }
+
+    /* Anything else is left to the sequential decompression */
+    size_t size = inflate_BgzfSize(inf);
+    if (size == 0 || inflate_Fill(inf, size) < (ssize_t)size)
+    {
+        inf->par_fallback = true;
+        return 0;
+    }
+
+    const unsigned char *p = inf->z.next_in;
+    size_t hdr = 12 + GetWLE(p + 10);
+    uint32_t isize = GetDWLE(p + size - 4);
+
+    if (isize > BGZF_MAX_SIZE)
+    {
+        inf->par_fallback = true;
+        return 0;
+    }
+
+    job->clen = size - hdr - 8;
+    memcpy(job->cdata, p + hdr, job->clen);
+    job->crc = GetDWLE(p + size - 8);
+    job->len = isize;
+    inflate_Consume(inf, size);
+    return 1;
+}
+
+/* Decompresses a job. Called without the lock. */
+static bool inflate_RunJob(z_stream *z, struct inflate_job *job)
+{
+    inflateReset(z);
+    z->next_in = job->cdata;
+    z->avail_in = job->clen;
+    z->next_out = job->data;
+    z->avail_out = BGZF_MAX_SIZE;
+
+    return inflate(z, Z_FINISH) == Z_STREAM_END
+        && BGZF_MAX_SIZE - z->avail_out == job->len
+        && crc32(0, job->data, job->len) == job->crc;
+}
+
+static struct inflate_job *inflate_TakeJob(struct vlc_inflate *inf)
+{
+    for (unsigned i = 0; i < inf->queued; i++)
+    {
+        struct inflate_job *job = &inf->jobs[(inf->head + i) % inf->depth];
+
+        if (job->state == JOB_QUEUED)
+        {
+            job->state = JOB_TAKEN;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static void *inflate_Run(void *data)
+{
+    struct vlc_inflate *inf = data;
+    z_stream z;
+
+    memset(&z, 0, sizeof (z));
+    if (inflateInit2(&z, -15) != Z_OK)
+        return NULL; /* the reader will do it all */
+
+    vlc_mutex_lock(&inf->lock);
+    while (!inf->closing)
+    {
+        struct inflate_job *job = inflate_TakeJob(inf);
+
+        if (job == NULL)
+        {
+            vlc_cond_wait(&inf->wait_job, &inf->lock);
+            continue;
+        }
+
+        vlc_mutex_unlock(&inf->lock);
+        bool ok = inflate_RunJob(&z, job);
+        vlc_mutex_lock(&inf->lock);
+        job->state = ok ? JOB_DONE : JOB_FAILED;
+        vlc_cond_broadcast(&inf->wait_done);
+    }
+    vlc_mutex_unlock(&inf->lock);
+    inflateEnd(&z);
+    return NULL;
+}
+
+/* Reads members ahead, as far as there are free jobs. */
+static int inflate_Queue(struct vlc_inflate *inf)
+{
+    while (inf->queued < inf->ahead && !inf->par_end && !inf->par_fallback)
+    {
+        struct inflate_job *job =
+            &inf->jobs[(inf->head + inf->queued) % inf->depth];
+        uint64_t in = inflate_InPos(inf);
+        int val = inflate_ReadMember(inf, job);
+
+        if (val <= 0)
+            return val;
+
+        inflate_AddMember(inf, in, inf->par_out);
+        job->out = inf->par_out;
+        inf->par_in = inflate_InPos(inf);
+        inf->par_out += job->len;
+
+        /* Members before the seek target are only indexed */
+        if (job->out + job->len <= inf->par_skip)
+            continue;
+
+        job->pos = 0;
+        if (inf->par_skip > job->out)
+        {
+            job->pos = inf->par_skip - job->out;
+            inf->skipped += job->pos;
+        }
+
+        vlc_mutex_lock(&inf->lock);
+        job->state = JOB_QUEUED;
+        inf->queued++;
+        vlc_cond_signal(&inf->wait_job);
+        vlc_mutex_unlock(&inf->lock);
+    }
+    return 0;
+}
+
+static ssize_t inflate_ReadParallel(struct vlc_inflate *inf,
+                                    unsigned char *buf, size_t len)
+{
+    for (;;)
+    {
+        if (inflate_Queue(inf))
+        {
+            inf->state = ST_ERROR;
+            return -1;
+        }
+
+        if (inf->queued == 0)
+        {
+            if (!inf->par_fallback)
+                return 0;
+
+            /* Carry on sequentially from the first non-BGZF member */
+            uint64_t offset = inf->out;
+
+            assert(inflate_InPos(inf) == inf->par_in);
+            inf->parallel = false;
+            inf->state = ST_HEADER;
+            inf->out = inf->par_out;
+            if (inflate_SkipTo(inf, offset))
+                return -1;
+            return inflate_ReadSequential(inf, buf, len);
+        }
+
+        struct inflate_job *job = &inf->jobs[inf->head];
+
+        vlc_mutex_lock(&inf->lock);
+        if (job->state == JOB_QUEUED)
+        {   /* Not taken by any thread yet: faster to do it here */
+            job->state = JOB_TAKEN;
+            vlc_mutex_unlock(&inf->lock);
+            bool ok = inflate_RunJob(&inf->job_z, job);
+            vlc_mutex_lock(&inf->lock);
+            job->state = ok ? JOB_DONE : JOB_FAILED;
+        }
+        while (job->state == JOB_TAKEN)
+            vlc_cond_wait(&inf->wait_done, &inf->lock);
+        vlc_mutex_unlock(&inf->lock);
+
+        if (job->state == JOB_FAILED)
+        {
+            inf->state = ST_ERROR;
+            return -1;
+        }
+
+        size_t copy = job->len - job->pos;
+
+        if (copy > len)
+            copy = len;
+        memcpy(buf, job->data + job->pos, copy);
+        job->pos += copy;
+        inf->out += copy;
+
+        if (job->pos == job->len)
+        {
+            vlc_mutex_lock(&inf->lock);
+            inf->head = (inf->head + 1) % inf->depth;
+            inf->queued--;
+            vlc_mutex_unlock(&inf->lock);
+
+            if (inf->ahead < inf->depth)
+                inf->ahead = (2 * inf->ahead < inf->depth) ? 2 * inf->ahead
+                                                           : inf->depth;
+        }
+
+        if (copy > 0)
+            return copy;
+    }
+}
+
+static int inflate_SeekParallel(struct vlc_inflate *inf, uint64_t offset)
+{
+    /* Drop the queued members, once the threads are done with them */
+    vlc_mutex_lock(&inf->lock);
+    for (unsigned i = 0; i < inf->queued; i++)
+    {
+        struct inflate_job *job = &inf->jobs[(inf->head + i) % inf->depth];
+
+        while (job->state == JOB_TAKEN)
+            vlc_cond_wait(&inf->wait_done, &inf->lock);
+    }
+    inf->queued = 0;
+    vlc_mutex_unlock(&inf->lock);
+
+    /* Only member starts are indexed while in parallel mode */
+    const struct inflate_point *p = inflate_Find(inf, offset);
+
+    assert(p == NULL || p->window == NULL);
+    inf->par_in = (p != NULL) ? p->in : 0;
+    inf->par_out = (p != NULL) ? p->out : 0;
+    inf->par_skip = offset;
+    /* Do not decompress much ahead of a random access */
+    inf->ahead = 1;
+    inf->par_end = false;
+    inf->par_fallback = false;
+    inflate_Restart(inf, inf->par_in);
+    inf->out = offset;
+    inf->state = ST_HEADER;
+    return 0;
+}
+
+static void inflate_StartThreads(struct vlc_inflate *inf)
+{
+    unsigned threads = inf->max_threads;
+
+    if (threads > INFLATE_MAX_THREADS)
+        threads = INFLATE_MAX_THREADS;
+
+    if (inflateInit2(&inf->job_z, -15) != Z_OK)
+        return;
+
+    /* Enough jobs to keep every thread and the reader busy */
+    inf->depth = 2 * (threads + 1);
+    inf->jobs = calloc(inf->depth, sizeof (*inf->jobs));
+    if (unlikely(inf->jobs == NULL))
+        return;
+
+    for (unsigned i = 0; i < inf->depth; i++)
+    {
+        struct inflate_job *job = &inf->jobs[i];
+
+        job->cdata = malloc(BGZF_MAX_SIZE);
+        job->data = malloc(BGZF_MAX_SIZE);
+        if (unlikely(job->cdata == NULL || job->data == NULL))
+        {
+            inf->depth = i + 1;
+            return; /* freed by vlc_inflate_Delete() */
+        }
+    }
+
+    inf->ahead = inf->depth;
+    inf->head = 0;
+    inf->queued = 0;
+    inf->par_in = 0;
+    inf->par_out = 0;
+    inf->par_skip = 0;
+    inf->par_end = false;
+    inf->par_fallback = false;
+
+    while (inf->thread_count < threads)
+    {
+        if (vlc_clone(&inf->threads[inf->thread_count], inflate_Run, inf,
+                      VLC_THREAD_PRIORITY_LOW))
+            break; /* the reader will do the rest */
+        inf->thread_count++;
+    }
+    inf->parallel = true;
+}
+
+/* Looks at the first member, before any read or seek. */
+static void inflate_Probe(struct vlc_inflate *inf)
+{
+    if (inf->probed)
+        return;
+    inf->probed = true;
+
+    if (inf->format == VLC_INFLATE_GZIP && inf->max_threads > 0
+     && inflate_BgzfSize(inf) > 0)
+        inflate_StartThreads(inf);
+}
+
+struct vlc_inflate *vlc_inflate_New(enum vlc_inflate_format format,
+                                    vlc_inflate_read_cb read, void *opaque,
+                                    size_t spacing, unsigned threads)
+{
+    struct vlc_inflate *inf = malloc(sizeof (*inf));
+    if (unlikely(inf == NULL))
+        return NULL;
+
+    memset(&inf->z, 0, sizeof (inf->z));
+    memset(&inf->job_z, 0, sizeof (inf->job_z));
+    inf->inbuf = malloc(INFLATE_IN_SIZE);
+    if (unlikely(inf->inbuf == NULL))
+    {
+        free(inf);
+        return NULL;
+    }
+
+    if (inflateInit2(&inf->z, -15) != Z_OK)
+    {
+        free(inf->inbuf);
+        free(inf);
+        return NULL;
+    }
+
+    inf->format = format;
+    inf->read = read;
+    inf->opaque = opaque;
+    inf->spacing = spacing;
+    inf->max_threads = threads;
+    inf->probed = false;
+    inflate_Restart(inf, 0);
+    inf->state = ST_HEADER;
+    inf->out = 0;
+    inf->member_out = 0;
+    inf->check_valid = false;
+    inf->scratch = NULL;
+    inf->points = NULL;
+    inf->count = 0;
+    inf->alloc = 0;
+    inf->windows = 0;
+    inf->members = 0;
+    inf->last_member = 0;
+    inf->skipped = 0;
+    inf->parallel = false;
+    inf->jobs = NULL;
+    inf->depth = 0;
+    inf->queued = 0;
+    inf->closing = false;
+    inf->thread_count = 0;
+    vlc_mutex_init(&inf->lock);
+    vlc_cond_init(&inf->wait_job);
+    vlc_cond_init(&inf->wait_done);
+    return inf;
+}
+
+void vlc_inflate_Delete(struct vlc_inflate *inf)
+{
+    vlc_mutex_lock(&inf->lock);
+    inf->closing = true;
+    vlc_cond_broadcast(&inf->wait_job);
+    vlc_mutex_unlock(&inf->lock);
+
+    for (unsigned i = 0; i < inf->thread_count; i++)
+        vlc_join(inf->threads[i], NULL);
+
+    if (inf->jobs != NULL)
+    {
+        for (unsigned i = 0; i < inf->depth; i++)
+        {
+            free(inf->jobs[i].data);
+            free(inf->jobs[i].cdata);
+        }
+        free(inf->jobs);
+    }
+    inflateEnd(&inf->job_z); /* no-op if never initialized */
+
+    vlc_cond_destroy(&inf->wait_done);
+    vlc_cond_destroy(&inf->wait_job);
+    vlc_mutex_destroy(&inf->lock);
+
+    for (size_t i = 0; i < inf->count; i++)
+        free(inf->points[i].window);
+    free(inf->points);
+    free(inf->scratch);
+    inflateEnd(&inf->z);
+    free(inf->inbuf);
+    free(inf);
+}
+
+ssize_t vlc_inflate_Read(struct vlc_inflate *inf, void *buf, size_t len)
+{
+    if (unlikely(len == 0))
+        return 0;
+    if (len > UINT_MAX) /* z_stream.avail_out */
+        len = UINT_MAX;
+
+    inflate_Probe(inf);
+
+    if (inf->state == ST_ERROR)
+        return -1;
+    return inf->parallel ? inflate_ReadParallel(inf, buf, len)
+                         : inflate_ReadSequential(inf, buf, len);
+}
+
+int vlc_inflate_Seek(struct vlc_inflate *inf, uint64_t offset)
+{
+    inflate_Probe(inf);
+
+    return inf->parallel ? inflate_SeekParallel(inf, offset)
+                         : inflate_SeekSequential(inf, offset);
+}
+
+uint64_t vlc_inflate_Tell(const struct vlc_inflate *inf)
+{
+    return inf->out;
+}
+
+void vlc_inflate_GetStats(const struct vlc_inflate *inf,
+                          struct vlc_inflate_stats *stats)
+{
+    stats->points = inf->count;
+    stats->members = inf->members;
+    stats->threads = inf->parallel ? inf->thread_count : 0;
+    stats->skipped = inf->skipped;
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * inflate_index.h: seekable zlib/gzip decompression
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_INFLATE_INDEX_H
+#define VLC_INFLATE_INDEX_H
+
+/*
+ * The decompressor records access points as it goes: the start of each gzip
+ * member, and every so often, a deflate block boundary along with the last
+ * 32 KiB of output (the deflate window). A seek resumes decompression from
+ * the closest access point before the target, instead of from the start of
+ * the stream. Seeking past the indexed part decompresses forward, extending
+ * the index.
+ *
+ * Gzip streams made of several members are decompressed member after
+ * member. If the members carry their compressed size in the header (BGZF,
+ * as written by bgzip), several members are decompressed in parallel.
+ *
+ * All functions must be called from the same thread.
+ */
+struct vlc_inflate;
+
+enum vlc_inflate_format
+{
+    VLC_INFLATE_ZLIB, /**< RFC1950 */
+    VLC_INFLATE_GZIP, /**< RFC1952, one or more members */
+};
+
+/**
+ * Reads compressed data.
+ *
+ * @param offset absolute byte offset to read from
+ * @return the number of bytes read (less than len only at the end of the
+ * stream), 0 at the end of the stream, or -1 on error
+ */
+typedef ssize_t (*vlc_inflate_read_cb)(void *opaque, uint64_t offset,
+                                       void *buf, size_t len);
+
+struct vlc_inflate_stats
+{
+    unsigned points;  /**< access points in the index */
+    unsigned members; /**< gzip members seen */
+    unsigned threads; /**< decompression threads (0 if sequential) */
+    uint64_t skipped; /**< bytes decompressed and discarded by seeks */
+};
+
+/**
+ * Creates a decompressor.
+ *
+ * @param spacing minimum uncompressed distance between two access points
+ *                within a member (0 to index member starts only)
+ * @param threads maximum number of threads for parallel decompression
+ * @return a decompressor, or NULL on memory error
+ */
+struct vlc_inflate *vlc_inflate_New(enum vlc_inflate_format,
+                                    vlc_inflate_read_cb read, void *opaque,
+                                    size_t spacing, unsigned threads);
+void vlc_inflate_Delete(struct vlc_inflate *);
+
+/**
+ * Reads decompressed data.
+ *
+ * @return the number of bytes read, 0 at the end of the stream,
+ * or -1 on error (corrupt or truncated data)
+ */
+ssize_t vlc_inflate_Read(struct vlc_inflate *, void *buf, size_t len);
+
+/**
+ * Seeks to an uncompressed offset.
+ *
+ * Seeking beyond the end is not an error; subsequent reads return 0.
+ *
+ * @return 0 on success, -1 on error
+ */
+int vlc_inflate_Seek(struct vlc_inflate *, uint64_t offset);
+
+/**
+ * @return the current uncompressed offset
+ */
+uint64_t vlc_inflate_Tell(const struct vlc_inflate *);
+
+void vlc_inflate_GetStats(const struct vlc_inflate *,
+                          struct vlc_inflate_stats *);
+
+#endif
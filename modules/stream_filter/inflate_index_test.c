@@ -0,0 +1,450 @@
+/*****************************************************************************
+ * inflate_index_test.c: seekable decompression test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Decompresses synthetic zlib, gzip and BGZF streams sequentially and at
+ * random offsets, checks the output, and measures the throughput and the
+ * seek latency with and without the index.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+
+#include "inflate_index.h"
+
+#define DATA_SIZE (8 << 20)
+#define SPACING (1 << 20)
+#define SEEKS 100
+#define BGZF_BLOCK 0xff00 /* as bgzip */
+
+static unsigned char *data;
+
+struct source
+{
+    const unsigned char *buf;
+    size_t size;
+};
+
+static ssize_t source_read(void *opaque, uint64_t offset, void *buf,
+                           size_t len)
+{
+    const struct source *src = opaque;
+
+    if (offset >= src->size)
+        return 0;
+    if (len > src->size - offset)
+        len = src->size - offset;
+    memcpy(buf, src->buf + offset, len);
+    return len;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand_next(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return rand_state >> 8;
+}
+
+/* Text-like data, compressing about 3:1 */
+static void make_data(void)
+{
+    static const char *const words[] = {
+        "video ", "audio ", "stream ", "filter ", "packet ", "decoder ",
+        "the ", "a ", "of ", "and ", "frame ", "sample ", "\n", "buffer ",
+    };
+    size_t i = 0;
+
+    data = malloc(DATA_SIZE);
+    assert(data != NULL);
+
+    while (i < DATA_SIZE)
+    {
+        char num[16];
+        const char *w = words[rand_next() % ARRAY_SIZE(words)];
+
+        if (rand_next() % 4 == 0)
+        {
+            snprintf(num, sizeof (num), "%u ", (unsigned)rand_next() % 10000);
+            w = num;
+        }
+
+        size_t len = strlen(w);
+        if (len > DATA_SIZE - i)
+            len = DATA_SIZE - i;
+        memcpy(data + i, w, len);
+        i += len;
+    }
+}
+
+struct output
+{
+    unsigned char *buf;
+    size_t size;
+    size_t alloc;
+};
+
+static unsigned char *out_reserve(struct output *out, size_t len)
+{
+    if (out->size + len > out->alloc)
+    {
+        out->alloc = 2 * (out->size + len);
+        out->buf = realloc(out->buf, out->alloc);
+        assert(out->buf != NULL);
+    }
+    return out->buf + out->size;
+}
+
+/* Appends a zlib (15), gzip (31) or raw deflate (-15) stream */
+static void compress_append(struct output *out, const unsigned char *in,
+                            size_t len, int bits, const char *name)
+{
+    z_stream z;
+    gz_header hdr;
+
+    memset(&z, 0, sizeof (z));
+    assert(deflateInit2(&z, 6, Z_DEFLATED, bits, 8,
+                        Z_DEFAULT_STRATEGY) == Z_OK);
+    if (name != NULL)
+    {
+        memset(&hdr, 0, sizeof (hdr));
+        hdr.name = (Bytef *)name;
+        assert(deflateSetHeader(&z, &hdr) == Z_OK);
+    }
+
+    size_t bound = deflateBound(&z, len);
+
+    z.next_in = (Bytef *)in;
+    z.avail_in = len;
+    z.next_out = out_reserve(out, bound);
+    z.avail_out = bound;
+    assert(deflate(&z, Z_FINISH) == Z_STREAM_END);
+    out->size += bound - z.avail_out;
+    deflateEnd(&z);
+}
+
+static void bgzf_append(struct output *out, const unsigned char *in,
+                        size_t len)
+{
+    unsigned char *p = out_reserve(out, 18 + compressBound(len) + 8);
+    size_t start = out->size;
+
+    memcpy(p, "\x1F\x8B\x08\x04\0\0\0\0\0\xFF\x06\0BC\x02\0", 16);
+    out->size += 18;
+    compress_append(out, in, len, -15, NULL);
+
+    p = out_reserve(out, 8);
+    SetDWLE(p, crc32(0, in, len));
+    SetDWLE(p + 4, len);
+    out->size += 8;
+    SetWLE(out->buf + start + 16, out->size - start - 1);
+}
+
+enum
+{
+    FMT_ZLIB,
+    FMT_GZIP, /* one member */
+    FMT_MULTI, /* members of random sizes, one with a file name */
+    FMT_BGZF,
+    FMT_BGZF_MIXED, /* BGZF then plain gzip members */
+    FMT_MAX,
+};
+
+static const char *const format_names[FMT_MAX] = {
+    "zlib", "gzip", "gzip, members", "BGZF", "BGZF then gzip",
+};
+
+static struct output make_stream(int fmt)
+{
+    struct output out = { NULL, 0, 0 };
+    size_t i = 0;
+
+    switch (fmt)
+    {
+        case FMT_ZLIB:
+            compress_append(&out, data, DATA_SIZE, 15, NULL);
+            break;
+        case FMT_GZIP:
+            compress_append(&out, data, DATA_SIZE, 31, NULL);
+            break;
+        case FMT_MULTI:
+            while (i < DATA_SIZE)
+            {
+                size_t len = 100000 + rand_next() % 3000000;
+
+                if (len > DATA_SIZE - i)
+                    len = DATA_SIZE - i;
+                compress_append(&out, data + i, len, 31,
+                                (i == 0) ? "first.txt" : NULL);
+                i += len;
+            }
+            break;
+        case FMT_BGZF:
+        case FMT_BGZF_MIXED:
+        {
+            const size_t end = (fmt == FMT_BGZF) ? DATA_SIZE : DATA_SIZE / 2;
+
+            for (; i < end; i += BGZF_BLOCK)
+                bgzf_append(&out, data + i,
+                            (end - i < BGZF_BLOCK) ? end - i : BGZF_BLOCK);
+            bgzf_append(&out, NULL, 0); /* end-of-file marker */
+            if (fmt == FMT_BGZF_MIXED)
+            {
+                compress_append(&out, data + end, DATA_SIZE / 4, 31, NULL);
+                compress_append(&out, data + end + DATA_SIZE / 4,
+                                DATA_SIZE - end - DATA_SIZE / 4, 31, NULL);
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+static struct vlc_inflate *open_stream(int fmt, struct source *src,
+                                       size_t spacing, unsigned threads)
+{
+    struct vlc_inflate *inf = vlc_inflate_New(
+        (fmt == FMT_ZLIB) ? VLC_INFLATE_ZLIB : VLC_INFLATE_GZIP,
+        source_read, src, spacing, threads);
+    assert(inf != NULL);
+    return inf;
+}
+
+static void read_check(struct vlc_inflate *inf, uint64_t offset, size_t len)
+{
+    static unsigned char buf[65536];
+    size_t got = 0;
+
+    assert(len <= sizeof (buf));
+
+    while (got < len)
+    {
+        ssize_t val = vlc_inflate_Read(inf, buf + got, len - got);
+
+        assert(val >= 0);
+        if (val == 0)
+            break;
+        got += val;
+    }
+
+    size_t expected = (offset < DATA_SIZE) ? DATA_SIZE - offset : 0;
+    if (expected > len)
+        expected = len;
+    assert(got == expected);
+    assert(!memcmp(buf, data + offset, got));
+}
+
+static void test_sequential(int fmt, struct source *src, unsigned threads)
+{
+    struct vlc_inflate *inf = open_stream(fmt, src, SPACING, threads);
+    uint64_t offset = 0;
+    unsigned char c;
+
+    while (offset < DATA_SIZE)
+    {
+        size_t len = 1 + rand_next() % 65536;
+
+        read_check(inf, offset, len);
+        offset += len;
+        assert(vlc_inflate_Tell(inf) == (offset < DATA_SIZE ? offset
+                                                            : DATA_SIZE));
+    }
+    assert(vlc_inflate_Read(inf, &c, 1) == 0);
+    vlc_inflate_Delete(inf);
+}
+
+static void test_seek(int fmt, struct source *src, unsigned threads)
+{
+    struct vlc_inflate *inf = open_stream(fmt, src, SPACING, threads);
+    unsigned char c;
+
+    /* Seeks ahead of the index first */
+    for (unsigned i = 0; i < SEEKS; i++)
+    {
+        uint64_t offset = rand_next() % (DATA_SIZE + 4096);
+
+        if (i % 16 == 0)
+            offset = (i % 32) ? DATA_SIZE - 100 : 0;
+
+        assert(vlc_inflate_Seek(inf, offset) == 0);
+        assert(vlc_inflate_Tell(inf) == offset);
+        read_check(inf, offset, 1 + rand_next() % 8192);
+    }
+
+    /* Beyond the end */
+    assert(vlc_inflate_Seek(inf, DATA_SIZE + 1000) == 0);
+    assert(vlc_inflate_Read(inf, &c, 1) == 0);
+    assert(vlc_inflate_Seek(inf, 1000) == 0);
+    read_check(inf, 1000, 100);
+
+    struct vlc_inflate_stats stats;
+    vlc_inflate_GetStats(inf, &stats);
+    assert(stats.points >= DATA_SIZE / SPACING / 2);
+    vlc_inflate_Delete(inf);
+}
+
+static void test_corrupt(int fmt, struct output *out)
+{
+    static unsigned char buf[65536];
+    struct source src = { out->buf, out->size };
+    ssize_t val;
+
+    /* Truncated */
+    src.size = out->size / 2;
+
+    struct vlc_inflate *inf = open_stream(fmt, &src, SPACING, 2);
+
+    while ((val = vlc_inflate_Read(inf, buf, sizeof (buf))) > 0);
+    assert(val < 0);
+    /* Data before the error can still be read */
+    assert(vlc_inflate_Seek(inf, 10) == 0);
+    read_check(inf, 10, 100);
+    vlc_inflate_Delete(inf);
+
+    /* Corrupt */
+    unsigned char *copy = malloc(out->size);
+    assert(copy != NULL);
+    memcpy(copy, out->buf, out->size);
+    for (size_t i = out->size / 2; i < out->size / 2 + 64; i++)
+        copy[i] ^= 0x55;
+    src.buf = copy;
+    src.size = out->size;
+
+    inf = open_stream(fmt, &src, SPACING, 2);
+    while ((val = vlc_inflate_Read(inf, buf, sizeof (buf))) > 0);
+    assert(val < 0);
+    vlc_inflate_Delete(inf);
+    free(copy);
+}
+
+static void bench_read(int fmt, struct source *src, unsigned threads)
+{
+    static unsigned char buf[65536];
+    struct vlc_inflate *inf = open_stream(fmt, src, SPACING, threads);
+    vlc_tick_t start = vlc_tick_now();
+    uint64_t total = 0;
+    ssize_t val;
+
+    while ((val = vlc_inflate_Read(inf, buf, sizeof (buf))) > 0)
+        total += val;
+    assert(total == DATA_SIZE);
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    printf("%-16s %2u threads: %5"PRId64" MB/s\n", format_names[fmt],
+           threads, (int64_t)(total / US_FROM_VLC_TICK(elapsed)));
+    vlc_inflate_Delete(inf);
+}
+
+static void bench_seek(int fmt, struct source *src, size_t spacing,
+                       unsigned threads)
+{
+    static unsigned char buf[4096];
+    struct vlc_inflate *inf = open_stream(fmt, src, spacing, threads);
+
+    /* First pass, building the index */
+    vlc_tick_t start = vlc_tick_now();
+    assert(vlc_inflate_Seek(inf, DATA_SIZE) == 0);
+    vlc_tick_t first = vlc_tick_now() - start;
+
+    struct vlc_inflate_stats stats;
+    vlc_inflate_GetStats(inf, &stats);
+    uint64_t skipped = stats.skipped;
+    const unsigned seeks = (spacing > 0) ? SEEKS : SEEKS / 10;
+
+    start = vlc_tick_now();
+    for (unsigned i = 0; i < seeks; i++)
+    {
+        uint64_t offset = rand_next() % (DATA_SIZE - sizeof (buf));
+
+        assert(vlc_inflate_Seek(inf, offset) == 0);
+        assert(vlc_inflate_Read(inf, buf, sizeof (buf)) > 0);
+    }
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+
+    vlc_inflate_GetStats(inf, &stats);
+    skipped = (stats.skipped - skipped) / seeks;
+    printf("%-16s %-8s %u threads: first pass %4"PRId64" ms, %3u points, "
+           "seek %6"PRId64" us, %7"PRIu64" bytes skipped\n",
+           format_names[fmt], spacing ? "index" : "no index", threads,
+           MS_FROM_VLC_TICK(first), stats.points,
+           US_FROM_VLC_TICK(elapsed / seeks), skipped);
+
+    /* Resuming from an access point skips less than two spacings */
+    if (spacing > 0)
+        assert(skipped < 2 * spacing);
+    vlc_inflate_Delete(inf);
+}
+
+int main(void)
+{
+    struct output streams[FMT_MAX];
+
+    make_data();
+    for (int fmt = 0; fmt < FMT_MAX; fmt++)
+        streams[fmt] = make_stream(fmt);
+
+    for (int fmt = 0; fmt < FMT_MAX; fmt++)
+    {
+        struct source src = { streams[fmt].buf, streams[fmt].size };
+
+        test_sequential(fmt, &src, 0);
+        test_sequential(fmt, &src, 3);
+        test_seek(fmt, &src, 0);
+        test_seek(fmt, &src, 3);
+        test_corrupt(fmt, &streams[fmt]);
+    }
+
+    for (int fmt = 0; fmt < FMT_MAX; fmt++)
+    {
+        struct source src = { streams[fmt].buf, streams[fmt].size };
+
+        bench_read(fmt, &src, 0);
+        if (fmt == FMT_BGZF)
+            for (unsigned threads = 1; threads <= 4; threads *= 2)
+                bench_read(fmt, &src, threads);
+    }
+
+    for (int fmt = FMT_GZIP; fmt <= FMT_BGZF; fmt++)
+    {
+        struct source src = { streams[fmt].buf, streams[fmt].size };
+
+        bench_seek(fmt, &src, 0, 0);
+        bench_seek(fmt, &src, SPACING, 0);
+        if (fmt == FMT_BGZF)
+            bench_seek(fmt, &src, 0, 4);
+    }
+
+    for (int fmt = 0; fmt < FMT_MAX; fmt++)
+        free(streams[fmt].buf);
+    free(data);
+    return 0;
+}
@@ -279,6 +279,7 @@ static int   MuxSend( sout_stream_t *, void *, block_t * );
 
 static sout_access_out_t *GrabberCreate( sout_stream_t *p_sout );
 static void* ThreadSend( void * );
+static void rtp_batch_queue( sout_stream_id_sys_t * );
 static void *rtp_listen_thread( void * );
 
 static void SDPHandleUrl( sout_stream_t *, const char * );
@@ -344,8 +345,37 @@ typedef struct rtp_sink_t
 {
     int rtp_fd;
     rtcp_sender_t *rtcp;
+
+    /* statistics */
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t calls; /* send system calls */
+    uint64_t dropped;
 } rtp_sink_t;
 
+/* Batched packetization: several RTP packets are written into a single
+ * arena block, one MTU-sized slot per packet, and sent together. */
+#define RTP_BATCH_FLAG    (1 << BLOCK_FLAG_PRIVATE_SHIFT)
+#define RTP_BATCH_MIN     8
+#define RTP_BATCH_MAX     64
+#define RTP_TRAILER_SIZE  10 /* room for the SRTP authentication tag */
+
+typedef struct
+{
+    uint8_t   *p_buffer;
+    size_t     i_buffer;
+    vlc_tick_t i_dts;
+} rtp_packet_t;
+
+typedef struct rtp_batch_t
+{
+    block_t      self;
+    unsigned     count;
+    unsigned     max;
+    size_t       slot;
+    rtp_packet_t packets[];
+} rtp_batch_t;
+
 struct sout_stream_id_sys_t
 {
     sout_stream_t *p_stream;
@@ -356,6 +386,7 @@ struct sout_stream_id_sys_t
     bool        b_ts_init;
     uint32_t    i_ts_offset;
     uint8_t     ssrc[4];
+    uint8_t     header[12]; /* RTP header template */
 
     /* for rtsp */
     uint16_t    i_seq_sent_next;
@@ -383,6 +414,12 @@ struct sout_stream_id_sys_t
 
     block_fifo_t     *p_fifo;
     vlc_tick_t        i_caching;
+
+    /* Batched packetization */
+    rtp_batch_t      *batch;
+    unsigned          batch_hint;
+    uint64_t          packets;
+    uint64_t          batches;
 };
 
 /*****************************************************************************
@@ -975,6 +1012,9 @@ static void *Add( sout_stream_t *p_stream, const es_format_t *p_fmt )
     id->rtsp_id = NULL;
     id->p_fifo = NULL;
     id->listen.fd = NULL;
+    id->batch = NULL;
+    id->batch_hint = 0;
+    id->packets = id->batches = 0;
 
     id->b_first_packet = true;
     id->i_caching =
@@ -1179,6 +1219,10 @@ static void *Add( sout_stream_t *p_stream, const es_format_t *p_fmt )
         id->rtsp_id = RtspAddId( p_sys->rtsp, id, GetDWBE( id->ssrc ),
                                  id->rtp_fmt.clock_rate, mcast_fd );
 
+    id->header[0] = 0x80;
+    id->header[1] = id->rtp_fmt.payload_type;
+    memcpy( id->header + 8, id->ssrc, 4 );
+
     id->p_fifo = block_FifoNew();
     if( unlikely(id->p_fifo == NULL) )
         goto error;
@@ -1229,6 +1273,11 @@ static void Del( sout_stream_t *p_stream, void *_id )
         vlc_join( id->thread, NULL );
         block_FifoRelease( id->p_fifo );
     }
+    if( id->batch != NULL )
+        block_Release( &id->batch->self );
+    if( id->packets > 0 )
+        msg_Dbg( p_stream, "%"PRIu64" RTP packets in %"PRIu64" batches",
+                 id->packets, id->batches );
 
     free( id->rtp_fmt.fmtp );
 
@@ -1286,6 +1335,8 @@ static int Send( sout_stream_t *p_stream, void *_id, block_t *p_buffer )
 
         p_buffer = p_next;
     }
+    rtp_batch_queue( id );
+    id->batch_hint = 0;
     return VLC_SUCCESS;
 }
 
@@ -1389,90 +1440,189 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
 /****************************************************************************
  * RTP send
  ****************************************************************************/
-static void* ThreadSend( void *data )
-{
 #ifdef _WIN32
 # define ENOBUFS      WSAENOBUFS
 # define EAGAIN       WSAEWOULDBLOCK
 # define EWOULDBLOCK  WSAEWOULDBLOCK
 #endif
-    sout_stream_id_sys_t *id = data;
-    vlc_tick_t i_caching = id->i_caching;
 
-    for (;;)
+/* Checks a failed send: returns -1 if the sink is broken, 1 if the packet
+ * should be sent again and 0 if it should be dropped. */
+static int rtp_send_error( int fd )
+{
+    if( net_errno == EAGAIN || net_errno == EWOULDBLOCK
+     || net_errno == ENOBUFS || net_errno == ENOMEM )
+        return 0;
+
+    int type;
+    getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &(socklen_t){ sizeof(type) });
+    /* ICMP soft error: ignore and retry, otherwise broken connection */
+    return (type == SOCK_DGRAM) ? 1 : -1;
+}
+
+/** Sends packets to one sink, with as few system calls as possible.
+ * @return false if the connection is broken */
+static bool rtp_sink_send( rtp_sink_t *sink, struct iovec *iov, unsigned n )
+{
+    bool retried = false;
+
+    for( unsigned i = 0; i < n; )
     {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
+        int val;
+#ifdef HAVE_SENDMMSG
+        if( n - i > 1 )
+        {
+            struct mmsghdr msgv[RTP_BATCH_MAX];
+            unsigned c = __MIN( n - i, RTP_BATCH_MAX );
 
-#ifdef HAVE_SRTP
-        if( id->srtp )
-        {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
+            memset( msgv, 0, c * sizeof (*msgv) );
+            for( unsigned j = 0; j < c; j++ )
+            {
+                msgv[j].msg_hdr.msg_iov = &iov[i + j];
+                msgv[j].msg_hdr.msg_iovlen = 1;
+            }
+            val = sendmmsg( sink->rtp_fd, msgv, c, 0 );
+        }
+        else
+#endif
+            val = send( sink->rtp_fd, iov[i].iov_base, iov[i].iov_len, 0 )
+                  != -1 ? 1 : -1;
+        sink->calls++;
 
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
+        if( val == -1 )
+        {
+            int ret = rtp_send_error( sink->rtp_fd );
+            if( ret < 0 )
+                return false;
+            if( ret > 0 && !retried )
+            {
+                retried = true;
+                continue;
+            }
+            sink->dropped++;
+            i++;
+            retried = false;
+            continue;
+        }
+
+        for( int j = 0; j < val; j++ )
+            sink->bytes += iov[i + j].iov_len;
+        sink->packets += val;
+        i += val;
+        retried = false;
+    }
+    return true;
+}
+
+/* Sends packets to all the sinks of the ES. Cancellation must be disabled. */
+static void rtp_send_packets( sout_stream_id_sys_t *id, rtp_packet_t *pkts,
+                              unsigned n )
+{
+    struct iovec iov[n];
+    unsigned c = 0;
+
+#ifdef HAVE_SRTP
+    if( id->srtp )
+    {
+        srtp_packet_t srtpv[n];
+
+        for( unsigned i = 0; i < n; i++ )
+            srtpv[i] = (srtp_packet_t){ pkts[i].p_buffer, pkts[i].i_buffer,
+                                        pkts[i].i_buffer + RTP_TRAILER_SIZE,
+                                        0 };
+        srtp_send_batch( id->srtp, srtpv, n );
+        for( unsigned i = 0; i < n; i++ )
+        {
+            if( srtpv[i].error )
             {
                 msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
+                         vlc_strerror_c(srtpv[i].error) );
+                srtpv[i].len = 0;
             }
-            else
-                out->i_buffer = len;
+            pkts[i].i_buffer = srtpv[i].len;
         }
-        if (out)
-            vlc_tick_wait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
-#else
-        vlc_tick_wait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
+    }
 #endif
 
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
+    for( unsigned i = 0; i < n; i++ )
+    {
+        if( pkts[i].i_buffer == 0 )
+            continue; /* SRTP error */
+        iov[c].iov_base = pkts[i].p_buffer;
+        iov[c].iov_len = pkts[i].i_buffer;
+        c++;
+    }
+    if( c == 0 )
+        return;
 
-        vlc_mutex_lock( &id->lock_sink );
-        unsigned deadc = 0; /* How many dead sockets? */
-        int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
+    vlc_mutex_lock( &id->lock_sink );
+    unsigned deadc = 0; /* How many dead sockets? */
+    int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
 
-        for( int i = 0; i < id->sinkc; i++ )
-        {
+    for( int i = 0; i < id->sinkc; i++ )
+    {
 #ifdef HAVE_SRTP
-            if( !id->srtp ) /* FIXME: SRTCP support */
+        if( !id->srtp ) /* FIXME: SRTCP support */
 #endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+            for( unsigned j = 0; j < c; j++ )
+                SendRTCP( id->sinkv[i].rtcp, iov[j].iov_base, iov[j].iov_len );
+
+        if( !rtp_sink_send( &id->sinkv[i], iov, c ) )
+            deadv[deadc++] = id->sinkv[i].rtp_fd;
+    }
+    id->i_seq_sent_next = GetWBE( (uint8_t *)iov[c - 1].iov_base + 2 ) + 1;
+    vlc_mutex_unlock( &id->lock_sink );
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
+    for( unsigned i = 0; i < deadc; i++ )
+    {
+        msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
+        rtp_del_sink( id, deadv[i] );
+    }
+}
+
+static void* ThreadSend( void *data )
+{
+    sout_stream_id_sys_t *id = data;
+    vlc_tick_t i_caching = id->i_caching;
+
+    for (;;)
+    {
+        block_t *out = block_FifoGet( id->p_fifo );
+        block_cleanup_push (out);
+
+        if( out->i_flags & RTP_BATCH_FLAG )
+        {
+            rtp_batch_t *batch = container_of( out, rtp_batch_t, self );
+
+            for( unsigned i = 0; i < batch->count; )
             {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
+                vlc_tick_wait( batch->packets[i].i_dts + i_caching );
+
+                /* Send the packets that are already due together */
+                vlc_tick_t now = vlc_tick_now();
+                unsigned n = 1;
+                while( i + n < batch->count
+                    && batch->packets[i + n].i_dts + i_caching <= now )
+                    n++;
+
+                int canc = vlc_savecancel ();
+                rtp_send_packets( id, batch->packets + i, n );
+                vlc_restorecancel (canc);
+                i += n;
             }
         }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
-        vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
-
-        for( unsigned i = 0; i < deadc; i++ )
+        else
         {
-            msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
-            rtp_del_sink( id, deadv[i] );
+            rtp_packet_t pkt = { out->p_buffer, out->i_buffer, out->i_dts };
+
+            vlc_tick_wait (out->i_dts + i_caching);
+
+            int canc = vlc_savecancel ();
+            rtp_send_packets( id, &pkt, 1 );
+            vlc_restorecancel (canc);
         }
-        vlc_restorecancel (canc);
+        vlc_cleanup_pop ();
+        block_Release( out );
     }
     return NULL;
 }
@@ -1532,6 +1682,10 @@ void rtp_del_sink( sout_stream_id_sys_t *id, int fd )
     }
     vlc_mutex_unlock( &id->lock_sink );
 
+    if( sink.calls > 0 )
+        msg_Dbg( id->p_stream, "socket %d: %"PRIu64" packets, %"PRIu64" bytes, "
+                 "%"PRIu64" send calls, %"PRIu64" dropped", fd, sink.packets,
+                 sink.bytes, sink.calls, sink.dropped );
     CloseRTCP( sink.rtcp );
     net_Close( sink.rtp_fd );
 }
@@ -1608,8 +1762,8 @@ vlc_tick_t rtp_get_ts( const sout_stream_t *p_stream, const sout_stream_id_sys_t
     return p_sys->i_pts_zero + npt;
 }
 
-void rtp_packetize_common( sout_stream_id_sys_t *id, block_t *out,
-                           bool b_m_bit, vlc_tick_t i_pts )
+static void rtp_write_header( sout_stream_id_sys_t *id, uint8_t *p,
+                              bool b_m_bit, vlc_tick_t i_pts )
 {
     if( !id->b_ts_init )
     {
@@ -1635,20 +1789,21 @@ void rtp_packetize_common( sout_stream_id_sys_t *id, block_t *out,
     uint32_t i_timestamp = rtp_compute_ts( id->rtp_fmt.clock_rate, i_pts )
                            + id->i_ts_offset;
 
-    out->p_buffer[0] = 0x80;
-    out->p_buffer[1] = (b_m_bit?0x80:0x00)|id->rtp_fmt.payload_type;
-    out->p_buffer[2] = ( id->i_sequence >> 8)&0xff;
-    out->p_buffer[3] = ( id->i_sequence     )&0xff;
-    out->p_buffer[4] = ( i_timestamp >> 24 )&0xff;
-    out->p_buffer[5] = ( i_timestamp >> 16 )&0xff;
-    out->p_buffer[6] = ( i_timestamp >>  8 )&0xff;
-    out->p_buffer[7] = ( i_timestamp       )&0xff;
-
-    memcpy( out->p_buffer + 8, id->ssrc, 4 );
+    memcpy( p, id->header, 12 );
+    if( b_m_bit )
+        p[1] |= 0x80;
+    SetWBE( p + 2, id->i_sequence );
+    SetDWBE( p + 4, i_timestamp );
 
     id->i_sequence++;
 }
 
+void rtp_packetize_common( sout_stream_id_sys_t *id, block_t *out,
+                           bool b_m_bit, vlc_tick_t i_pts )
+{
+    rtp_write_header( id, out->p_buffer, b_m_bit, i_pts );
+}
+
 uint16_t rtp_get_extended_sequence( sout_stream_id_sys_t *id )
 {
     return id->i_sequence >> 16;
@@ -1656,9 +1811,107 @@ uint16_t rtp_get_extended_sequence( sout_stream_id_sys_t *id )
 
 void rtp_packetize_send( sout_stream_id_sys_t *id, block_t *out )
 {
+    rtp_batch_queue( id ); /* keep packets in sequence */
+#ifdef HAVE_SRTP
+    if( id->srtp )
+    {
+        size_t len = out->i_buffer;
+        out = block_Realloc( out, 0, len + RTP_TRAILER_SIZE );
+        if( unlikely(out == NULL) )
+            return;
+        out->i_buffer = len;
+    }
+#endif
     block_FifoPut( id->p_fifo, out );
 }
 
+static void rtp_batch_Release( block_t *block )
+{
+    free( container_of( block, rtp_batch_t, self ) );
+}
+
+static const struct vlc_block_callbacks rtp_batch_cbs =
+{
+    rtp_batch_Release,
+};
+
+static void rtp_batch_queue( sout_stream_id_sys_t *id )
+{
+    rtp_batch_t *batch = id->batch;
+
+    if( batch == NULL )
+        return;
+    id->batch = NULL;
+    id->packets += batch->count;
+    id->batches++;
+    block_FifoPut( id->p_fifo, &batch->self );
+}
+
+/**
+ * Announces how many packets the next rtp_batch_packet() calls will
+ * produce, so that they fit in as few arenas as possible.
+ */
+void rtp_batch_reserve( sout_stream_id_sys_t *id, unsigned count )
+{
+    id->batch_hint = count;
+}
+
+/**
+ * Appends a packet to the current batch, and fills its RTP header from the
+ * ES template. Batches are queued for sending when full, and at the latest
+ * once the input block has been packetized.
+ * @param i_payload payload size, at most rtp_mtu()
+ * @return a pointer to the payload of the packet, or NULL on error
+ */
+uint8_t *rtp_batch_packet( sout_stream_id_sys_t *id, size_t i_payload,
+                           bool b_m_bit, vlc_tick_t i_pts, vlc_tick_t i_dts )
+{
+    rtp_batch_t *batch = id->batch;
+
+    assert( i_payload <= rtp_mtu( id ) );
+
+    if( batch != NULL && batch->count == batch->max )
+    {
+        rtp_batch_queue( id );
+        batch = NULL;
+    }
+
+    if( batch == NULL )
+    {
+        unsigned max = id->batch_hint ? id->batch_hint : RTP_BATCH_MIN;
+        size_t slot = id->i_mtu + RTP_TRAILER_SIZE;
+
+        if( max > RTP_BATCH_MAX )
+            max = RTP_BATCH_MAX;
+        batch = malloc( sizeof (*batch)
+                        + max * (sizeof (batch->packets[0]) + slot) );
+        if( unlikely(batch == NULL) )
+            return NULL;
+
+        block_Init( &batch->self, &rtp_batch_cbs, batch->packets + max,
+                    max * slot );
+        batch->self.i_flags = RTP_BATCH_FLAG;
+        batch->self.i_buffer = 0;
+        batch->count = 0;
+        batch->max = max;
+        batch->slot = slot;
+        id->batch = batch;
+    }
+    if( id->batch_hint > 0 )
+        id->batch_hint--;
+
+    rtp_packet_t *pkt = &batch->packets[batch->count];
+    pkt->p_buffer = batch->self.p_start + batch->count * batch->slot;
+    pkt->i_buffer = 12 + i_payload;
+    pkt->i_dts = i_dts;
+    if( batch->count++ == 0 )
+        batch->self.i_dts = i_dts;
+    batch->self.i_buffer += pkt->i_buffer;
+
+    rtp_write_header( id, pkt->p_buffer, b_m_bit, i_pts );
+    return pkt->p_buffer + 12;
+}
+
 /**
  * @return configured max RTP payload size (including payload type-specific
  * headers, excluding RTP and transport headers)
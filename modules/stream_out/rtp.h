@@ -60,6 +60,11 @@ void rtp_packetize_common (sout_stream_id_sys_t *id, block_t *out,
 void rtp_packetize_send (sout_stream_id_sys_t *id, block_t *out);
 size_t rtp_mtu (const sout_stream_id_sys_t *id);
 
+/* Batched RTP packetization */
+void rtp_batch_reserve (sout_stream_id_sys_t *id, unsigned count);
+uint8_t *rtp_batch_packet (sout_stream_id_sys_t *id, size_t i_payload,
+                           bool b_m_bit, vlc_tick_t i_pts, vlc_tick_t i_dts);
+
 int rtp_packetize_xiph_config( sout_stream_id_sys_t *id, const char *fmtp,
                                vlc_tick_t i_pts );
 
@@ -68,7 +73,7 @@ typedef struct rtcp_sender_t rtcp_sender_t;
 rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
                          bool mux);
 void CloseRTCP (rtcp_sender_t *rtcp);
-void SendRTCP (rtcp_sender_t *restrict rtcp, const block_t *rtp);
+void SendRTCP (rtcp_sender_t *restrict rtcp, const uint8_t *rtp, size_t len);
 
 typedef int (*pf_rtp_packetizer_t)( sout_stream_id_sys_t *, block_t * );
 
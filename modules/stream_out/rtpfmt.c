@@ -825,23 +825,20 @@ static int rtp_packetize_mpa( sout_stream_id_sys_t *id, block_t *in )
     int     i_data  = in->i_buffer;
     int     i;
 
+    rtp_batch_reserve( id, i_count );
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
+        uint8_t *out = rtp_batch_packet( id, 4 + i_payload, i == i_count - 1,
+                                in->i_pts, in->i_dts + i * in->i_length / i_count );
+        if( unlikely(out == NULL) )
+            break;
 
-        /* rtp common header */
-        rtp_packetize_common( id, out, (i == i_count - 1)?1:0, in->i_pts );
         /* mbz set to 0 */
-        SetWBE( out->p_buffer + 12, 0 );
+        SetWBE( out, 0 );
         /* fragment offset in the current frame */
-        SetWBE( out->p_buffer + 14, i * i_max );
-        memcpy( &out->p_buffer[16], p_data, i_payload );
-
-        out->i_dts    = in->i_dts + i * in->i_length / i_count;
-        out->i_length = in->i_length / i_count;
-
-        rtp_packetize_send( id, out );
+        SetWBE( out + 2, i * i_max );
+        memcpy( &out[4], p_data, i_payload );
 
         p_data += i_payload;
         i_data -= i_payload;
@@ -903,10 +900,10 @@ static int rtp_packetize_mpv( sout_stream_id_sys_t *id, block_t *in )
         }
     }
 
+    rtp_batch_reserve( id, i_count );
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
         /* MBZ:5 T:1 TR:10 AN:1 N:1 S:1 B:1 E:1 P:3 FBV:1 BFC:3 FFV:1 FFC:3 */
         uint32_t      h = ( i_temporal_ref << 16 )|
                           ( b_sequence_start << 13 )|
@@ -915,18 +912,15 @@ static int rtp_packetize_mpv( sout_stream_id_sys_t *id, block_t *in )
                           ( i_picture_coding_type << 8 )|
                           ( i_fbv << 7 )|( i_bfc << 4 )|( i_ffv << 3 )|i_ffc;
 
-        /* rtp common header */
-        rtp_packetize_common( id, out, (i == i_count - 1)?1:0,
-                          in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts );
-
-        SetDWBE( out->p_buffer + 12, h );
-
-        memcpy( &out->p_buffer[16], p_data, i_payload );
+        uint8_t *out = rtp_batch_packet( id, 4 + i_payload, i == i_count - 1,
+                          in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts,
+                          in->i_dts + i * in->i_length / i_count );
+        if( unlikely(out == NULL) )
+            break;
 
-        out->i_dts    = in->i_dts + i * in->i_length / i_count;
-        out->i_length = in->i_length / i_count;
+        SetDWBE( out, h );
 
-        rtp_packetize_send( id, out );
+        memcpy( &out[4], p_data, i_payload );
 
         p_data += i_payload;
         i_data -= i_payload;
@@ -945,24 +939,21 @@ static int rtp_packetize_ac3( sout_stream_id_sys_t *id, block_t *in )
     int     i_data  = in->i_buffer;
     int     i;
 
+    rtp_batch_reserve( id, i_count );
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 14 + i_payload );
+        uint8_t *out = rtp_batch_packet( id, 2 + i_payload, i == i_count - 1,
+                                in->i_pts, in->i_dts + i * in->i_length / i_count );
+        if( unlikely(out == NULL) )
+            break;
 
-        /* rtp common header */
-        rtp_packetize_common( id, out, (i == i_count - 1)?1:0, in->i_pts );
         /* unit count */
-        out->p_buffer[12] = 1;
+        out[0] = 1;
         /* unit header */
-        out->p_buffer[13] = 0x00;
+        out[1] = 0x00;
         /* data */
-        memcpy( &out->p_buffer[14], p_data, i_payload );
-
-        out->i_dts    = in->i_dts + i * in->i_length / i_count;
-        out->i_length = in->i_length / i_count;
-
-        rtp_packetize_send( id, out );
+        memcpy( &out[2], p_data, i_payload );
 
         p_data += i_payload;
         i_data -= i_payload;
@@ -994,20 +985,17 @@ static int rtp_packetize_split( sout_stream_id_sys_t *id, block_t *in )
     int     i_data  = in->i_buffer;
     int     i;
 
+    rtp_batch_reserve( id, i_count );
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 12 + i_payload );
-
-        /* rtp common header */
-        rtp_packetize_common( id, out, (i == i_count - 1),
-                      (in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts) );
-        memcpy( &out->p_buffer[12], p_data, i_payload );
-
-        out->i_dts    = in->i_dts + i * in->i_length / i_count;
-        out->i_length = in->i_length / i_count;
+        uint8_t *out = rtp_batch_packet( id, i_payload, i == i_count - 1,
+                      (in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts),
+                      in->i_dts + i * in->i_length / i_count );
+        if( unlikely(out == NULL) )
+            break;
 
-        rtp_packetize_send( id, out );
+        memcpy( out, p_data, i_payload );
 
         p_data += i_payload;
         i_data -= i_payload;
@@ -1142,27 +1130,24 @@ static int rtp_packetize_mp4a( sout_stream_id_sys_t *id, block_t *in )
     int     i_data  = in->i_buffer;
     int     i;
 
+    rtp_batch_reserve( id, i_count );
     for( i = 0; i < i_count; i++ )
     {
         int           i_payload = __MIN( i_max, i_data );
-        block_t *out = block_Alloc( 16 + i_payload );
+        uint8_t *out = rtp_batch_packet( id, 4 + i_payload, i == i_count - 1,
+                      (in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts),
+                      in->i_dts + i * in->i_length / i_count );
+        if( unlikely(out == NULL) )
+            break;
 
-        /* rtp common header */
-        rtp_packetize_common( id, out, ((i == i_count - 1)?1:0),
-                      (in->i_pts != VLC_TICK_INVALID ? in->i_pts : in->i_dts) );
         /* AU headers */
         /* AU headers length (bits) */
-        out->p_buffer[12] = 0;
-        out->p_buffer[13] = 2*8;
+        out[0] = 0;
+        out[1] = 2*8;
         /* for each AU length 13 bits + idx 3bits, */
-        SetWBE( out->p_buffer + 14, (in->i_buffer << 3) | 0 );
-
-        memcpy( &out->p_buffer[16], p_data, i_payload );
-
-        out->i_dts    = in->i_dts + i * in->i_length / i_count;
-        out->i_length = in->i_length / i_count;
+        SetWBE( out + 2, (in->i_buffer << 3) | 0 );
 
-        rtp_packetize_send( id, out );
+        memcpy( &out[4], p_data, i_payload );
 
         p_data += i_payload;
         i_data -= i_payload;
@@ -1256,16 +1241,11 @@ rtp_packetize_h264_nal( sout_stream_id_sys_t *id,
     if( i_data <= i_max )
     {
         /* Single NAL unit packet */
-        block_t *out = block_Alloc( 12 + i_data );
-        out->i_dts    = i_dts;
-        out->i_length = i_length;
-
-        /* */
-        rtp_packetize_common( id, out, b_last, i_pts );
-
-        memcpy( &out->p_buffer[12], p_data, i_data );
+        uint8_t *out = rtp_batch_packet( id, i_data, b_last, i_pts, i_dts );
+        if( unlikely(out == NULL) )
+            return VLC_ENOMEM;
 
-        rtp_packetize_send( id, out );
+        memcpy( out, p_data, i_data );
     }
     else
     {
@@ -1276,23 +1256,22 @@ rtp_packetize_h264_nal( sout_stream_id_sys_t *id,
         p_data++;
         i_data--;
 
+        rtp_batch_reserve( id, i_count );
         for( i = 0; i < i_count; i++ )
         {
             const int i_payload = __MIN( i_data, i_max-2 );
-            block_t *out = block_Alloc( 12 + 2 + i_payload );
-            out->i_dts    = i_dts + i * i_length / i_count;
-            out->i_length = i_length / i_count;
+            uint8_t *out = rtp_batch_packet( id, 2 + i_payload,
+                                             b_last && i_payload == i_data,
+                                             i_pts,
+                                             i_dts + i * i_length / i_count );
+            if( unlikely(out == NULL) )
+                return VLC_ENOMEM;
 
-            /* */
-            rtp_packetize_common( id, out, (b_last && i_payload == i_data),
-                                    i_pts );
             /* FU indicator */
-            out->p_buffer[12] = 0x00 | (i_nal_hdr & 0x60) | 28;
+            out[0] = 0x00 | (i_nal_hdr & 0x60) | 28;
             /* FU header */
-            out->p_buffer[13] = ( i == 0 ? 0x80 : 0x00 ) | ( (i == i_count-1) ? 0x40 : 0x00 )  | i_nal_type;
-            memcpy( &out->p_buffer[14], p_data, i_payload );
-
-            rtp_packetize_send( id, out );
+            out[1] = ( i == 0 ? 0x80 : 0x00 ) | ( (i == i_count-1) ? 0x40 : 0x00 )  | i_nal_type;
+            memcpy( &out[2], p_data, i_payload );
 
             i_data -= i_payload;
             p_data += i_payload;
@@ -1335,16 +1314,11 @@ rtp_packetize_h265_nal( sout_stream_id_sys_t *id,
     if( i_data <= i_max )
     {
         /* Single NAL unit packet */
-        block_t *out = block_Alloc( 12 + i_data );
-        out->i_dts    = i_dts;
-        out->i_length = i_length;
-
-        /* */
-        rtp_packetize_common( id, out, b_last, i_pts );
-
-        memcpy( &out->p_buffer[12], p_data, i_data );
+        uint8_t *out = rtp_batch_packet( id, i_data, b_last, i_pts, i_dts );
+        if( unlikely(out == NULL) )
+            return VLC_ENOMEM;
 
-        rtp_packetize_send( id, out );
+        memcpy( out, p_data, i_data );
     }
     else
     {
@@ -1357,24 +1331,23 @@ rtp_packetize_h265_nal( sout_stream_id_sys_t *id,
         p_data += 2;
         i_data -= 2;
 
+        rtp_batch_reserve( id, i_count );
         for( size_t i = 0; i < i_count; i++ )
         {
             const size_t i_payload = __MIN( i_data, i_max-3 );
-            block_t *out = block_Alloc( 12 + 3 + i_payload );
-            out->i_dts    = i_dts + i * i_length / i_count;
-            out->i_length = i_length / i_count;
+            uint8_t *out = rtp_batch_packet( id, 3 + i_payload,
+                                             b_last && i_payload == i_data,
+                                             i_pts,
+                                             i_dts + i * i_length / i_count );
+            if( unlikely(out == NULL) )
+                return VLC_ENOMEM;
 
-            /* */
-            rtp_packetize_common( id, out, (b_last && i_payload == i_data),
-                                    i_pts );
             /* FU indicator */
-            out->p_buffer[12] = i_nal_hdr >> 8;
-            out->p_buffer[13] = i_nal_hdr & 0x00FF;
+            out[0] = i_nal_hdr >> 8;
+            out[1] = i_nal_hdr & 0x00FF;
             /* FU header */
-            out->p_buffer[14] = ( i == 0 ? 0x80 : 0x00 ) | ( (i == i_count-1) ? 0x40 : 0x00 )  | i_nal_type;
-            memcpy( &out->p_buffer[15], p_data, i_payload );
-
-            rtp_packetize_send( id, out );
+            out[2] = ( i == 0 ? 0x80 : 0x00 ) | ( (i == i_count-1) ? 0x40 : 0x00 )  | i_nal_type;
+            memcpy( &out[3], p_data, i_payload );
 
             i_data -= i_payload;
             p_data += i_payload;
@@ -47,10 +47,36 @@ DBMSDIOutput::DBMSDIOutput(sout_stream_t *p_stream) :
     offset = 0;
     lasttimestamp = 0;
     b_running = false;
+    videoStart = videoConverted = videoCount = 0;
+    vlc_mutex_init(&videoLock);
+    vlc_cond_init(&videoWait);
+    b_videoThread = false;
+    b_videoStop = false;
 }
 
 DBMSDIOutput::~DBMSDIOutput()
 {
+    if(b_videoThread)
+    {
+        vlc_mutex_lock(&videoLock);
+        b_videoStop = true;
+        vlc_cond_broadcast(&videoWait);
+        vlc_mutex_unlock(&videoLock);
+        vlc_join(videoThread, NULL);
+    }
+    for(unsigned i = 0; i < videoCount; i++)
+    {
+        VideoFrame *f = &videoRing[(videoStart + i) % VIDEO_RING_SIZE];
+        if(f->frame)
+            f->frame->Release();
+        if(f->picture)
+            picture_Release(f->picture);
+        if(f->p_cc)
+            block_Release(f->p_cc);
+    }
+    vlc_cond_destroy(&videoWait);
+    vlc_mutex_destroy(&videoLock);
+
     if(video.pic_nosignal)
         picture_Release(video.pic_nosignal);
     es_format_Clean(&video.configuredfmt);
@@ -505,16 +531,20 @@ error:
 int DBMSDIOutput::Start()
 {
     HRESULT result;
-    if(FAKE_DRIVER && !b_running)
-    {
-        b_running = true;
-        return VLC_SUCCESS;
-    }
     if(b_running)
         return VLC_EGENERIC;
-    result = p_output->StartScheduledPlayback(
-                     samples_from_vlc_tick(vlc_tick_now(), timescale), timescale, 1.0);
-    CHECK("Could not start playback");
+    if(!FAKE_DRIVER)
+    {
+        result = p_output->StartScheduledPlayback(
+                         samples_from_vlc_tick(vlc_tick_now(), timescale), timescale, 1.0);
+        CHECK("Could not start playback");
+    }
+    if(vlc_clone(&videoThread, VideoThread, this, VLC_THREAD_PRIORITY_OUTPUT))
+    {
+        msg_Err(p_stream, "Could not start video thread");
+        goto error;
+    }
+    b_videoThread = true;
     b_running = true;
     return VLC_SUCCESS;
 
@@ -575,7 +605,7 @@ int DBMSDIOutput::ProcessAudio(block_t *p_block)
         return VLC_EGENERIC;
     }
 
-    p_block->i_pts -= offset;
+    p_block->i_pts -= offset.load();
 
     uint32_t sampleFrameCount = p_block->i_nb_samples;
     uint32_t written;
@@ -586,7 +616,7 @@ int DBMSDIOutput::ProcessAudio(block_t *p_block)
         msg_Err(p_stream, "Failed to schedule audio sample: 0x%X", result);
     else
     {
-        lasttimestamp = __MAX(p_block->i_pts, lasttimestamp);
+        UpdateLastTimestamp(p_block->i_pts);
         if (sampleFrameCount != written)
             msg_Err(p_stream, "Written only %d samples out of %d", written, sampleFrameCount);
     }
@@ -596,34 +626,102 @@ int DBMSDIOutput::ProcessAudio(block_t *p_block)
     return result != S_OK ? VLC_EGENERIC : VLC_SUCCESS;
 }
 
+void DBMSDIOutput::UpdateLastTimestamp(vlc_tick_t ts)
+{
+    vlc_tick_t last = lasttimestamp.load();
+    while(ts > last && !lasttimestamp.compare_exchange_weak(last, ts));
+}
+
 int DBMSDIOutput::ProcessVideo(picture_t *picture, block_t *p_cc)
 {
-    mtime_t now = vlc_tick_now();
+    vlc_tick_t now = vlc_tick_now();
 
     if (!picture)
         return VLC_EGENERIC;
 
-    if(picture->date - now >  5000)
-        vlc_msleep_i11e(picture->date - now);
-
     if (video.pic_nosignal &&
         now - picture->date > vlc_tick_from_sec(video.nosignal_delay))
     {
         msg_Dbg(p_stream, "no signal");
 
         picture_Hold(video.pic_nosignal);
-        video.pic_nosignal->date = now;
-        doProcessVideo(picture, NULL);
+        QueueVideo(video.pic_nosignal, NULL, now);
     }
 
-    return doProcessVideo(picture, p_cc);
+    QueueVideo(picture, p_cc, picture->date);
+    return VLC_SUCCESS;
+}
+
+/* Blocks while the ring is full */
+void DBMSDIOutput::QueueVideo(picture_t *picture, block_t *p_cc, vlc_tick_t date)
+{
+    vlc_mutex_lock(&videoLock);
+    while(videoCount == VIDEO_RING_SIZE)
+        vlc_cond_wait(&videoWait, &videoLock);
+
+    VideoFrame *f = &videoRing[(videoStart + videoCount++) % VIDEO_RING_SIZE];
+    f->picture = picture;
+    f->p_cc = p_cc;
+    f->frame = NULL;
+    f->date = date;
+
+    vlc_cond_broadcast(&videoWait);
+    vlc_mutex_unlock(&videoLock);
 }
 
-int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
+void *DBMSDIOutput::VideoThread(void *data)
+{
+    DBMSDIOutput *me = static_cast<DBMSDIOutput *>(data);
+
+    vlc_mutex_lock(&me->videoLock);
+    while(!me->b_videoStop)
+    {
+        /* Schedule the oldest converted frame once due */
+        if(me->videoConverted > 0)
+        {
+            VideoFrame frame = me->videoRing[me->videoStart];
+            if(frame.date - vlc_tick_now() <= VLC_TICK_FROM_MS(5))
+            {
+                me->videoStart = (me->videoStart + 1) % VIDEO_RING_SIZE;
+                me->videoConverted--;
+                me->videoCount--;
+                vlc_cond_broadcast(&me->videoWait);
+                vlc_mutex_unlock(&me->videoLock);
+                me->ScheduleVideo(&frame);
+                vlc_mutex_lock(&me->videoLock);
+                continue;
+            }
+        }
+
+        /* Meanwhile, convert the next pictures. Only this thread accesses
+         * queued entries, so the lock is not needed while converting. */
+        if(me->videoConverted < me->videoCount)
+        {
+            VideoFrame *f = &me->videoRing[(me->videoStart + me->videoConverted)
+                                           % VIDEO_RING_SIZE];
+            vlc_mutex_unlock(&me->videoLock);
+            me->ConvertVideo(f);
+            vlc_mutex_lock(&me->videoLock);
+            me->videoConverted++;
+            continue;
+        }
+
+        if(me->videoConverted > 0)
+            vlc_cond_timedwait(&me->videoWait, &me->videoLock,
+                               me->videoRing[me->videoStart].date);
+        else
+            vlc_cond_wait(&me->videoWait, &me->videoLock);
+    }
+    vlc_mutex_unlock(&me->videoLock);
+    return NULL;
+}
+
+void DBMSDIOutput::ConvertVideo(VideoFrame *f)
 {
     HRESULT result;
-    int w, h, stride, length, ret = VLC_EGENERIC;
-    mtime_t now;
+    int w, h, stride;
+    picture_t *picture = f->picture;
+    block_t *p_cc = f->p_cc;
     IDeckLinkMutableVideoFrame *pDLVideoFrame = NULL;
     w = video.configuredfmt.video.i_visible_width;
     h = video.configuredfmt.video.i_visible_height;
@@ -636,7 +734,7 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
                                         bmdFrameFlagDefault, &pDLVideoFrame);
     if (result != S_OK) {
         msg_Err(p_stream, "Failed to create video frame: 0x%X", result);
-        goto error;
+        goto end;
     }
 
     void *frame_bytes;
@@ -651,13 +749,13 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
         result = p_output->CreateAncillaryData(bmdFormat10BitYUV, &vanc);
         if (result != S_OK) {
             msg_Err(p_stream, "Failed to create vanc: %d", result);
-            goto error;
+            goto end;
         }
 
         result = vanc->GetBufferForVerticalBlankingLine(ancillary.afd_line, &buf);
         if (result != S_OK) {
             msg_Err(p_stream, "Failed to get VBI line %u: %d", ancillary.afd_line, result);
-            goto error;
+            goto end;
         }
 
         sdi::AFD afd(ancillary.afd, ancillary.ar);
@@ -668,7 +766,7 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
             result = vanc->GetBufferForVerticalBlankingLine(ancillary.captions_line, &buf);
             if (result != S_OK) {
                 msg_Err(p_stream, "Failed to get VBI line %u: %d", ancillary.captions_line, result);
-                goto error;
+                goto end;
             }
             sdi::Captions captions(p_cc->p_buffer, p_cc->i_buffer, timescale, frameduration);
             captions.FillBuffer(reinterpret_cast<uint8_t*>(buf), stride);
@@ -680,7 +778,7 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
         vanc->Release();
         if (result != S_OK) {
             msg_Err(p_stream, "Failed to set vanc: %d", result);
-            goto error;
+            goto end;
         }
     }
     else for(int y = 0; y < h; ++y) {
@@ -690,21 +788,41 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
         memcpy(dst, src, w * 2 /* bpp */);
     }
 
+    f->frame = pDLVideoFrame;
+    pDLVideoFrame = NULL;
+
+end:
+    if(p_cc)
+        block_Release(p_cc);
+    picture_Release(picture);
+    if (pDLVideoFrame)
+        pDLVideoFrame->Release();
+    f->picture = NULL;
+    f->p_cc = NULL;
+}
+
+int DBMSDIOutput::ScheduleVideo(VideoFrame *f)
+{
+    HRESULT result;
+    int length, ret = VLC_EGENERIC;
+    vlc_tick_t now, date;
+
+    if(!f->frame)
+        return FAKE_DRIVER ? VLC_SUCCESS : VLC_EGENERIC;
 
     // compute frame duration in CLOCK_FREQ units
     length = (frameduration * CLOCK_FREQ) / timescale;
 
-    picture->date -= offset;
-    result = p_output->ScheduleVideoFrame(pDLVideoFrame,
-                                          picture->date, length, CLOCK_FREQ);
+    date = f->date - offset.load();
+    result = p_output->ScheduleVideoFrame(f->frame, date, length, CLOCK_FREQ);
     if (result != S_OK) {
         msg_Err(p_stream, "Dropped Video frame %" PRId64 ": 0x%x",
-                picture->date, result);
+                date, result);
         goto error;
     }
-    lasttimestamp = __MAX(picture->date, lasttimestamp);
+    UpdateLastTimestamp(date);
 
-    now = vlc_tick_now() - offset;
+    now = vlc_tick_now() - offset.load();
 
     BMDTimeValue decklink_now;
     double speed;
@@ -713,19 +831,13 @@ int DBMSDIOutput::doProcessVideo(picture_t *picture, block_t *p_cc)
     if ((now - decklink_now) > 400000) {
         /* XXX: workaround card clock drift */
         offset += 50000;
-        msg_Err(p_stream, "Delaying: offset now %" PRId64, offset);
+        msg_Err(p_stream, "Delaying: offset now %" PRId64, offset.load());
     }
-
-end:
     ret = VLC_SUCCESS;
 
 error:
-    if(p_cc)
-        block_Release(p_cc);
-    picture_Release(picture);
-    if (pDLVideoFrame)
-        pDLVideoFrame->Release();
-
+    f->frame->Release();
+    f->frame = NULL;
     return ret;
 }
 
@@ -26,6 +26,8 @@
 #include <vlc_es.h>
 #include "../../access/vlc_decklink.h"
 
+#include <atomic>
+
 namespace sdi_sout
 {
     class DBMSDIOutput : public SDIOutput
@@ -49,15 +51,40 @@ namespace sdi_sout
 
             BMDTimeScale timescale;
             BMDTimeValue frameduration;
-            vlc_tick_t lasttimestamp;
+            std::atomic<vlc_tick_t> lasttimestamp;
             /* XXX: workaround card clock drift */
-            vlc_tick_t offset;
+            std::atomic<vlc_tick_t> offset;
             bool b_running;
             int Start();
+            void UpdateLastTimestamp(vlc_tick_t);
+
+            /* Pictures are converted by a dedicated thread ahead of their
+             * schedule time. The ring holds the converted frames waiting to
+             * be scheduled, followed by the pictures waiting for conversion. */
+            struct VideoFrame
+            {
+                picture_t *picture;
+                block_t *p_cc;
+                IDeckLinkMutableVideoFrame *frame;
+                vlc_tick_t date;
+            };
+            static const unsigned VIDEO_RING_SIZE = 4;
+            VideoFrame videoRing[VIDEO_RING_SIZE];
+            unsigned videoStart;
+            unsigned videoConverted;
+            unsigned videoCount;
+            vlc_mutex_t videoLock;
+            vlc_cond_t videoWait;
+            vlc_thread_t videoThread;
+            bool b_videoThread;
+            bool b_videoStop;
+            static void *VideoThread(void *);
+            void QueueVideo(picture_t *, block_t *, vlc_tick_t);
+            void ConvertVideo(VideoFrame *);
+            int ScheduleVideo(VideoFrame *);
             const char *ErrorToString(long i_code);
             IDeckLinkDisplayMode * MatchDisplayMode(const video_format_t *,
                                                     BMDDisplayMode = bmdDisplayModeNotSupported);
-            int doProcessVideo(picture_t *, block_t *);
             picture_t * CreateNoSignalPicture(const char*, const video_format_t *);
     };
 }
@@ -25,9 +25,18 @@
 #include "V210.hpp"
 
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#if defined(CAN_COMPILE_SSE4_1) || defined(CAN_COMPILE_AVX2)
+# include <immintrin.h>
+#endif
 
 using namespace sdi;
 
+typedef uint8_t * (*v210_pack_line)(uint8_t *, const uint16_t *,
+                                    const uint16_t *, const uint16_t *,
+                                    unsigned);
+
 static inline unsigned clip(unsigned a)
 {
     if      (a < 4) return 4;
@@ -41,18 +50,12 @@ static inline void put_le32(uint8_t **p, uint32_t d)
     (*p) += 4;
 }
 
-void V210::Convert(const picture_t *pic, unsigned dst_stride, void *frame_bytes)
+/* Packs one line of 4:2:2 10 bits samples, returns the end of the output */
+static uint8_t *PackLine_C(uint8_t *dst, const uint16_t *y,
+                           const uint16_t *u, const uint16_t *v,
+                           unsigned width)
 {
-    unsigned width = pic->format.i_width;
-    unsigned height = pic->format.i_height;
-    unsigned payload_size = ((width * 8 + 11) / 12) * 4;
-    unsigned line_padding = (payload_size < dst_stride) ? dst_stride - payload_size : 0;
-    unsigned h, w;
-    uint8_t *dst = (uint8_t*)frame_bytes;
-
-    const uint16_t *y = (const uint16_t*)pic->p[0].p_pixels;
-    const uint16_t *u = (const uint16_t*)pic->p[1].p_pixels;
-    const uint16_t *v = (const uint16_t*)pic->p[2].p_pixels;
+    unsigned w;
 
 #define WRITE_PIXELS(a, b, c)           \
     do {                                \
@@ -62,35 +65,298 @@ void V210::Convert(const picture_t *pic, unsigned dst_stride, void *frame_bytes)
         put_le32(&dst, val);           \
     } while (0)
 
-    for (h = 0; h < height; h++) {
-        uint32_t val = 0;
-        for (w = 0; w + 5 < width; w += 6) {
-            WRITE_PIXELS(u, y, v);
-            WRITE_PIXELS(y, u, y);
-            WRITE_PIXELS(v, y, u);
-            WRITE_PIXELS(y, v, y);
-        }
-        if (w + 1 < width) {
-            WRITE_PIXELS(u, y, v);
+    uint32_t val = 0;
+    for (w = 0; w + 5 < width; w += 6) {
+        WRITE_PIXELS(u, y, v);
+        WRITE_PIXELS(y, u, y);
+        WRITE_PIXELS(v, y, u);
+        WRITE_PIXELS(y, v, y);
+    }
+    if (w + 1 < width) {
+        WRITE_PIXELS(u, y, v);
 
-            val = clip(*y++);
-            if (w + 2 == width)
-                put_le32(&dst, val);
-#undef WRITE_PIXELS
-        }
-        if (w + 3 < width) {
-            val |= (clip(*u++) << 10) | (clip(*y++) << 20);
+        val = clip(*y++);
+        if (w + 2 == width)
             put_le32(&dst, val);
+#undef WRITE_PIXELS
+    }
+    if (w + 3 < width) {
+        val |= (clip(*u++) << 10) | (clip(*y++) << 20);
+        put_le32(&dst, val);
 
-            val = clip(*v++) | (clip(*y++) << 10);
-            put_le32(&dst, val);
-        }
+        val = clip(*v++) | (clip(*y++) << 10);
+        put_le32(&dst, val);
+    }
+    return dst;
+}
+
+/*
+ * Every 6 pixels make 4 little endian words of 3 components each:
+ *  U0 Y0 V0 | Y1 U1 Y2 | V1 Y3 U2 | Y4 V2 Y5
+ * The SIMD kernels interleave U and V, then gather the components
+ * that go at bit 0, 10 and 20 of each word with byte shuffles.
+ */
+#define Z (char)0x80
+#define V210_SHUFFLES(type, broadcast) \
+    /* U0 V0 U1 V1 U2 V2 */ \
+    const type uv0  = broadcast(_mm_setr_epi8( 0, 1, Z, Z,  Z, Z, Z, Z,  6, 7, Z, Z,  Z, Z, Z, Z)); \
+    const type uv10 = broadcast(_mm_setr_epi8( Z, Z, Z, Z,  4, 5, Z, Z,  Z, Z, Z, Z, 10,11, Z, Z)); \
+    const type uv20 = broadcast(_mm_setr_epi8( 2, 3, Z, Z,  Z, Z, Z, Z,  8, 9, Z, Z,  Z, Z, Z, Z)); \
+    /* Y0 Y1 Y2 Y3 Y4 Y5 */ \
+    const type y0   = broadcast(_mm_setr_epi8( Z, Z, Z, Z,  2, 3, Z, Z,  Z, Z, Z, Z,  8, 9, Z, Z)); \
+    const type y10  = broadcast(_mm_setr_epi8( 0, 1, Z, Z,  Z, Z, Z, Z,  6, 7, Z, Z,  Z, Z, Z, Z)); \
+    const type y20  = broadcast(_mm_setr_epi8( Z, Z, Z, Z,  4, 5, Z, Z,  Z, Z, Z, Z, 10,11, Z, Z))
+
+#ifdef CAN_COMPILE_SSE4_1
+__attribute__ ((__target__ ("sse4.1")))
+static uint8_t *PackLine_SSE4(uint8_t *dst, const uint16_t *y,
+                              const uint16_t *u, const uint16_t *v,
+                              unsigned width)
+{
+    V210_SHUFFLES(__m128i, );
+    const __m128i min = _mm_set1_epi16(4), max = _mm_set1_epi16(1019);
+    unsigned w;
+
+    /* 8 luma and 4 chroma samples are loaded for every 6 pixels */
+    for (w = 0; w + 8 <= width; w += 6)
+    {
+        __m128i yy = _mm_loadu_si128((const __m128i *)y);
+        __m128i uv = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)u),
+                                        _mm_loadl_epi64((const __m128i *)v));
+
+        yy = _mm_min_epu16(_mm_max_epu16(yy, min), max);
+        uv = _mm_min_epu16(_mm_max_epu16(uv, min), max);
+
+        __m128i a = _mm_or_si128(_mm_shuffle_epi8(uv, uv0),
+                                 _mm_shuffle_epi8(yy, y0));
+        __m128i b = _mm_or_si128(_mm_shuffle_epi8(uv, uv10),
+                                 _mm_shuffle_epi8(yy, y10));
+        __m128i c = _mm_or_si128(_mm_shuffle_epi8(uv, uv20),
+                                 _mm_shuffle_epi8(yy, y20));
+
+        a = _mm_or_si128(a, _mm_slli_epi32(b, 10));
+        a = _mm_or_si128(a, _mm_slli_epi32(c, 20));
+        _mm_storeu_si128((__m128i *)dst, a);
+
+        dst += 16;
+        y += 6;
+        u += 3;
+        v += 3;
+    }
+    return PackLine_C(dst, y, u, v, width - w);
+}
+#endif
+
+#if defined(CAN_COMPILE_AVX2) && defined(CAN_COMPILE_SSE4_1)
+__attribute__ ((__target__ ("avx2")))
+static uint8_t *PackLine_AVX2(uint8_t *dst, const uint16_t *y,
+                              const uint16_t *u, const uint16_t *v,
+                              unsigned width)
+{
+    V210_SHUFFLES(__m256i, _mm256_broadcastsi128_si256);
+#undef V210_SHUFFLES
+    const __m256i min = _mm256_set1_epi16(4), max = _mm256_set1_epi16(1019);
+    unsigned w;
+
+    /* Each 128-bits lane packs 6 pixels, as with SSE4 */
+    for (w = 0; w + 14 <= width; w += 12)
+    {
+        __m256i yy = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)y)),
+                _mm_loadu_si128((const __m128i *)(y + 6)), 1);
+        __m256i uu = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)u)),
+                _mm_loadl_epi64((const __m128i *)(u + 3)), 1);
+        __m256i vv = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)v)),
+                _mm_loadl_epi64((const __m128i *)(v + 3)), 1);
+        __m256i uv = _mm256_unpacklo_epi16(uu, vv);
+
+        yy = _mm256_min_epu16(_mm256_max_epu16(yy, min), max);
+        uv = _mm256_min_epu16(_mm256_max_epu16(uv, min), max);
+
+        __m256i a = _mm256_or_si256(_mm256_shuffle_epi8(uv, uv0),
+                                    _mm256_shuffle_epi8(yy, y0));
+        __m256i b = _mm256_or_si256(_mm256_shuffle_epi8(uv, uv10),
+                                    _mm256_shuffle_epi8(yy, y10));
+        __m256i c = _mm256_or_si256(_mm256_shuffle_epi8(uv, uv20),
+                                    _mm256_shuffle_epi8(yy, y20));
+
+        a = _mm256_or_si256(a, _mm256_slli_epi32(b, 10));
+        a = _mm256_or_si256(a, _mm256_slli_epi32(c, 20));
+        _mm256_storeu_si256((__m256i *)dst, a);
+
+        dst += 32;
+        y += 12;
+        u += 6;
+        v += 6;
+    }
+    return PackLine_SSE4(dst, y, u, v, width - w);
+}
+#endif
+#undef Z
+
+static void Pack(v210_pack_line pack, const picture_t *pic,
+                 unsigned dst_stride, void *frame_bytes)
+{
+    unsigned width = pic->format.i_width;
+    unsigned height = pic->format.i_height;
+    unsigned payload_size = ((width * 8 + 11) / 12) * 4;
+    unsigned line_padding = (payload_size < dst_stride) ? dst_stride - payload_size : 0;
+    uint8_t *dst = (uint8_t*)frame_bytes;
+
+    const uint16_t *y = (const uint16_t*)pic->p[0].p_pixels;
+    const uint16_t *u = (const uint16_t*)pic->p[1].p_pixels;
+    const uint16_t *v = (const uint16_t*)pic->p[2].p_pixels;
+
+    for (unsigned h = 0; h < height; h++) {
+        dst = pack(dst, y, u, v, width);
 
         memset(dst, 0, line_padding);
         dst += line_padding;
 
-        y += pic->p[0].i_pitch / 2 - width;
-        u += pic->p[1].i_pitch / 2 - width / 2;
-        v += pic->p[2].i_pitch / 2 - width / 2;
+        y += pic->p[0].i_pitch / 2;
+        u += pic->p[1].i_pitch / 2;
+        v += pic->p[2].i_pitch / 2;
     }
 }
+
+static v210_pack_line GetPackLine()
+{
+#if defined(CAN_COMPILE_AVX2) && defined(CAN_COMPILE_SSE4_1)
+    if (vlc_CPU_AVX2())
+        return PackLine_AVX2;
+#endif
+#ifdef CAN_COMPILE_SSE4_1
+    if (vlc_CPU_SSE4_1())
+        return PackLine_SSE4;
+#endif
+    return PackLine_C;
+}
+
+void V210::Convert(const picture_t *pic, unsigned dst_stride, void *frame_bytes)
+{
+    Pack(GetPackLine(), pic, dst_stride, frame_bytes);
+}
+
+#ifdef V210_TEST
+#include <vlc_tick.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const struct
+{
+    const char *name;
+    v210_pack_line pack;
+    bool (*available)(void);
+} kernels[] = {
+    { "C", PackLine_C, NULL },
+#ifdef CAN_COMPILE_SSE4_1
+    { "SSE4.1", PackLine_SSE4, [] { return (bool)vlc_CPU_SSE4_1(); } },
+#endif
+#if defined(CAN_COMPILE_AVX2) && defined(CAN_COMPILE_SSE4_1)
+    { "AVX2", PackLine_AVX2, [] { return (bool)vlc_CPU_AVX2(); } },
+#endif
+};
+
+/* DeckLink 10-bits rows are made of 48 pixels blocks of 128 bytes */
+static unsigned RowBytes(unsigned width)
+{
+    return ((width + 47) / 48) * 128;
+}
+
+static picture_t *NewPicture(unsigned width, unsigned height)
+{
+    video_format_t fmt;
+    video_format_Init(&fmt, VLC_CODEC_I422_10L);
+    video_format_Setup(&fmt, VLC_CODEC_I422_10L, width, height,
+                       width, height, 1, 1);
+
+    picture_t *pic = picture_NewFromFormat(&fmt);
+    assert(pic != NULL);
+
+    /* Also out of range values, to check clipping */
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        uint16_t *p = (uint16_t *)pic->p[i].p_pixels;
+        size_t count = pic->p[i].i_pitch * pic->p[i].i_lines / 2;
+        for (size_t j = 0; j < count; j++)
+            p[j] = (rand() % 8) ? rand() % 1024 : rand() % 65536;
+    }
+    return pic;
+}
+
+static void TestSize(unsigned width, unsigned height)
+{
+    picture_t *pic = NewPicture(width, height);
+    size_t stride = RowBytes(width), size = stride * height;
+    uint8_t *ref = (uint8_t *)malloc(size);
+    uint8_t *out = (uint8_t *)malloc(size);
+    assert(ref != NULL && out != NULL);
+
+    Pack(PackLine_C, pic, stride, ref);
+
+    for (size_t i = 1; i < ARRAY_SIZE(kernels); i++)
+    {
+        if (!kernels[i].available())
+            continue;
+        memset(out, 0xAA, size);
+        Pack(kernels[i].pack, pic, stride, out);
+        if (memcmp(ref, out, size))
+        {
+            fprintf(stderr, "%s output mismatch at %ux%u\n",
+                    kernels[i].name, width, height);
+            abort();
+        }
+    }
+
+    free(out);
+    free(ref);
+    picture_Release(pic);
+}
+
+static void Benchmark(unsigned width, unsigned height, unsigned frames)
+{
+    picture_t *pic = NewPicture(width, height);
+    size_t stride = RowBytes(width);
+    uint8_t *out = (uint8_t *)malloc(stride * height);
+    assert(out != NULL);
+
+    for (size_t i = 0; i < ARRAY_SIZE(kernels); i++)
+    {
+        if (kernels[i].available && !kernels[i].available())
+            continue;
+
+        vlc_tick_t start = vlc_tick_now();
+        for (unsigned n = 0; n < frames; n++)
+            Pack(kernels[i].pack, pic, stride, out);
+        vlc_tick_t elapsed = vlc_tick_now() - start;
+
+        printf("%ux%u %s: %.1f frames/s\n", width, height, kernels[i].name,
+               (double)frames * CLOCK_FREQ / (elapsed ? elapsed : 1));
+    }
+
+    free(out);
+    picture_Release(pic);
+}
+
+int main(void)
+{
+    alarm(30);
+
+    /* Every tail length of the SIMD loops, then common sizes */
+    for (unsigned width = 2; width <= 96; width += 2)
+        TestSize(width, 2);
+    TestSize(720, 486);
+    TestSize(1280, 720);
+    TestSize(1920, 1080);
+    TestSize(3840, 2160);
+
+    Benchmark(3840, 2160, 30);
+    return 0;
+}
+#endif
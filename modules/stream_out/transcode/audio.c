@@ -85,6 +85,8 @@ static void decoder_queue_audio( decoder_t *p_dec, block_t *p_audio )
     vlc_mutex_lock(&id->fifo.lock);
     *id->fifo.audio.last = p_audio;
     id->fifo.audio.last = &p_audio->p_next;
+    if( ++id->fifo.i_depth > id->fifo.i_peak )
+        id->fifo.i_peak = id->fifo.i_depth;
     vlc_mutex_unlock(&id->fifo.lock);
 }
 
@@ -94,6 +96,7 @@ static block_t *transcode_dequeue_all_audios( sout_stream_id_sys_t *id )
     block_t *p_audio_bufs = id->fifo.audio.first;
     id->fifo.audio.first = NULL;
     id->fifo.audio.last = &id->fifo.audio.first;
+    id->fifo.i_depth = 0;
     vlc_mutex_unlock(&id->fifo.lock);
 
     return p_audio_bufs;
@@ -343,9 +346,9 @@ int transcode_audio_process( sout_stream_t *p_stream,
 
         p_audio_buf->i_dts = p_audio_buf->i_pts;
 
+        /* The encoder takes ownership of the buffer */
         block_t *p_block = transcode_encoder_encode( id->encoder, p_audio_buf );
         block_ChainAppend( out, p_block );
-        block_Release( p_audio_buf );
         continue;
 error:
         if( p_audio_buf )
@@ -353,6 +356,10 @@ error:
         id->b_error = true;
     } while( p_audio_bufs );
 
+    /* Pick up any return data the encoder thread wants to output. */
+    if( transcode_encoder_opened( id->encoder ) )
+        block_ChainAppend( out, transcode_encoder_get_output_async( id->encoder ) );
+
     /* Drain encoder */
     if( unlikely( !id->b_error && in == NULL ) && transcode_encoder_opened( id->encoder ) )
     {
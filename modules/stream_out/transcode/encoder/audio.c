@@ -65,13 +65,22 @@ int transcode_encoder_audio_open( transcode_encoder_t *p_enc,
     p_enc->p_encoder->p_module = module_need( p_enc->p_encoder, "encoder",
                                               p_cfg->psz_name, true );
 
-    if( p_enc->p_encoder->p_module )
+    if( !p_enc->p_encoder->p_module )
+        return VLC_EGENERIC;
+
+    p_enc->p_encoder->fmt_out.i_codec =
+            vlc_fourcc_GetCodec( AUDIO_ES, p_enc->p_encoder->fmt_out.i_codec );
+
+    if( p_cfg->audio.threads.i_count > 0 &&
+        transcode_encoder_thread_start( p_enc, p_cfg->audio.threads.pool_size,
+                                        p_cfg->audio.threads.i_priority ) )
     {
-        p_enc->p_encoder->fmt_out.i_codec =
-                vlc_fourcc_GetCodec( AUDIO_ES, p_enc->p_encoder->fmt_out.i_codec );
+        module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
+        p_enc->p_encoder->p_module = NULL;
+        return VLC_EGENERIC;
     }
 
-    return ( p_enc->p_encoder->p_module ) ? VLC_SUCCESS: VLC_EGENERIC;
+    return VLC_SUCCESS;
 }
 
 static int encoder_audio_configure( vlc_object_t *p_obj,
@@ -197,13 +206,30 @@ int transcode_encoder_audio_test( vlc_object_t *p_obj,
     return p_module != NULL ? VLC_SUCCESS : VLC_EGENERIC;
 }
 
+/* Takes ownership of the input block */
 block_t * transcode_encoder_audio_encode( transcode_encoder_t *p_enc, block_t *p_block )
 {
-    return p_enc->p_encoder->pf_encode_audio( p_enc->p_encoder, p_block );
+    if( p_enc->b_threaded )
+    {
+        transcode_encoder_thread_push( p_enc, p_block );
+        return NULL;
+    }
+
+    block_t *p_out = p_enc->p_encoder->pf_encode_audio( p_enc->p_encoder, p_block );
+    if( p_block )
+        block_Release( p_block );
+    return p_out;
 }
 
 int transcode_encoder_audio_drain( transcode_encoder_t *p_enc, block_t **out )
 {
+    if( p_enc->b_threaded )
+    {
+        transcode_encoder_thread_stop( p_enc );
+        block_ChainAppend( out, transcode_encoder_get_output_async( p_enc ) );
+        return VLC_SUCCESS;
+    }
+
     block_t *p_block;
     do {
         p_block = transcode_encoder_audio_encode( p_enc, NULL );
@@ -23,7 +23,6 @@
 #include <vlc_common.h>
 #include <vlc_modules.h>
 #include <vlc_codec.h>
-#include <vlc_picture_fifo.h>
 #include <vlc_aout.h>
 #include <vlc_sout.h>
 
@@ -46,12 +45,8 @@ void transcode_encoder_delete( transcode_encoder_t *p_enc )
 {
     if( p_enc->p_encoder )
     {
-        if( p_enc->p_encoder->fmt_in.i_cat == VIDEO_ES )
-        {
-            block_ChainRelease( p_enc->p_buffers );
-            picture_fifo_Delete( p_enc->pp_pics );
-            vlc_mutex_destroy( &p_enc->lock_out );
-        }
+        block_ChainRelease( p_enc->p_buffers );
+        vlc_mutex_destroy( &p_enc->lock_out );
         es_format_Clean( &p_enc->p_encoder->fmt_in );
         es_format_Clean( &p_enc->p_encoder->fmt_out );
         vlc_object_release( p_enc->p_encoder );
@@ -93,23 +88,7 @@ transcode_encoder_t * transcode_encoder_new( vlc_object_t *p_obj,
     if( p_enc->p_encoder->fmt_in.psz_language )
         p_enc->p_encoder->fmt_out.psz_language = strdup( p_enc->p_encoder->fmt_in.psz_language );
 
-    switch( p_fmt->i_cat )
-    {
-        case VIDEO_ES:
-            p_enc->pp_pics = picture_fifo_New();
-            if( !p_enc->pp_pics )
-            {
-                es_format_Clean( &p_enc->p_encoder->fmt_in );
-                es_format_Clean( &p_enc->p_encoder->fmt_out );
-                vlc_object_release( p_enc->p_encoder );
-                free( p_enc );
-                return NULL;
-            }
-            vlc_mutex_init( &p_enc->lock_out );
-            break;
-        default:
-            break;
-    }
+    vlc_mutex_init( &p_enc->lock_out );
 
     return p_enc;
 }
@@ -166,21 +145,104 @@ block_t * transcode_encoder_get_output_async( transcode_encoder_t *p_enc )
     return p_data;
 }
 
+void transcode_encoder_get_queue_stats( const transcode_encoder_t *p_enc,
+                                        transcode_queue_stats_t *p_stats )
+{
+    if( p_enc->b_threaded )
+        transcode_queue_get_stats( (transcode_queue_t *) &p_enc->queue, p_stats );
+    else
+        *p_stats = p_enc->queue_stats;
+}
+
+static block_t * EncodeFrame( encoder_t *p_encoder, void *in )
+{
+    block_t *p_block;
+
+    if( p_encoder->fmt_in.i_cat == VIDEO_ES )
+    {
+        p_block = p_encoder->pf_encode_video( p_encoder, in );
+        if( in )
+            picture_Release( in );
+    }
+    else
+    {
+        p_block = p_encoder->pf_encode_audio( p_encoder, in );
+        if( in )
+            block_Release( in );
+    }
+    return p_block;
+}
+
+static void OutputAppend( transcode_encoder_t *p_enc, block_t *p_block )
+{
+    vlc_mutex_lock( &p_enc->lock_out );
+    block_ChainAppend( &p_enc->p_buffers, p_block );
+    vlc_mutex_unlock( &p_enc->lock_out );
+}
+
+static void* EncoderThread( void *obj )
+{
+    transcode_encoder_t *p_enc = obj;
+    int canc = vlc_savecancel ();
+    block_t *p_block;
+    void *in;
+
+    /* A NULL input asks for draining */
+    while( (in = transcode_queue_pop( &p_enc->queue )) != NULL )
+        OutputAppend( p_enc, EncodeFrame( p_enc->p_encoder, in ) );
+
+    /*Now flush encoder*/
+    while( (p_block = EncodeFrame( p_enc->p_encoder, NULL )) != NULL )
+        OutputAppend( p_enc, p_block );
+
+    vlc_restorecancel (canc);
+
+    return NULL;
+}
+
+int transcode_encoder_thread_start( transcode_encoder_t *p_enc,
+                                    uint32_t i_queue_size, int i_priority )
+{
+    if( transcode_queue_init( &p_enc->queue, i_queue_size ) )
+        return VLC_ENOMEM;
+
+    if( vlc_clone( &p_enc->thread, EncoderThread, p_enc, i_priority ) )
+    {
+        transcode_queue_clean( &p_enc->queue );
+        return VLC_EGENERIC;
+    }
+    p_enc->b_threaded = true;
+    return VLC_SUCCESS;
+}
+
+/* Takes ownership of the input, blocks while the encoder is too late */
+void transcode_encoder_thread_push( transcode_encoder_t *p_enc, void *in )
+{
+    transcode_queue_push( &p_enc->queue, in );
+}
+
+/* Encodes the queued inputs, drains the encoder, and waits for the thread */
+void transcode_encoder_thread_stop( transcode_encoder_t *p_enc )
+{
+    if( !p_enc->b_threaded )
+        return;
+
+    transcode_queue_push( &p_enc->queue, NULL );
+    vlc_join( p_enc->thread, NULL );
+
+    transcode_queue_get_stats( &p_enc->queue, &p_enc->queue_stats );
+    transcode_queue_clean( &p_enc->queue );
+    p_enc->b_threaded = false;
+}
+
 void transcode_encoder_close( transcode_encoder_t *p_enc )
 {
     if( !p_enc->p_encoder->p_module )
         return;
 
-    switch( p_enc->p_encoder->fmt_in.i_cat )
-    {
-        case VIDEO_ES:
-            transcode_encoder_video_close( p_enc );
-            break;
-        default:
-            module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
-            break;
-    }
+    transcode_encoder_thread_stop( p_enc );
 
+    module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
     p_enc->p_encoder->p_module = NULL;
 }
 
@@ -17,6 +17,8 @@
  * along with this program; if not, If not, see https://www.gnu.org/licenses/
  *****************************************************************************/
 
+#include "queue.h"
+
 #define ENC_FRAMERATE (25 * 1000)
 #define ENC_FRAMERATE_BASE 1000
 #define FIRSTVALID(a,b,c) ( a ? a : ( b ? b : c ) )
@@ -51,6 +53,12 @@ typedef struct
             unsigned int    i_bitrate;
             uint32_t        i_sample_rate;
             uint32_t        i_channels;
+            struct
+            {
+                unsigned int i_count; /* > 0 to encode on a separate thread */
+                int          i_priority;
+                uint32_t     pool_size;
+            } threads;
         } audio;
         struct
         {
@@ -70,6 +78,8 @@ void transcode_encoder_update_format_out( transcode_encoder_t *, const es_format
 
 block_t * transcode_encoder_encode( transcode_encoder_t *, void * );
 block_t * transcode_encoder_get_output_async( transcode_encoder_t * );
+void transcode_encoder_get_queue_stats( const transcode_encoder_t *,
+                                        transcode_queue_stats_t * );
 void transcode_encoder_delete( transcode_encoder_t * );
 transcode_encoder_t * transcode_encoder_new( vlc_object_t *, const es_format_t * );
 void transcode_encoder_close( transcode_encoder_t * );
@@ -16,23 +16,24 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this program; if not, If not, see https://www.gnu.org/licenses/
  *****************************************************************************/
-#include <vlc_picture_fifo.h>
-
 struct transcode_encoder_t
 {
     encoder_t       *p_encoder;
     vlc_thread_t    thread;
     vlc_mutex_t     lock_out;
-    bool            b_abort;
-    picture_fifo_t *pp_pics;
-    vlc_sem_t       picture_pool_has_room;
-    vlc_cond_t      cond;
+    transcode_queue_t queue; /* pictures or audio blocks, when threaded */
+    transcode_queue_stats_t queue_stats; /* last stats of a stopped thread */
 
     /* output buffers */
     block_t         *p_buffers;
     bool b_threaded;
 };
 
+int transcode_encoder_thread_start( transcode_encoder_t *p_enc,
+                                    uint32_t i_queue_size, int i_priority );
+void transcode_encoder_thread_push( transcode_encoder_t *p_enc, void *in );
+void transcode_encoder_thread_stop( transcode_encoder_t *p_enc );
+
 int transcode_encoder_audio_open( transcode_encoder_t *p_enc,
                                   const transcode_encoder_config_t *p_cfg );
 int transcode_encoder_video_open( transcode_encoder_t *p_enc,
@@ -40,8 +41,6 @@ int transcode_encoder_video_open( transcode_encoder_t *p_enc,
 int transcode_encoder_spu_open( transcode_encoder_t *p_enc,
                                 const transcode_encoder_config_t *p_cfg );
 
-void transcode_encoder_video_close( transcode_encoder_t *p_enc );
-
 block_t * transcode_encoder_video_encode( transcode_encoder_t *p_enc, picture_t *p_pic );
 block_t * transcode_encoder_audio_encode( transcode_encoder_t *p_enc, block_t *p_block );
 block_t * transcode_encoder_spu_encode( transcode_encoder_t *p_enc, subpicture_t *p_spu );
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * queue.h: transcoding encoder input queue
+ *****************************************************************************
+ * Copyright (C) 2018 VideoLabs, VideoLAN and VLC authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, If not, see https://www.gnu.org/licenses/
+ *****************************************************************************/
+#include <stdatomic.h>
+
+/*
+ * Bounded single producer, single consumer queue.
+ * Slots are handed over with semaphores, so that neither side takes a lock:
+ * the producer blocks while the queue is full, the consumer while it is empty.
+ */
+typedef struct
+{
+    void      **pp_items;
+    unsigned    i_size;
+    unsigned    i_read;  /* consumer side only */
+    unsigned    i_write; /* producer side only */
+    vlc_sem_t   items;
+    vlc_sem_t   room;
+
+    /* metrics */
+    atomic_uint i_depth;
+    atomic_uint i_peak;
+    atomic_uint i_stalls;
+} transcode_queue_t;
+
+typedef struct
+{
+    unsigned i_depth;
+    unsigned i_peak;
+    unsigned i_size;
+    unsigned i_stalls; /* times the producer had to wait for room */
+} transcode_queue_stats_t;
+
+static inline int transcode_queue_init( transcode_queue_t *q, unsigned i_size )
+{
+    q->pp_items = vlc_alloc( i_size, sizeof(*q->pp_items) );
+    if( !q->pp_items )
+        return VLC_ENOMEM;
+    q->i_size = i_size;
+    q->i_read = q->i_write = 0;
+    vlc_sem_init( &q->items, 0 );
+    vlc_sem_init( &q->room, i_size );
+    atomic_init( &q->i_depth, 0 );
+    atomic_init( &q->i_peak, 0 );
+    atomic_init( &q->i_stalls, 0 );
+    return VLC_SUCCESS;
+}
+
+static inline void transcode_queue_clean( transcode_queue_t *q )
+{
+    vlc_sem_destroy( &q->room );
+    vlc_sem_destroy( &q->items );
+    free( q->pp_items );
+}
+
+/* Blocks while the queue is full. NULL is a valid item. */
+static inline void transcode_queue_push( transcode_queue_t *q, void *p_item )
+{
+    if( atomic_load( &q->i_depth ) >= q->i_size )
+        atomic_fetch_add( &q->i_stalls, 1 );
+    vlc_sem_wait( &q->room );
+
+    q->pp_items[q->i_write] = p_item;
+    q->i_write = (q->i_write + 1) % q->i_size;
+
+    unsigned i_depth = atomic_fetch_add( &q->i_depth, 1 ) + 1;
+    if( i_depth > atomic_load( &q->i_peak ) )
+        atomic_store( &q->i_peak, i_depth );
+
+    vlc_sem_post( &q->items );
+}
+
+/* Blocks while the queue is empty */
+static inline void *transcode_queue_pop( transcode_queue_t *q )
+{
+    vlc_sem_wait( &q->items );
+
+    void *p_item = q->pp_items[q->i_read];
+    q->i_read = (q->i_read + 1) % q->i_size;
+    atomic_fetch_sub( &q->i_depth, 1 );
+
+    vlc_sem_post( &q->room );
+    return p_item;
+}
+
+static inline void transcode_queue_get_stats( transcode_queue_t *q,
+                                              transcode_queue_stats_t *p_stats )
+{
+    p_stats->i_depth = atomic_load( &q->i_depth );
+    p_stats->i_peak = atomic_load( &q->i_peak );
+    p_stats->i_size = q->i_size;
+    p_stats->i_stalls = atomic_load( &q->i_stalls );
+}
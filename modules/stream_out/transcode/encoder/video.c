@@ -325,59 +325,6 @@ int transcode_encoder_video_test( vlc_object_t *p_obj,
     return p_module != NULL ? VLC_SUCCESS : VLC_EGENERIC;
 }
 
-static void* EncoderThread( void *obj )
-{
-    transcode_encoder_t *p_enc = obj;
-    picture_t *p_pic = NULL;
-    int canc = vlc_savecancel ();
-    block_t *p_block = NULL;
-
-    vlc_mutex_lock( &p_enc->lock_out );
-
-    for( ;; )
-    {
-        while( !p_enc->b_abort &&
-               (p_pic = picture_fifo_Pop( p_enc->pp_pics )) == NULL )
-            vlc_cond_wait( &p_enc->cond, &p_enc->lock_out );
-        vlc_sem_post( &p_enc->picture_pool_has_room );
-
-        if( p_pic )
-        {
-            /* release lock while encoding */
-            vlc_mutex_unlock( &p_enc->lock_out );
-            p_block = p_enc->p_encoder->pf_encode_video( p_enc->p_encoder, p_pic );
-            picture_Release( p_pic );
-            vlc_mutex_lock( &p_enc->lock_out );
-
-            block_ChainAppend( &p_enc->p_buffers, p_block );
-        }
-
-        if( p_enc->b_abort )
-            break;
-    }
-
-    /*Encode what we have in the buffer on closing*/
-    while( (p_pic = picture_fifo_Pop( p_enc->pp_pics )) != NULL )
-    {
-        vlc_sem_post( &p_enc->picture_pool_has_room );
-        p_block = p_enc->p_encoder->pf_encode_video( p_enc->p_encoder, p_pic );
-        picture_Release( p_pic );
-        block_ChainAppend( &p_enc->p_buffers, p_block );
-    }
-
-    /*Now flush encoder*/
-    do {
-        p_block = p_enc->p_encoder->pf_encode_video(p_enc->p_encoder, NULL );
-        block_ChainAppend( &p_enc->p_buffers, p_block );
-    } while( p_block );
-
-    vlc_mutex_unlock( &p_enc->lock_out );
-
-    vlc_restorecancel (canc);
-
-    return NULL;
-}
-
 int transcode_encoder_video_drain( transcode_encoder_t *p_enc, block_t **out )
 {
     if( !p_enc->b_threaded )
@@ -390,38 +337,12 @@ int transcode_encoder_video_drain( transcode_encoder_t *p_enc, block_t **out )
     }
     else
     {
-        if( p_enc->b_threaded && !p_enc->b_abort )
-        {
-            vlc_mutex_lock( &p_enc->lock_out );
-            p_enc->b_abort = true;
-            vlc_cond_signal( &p_enc->cond );
-            vlc_mutex_unlock( &p_enc->lock_out );
-            vlc_join( p_enc->thread, NULL );
-        }
+        transcode_encoder_thread_stop( p_enc );
         block_ChainAppend( out, transcode_encoder_get_output_async( p_enc ) );
     }
     return VLC_SUCCESS;
 }
 
-void transcode_encoder_video_close( transcode_encoder_t *p_enc )
-{
-    if( p_enc->b_threaded && !p_enc->b_abort )
-    {
-        vlc_mutex_lock( &p_enc->lock_out );
-        p_enc->b_abort = true;
-        vlc_cond_signal( &p_enc->cond );
-        vlc_mutex_unlock( &p_enc->lock_out );
-        vlc_join( p_enc->thread, NULL );
-    }
-
-    /* Close encoder */
-    module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
-    p_enc->p_encoder->p_module = NULL;
-
-    vlc_cond_destroy( &p_enc->cond );
-    vlc_sem_destroy( &p_enc->picture_pool_has_room );
-}
-
 int transcode_encoder_video_open( transcode_encoder_t *p_enc,
                                    const transcode_encoder_config_t *p_cfg )
 {
@@ -439,22 +360,13 @@ int transcode_encoder_video_open( transcode_encoder_t *p_enc,
     p_enc->p_encoder->fmt_out.i_codec =
         vlc_fourcc_GetCodec( VIDEO_ES, p_enc->p_encoder->fmt_out.i_codec );
 
-    vlc_sem_init( &p_enc->picture_pool_has_room, p_cfg->video.threads.pool_size );
-    vlc_cond_init( &p_enc->cond );
-    p_enc->p_buffers = NULL;
-    p_enc->b_abort = false;
-
-    if( p_cfg->video.threads.i_count > 0 )
+    if( p_cfg->video.threads.i_count > 0 &&
+        transcode_encoder_thread_start( p_enc, p_cfg->video.threads.pool_size,
+                                        p_cfg->video.threads.i_priority ) )
     {
-        if( vlc_clone( &p_enc->thread, EncoderThread, p_enc, p_cfg->video.threads.i_priority ) )
-        {
-            vlc_cond_destroy( &p_enc->cond );
-            vlc_sem_destroy( &p_enc->picture_pool_has_room );
-            module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
-            p_enc->p_encoder->p_module = NULL;
-            return VLC_EGENERIC;
-        }
-        p_enc->b_threaded = true;
+        module_unneed( p_enc->p_encoder, p_enc->p_encoder->p_module );
+        p_enc->p_encoder->p_module = NULL;
+        return VLC_EGENERIC;
     }
 
     return VLC_SUCCESS;
@@ -468,12 +380,7 @@ block_t * transcode_encoder_video_encode( transcode_encoder_t *p_enc, picture_t
     }
     else
     {
-        vlc_sem_wait( &p_enc->picture_pool_has_room );
-        vlc_mutex_lock( &p_enc->lock_out );
-        picture_Hold( p_pic );
-        picture_fifo_Push( p_enc->pp_pics, p_pic );
-        vlc_cond_signal( &p_enc->cond );
-        vlc_mutex_unlock( &p_enc->lock_out );
+        transcode_encoder_thread_push( p_enc, picture_Hold( p_pic ) );
         return NULL;
     }
 }
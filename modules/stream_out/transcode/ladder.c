@@ -0,0 +1,526 @@
+/*****************************************************************************
+ * ladder.c: transcoding stream output module (video renditions ladder)
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * A ladder encodes the decoded and filtered video into several renditions.
+ * Each rung scales and encodes on its own thread. Rungs are fed either with
+ * the source pictures, or with the scaled pictures of the smallest larger
+ * rung whose dimensions are a multiple of theirs, so that scaling cost
+ * decreases down the ladder.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+
+#include "transcode.h"
+
+/* ES id offset between two consecutive renditions */
+#define LADDER_ES_ID_STEP 1000
+
+typedef struct transcode_rung_t transcode_rung_t;
+
+struct transcode_rung_t
+{
+    transcode_ladder_t      *ladder;
+    transcode_encoder_config_t cfg;
+    transcode_encoder_t     *encoder;
+    filter_chain_t          *p_scaler;
+    transcode_rung_t        *parent; /**< NULL if fed with source pictures */
+    void                    *downstream_id;
+
+    vlc_thread_t    thread;
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait;  /**< pictures queued, or abort */
+    vlc_cond_t      room;  /**< the queue is not full anymore */
+    vlc_cond_t      idle;  /**< the queue is empty and nothing is in flight */
+    picture_t      *p_first;
+    picture_t     **pp_last;
+    unsigned        i_pics;
+    bool            b_busy;
+    bool            b_abort;
+
+    block_t        *p_out;
+    block_t       **pp_out_last;
+};
+
+struct transcode_ladder_t
+{
+    vlc_object_t     *p_obj;
+    transcode_rung_t *p_rungs;
+    unsigned          i_rungs;
+    bool              b_opened;
+};
+
+static picture_t *transcode_ladder_buffer_new( filter_t *p_filter )
+{
+    p_filter->fmt_out.video.i_chroma = p_filter->fmt_out.i_codec;
+    return picture_NewFromFormat( &p_filter->fmt_out.video );
+}
+
+static const struct filter_video_callbacks transcode_ladder_video_cbs =
+{
+    .buffer_new = transcode_ladder_buffer_new,
+};
+
+static void RungPush( transcode_rung_t *rung, picture_t *p_pic )
+{
+    vlc_mutex_lock( &rung->lock );
+    /* Backpressure: the producer waits for the slowest consumer */
+    while( rung->i_pics >= rung->cfg.video.threads.pool_size && !rung->b_abort )
+        vlc_cond_wait( &rung->room, &rung->lock );
+
+    if( rung->b_abort )
+    {
+        vlc_mutex_unlock( &rung->lock );
+        picture_Release( p_pic );
+        return;
+    }
+
+    p_pic->p_next = NULL;
+    *rung->pp_last = p_pic;
+    rung->pp_last = &p_pic->p_next;
+    rung->i_pics++;
+    vlc_cond_signal( &rung->wait );
+    vlc_mutex_unlock( &rung->lock );
+}
+
+static block_t *RungProcess( transcode_rung_t *rung, picture_t *p_pic )
+{
+    transcode_ladder_t *ladder = rung->ladder;
+
+    if( rung->p_scaler )
+    {
+        p_pic = filter_chain_VideoFilter( rung->p_scaler, p_pic );
+        if( !p_pic )
+            return NULL;
+    }
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *child = &ladder->p_rungs[i];
+        if( child->parent == rung )
+            RungPush( child, picture_Hold( p_pic ) );
+    }
+
+    block_t *p_block = transcode_encoder_encode( rung->encoder, p_pic );
+    picture_Release( p_pic );
+    return p_block;
+}
+
+static void *RungThread( void *data )
+{
+    transcode_rung_t *rung = data;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &rung->lock );
+    for( ;; )
+    {
+        while( !rung->b_abort && rung->p_first == NULL )
+        {
+            rung->b_busy = false;
+            vlc_cond_broadcast( &rung->idle );
+            vlc_cond_wait( &rung->wait, &rung->lock );
+        }
+        if( rung->b_abort )
+            break;
+
+        picture_t *p_pic = rung->p_first;
+        rung->p_first = p_pic->p_next;
+        if( rung->p_first == NULL )
+            rung->pp_last = &rung->p_first;
+        p_pic->p_next = NULL;
+        rung->i_pics--;
+        rung->b_busy = true;
+        vlc_cond_signal( &rung->room );
+        vlc_mutex_unlock( &rung->lock );
+
+        block_t *p_block = RungProcess( rung, p_pic );
+
+        vlc_mutex_lock( &rung->lock );
+        if( p_block )
+            block_ChainLastAppend( &rung->pp_out_last, p_block );
+    }
+    rung->b_busy = false;
+    vlc_cond_broadcast( &rung->idle );
+    vlc_mutex_unlock( &rung->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+transcode_ladder_t *transcode_ladder_new( vlc_object_t *p_obj,
+                                          const transcode_encoder_config_t *p_enccfg,
+                                          const transcode_ladder_config_t *p_cfg )
+{
+    transcode_ladder_t *ladder = malloc( sizeof(*ladder) );
+    if( !ladder )
+        return NULL;
+
+    ladder->p_rungs = calloc( p_cfg->i_rungs, sizeof(*ladder->p_rungs) );
+    if( !ladder->p_rungs )
+    {
+        free( ladder );
+        return NULL;
+    }
+    ladder->p_obj = p_obj;
+    ladder->i_rungs = p_cfg->i_rungs;
+    ladder->b_opened = false;
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        const transcode_rung_config_t *p_rungcfg = &p_cfg->p_rungs[i];
+
+        rung->ladder = ladder;
+        /* Shallow copy: strings and chains stay owned by p_enccfg */
+        rung->cfg = *p_enccfg;
+        rung->cfg.video.i_width = p_rungcfg->i_width;
+        rung->cfg.video.i_height = p_rungcfg->i_height;
+        rung->cfg.video.i_maxwidth = 0;
+        rung->cfg.video.i_maxheight = 0;
+        rung->cfg.video.f_scale = 0;
+        if( p_rungcfg->i_bitrate )
+            rung->cfg.video.i_bitrate = p_rungcfg->i_bitrate;
+        /* The rung thread is the encoder thread */
+        rung->cfg.video.threads.i_count = 0;
+    }
+    return ladder;
+}
+
+bool transcode_ladder_opened( const transcode_ladder_t *ladder )
+{
+    return ladder->b_opened;
+}
+
+static uint64_t video_area( const video_format_t *fmt )
+{
+    return (uint64_t)fmt->i_visible_width * fmt->i_visible_height;
+}
+
+static void transcode_ladder_link( transcode_ladder_t *ladder )
+{
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        const video_format_t *p_fmt =
+            &transcode_encoder_format_in( rung->encoder )->video;
+
+        rung->parent = NULL;
+        for( unsigned j = 0; j < ladder->i_rungs; j++ )
+        {
+            transcode_rung_t *cand = &ladder->p_rungs[j];
+            const video_format_t *p_cand =
+                &transcode_encoder_format_in( cand->encoder )->video;
+
+            if( j == i || p_cand->i_chroma != p_fmt->i_chroma ||
+                p_cand->i_visible_width <= p_fmt->i_visible_width ||
+                p_cand->i_visible_height <= p_fmt->i_visible_height ||
+                p_cand->i_visible_width % p_fmt->i_visible_width ||
+                p_cand->i_visible_height % p_fmt->i_visible_height )
+                continue;
+
+            if( rung->parent == NULL || video_area( p_cand ) <
+                video_area( &transcode_encoder_format_in( rung->parent->encoder )->video ) )
+                rung->parent = cand;
+        }
+    }
+}
+
+static void transcode_ladder_stop( transcode_ladder_t *ladder, unsigned i_started )
+{
+    /* Abort all the rungs first, as parents may wait for room in children */
+    for( unsigned i = 0; i < i_started; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        vlc_mutex_lock( &rung->lock );
+        rung->b_abort = true;
+        vlc_cond_signal( &rung->wait );
+        vlc_cond_broadcast( &rung->room );
+        vlc_mutex_unlock( &rung->lock );
+    }
+
+    for( unsigned i = 0; i < i_started; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        vlc_join( rung->thread, NULL );
+
+        while( rung->p_first )
+        {
+            picture_t *p_pic = rung->p_first;
+            rung->p_first = p_pic->p_next;
+            picture_Release( p_pic );
+        }
+        block_ChainRelease( rung->p_out );
+        rung->p_out = NULL;
+
+        vlc_cond_destroy( &rung->idle );
+        vlc_cond_destroy( &rung->room );
+        vlc_cond_destroy( &rung->wait );
+        vlc_mutex_destroy( &rung->lock );
+    }
+}
+
+static void transcode_ladder_release_rungs( transcode_ladder_t *ladder )
+{
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+
+        if( rung->p_scaler )
+            filter_chain_Delete( rung->p_scaler );
+        rung->p_scaler = NULL;
+        if( rung->encoder )
+        {
+            transcode_encoder_close( rung->encoder );
+            transcode_encoder_delete( rung->encoder );
+        }
+        rung->encoder = NULL;
+        rung->parent = NULL;
+    }
+}
+
+int transcode_ladder_open( transcode_ladder_t *ladder, sout_stream_t *p_stream,
+                           sout_stream_id_sys_t *id, const es_format_t *p_src )
+{
+    vlc_object_t *p_obj = ladder->p_obj;
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+
+        rung->encoder = transcode_encoder_new( p_obj, p_src );
+        if( !rung->encoder )
+            goto error;
+
+        transcode_encoder_video_configure( p_obj,
+                                           &id->p_decoder->fmt_in.video,
+                                           &id->p_decoder->fmt_out.video,
+                                           &rung->cfg, &p_src->video,
+                                           rung->encoder );
+
+        if( transcode_encoder_open( rung->encoder, &rung->cfg ) != VLC_SUCCESS )
+        {
+            msg_Err( p_obj, "cannot open encoder for rendition %ux%u",
+                     rung->cfg.video.i_width, rung->cfg.video.i_height );
+            goto error;
+        }
+
+        if( !rung->downstream_id )
+        {
+            /* Renditions must be told apart downstream */
+            es_format_t fmt_orig = id->p_decoder->fmt_in;
+            fmt_orig.i_id += i * LADDER_ES_ID_STEP;
+
+            rung->downstream_id =
+                id->pf_transcode_downstream_add( p_stream, &fmt_orig,
+                                                 transcode_encoder_format_out( rung->encoder ) );
+            if( !rung->downstream_id )
+            {
+                msg_Err( p_obj, "cannot output rendition %ux%u",
+                         rung->cfg.video.i_width, rung->cfg.video.i_height );
+                goto error;
+            }
+        }
+    }
+
+    transcode_ladder_link( ladder );
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        const es_format_t *p_in = rung->parent
+                                ? transcode_encoder_format_in( rung->parent->encoder )
+                                : p_src;
+        const es_format_t *p_out = transcode_encoder_format_in( rung->encoder );
+
+        msg_Dbg( p_obj, "rendition %ux%u scaled from %ux%u",
+                 p_out->video.i_visible_width, p_out->video.i_visible_height,
+                 p_in->video.i_visible_width, p_in->video.i_visible_height );
+
+        if( p_in->video.i_chroma == p_out->video.i_chroma &&
+            p_in->video.i_width == p_out->video.i_width &&
+            p_in->video.i_height == p_out->video.i_height )
+            continue;
+
+        filter_owner_t owner = {
+            .video = &transcode_ladder_video_cbs,
+            .sys = rung,
+        };
+        rung->p_scaler = filter_chain_NewVideo( p_obj, false, &owner );
+        if( !rung->p_scaler )
+            goto error;
+        filter_chain_Reset( rung->p_scaler, p_in, p_in );
+        if( filter_chain_AppendConverter( rung->p_scaler, p_in, p_out ) )
+        {
+            msg_Err( p_obj, "cannot scale rendition %ux%u",
+                     p_out->video.i_visible_width, p_out->video.i_visible_height );
+            goto error;
+        }
+    }
+
+    unsigned i_started = 0;
+    for( ; i_started < ladder->i_rungs; i_started++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i_started];
+
+        vlc_mutex_init( &rung->lock );
+        vlc_cond_init( &rung->wait );
+        vlc_cond_init( &rung->room );
+        vlc_cond_init( &rung->idle );
+        rung->p_first = NULL;
+        rung->pp_last = &rung->p_first;
+        rung->i_pics = 0;
+        rung->b_busy = false;
+        rung->b_abort = false;
+        rung->p_out = NULL;
+        rung->pp_out_last = &rung->p_out;
+
+        if( vlc_clone( &rung->thread, RungThread, rung,
+                       rung->cfg.video.threads.i_priority ) )
+        {
+            vlc_cond_destroy( &rung->idle );
+            vlc_cond_destroy( &rung->room );
+            vlc_cond_destroy( &rung->wait );
+            vlc_mutex_destroy( &rung->lock );
+            transcode_ladder_stop( ladder, i_started );
+            goto error;
+        }
+    }
+
+    ladder->b_opened = true;
+    return VLC_SUCCESS;
+
+error:
+    transcode_ladder_release_rungs( ladder );
+    return VLC_EGENERIC;
+}
+
+void transcode_ladder_push( transcode_ladder_t *ladder, picture_t *p_pic )
+{
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        if( rung->parent == NULL )
+            RungPush( rung, picture_Hold( p_pic ) );
+    }
+    picture_Release( p_pic );
+}
+
+int transcode_ladder_send( transcode_ladder_t *ladder, sout_stream_t *p_stream )
+{
+    int ret = VLC_SUCCESS;
+
+    if( !ladder->b_opened )
+        return VLC_SUCCESS;
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+
+        vlc_mutex_lock( &rung->lock );
+        block_t *p_out = rung->p_out;
+        rung->p_out = NULL;
+        rung->pp_out_last = &rung->p_out;
+        vlc_mutex_unlock( &rung->lock );
+
+        if( p_out &&
+            sout_StreamIdSend( p_stream->p_next, rung->downstream_id, p_out ) )
+            ret = VLC_EGENERIC;
+    }
+    return ret;
+}
+
+int transcode_ladder_drain( transcode_ladder_t *ladder, sout_stream_t *p_stream,
+                            bool b_eos )
+{
+    if( !ladder->b_opened )
+        return VLC_EGENERIC;
+
+    /* Children are fed by their parent threads: loop until no rung had
+     * anything left to do */
+    bool b_waited;
+    do
+    {
+        b_waited = false;
+        for( unsigned i = 0; i < ladder->i_rungs; i++ )
+        {
+            transcode_rung_t *rung = &ladder->p_rungs[i];
+
+            vlc_mutex_lock( &rung->lock );
+            while( rung->p_first != NULL || rung->b_busy )
+            {
+                b_waited = true;
+                vlc_cond_wait( &rung->idle, &rung->lock );
+            }
+            vlc_mutex_unlock( &rung->lock );
+        }
+    } while( b_waited );
+
+    /* All the rungs are idle, their encoders can be flushed from here */
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        block_t *p_out = NULL;
+
+        transcode_encoder_drain( rung->encoder, &p_out );
+
+        vlc_mutex_lock( &rung->lock );
+        if( p_out )
+            block_ChainLastAppend( &rung->pp_out_last, p_out );
+        if( b_eos && rung->p_out )
+        {
+            block_t *p_last = rung->p_out;
+            while( p_last->p_next )
+                p_last = p_last->p_next;
+            p_last->i_flags |= BLOCK_FLAG_END_OF_SEQUENCE;
+        }
+        vlc_mutex_unlock( &rung->lock );
+    }
+
+    return transcode_ladder_send( ladder, p_stream );
+}
+
+void transcode_ladder_close( transcode_ladder_t *ladder )
+{
+    if( !ladder->b_opened )
+        return;
+
+    transcode_ladder_stop( ladder, ladder->i_rungs );
+    transcode_ladder_release_rungs( ladder );
+    ladder->b_opened = false;
+}
+
+void transcode_ladder_delete( transcode_ladder_t *ladder, sout_stream_t *p_stream )
+{
+    transcode_ladder_close( ladder );
+
+    for( unsigned i = 0; i < ladder->i_rungs; i++ )
+    {
+        transcode_rung_t *rung = &ladder->p_rungs[i];
+        if( rung->downstream_id )
+            sout_StreamIdDel( p_stream->p_next, rung->downstream_id );
+    }
+    free( ladder->p_rungs );
+    free( ladder );
+}
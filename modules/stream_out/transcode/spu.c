@@ -59,6 +59,8 @@ static void decoder_queue_sub( decoder_t *p_dec, subpicture_t *p_spu )
     vlc_mutex_lock(&id->fifo.lock);
     *id->fifo.spu.last = p_spu;
     id->fifo.spu.last = &p_spu->p_next;
+    if( ++id->fifo.i_depth > id->fifo.i_peak )
+        id->fifo.i_peak = id->fifo.i_depth;
     vlc_mutex_unlock(&id->fifo.lock);
 }
 
@@ -68,6 +70,7 @@ static subpicture_t *transcode_dequeue_all_subs( sout_stream_id_sys_t *id )
     subpicture_t *p_subpics = id->fifo.spu.first;
     id->fifo.spu.first = NULL;
     id->fifo.spu.last = &id->fifo.spu.first;
+    id->fifo.i_depth = 0;
     vlc_mutex_unlock(&id->fifo.lock);
 
     return p_subpics;
@@ -80,6 +80,12 @@
 #define VFILTER_LONGTEXT N_( \
     "Video filters will be applied to the video streams (after overlays " \
     "are applied). You can enter a colon-separated list of filters." )
+#define LADDER_TEXT N_("Renditions ladder")
+#define LADDER_LONGTEXT N_( \
+    "Encodes the video into several renditions at once, sharing the " \
+    "decoding and filtering. You can enter a comma-separated list of " \
+    "WIDTHxHEIGHT[@BITRATE] renditions, bitrates in kbit/s. The Nth " \
+    "rendition is output with the ES id of the source plus N*1000." )
 
 #define AENC_TEXT N_("Audio encoder")
 #define AENC_LONGTEXT N_( \
@@ -122,14 +128,16 @@
 
 #define THREADS_TEXT N_("Number of threads")
 #define THREADS_LONGTEXT N_( \
-    "Number of threads used for the transcoding." )
+    "Number of threads used for the transcoding. When set, audio and " \
+    "video are also encoded on their own threads." )
 #define HP_TEXT N_("High priority")
 #define HP_LONGTEXT N_( \
     "Runs the optional encoder thread at the OUTPUT priority instead of " \
     "VIDEO." )
 #define POOL_TEXT N_("Picture pool size")
-#define POOL_LONGTEXT N_( "Defines how many pictures we allow to be in pool "\
-    "between decoder/encoder threads when threads > 0" )
+#define POOL_LONGTEXT N_( "Defines how many pictures or audio buffers we " \
+    "allow to be queued between decoder/encoder threads when threads > 0. " \
+    "The input is slowed down when the queue is full." )
 
 
 static const char *const ppsz_deinterlace_type[] =
@@ -178,6 +186,8 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT, true )
     add_module_list(SOUT_CFG_PREFIX "vfilter", "video filter", NULL,
                     VFILTER_TEXT, VFILTER_LONGTEXT)
+    add_string( SOUT_CFG_PREFIX "ladder", NULL, LADDER_TEXT,
+                LADDER_LONGTEXT, true )
 
     set_section( N_("Audio"), NULL )
     add_module(SOUT_CFG_PREFIX "aenc", "encoder", NULL,
@@ -225,7 +235,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "high-priority", "maxwidth", "maxheight", "pool-size",
-    NULL
+    "ladder", NULL
 };
 
 /*****************************************************************************
@@ -263,6 +273,10 @@ static void SetAudioEncoderConfig( sout_stream_t *p_stream, transcode_encoder_co
     if( p_cfg->audio.i_bitrate < 4000 )
         p_cfg->audio.i_bitrate *= 1000;
 
+    p_cfg->audio.threads.i_count = var_GetInteger( p_stream, SOUT_CFG_PREFIX "threads" );
+    p_cfg->audio.threads.pool_size = var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" );
+    p_cfg->audio.threads.i_priority = VLC_THREAD_PRIORITY_AUDIO;
+
     p_cfg->audio.i_sample_rate = var_GetInteger( p_stream, SOUT_CFG_PREFIX "samplerate" );
     p_cfg->audio.i_channels = var_GetInteger( p_stream, SOUT_CFG_PREFIX "channels" );
 
@@ -333,6 +347,42 @@ static void SetVideoEncoderConfig( sout_stream_t *p_stream, transcode_encoder_co
         p_cfg->video.threads.i_priority = VLC_THREAD_PRIORITY_VIDEO;
 }
 
+static void SetLadderConfig( sout_stream_t *p_stream,
+                             transcode_ladder_config_t *p_cfg )
+{
+    char *psz_string = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "ladder" );
+    if( !psz_string )
+        return;
+
+    char *psz_save;
+    for( char *psz_rung = strtok_r( psz_string, ",", &psz_save );
+         psz_rung != NULL;
+         psz_rung = strtok_r( NULL, ",", &psz_save ) )
+    {
+        transcode_rung_config_t rung = { 0, 0, 0 };
+
+        if( sscanf( psz_rung, "%ux%u@%u", &rung.i_width, &rung.i_height,
+                    &rung.i_bitrate ) < 2 || !rung.i_width || !rung.i_height )
+        {
+            msg_Warn( p_stream, "ignoring invalid rendition `%s'", psz_rung );
+            continue;
+        }
+        if( rung.i_bitrate < 16000 )
+            rung.i_bitrate *= 1000;
+
+        transcode_rung_config_t *p_rungs =
+            realloc( p_cfg->p_rungs, (p_cfg->i_rungs + 1) * sizeof(*p_rungs) );
+        if( !p_rungs )
+            break;
+        p_rungs[p_cfg->i_rungs++] = rung;
+        p_cfg->p_rungs = p_rungs;
+
+        msg_Dbg( p_stream, "rendition %ux%u %ukb/s", rung.i_width,
+                 rung.i_height, rung.i_bitrate / 1000 );
+    }
+    free( psz_string );
+}
+
 static void SetSPUEncoderConfig( sout_stream_t *p_stream, transcode_encoder_config_t *p_cfg )
 {
     char *psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "senc" );
@@ -427,6 +477,8 @@ static int Open( vlc_object_t *p_this )
                  p_sys->venc_cfg.video.i_bitrate / 1000 );
     }
 
+    SetLadderConfig( p_stream, &p_sys->ladder_cfg );
+
     /* Video Filter Parameters */
     sout_filters_config_init( &p_sys->vfilters_cfg );
 
@@ -484,6 +536,7 @@ static void Close( vlc_object_t * p_this )
 
     transcode_encoder_config_clean( &p_sys->venc_cfg );
     sout_filters_config_clean( &p_sys->vfilters_cfg );
+    free( p_sys->ladder_cfg.p_rungs );
 
     transcode_encoder_config_clean( &p_sys->aenc_cfg );
     sout_filters_config_clean( &p_sys->afilters_cfg );
@@ -621,6 +674,8 @@ static void *Add( sout_stream_t *p_stream, const es_format_t *p_fmt )
         case VIDEO_ES:
             id->p_filterscfg = &p_sys->vfilters_cfg;
             id->p_enccfg = &p_sys->venc_cfg;
+            if( p_sys->ladder_cfg.i_rungs )
+                id->p_laddercfg = &p_sys->ladder_cfg;
             break;
         case SPU_ES:
             id->p_filterscfg = NULL;
@@ -672,6 +727,16 @@ error:
     return NULL;
 }
 
+static void LogQueueStats( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    transcode_queue_stats_t stats;
+
+    transcode_encoder_get_queue_stats( id->encoder, &stats );
+    msg_Dbg( p_stream, "%4.4s queues: decoder peak %u, encoder peak %u/%u "
+             "with %u stalls", (char *)&id->p_decoder->fmt_in.i_codec,
+             id->fifo.i_peak, stats.i_peak, stats.i_size, stats.i_stalls );
+}
+
 static void Del( sout_stream_t *p_stream, void *_id )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
@@ -682,12 +747,14 @@ static void Del( sout_stream_t *p_stream, void *_id )
         {
         case AUDIO_ES:
             Send( p_stream, id, NULL );
+            LogQueueStats( p_stream, id );
             transcode_audio_clean( id );
             if( id == p_sys->id_master_sync )
                 p_sys->id_master_sync = NULL;
             break;
         case VIDEO_ES:
             Send( p_stream, id, NULL );
+            LogQueueStats( p_stream, id );
             if( id == p_sys->id_video )
                 p_sys->id_video = NULL;
             transcode_video_clean( p_stream, id );
@@ -721,6 +788,14 @@ static int Send( sout_stream_t *p_stream, void *_id, block_t *p_buffer )
             goto error;
     }
 
+    /* Decoders and packetizers may modify their input in place */
+    if( p_buffer )
+    {
+        p_buffer = block_Unshare( p_buffer );
+        if( p_buffer == NULL )
+            return VLC_ENOMEM;
+    }
+
     int i_ret;
     switch( id->p_decoder->fmt_in.i_cat )
     {
@@ -38,7 +38,21 @@ void sout_filters_config_clean( sout_filters_config_t *p_cfg )
     free( p_cfg->video.psz_spu_sources );
 }
 
+typedef struct
+{
+    unsigned int    i_width;
+    unsigned int    i_height;
+    unsigned int    i_bitrate; /* 0 to use the video bitrate */
+} transcode_rung_config_t;
+
+typedef struct
+{
+    transcode_rung_config_t *p_rungs;
+    unsigned int             i_rungs;
+} transcode_ladder_config_t;
+
 typedef struct sout_stream_id_sys_t sout_stream_id_sys_t;
+typedef struct transcode_ladder_t transcode_ladder_t;
 
 typedef struct
 {
@@ -53,6 +67,7 @@ typedef struct
     /* Video */
     transcode_encoder_config_t venc_cfg;
     sout_filters_config_t vfilters_cfg;
+    transcode_ladder_config_t ladder_cfg;
 
     /* SPU */
     transcode_encoder_config_t senc_cfg;
@@ -82,6 +97,8 @@ struct sout_stream_id_sys_t
     struct
     {
         vlc_mutex_t lock;
+        unsigned    i_depth; /* queued and not yet dequeued outputs */
+        unsigned    i_peak;
         union
         {
             struct {
@@ -123,6 +140,7 @@ struct sout_stream_id_sys_t
              filter_t        *p_spu_blender;
              spu_t           *p_spu;
              video_format_t  fmt_input_video;
+             transcode_ladder_t *p_ladder; /**< Renditions, replacing encoder */
          };
          struct
          {
@@ -135,6 +153,7 @@ struct sout_stream_id_sys_t
 
     /* Encoder */
     const transcode_encoder_config_t *p_enccfg;
+    const transcode_ladder_config_t *p_laddercfg;
     transcode_encoder_t *encoder;
 
     /* Sync */
@@ -195,3 +214,17 @@ int transcode_video_get_output_dimensions( sout_stream_t *, sout_stream_id_sys_t
 void transcode_video_push_spu( sout_stream_t *, sout_stream_id_sys_t *, subpicture_t * );
 int  transcode_video_init    ( sout_stream_t *, const es_format_t *,
                                sout_stream_id_sys_t *);
+
+/* LADDER */
+
+transcode_ladder_t *transcode_ladder_new( vlc_object_t *,
+                                          const transcode_encoder_config_t *,
+                                          const transcode_ladder_config_t * );
+void transcode_ladder_delete( transcode_ladder_t *, sout_stream_t * );
+int  transcode_ladder_open  ( transcode_ladder_t *, sout_stream_t *,
+                              sout_stream_id_sys_t *, const es_format_t * );
+void transcode_ladder_close ( transcode_ladder_t * );
+bool transcode_ladder_opened( const transcode_ladder_t * );
+void transcode_ladder_push  ( transcode_ladder_t *, picture_t * );
+int  transcode_ladder_send  ( transcode_ladder_t *, sout_stream_t * );
+int  transcode_ladder_drain ( transcode_ladder_t *, sout_stream_t *, bool b_eos );
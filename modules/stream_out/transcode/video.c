@@ -121,6 +121,8 @@ static void decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
     vlc_mutex_lock(&id->fifo.lock);
     *id->fifo.pic.last = p_pic;
     id->fifo.pic.last = &p_pic->p_next;
+    if( ++id->fifo.i_depth > id->fifo.i_peak )
+        id->fifo.i_peak = id->fifo.i_depth;
     vlc_mutex_unlock(&id->fifo.lock);
 }
 
@@ -130,6 +132,7 @@ static picture_t *transcode_dequeue_all_pics( sout_stream_id_sys_t *id )
     picture_t *p_pics = id->fifo.pic.first;
     id->fifo.pic.first = NULL;
     id->fifo.pic.last = &id->fifo.pic.first;
+    id->fifo.i_depth = 0;
     vlc_mutex_unlock(&id->fifo.lock);
 
     return p_pics;
@@ -221,9 +224,33 @@ int transcode_video_init( sout_stream_t *p_stream, const es_format_t *p_fmt,
 
     es_format_Clean( &encoder_tested_fmt_in );
 
+    /* With a ladder, the encoder only describes the filters output, and
+     * each rendition gets its own encoder */
+    if( id->p_laddercfg )
+    {
+        id->p_ladder = transcode_ladder_new( VLC_OBJECT(p_stream),
+                                             id->p_enccfg, id->p_laddercfg );
+        if( !id->p_ladder )
+        {
+            transcode_encoder_delete( id->encoder );
+            module_unneed( id->p_decoder, id->p_decoder->p_module );
+            id->p_decoder->p_module = NULL;
+            video_format_Clean( &id->fmt_input_video );
+            es_format_Clean( &id->decoder_out );
+            return VLC_EGENERIC;
+        }
+    }
+
     return VLC_SUCCESS;
 }
 
+static bool transcode_video_output_opened( const sout_stream_id_sys_t *id )
+{
+    if( id->p_ladder )
+        return transcode_ladder_opened( id->p_ladder );
+    return transcode_encoder_opened( id->encoder );
+}
+
 static const struct filter_video_callbacks transcode_filter_video_cbs =
 {
     .buffer_new = transcode_video_filter_buffer_new,
@@ -309,8 +336,6 @@ static int conversion_video_filter_append( sout_stream_id_sys_t *id,
 void transcode_video_clean( sout_stream_t *p_stream,
                                    sout_stream_id_sys_t *id )
 {
-    VLC_UNUSED(p_stream);
-
     /* Close decoder */
     if( id->p_decoder->p_module )
         module_unneed( id->p_decoder, id->p_decoder->p_module );
@@ -318,6 +343,8 @@ void transcode_video_clean( sout_stream_t *p_stream,
         vlc_meta_Delete( id->p_decoder->p_description );
 
     /* Close encoder */
+    if( id->p_ladder )
+        transcode_ladder_delete( id->p_ladder, p_stream );
     transcode_encoder_close( id->encoder );
     transcode_encoder_delete( id->encoder );
 
@@ -415,6 +442,38 @@ static picture_t * RenderSubpictures( sout_stream_t *p_stream, sout_stream_id_sy
     return p_pic;
 }
 
+static int transcode_video_encoder_open( sout_stream_t *p_stream,
+                                         sout_stream_id_sys_t *id )
+{
+    /* Start missing encoder */
+    if( !transcode_encoder_opened( id->encoder ) &&
+        transcode_encoder_open( id->encoder, id->p_enccfg ) != VLC_SUCCESS )
+    {
+        msg_Err( p_stream, "cannot find audio encoder (module:%s fourcc:%4.4s). "
+                           "Take a look few lines earlier to see possible reason.",
+                           id->p_enccfg->psz_name ? id->p_enccfg->psz_name : "any",
+                           (char *)&id->p_enccfg->i_codec );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_stream, "destination (after video filters) %ux%u",
+                       transcode_encoder_format_in( id->encoder )->video.i_width,
+                       transcode_encoder_format_in( id->encoder )->video.i_height );
+
+    if( !id->downstream_id )
+        id->downstream_id =
+            id->pf_transcode_downstream_add( p_stream,
+                                             &id->p_decoder->fmt_in,
+                                             transcode_encoder_format_out( id->encoder ) );
+    if( !id->downstream_id )
+    {
+        msg_Err( p_stream, "cannot output transcoded stream %4.4s",
+                           (char *) &id->p_enccfg->i_codec );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
 static void tag_last_block_with_flag( block_t **out, int i_flag )
 {
     block_t *p_last = *out;
@@ -454,15 +513,23 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             continue;
         }
 
-        if( p_pic && ( unlikely(!transcode_encoder_opened(id->encoder)) ||
+        if( p_pic && ( unlikely(!transcode_video_output_opened(id)) ||
               !video_format_IsSimilar( &id->fmt_input_video, &p_pic->format ) ) )
         {
-            if( !transcode_encoder_opened(id->encoder) ) /* Configure Encoder input/output */
+            if( !transcode_video_output_opened(id) ) /* Configure Encoder input/output */
             {
+                transcode_encoder_config_t enccfg = *id->p_enccfg;
+                if( id->p_ladder )
+                {
+                    /* Filters keep the source size, renditions scale */
+                    enccfg.video.i_width = enccfg.video.i_height = 0;
+                    enccfg.video.i_maxwidth = enccfg.video.i_maxheight = 0;
+                    enccfg.video.f_scale = 0;
+                }
                 transcode_encoder_video_configure( VLC_OBJECT(p_stream),
                                                    &id->p_decoder->fmt_in.video,
                                                    &id->p_decoder->fmt_out.video,
-                                                   id->p_enccfg,
+                                                   &enccfg,
                                                    filtered_video_format( id, p_pic ),
                                                    id->encoder );
                 /* will be opened below */
@@ -497,32 +564,18 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                     goto error;
             }
 
-            /* Start missing encoder */
-            if( !transcode_encoder_opened( id->encoder ) &&
-                transcode_encoder_open( id->encoder, id->p_enccfg ) != VLC_SUCCESS )
+            if( id->p_ladder )
             {
-                msg_Err( p_stream, "cannot find audio encoder (module:%s fourcc:%4.4s). "
-                                   "Take a look few lines earlier to see possible reason.",
-                                   id->p_enccfg->psz_name ? id->p_enccfg->psz_name : "any",
-                                   (char *)&id->p_enccfg->i_codec );
-                goto error;
+                if( !transcode_ladder_opened( id->p_ladder ) &&
+                    transcode_ladder_open( id->p_ladder, p_stream, id,
+                                           transcode_encoder_format_in( id->encoder ) ) != VLC_SUCCESS )
+                {
+                    msg_Err( p_stream, "cannot start the renditions ladder" );
+                    goto error;
+                }
             }
-
-            msg_Dbg( p_stream, "destination (after video filters) %ux%u",
-                               transcode_encoder_format_in( id->encoder )->video.i_width,
-                               transcode_encoder_format_in( id->encoder )->video.i_height );
-
-            if( !id->downstream_id )
-                id->downstream_id =
-                    id->pf_transcode_downstream_add( p_stream,
-                                                     &id->p_decoder->fmt_in,
-                                                     transcode_encoder_format_out( id->encoder ) );
-            if( !id->downstream_id )
-            {
-                msg_Err( p_stream, "cannot output transcoded stream %4.4s",
-                                   (char *) &id->p_enccfg->i_codec );
+            else if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
                 goto error;
-            }
         }
 
         /* Run the filter and output chains; first with the picture,
@@ -550,7 +603,9 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
                 /* Blend subpictures */
                 p_in = RenderSubpictures( p_stream, id, p_in );
 
-                if( p_in )
+                if( p_in && id->p_ladder )
+                    transcode_ladder_push( id->p_ladder, p_in );
+                else if( p_in )
                 {
                     block_t *p_encoded = transcode_encoder_encode( id->encoder, p_in );
                     if( p_encoded )
@@ -560,7 +615,14 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             }
         }
 
-        if( b_eos )
+        if( b_eos && id->p_ladder )
+        {
+            msg_Info( p_stream, "Drain/restart on EOS" );
+            if( transcode_ladder_drain( id->p_ladder, p_stream, true ) != VLC_SUCCESS )
+                goto error;
+            transcode_ladder_close( id->p_ladder );
+        }
+        else if( b_eos )
         {
             msg_Info( p_stream, "Drain/restart on EOS" );
             if( transcode_encoder_drain( id->encoder, out ) != VLC_SUCCESS )
@@ -577,6 +639,18 @@ error:
         id->b_error = true;
     } while( p_pics );
 
+    if( id->p_ladder )
+    {
+        /* Renditions are sent to their own outputs */
+        if( unlikely( !id->b_error && in == NULL ) &&
+            transcode_ladder_opened( id->p_ladder ) )
+            transcode_ladder_drain( id->p_ladder, p_stream, false );
+        else if( transcode_ladder_send( id->p_ladder, p_stream ) != VLC_SUCCESS )
+            id->b_error = true;
+
+        return id->b_error ? VLC_EGENERIC : VLC_SUCCESS;
+    }
+
     if( id->p_enccfg->video.threads.i_count >= 1 )
     {
         /* Pick up any return data the encoder thread wants to output. */
@@ -233,7 +233,7 @@ static char **LanguageSplit( const char *psz_langs );
 static int LanguageArrayIndex( char **ppsz_langs, const char *psz_lang );
 
 static char *EsOutProgramGetMetaName( es_out_pgrm_t *p_pgrm );
-static char *EsInfoCategoryName( es_out_id_t* es );
+static char *EsInfoCategoryName( int i_meta_id );
 
 static inline int EsOutGetClosedCaptionsChannel( const es_format_t *p_fmt )
 {
@@ -1229,11 +1229,11 @@ static char *EsOutProgramGetProgramName( es_out_pgrm_t *p_pgrm )
     return psz;
 }
 
-static char *EsInfoCategoryName( es_out_id_t* es )
+static char *EsInfoCategoryName( int i_meta_id )
 {
     char *psz_category;
 
-    if( asprintf( &psz_category, _("Stream %d"), es->i_meta_id ) == -1 )
+    if( asprintf( &psz_category, _("Stream %d"), i_meta_id ) == -1 )
         return NULL;
 
     return psz_category;
@@ -3335,36 +3335,31 @@ static int EsOutEsUpdateFmt(es_out_t *out, es_out_id_t *es,
 }
 
 /****************************************************************************
- * EsOutUpdateInfo:
- * - add meta info to the playlist item
+ * input_EsInfoCategoryNew:
+ * - describe an elementary stream for the item info
  ****************************************************************************/
-static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p_meta )
+info_category_t *input_EsInfoCategoryNew( int i_meta_id,
+                                          const es_format_t *p_fmt_es,
+                                          const es_format_t *fmt,
+                                          const vlc_meta_t *p_meta )
 {
-    es_out_sys_t *p_sys = container_of(out, es_out_sys_t, out);
-    input_thread_t *p_input = p_sys->p_input;
-    input_item_t   *p_item = input_priv(p_input)->p_item;
-    const es_format_t *p_fmt_es = &es->fmt;
-    const es_format_t *fmt = es->fmt_out.i_cat != UNKNOWN_ES ? &es->fmt_out : &es->fmt;
-
-    input_item_UpdateTracksInfo( p_item , fmt );
-
     /* Create category */
-    char* psz_cat = EsInfoCategoryName( es );
+    char* psz_cat = EsInfoCategoryName( i_meta_id );
 
     if( unlikely( !psz_cat ) )
-        return;
+        return NULL;
 
     info_category_t* p_cat = info_category_New( psz_cat );
 
     free( psz_cat );
 
     if( unlikely( !p_cat ) )
-        return;
+        return NULL;
 
     /* Add information */
-    if( es->i_meta_id != es->fmt.i_id )
+    if( i_meta_id != p_fmt_es->i_id )
         info_category_AddInfo( p_cat, _("Original ID"),
-                       "%d", es->fmt.i_id );
+                       "%d", p_fmt_es->i_id );
 
     const vlc_fourcc_t i_codec_fourcc = p_fmt_es->i_original_fourcc;
     const char *psz_codec_description =
@@ -3376,9 +3371,11 @@ static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p
         info_category_AddInfo( p_cat, _("Codec"), "%.4s",
                                (char*)&i_codec_fourcc );
 
-    if( es->psz_language && *es->psz_language )
+    char *psz_language = LanguageGetName( p_fmt_es->psz_language );
+    if( psz_language && *psz_language )
         info_category_AddInfo( p_cat, _("Language"), "%s",
-                               es->psz_language );
+                               psz_language );
+    free( psz_language );
     if( fmt->psz_description && *fmt->psz_description )
         info_category_AddInfo( p_cat, _("Description"), "%s",
                                fmt->psz_description );
@@ -3393,12 +3390,8 @@ static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p
                 vlc_gettext( aout_FormatPrintChannels( &fmt->audio ) ) );
 
         if( fmt->audio.i_rate != 0 )
-        {
             info_category_AddInfo( p_cat, _("Sample rate"), _("%u Hz"),
                                    fmt->audio.i_rate );
-            /* FIXME that should be removed or improved ! (used by text/strings.c) */
-            var_SetInteger( p_input, "sample-rate", fmt->audio.i_rate );
-        }
 
         unsigned int i_bitspersample = fmt->audio.i_bitspersample;
         if( i_bitspersample == 0 )
@@ -3408,12 +3401,8 @@ static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p
                                    i_bitspersample );
 
         if( fmt->i_bitrate != 0 )
-        {
             info_category_AddInfo( p_cat, _("Bitrate"), _("%u kb/s"),
                                    fmt->i_bitrate / 1000 );
-            /* FIXME that should be removed or improved ! (used by text/strings.c) */
-            var_SetInteger( p_input, "bit-rate", fmt->i_bitrate );
-        }
         for( int i = 0; i < AUDIO_REPLAY_GAIN_MAX; i++ )
         {
             const audio_replay_gain_t *p_rg = &fmt->audio_replay_gain;
@@ -3672,6 +3661,36 @@ static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p
         }
         free( ppsz_all_keys );
     }
+    return p_cat;
+}
+
+/****************************************************************************
+ * EsOutUpdateInfo:
+ * - add meta info to the playlist item
+ ****************************************************************************/
+static void EsOutUpdateInfo( es_out_t *out, es_out_id_t *es, const vlc_meta_t *p_meta )
+{
+    es_out_sys_t *p_sys = container_of(out, es_out_sys_t, out);
+    input_thread_t *p_input = p_sys->p_input;
+    input_item_t   *p_item = input_priv(p_input)->p_item;
+    const es_format_t *fmt = es->fmt_out.i_cat != UNKNOWN_ES ? &es->fmt_out : &es->fmt;
+
+    input_item_UpdateTracksInfo( p_item , fmt );
+
+    info_category_t *p_cat = input_EsInfoCategoryNew( es->i_meta_id, &es->fmt,
+                                                      fmt, p_meta );
+    if( unlikely( !p_cat ) )
+        return;
+
+    if( fmt->i_cat == AUDIO_ES )
+    {
+        /* FIXME that should be removed or improved ! (used by text/strings.c) */
+        if( fmt->audio.i_rate != 0 )
+            var_SetInteger( p_input, "sample-rate", fmt->audio.i_rate );
+        if( fmt->i_bitrate != 0 )
+            var_SetInteger( p_input, "bit-rate", fmt->i_bitrate );
+    }
+
     /* */
     input_item_ReplaceInfos( p_item, p_cat );
     if( !input_priv(p_input)->b_preparsing  )
@@ -3685,7 +3704,7 @@ static void EsOutDeleteInfoEs( es_out_t *out, es_out_id_t *es )
     input_item_t   *p_item = input_priv(p_input)->p_item;
     char* psz_info_category;
 
-    if( likely( psz_info_category = EsInfoCategoryName( es ) ) )
+    if( likely( psz_info_category = EsInfoCategoryName( es->i_meta_id ) ) )
     {
         int ret = input_item_DelInfo( p_item, psz_info_category, NULL );
         free( psz_info_category );
@@ -175,4 +175,17 @@ static inline void es_out_Eos( es_out_t *p_out )
 
 es_out_t  *input_EsOutNew( input_thread_t *, int i_rate );
 
+/**
+ * Creates the "Stream N" info category of an elementary stream.
+ *
+ * \param i_meta_id number of the stream in the category name
+ * \param p_fmt_es format of the stream, as demuxed
+ * \param fmt current format of the stream (after decoding), or p_fmt_es
+ * \param p_meta extra meta data to append, or NULL
+ */
+info_category_t *input_EsInfoCategoryNew( int i_meta_id,
+                                          const es_format_t *p_fmt_es,
+                                          const es_format_t *fmt,
+                                          const vlc_meta_t *p_meta );
+
 #endif
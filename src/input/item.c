@@ -466,6 +466,24 @@ bool input_item_ShouldPreparseSubItems( input_item_t *p_item )
     return b_ret;
 }
 
+char *input_item_GetHost( input_item_t *p_item )
+{
+    char *psz_host = NULL;
+    vlc_url_t url;
+
+    vlc_mutex_lock( &p_item->lock );
+    bool b_net = p_item->b_net;
+    int ret = b_net ? vlc_UrlParse( &url, p_item->psz_uri ) : -1;
+    vlc_mutex_unlock( &p_item->lock );
+
+    if( !b_net )
+        return NULL;
+    if( ret == 0 && url.psz_host != NULL && *url.psz_host != '\0' )
+        psz_host = strdup( url.psz_host );
+    vlc_UrlClean( &url );
+    return psz_host;
+}
+
 input_item_t *input_item_Hold( input_item_t *p_item )
 {
     input_item_owner_t *owner = item_owner(p_item);
@@ -30,6 +30,8 @@
 void input_item_SetErrorWhenReading( input_item_t *p_i, bool b_error );
 void input_item_UpdateTracksInfo( input_item_t *item, const es_format_t *fmt );
 bool input_item_ShouldPreparseSubItems( input_item_t *p_i );
+/* Returns the host name of a network item, NULL otherwise (to be freed) */
+char *input_item_GetHost( input_item_t *p_i );
 
 typedef struct input_item_owner
 {
@@ -26,12 +26,26 @@
 
 #include <vlc_thumbnailer.h>
 #include <vlc_input.h>
+#include <vlc_codec.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_interrupt.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include <vlc_image.h>
+#include <vlc_memstream.h>
 #include "misc/background_worker.h"
+#include "../libvlc.h"
+#include "demux.h"
+#include "stream.h"
 
 struct vlc_thumbnailer_t
 {
     vlc_object_t* parent;
     struct background_worker* worker;
+    struct background_worker* storyboard_worker;
+    bool fast;
 };
 
 typedef struct vlc_thumbnailer_params_t
@@ -45,6 +59,7 @@ typedef struct vlc_thumbnailer_params_t
     {
         VLC_THUMBNAILER_SEEK_TIME,
         VLC_THUMBNAILER_SEEK_POS,
+        VLC_THUMBNAILER_STORYBOARD,
     } type;
     bool fast_seek;
     input_item_t* input_item;
@@ -55,6 +70,13 @@ typedef struct vlc_thumbnailer_params_t
     vlc_tick_t timeout;
     vlc_thumbnailer_cb cb;
     void* user_data;
+
+    /* Storyboard requests */
+    vlc_tick_t interval;
+    unsigned max_count;
+    unsigned tile_width;
+    unsigned columns;
+    vlc_thumbnailer_storyboard_cb storyboard_cb;
 } vlc_thumbnailer_params_t;
 
 struct vlc_thumbnailer_request_t
@@ -62,6 +84,11 @@ struct vlc_thumbnailer_request_t
     vlc_thumbnailer_t *thumbnailer;
     input_thread_t *input_thread;
 
+    /* Lightweight path, see thumbnailer_fast_Run */
+    vlc_thread_t thread;
+    vlc_interrupt_t *interrupt;
+    bool thread_running;
+
     vlc_thumbnailer_params_t params;
 
     vlc_mutex_t lock;
@@ -105,6 +132,826 @@ on_thumbnailer_input_event( input_thread_t *input,
     background_worker_RequestProbe( request->thumbnailer->worker );
 }
 
+static int thumbnailer_request_StartInput( vlc_thumbnailer_request_t* request )
+{
+    input_thread_t* input = request->input_thread =
+            input_CreateThumbnailer( request->thumbnailer->parent,
+                                     on_thumbnailer_input_event, request,
+                                     request->params.input_item );
+    if ( unlikely( input == NULL ) )
+        return VLC_EGENERIC;
+    if ( request->params.type == VLC_THUMBNAILER_SEEK_TIME )
+    {
+        input_SetTime( input, request->params.time,
+                       request->params.fast_seek );
+    }
+    else
+    {
+        assert( request->params.type == VLC_THUMBNAILER_SEEK_POS );
+        input_SetPosition( input, request->params.pos,
+                       request->params.fast_seek );
+    }
+    return input_Start( input );
+}
+
+/*
+ * Lightweight thumbnailer
+ *
+ * The access and demuxer are driven synchronously from a single thread,
+ * with an ES output that only keeps the first video track: there is no
+ * clock, no decoder thread, and other tracks are neither selected nor
+ * decoded. The demuxer seeks to the nearest key frame and the blocks are
+ * decoded until a picture comes out. In fast seek mode, the decoder is told
+ * to skip all but key frames.
+ */
+struct thumbnailer_fast
+{
+    es_out_t out;
+    vlc_object_t *obj;
+    bool keyframes; /* decode key frames only */
+    bool fast; /* take the first picture after the seek */
+    vlc_tick_t target; /* first acceptable picture date (precise mode) */
+    vlc_tick_t after; /* pictures up to that date are ignored */
+    vlc_tick_t origin; /* date of the media start, if known */
+    vlc_tick_t next_display; /* date requested by the demuxer after a seek */
+    vlc_tick_t pending; /* media time of the target, until origin is known */
+
+    es_out_id_t *video;
+    decoder_t *packetizer;
+    decoder_t *decoder;
+    bool failed; /* no decoder for the video track */
+    bool eof;
+
+    vlc_mutex_t lock;
+    picture_t *picture;
+    bool complete; /* picture at or after the target */
+};
+
+struct es_out_id_t
+{
+    bool selected;
+};
+
+struct thumbnailer_decoder
+{
+    decoder_t dec;
+    struct thumbnailer_fast *sys;
+};
+
+static int thumbnailer_fast_UpdateFormat( decoder_t *dec )
+{
+    dec->fmt_out.video.i_chroma = dec->fmt_out.i_codec;
+    return 0;
+}
+
+static picture_t *thumbnailer_fast_NewBuffer( decoder_t *dec )
+{
+    return picture_NewFromFormat( &dec->fmt_out.video );
+}
+
+static void thumbnailer_fast_Queue( decoder_t *dec, picture_t *pic )
+{
+    struct thumbnailer_fast *sys =
+        container_of( dec, struct thumbnailer_decoder, dec )->sys;
+
+    vlc_mutex_lock( &sys->lock );
+    if ( !sys->complete
+      && ( pic->date == VLC_TICK_INVALID || pic->date > sys->after ) )
+    {
+        /* Keep the latest picture, in case the target is never reached */
+        if ( sys->picture != NULL )
+            picture_Release( sys->picture );
+        sys->picture = pic;
+        sys->complete = sys->fast || pic->date == VLC_TICK_INVALID
+                     || ( sys->target != VLC_TICK_INVALID
+                       && pic->date >= sys->target );
+        pic = NULL;
+    }
+    vlc_mutex_unlock( &sys->lock );
+
+    if ( pic != NULL )
+        picture_Release( pic );
+}
+
+static const struct decoder_owner_callbacks thumbnailer_fast_cbs =
+{
+    .video = {
+        .format_update = thumbnailer_fast_UpdateFormat,
+        .buffer_new = thumbnailer_fast_NewBuffer,
+        .queue = thumbnailer_fast_Queue,
+    },
+};
+
+static decoder_t *thumbnailer_fast_LoadDecoder( struct thumbnailer_fast *sys,
+                                                const es_format_t *fmt,
+                                                bool packetizer )
+{
+    struct thumbnailer_decoder *owner =
+        vlc_custom_create( sys->obj, sizeof( *owner ),
+                           packetizer ? "packetizer" : "decoder" );
+    if ( unlikely( owner == NULL ) )
+        return NULL;
+
+    decoder_t *dec = &owner->dec;
+    owner->sys = sys;
+    dec->b_frame_drop_allowed = false;
+    dec->cbs = &thumbnailer_fast_cbs;
+    es_format_Copy( &dec->fmt_in, fmt );
+    es_format_Init( &dec->fmt_out, fmt->i_cat, 0 );
+
+    if ( !packetizer )
+    {
+        /* A single picture is needed: no hardware decoder set up, and no
+         * frame threads delaying the first output. */
+        var_Create( dec, "avcodec-hw", VLC_VAR_STRING );
+        var_SetString( dec, "avcodec-hw", "none" );
+        var_Create( dec, "avcodec-threads", VLC_VAR_INTEGER );
+        var_SetInteger( dec, "avcodec-threads", 1 );
+        if ( sys->keyframes )
+        {   /* Skip non-key frames (AVDISCARD_NONKEY) */
+            var_Create( dec, "avcodec-skip-frame", VLC_VAR_INTEGER );
+            var_SetInteger( dec, "avcodec-skip-frame", 3 );
+        }
+        dec->p_module = module_need_var( dec, "video decoder", "codec" );
+    }
+    else
+        dec->p_module = module_need_var( dec, "packetizer", "packetizer" );
+
+    if ( dec->p_module == NULL )
+    {
+        es_format_Clean( &dec->fmt_in );
+        es_format_Clean( &dec->fmt_out );
+        vlc_object_release( dec );
+        return NULL;
+    }
+    return dec;
+}
+
+static void thumbnailer_fast_UnloadDecoder( decoder_t *dec )
+{
+    module_unneed( dec, dec->p_module );
+    es_format_Clean( &dec->fmt_in );
+    es_format_Clean( &dec->fmt_out );
+    if ( dec->p_description != NULL )
+        vlc_meta_Delete( dec->p_description );
+    vlc_object_release( dec );
+}
+
+static es_out_id_t *thumbnailer_fast_EsAdd( es_out_t *out,
+                                            const es_format_t *fmt )
+{
+    struct thumbnailer_fast *sys = container_of( out, struct thumbnailer_fast,
+                                                 out );
+    es_out_id_t *id = malloc( sizeof( *id ) );
+    if ( unlikely( id == NULL ) )
+        return NULL;
+
+    id->selected = false;
+    if ( fmt->i_cat != VIDEO_ES || sys->video != NULL
+      || fmt->i_priority < ES_PRIORITY_SELECTABLE_MIN )
+        return id;
+
+    if ( fmt->b_packetized )
+        sys->decoder = thumbnailer_fast_LoadDecoder( sys, fmt, false );
+    else
+        sys->packetizer = thumbnailer_fast_LoadDecoder( sys, fmt, true );
+
+    if ( sys->decoder == NULL && sys->packetizer == NULL )
+    {
+        msg_Warn( sys->obj, "no decoder for video track (%4.4s)",
+                  (const char *)&fmt->i_codec );
+        sys->failed = true;
+        return id;
+    }
+    id->selected = true;
+    sys->video = id;
+    return id;
+}
+
+static void thumbnailer_fast_Decode( struct thumbnailer_fast *sys,
+                                     block_t *block )
+{
+    if ( sys->decoder == NULL )
+    {   /* The packetizer output format is only known now */
+        sys->decoder = thumbnailer_fast_LoadDecoder( sys,
+                                        &sys->packetizer->fmt_out, false );
+        if ( sys->decoder == NULL )
+        {
+            sys->failed = true;
+            block_Release( block );
+            return;
+        }
+    }
+
+    if ( sys->decoder->pf_decode( sys->decoder, block ) == VLCDEC_ECRITICAL )
+        sys->failed = true;
+}
+
+/* Packetizes and decodes a block, or drains the packetizer if pp_block is
+ * NULL. */
+static void thumbnailer_fast_Packetize( struct thumbnailer_fast *sys,
+                                        block_t **pp_block )
+{
+    block_t *chain;
+    while ( ( chain = sys->packetizer->pf_packetize( sys->packetizer,
+                                                      pp_block ) ) != NULL )
+    {
+        while ( chain != NULL )
+        {
+            block_t *next = chain->p_next;
+
+            chain->p_next = NULL;
+            if ( sys->failed || sys->complete )
+                block_Release( chain );
+            else
+                thumbnailer_fast_Decode( sys, chain );
+            chain = next;
+        }
+    }
+}
+
+static int thumbnailer_fast_EsSend( es_out_t *out, es_out_id_t *id,
+                                    block_t *block )
+{
+    struct thumbnailer_fast *sys = container_of( out, struct thumbnailer_fast,
+                                                 out );
+
+    if ( id != sys->video || sys->failed || sys->complete )
+    {
+        block_Release( block );
+        return VLC_SUCCESS;
+    }
+
+    if ( sys->packetizer == NULL )
+        thumbnailer_fast_Decode( sys, block );
+    else
+        thumbnailer_fast_Packetize( sys, &block );
+    return VLC_SUCCESS;
+}
+
+static void thumbnailer_fast_EsDel( es_out_t *out, es_out_id_t *id )
+{
+    struct thumbnailer_fast *sys = container_of( out, struct thumbnailer_fast,
+                                                 out );
+    if ( id == sys->video )
+        sys->video = NULL;
+    free( id );
+}
+
+static int thumbnailer_fast_EsControl( es_out_t *out, int query,
+                                       va_list args )
+{
+    struct thumbnailer_fast *sys = container_of( out, struct thumbnailer_fast,
+                                                 out );
+    switch ( query )
+    {
+        case ES_OUT_SET_GROUP_PCR:
+            (void) va_arg( args, int );
+            /* fall through */
+        case ES_OUT_SET_PCR:
+        {
+            vlc_tick_t pcr = va_arg( args, vlc_tick_t );
+            /* Unless a seek said otherwise, the media starts at the first
+             * PCR, as the stream timestamps need not start at 0 */
+            if ( sys->origin == VLC_TICK_INVALID )
+            {
+                sys->origin = pcr;
+                if ( sys->pending != VLC_TICK_INVALID )
+                    sys->target = pcr + sys->pending;
+            }
+            return VLC_SUCCESS;
+        }
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+            sys->next_display = va_arg( args, int64_t );
+            return VLC_SUCCESS;
+        case ES_OUT_GET_ES_STATE:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = id->selected;
+            return VLC_SUCCESS;
+        }
+        case ES_OUT_GET_EMPTY:
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static const struct es_out_callbacks thumbnailer_fast_es_cbs =
+{
+    .add = thumbnailer_fast_EsAdd,
+    .send = thumbnailer_fast_EsSend,
+    .del = thumbnailer_fast_EsDel,
+    .control = thumbnailer_fast_EsControl,
+};
+
+/* Opens the access and the demuxer, as the input does for a plain URL. */
+static demux_t *thumbnailer_fast_OpenDemux( struct thumbnailer_fast *sys,
+                                            const char *url )
+{
+    stream_t *stream = stream_AccessNew( sys->obj, NULL, &sys->out, false,
+                                         url );
+    if ( stream == NULL )
+        return NULL;
+
+    stream = stream_FilterAutoNew( stream );
+
+    if ( stream->pf_read == NULL && stream->pf_block == NULL )
+    {
+        if ( stream->pf_readdir != NULL )
+        {   /* Directories have no thumbnails */
+            vlc_stream_Delete( stream );
+            return NULL;
+        }
+        return stream; /* combined access/demux */
+    }
+
+    demux_t *demux = demux_NewAdvanced( sys->obj, NULL, "any", url, stream,
+                                        &sys->out, false );
+    if ( demux == NULL )
+        vlc_stream_Delete( stream );
+    return demux;
+}
+
+static void thumbnailer_fast_Init( struct thumbnailer_fast *sys,
+                                   vlc_object_t *obj, bool keyframes )
+{
+    memset( sys, 0, sizeof( *sys ) );
+    sys->out.cbs = &thumbnailer_fast_es_cbs;
+    sys->obj = obj;
+    sys->keyframes = keyframes;
+    sys->target = VLC_TICK_INVALID;
+    sys->after = VLC_TICK_INVALID;
+    sys->origin = VLC_TICK_INVALID;
+    sys->next_display = VLC_TICK_INVALID;
+    sys->pending = VLC_TICK_INVALID;
+    vlc_mutex_init( &sys->lock );
+}
+
+/* Returns the date of the media start in the stream timebase. */
+static vlc_tick_t thumbnailer_fast_Origin( const struct thumbnailer_fast *sys )
+{
+    return sys->origin != VLC_TICK_INVALID ? sys->origin : VLC_TICK_0;
+}
+
+/* Seeks to a media time, and updates the origin of the stream timestamps
+ * if the demuxer tells which date it seeked to. */
+static int thumbnailer_fast_SetTime( struct thumbnailer_fast *sys,
+                                     demux_t *demux, vlc_tick_t time,
+                                     bool precise )
+{
+    sys->next_display = VLC_TICK_INVALID;
+    if ( demux_SetTime( demux, time, precise, true ) != VLC_SUCCESS )
+        return VLC_EGENERIC;
+
+    if ( sys->next_display != VLC_TICK_INVALID )
+        sys->origin = sys->next_display - time;
+    else if ( sys->origin == VLC_TICK_INVALID )
+        sys->origin = VLC_TICK_0; /* the next PCR is not the start */
+    return VLC_SUCCESS;
+}
+
+static demux_t *thumbnailer_fast_Open( struct thumbnailer_fast *sys,
+                                       input_item_t *item )
+{
+    char *url = input_item_GetURI( item );
+    if ( url == NULL )
+        return NULL;
+
+    demux_t *demux = thumbnailer_fast_OpenDemux( sys, url );
+    free( url );
+    return demux;
+}
+
+/* Demuxes until a picture matching the current criteria is decoded. */
+static picture_t *thumbnailer_fast_Grab( struct thumbnailer_fast *sys,
+                                         demux_t *demux )
+{
+    while ( !sys->complete && !sys->failed && !sys->eof && !vlc_killed() )
+    {
+        if ( demux_Demux( demux ) != VLC_DEMUXER_SUCCESS )
+        {   /* Drain, as the last frames may still match */
+            if ( sys->packetizer != NULL && !sys->failed && !sys->complete )
+                thumbnailer_fast_Packetize( sys, NULL );
+            if ( sys->decoder != NULL && !sys->failed && !sys->complete )
+                sys->decoder->pf_decode( sys->decoder, NULL );
+            sys->eof = true;
+        }
+    }
+
+    vlc_mutex_lock( &sys->lock );
+    picture_t *pic = sys->picture;
+    if ( !sys->complete && !sys->eof )
+    {   /* Interrupted or failed */
+        if ( pic != NULL )
+            picture_Release( pic );
+        pic = NULL;
+    }
+    sys->picture = NULL;
+    sys->complete = false;
+    vlc_mutex_unlock( &sys->lock );
+    return pic;
+}
+
+/* Discards buffered data after a seek. */
+static void thumbnailer_fast_Flush( struct thumbnailer_fast *sys )
+{
+    if ( sys->packetizer != NULL && sys->packetizer->pf_flush != NULL )
+        sys->packetizer->pf_flush( sys->packetizer );
+    if ( sys->decoder != NULL && sys->decoder->pf_flush != NULL )
+        sys->decoder->pf_flush( sys->decoder );
+    sys->eof = false;
+}
+
+static void thumbnailer_fast_Close( struct thumbnailer_fast *sys,
+                                    demux_t *demux )
+{
+    if ( demux != NULL )
+        demux_Delete( demux );
+    if ( sys->decoder != NULL )
+        thumbnailer_fast_UnloadDecoder( sys->decoder );
+    if ( sys->packetizer != NULL )
+        thumbnailer_fast_UnloadDecoder( sys->packetizer );
+    if ( sys->picture != NULL )
+        picture_Release( sys->picture );
+    vlc_mutex_destroy( &sys->lock );
+}
+
+/**
+ * Takes a thumbnail without an input thread.
+ * \return VLC_SUCCESS (with or without a picture), or VLC_EGENERIC if the
+ * item cannot be opened this way.
+ */
+static int thumbnailer_fast_Take( vlc_thumbnailer_request_t* request,
+                                  picture_t **picp )
+{
+    const vlc_thumbnailer_params_t *params = &request->params;
+    struct thumbnailer_fast sys;
+
+    *picp = NULL;
+    thumbnailer_fast_Init( &sys, request->thumbnailer->parent,
+                           params->fast_seek );
+    sys.fast = params->fast_seek;
+
+    demux_t *demux = thumbnailer_fast_Open( &sys, params->input_item );
+    if ( demux == NULL )
+    {
+        thumbnailer_fast_Close( &sys, NULL );
+        return VLC_EGENERIC;
+    }
+
+    /* Seek to the nearest key frame before the requested point; in precise
+     * mode, pictures before that point are then decoded and dropped. */
+    const bool precise = !params->fast_seek;
+    vlc_tick_t time = 0; /* media time of the point, if known */
+    int ret = VLC_EGENERIC;
+
+    if ( params->type == VLC_THUMBNAILER_SEEK_TIME )
+    {
+        if ( params->time > 0 )
+        {
+            time = params->time;
+            ret = demux_SetTime( demux, time, precise, true );
+        }
+    }
+    else
+    {
+        vlc_tick_t length;
+
+        ret = demux_SetPosition( demux, params->pos, precise, true );
+        if ( demux_Control( demux, DEMUX_GET_LENGTH, &length ) == VLC_SUCCESS
+          && length > 0 )
+            time = params->pos * length;
+    }
+
+    if ( ret == VLC_SUCCESS && sys.next_display != VLC_TICK_INVALID )
+        sys.target = sys.next_display; /* already in the stream timebase */
+    else if ( time <= 0 )
+        sys.fast = true; /* the first picture */
+    else if ( ret == VLC_SUCCESS )
+        sys.target = VLC_TICK_0 + time;
+    else /* decoding from the start, dated from the first PCR */
+        sys.pending = time;
+
+    *picp = thumbnailer_fast_Grab( &sys, demux );
+    thumbnailer_fast_Close( &sys, demux );
+    return VLC_SUCCESS;
+}
+
+static void* thumbnailer_fast_Run( void* data )
+{
+    vlc_thumbnailer_request_t* request = data;
+    picture_t* pic;
+
+    vlc_interrupt_set( request->interrupt );
+
+    if ( thumbnailer_fast_Take( request, &pic ) != VLC_SUCCESS )
+    {
+        msg_Dbg( request->thumbnailer->parent,
+                 "falling back to a full input for thumbnailing" );
+        if ( thumbnailer_request_StartInput( request ) == VLC_SUCCESS )
+            return NULL; /* completed by on_thumbnailer_input_event */
+    }
+
+    vlc_mutex_lock( &request->lock );
+    request->done = true;
+    if ( request->params.cb )
+    {
+        request->params.cb( request->params.user_data, pic );
+        request->params.cb = NULL;
+    }
+    vlc_mutex_unlock( &request->lock );
+
+    if ( pic != NULL )
+        picture_Release( pic );
+    background_worker_RequestProbe( request->thumbnailer->worker );
+    return NULL;
+}
+
+/*
+ * Storyboards
+ *
+ * All the thumbnails of a storyboard are taken from a single demuxer and
+ * decoder, which only decodes key frames. For each point, the demuxer seeks
+ * to the key frame before it, unless the previous thumbnail is already past
+ * that point: then the next key frame is taken without seeking.
+ */
+
+/* Limit if neither the length nor a maximum count are known */
+#define STORYBOARD_MAX_COUNT 10000
+#define STORYBOARD_COLUMNS 10
+
+static void storyboard_Clean( vlc_thumbnailer_storyboard_t *sb )
+{
+    for ( size_t i = 0; i < sb->count; ++i )
+        picture_Release( sb->thumbnails[i] );
+    free( sb->thumbnails );
+    free( sb->times );
+    if ( sb->sheet != NULL )
+        picture_Release( sb->sheet );
+}
+
+static int storyboard_Grab( vlc_thumbnailer_request_t* request,
+                            vlc_thumbnailer_storyboard_t *sb )
+{
+    const vlc_thumbnailer_params_t *params = &request->params;
+    struct thumbnailer_fast sys;
+
+    thumbnailer_fast_Init( &sys, request->thumbnailer->parent, true );
+
+    demux_t *demux = thumbnailer_fast_Open( &sys, params->input_item );
+    if ( demux == NULL )
+    {
+        thumbnailer_fast_Close( &sys, NULL );
+        return VLC_EGENERIC;
+    }
+
+    size_t max = params->max_count ? params->max_count : STORYBOARD_MAX_COUNT;
+    vlc_tick_t length;
+    bool can_seek;
+
+    if ( demux_Control( demux, DEMUX_GET_LENGTH, &length ) == VLC_SUCCESS
+      && length > 0 )
+    {
+        sb->length = length;
+        if ( (uint64_t)( length - 1 ) / params->interval + 1 < max )
+            max = ( length - 1 ) / params->interval + 1;
+    }
+    if ( demux_Control( demux, DEMUX_CAN_SEEK, &can_seek ) != VLC_SUCCESS )
+        can_seek = false;
+
+    sb->thumbnails = vlc_alloc( max, sizeof( *sb->thumbnails ) );
+    sb->times = vlc_alloc( max, sizeof( *sb->times ) );
+    if ( unlikely( sb->thumbnails == NULL || sb->times == NULL ) )
+        goto error;
+
+    /* The points are media times, while the pictures are dated in the
+     * stream timebase, which starts at thumbnailer_fast_Origin() */
+    for ( size_t i = 0; i < max && !sys.eof; ++i )
+    {
+        vlc_tick_t time = i * params->interval;
+
+        sys.target = thumbnailer_fast_Origin( &sys ) + time;
+        if ( i == 0 || sys.after >= sys.target )
+            sys.fast = true;
+        else if ( can_seek && thumbnailer_fast_SetTime( &sys, demux, time,
+                                                        false ) == VLC_SUCCESS )
+        {
+            thumbnailer_fast_Flush( &sys );
+            sys.fast = true;
+        }
+        else /* decode key frames up to the point */
+            sys.fast = false;
+
+        picture_t *pic = thumbnailer_fast_Grab( &sys, demux );
+        if ( pic == NULL )
+            break;
+
+        sb->thumbnails[sb->count] = pic;
+        sb->times[sb->count] = pic->date != VLC_TICK_INVALID ?
+                               pic->date - thumbnailer_fast_Origin( &sys ) :
+                               time;
+        sb->count++;
+        if ( pic->date != VLC_TICK_INVALID )
+            sys.after = pic->date;
+    }
+
+    if ( sb->count == 0 || vlc_killed() )
+        goto error;
+    thumbnailer_fast_Close( &sys, demux );
+    return VLC_SUCCESS;
+
+error:
+    thumbnailer_fast_Close( &sys, demux );
+    storyboard_Clean( sb );
+    return VLC_EGENERIC;
+}
+
+/* Scales the thumbnails into the tiles of a sprite sheet. */
+static int storyboard_Compose( vlc_object_t *obj,
+                               vlc_thumbnailer_storyboard_t *sb,
+                               unsigned tile_width, unsigned columns )
+{
+    const video_format_t *fmt = &sb->thumbnails[0]->format;
+    unsigned sar_num = fmt->i_sar_num, sar_den = fmt->i_sar_den;
+
+    if ( fmt->i_visible_width == 0 || fmt->i_visible_height == 0 )
+        return VLC_EGENERIC;
+    if ( sar_num == 0 || sar_den == 0 )
+        sar_num = sar_den = 1;
+
+    /* Keep the display aspect ratio, with square pixels */
+    uint64_t num = (uint64_t)tile_width * fmt->i_visible_height * sar_den;
+    uint64_t den = (uint64_t)fmt->i_visible_width * sar_num;
+    unsigned tile_height = ( num + den / 2 ) / den;
+
+    tile_width &= ~1u;
+    tile_height &= ~1u;
+    if ( tile_width == 0 || tile_height == 0 )
+        return VLC_EGENERIC;
+
+    if ( columns == 0 )
+        columns = STORYBOARD_COLUMNS;
+    if ( columns > sb->count )
+        columns = sb->count;
+    unsigned rows = ( sb->count + columns - 1 ) / columns;
+
+    video_format_t sheet_fmt;
+    video_format_Init( &sheet_fmt, VLC_CODEC_RGBA );
+    video_format_Setup( &sheet_fmt, VLC_CODEC_RGBA, columns * tile_width,
+                        rows * tile_height, columns * tile_width,
+                        rows * tile_height, 1, 1 );
+
+    picture_t *sheet = picture_NewFromFormat( &sheet_fmt );
+    video_format_Clean( &sheet_fmt );
+    if ( unlikely( sheet == NULL ) )
+        return VLC_EGENERIC;
+
+    plane_t *dst = &sheet->p[0];
+    memset( dst->p_pixels, 0, dst->i_pitch * dst->i_lines );
+
+    image_handler_t *handler = image_HandlerCreate( obj );
+    if ( unlikely( handler == NULL ) )
+    {
+        picture_Release( sheet );
+        return VLC_EGENERIC;
+    }
+
+    for ( size_t i = 0; i < sb->count; ++i )
+    {
+        picture_t *pic = sb->thumbnails[i];
+        video_format_t tile_fmt;
+
+        video_format_Init( &tile_fmt, VLC_CODEC_RGBA );
+        video_format_Setup( &tile_fmt, VLC_CODEC_RGBA, tile_width,
+                            tile_height, tile_width, tile_height, 1, 1 );
+
+        picture_t *tile = image_Convert( handler, pic, &pic->format,
+                                         &tile_fmt );
+        video_format_Clean( &tile_fmt );
+        if ( tile == NULL )
+        {
+            msg_Warn( obj, "cannot scale thumbnail for the sprite sheet" );
+            image_HandlerDelete( handler );
+            picture_Release( sheet );
+            return VLC_EGENERIC;
+        }
+
+        const plane_t *src = &tile->p[0];
+        unsigned lines = __MIN( (unsigned)src->i_visible_lines, tile_height );
+        size_t bytes = __MIN( (size_t)src->i_visible_pitch,
+                              (size_t)tile_width * 4 );
+        uint8_t *out = dst->p_pixels
+                     + ( i / columns ) * tile_height * dst->i_pitch
+                     + ( i % columns ) * tile_width * 4;
+
+        for ( unsigned y = 0; y < lines; ++y )
+            memcpy( out + y * dst->i_pitch, src->p_pixels + y * src->i_pitch,
+                    bytes );
+        picture_Release( tile );
+    }
+    image_HandlerDelete( handler );
+
+    sb->sheet = sheet;
+    sb->columns = columns;
+    sb->rows = rows;
+    sb->tile_width = tile_width;
+    sb->tile_height = tile_height;
+    return VLC_SUCCESS;
+}
+
+static void* thumbnailer_storyboard_Run( void* data )
+{
+    vlc_thumbnailer_request_t* request = data;
+    const vlc_thumbnailer_params_t *params = &request->params;
+    vlc_thumbnailer_storyboard_t sb = {
+        .interval = params->interval,
+        .length = VLC_TICK_INVALID,
+    };
+
+    vlc_interrupt_set( request->interrupt );
+
+    bool ok = storyboard_Grab( request, &sb ) == VLC_SUCCESS;
+    if ( ok && params->tile_width > 0
+      && storyboard_Compose( request->thumbnailer->parent, &sb,
+                             params->tile_width, params->columns ) )
+    {
+        storyboard_Clean( &sb );
+        ok = false;
+    }
+
+    vlc_mutex_lock( &request->lock );
+    request->done = true;
+    if ( request->params.storyboard_cb )
+    {
+        request->params.storyboard_cb( request->params.user_data,
+                                       ok ? &sb : NULL );
+        request->params.storyboard_cb = NULL;
+    }
+    vlc_mutex_unlock( &request->lock );
+
+    if ( ok )
+        storyboard_Clean( &sb );
+    background_worker_RequestProbe( request->thumbnailer->storyboard_worker );
+    return NULL;
+}
+
+static void storyboard_PrintTime( struct vlc_memstream *ms, vlc_tick_t tick )
+{
+    uint64_t ms_total = MS_FROM_VLC_TICK( tick );
+
+    vlc_memstream_printf( ms, "%02"PRIu64":%02u:%02u.%03u",
+                          ms_total / 3600000,
+                          (unsigned)( ms_total / 60000 % 60 ),
+                          (unsigned)( ms_total / 1000 % 60 ),
+                          (unsigned)( ms_total % 1000 ) );
+}
+
+char* vlc_thumbnailer_storyboard_WebVTT( const vlc_thumbnailer_storyboard_t* sb,
+                                         const char* sheet_url )
+{
+    struct vlc_memstream ms;
+
+    if ( sb->sheet == NULL || vlc_memstream_open( &ms ) )
+        return NULL;
+
+    vlc_memstream_puts( &ms, "WEBVTT\n" );
+    for ( size_t i = 0; i < sb->count; ++i )
+    {
+        vlc_tick_t start = sb->times[i], end;
+
+        if ( i + 1 < sb->count )
+            end = sb->times[i + 1];
+        else if ( sb->length != VLC_TICK_INVALID && sb->length > start )
+            end = sb->length;
+        else
+            end = start + sb->interval;
+
+        vlc_memstream_putc( &ms, '\n' );
+        storyboard_PrintTime( &ms, start );
+        vlc_memstream_puts( &ms, " --> " );
+        storyboard_PrintTime( &ms, end );
+        vlc_memstream_printf( &ms, "\n%s#xywh=%u,%u,%u,%u\n", sheet_url,
+                              (unsigned)( i % sb->columns ) * sb->tile_width,
+                              (unsigned)( i / sb->columns ) * sb->tile_height,
+                              sb->tile_width, sb->tile_height );
+    }
+
+    if ( vlc_memstream_close( &ms ) )
+        return NULL;
+    return ms.ptr;
+}
+
+static void thumbnailer_request_Join( vlc_thumbnailer_request_t* request )
+{
+    if ( !request->thread_running )
+        return;
+    vlc_interrupt_kill( request->interrupt );
+    vlc_join( request->thread, NULL );
+    request->thread_running = false;
+}
+
 static void thumbnailer_request_Hold( void* data )
 {
     VLC_UNUSED(data);
@@ -113,6 +960,9 @@ static void thumbnailer_request_Hold( void* data )
 static void thumbnailer_request_Release( void* data )
 {
     vlc_thumbnailer_request_t* request = data;
+    thumbnailer_request_Join( request );
+    if ( request->interrupt )
+        vlc_interrupt_destroy( request->interrupt );
     if ( request->input_thread )
         input_Close( request->input_thread );
 
@@ -125,24 +975,20 @@ static int thumbnailer_request_Start( void* owner, void* entity, void** out )
 {
     vlc_thumbnailer_t* thumbnailer = owner;
     vlc_thumbnailer_request_t* request = entity;
-    input_thread_t* input = request->input_thread =
-            input_CreateThumbnailer( thumbnailer->parent,
-                                     on_thumbnailer_input_event, request,
-                                     request->params.input_item );
-    if ( unlikely( input == NULL ) )
-        return VLC_EGENERIC;
-    if ( request->params.type == VLC_THUMBNAILER_SEEK_TIME )
-    {
-        input_SetTime( input, request->params.time,
-                       request->params.fast_seek );
-    }
-    else
+    bool storyboard = request->params.type == VLC_THUMBNAILER_STORYBOARD;
+
+    if ( thumbnailer->fast || storyboard )
     {
-        assert( request->params.type == VLC_THUMBNAILER_SEEK_POS );
-        input_SetPosition( input, request->params.pos,
-                       request->params.fast_seek );
+        request->interrupt = vlc_interrupt_create();
+        if ( unlikely( request->interrupt == NULL ) )
+            return VLC_EGENERIC;
+        if ( vlc_clone( &request->thread, storyboard ?
+                        thumbnailer_storyboard_Run : thumbnailer_fast_Run,
+                        request, VLC_THREAD_PRIORITY_LOW ) )
+            return VLC_EGENERIC;
+        request->thread_running = true;
     }
-    if ( input_Start( input ) != VLC_SUCCESS )
+    else if ( thumbnailer_request_StartInput( request ) != VLC_SUCCESS )
         return VLC_EGENERIC;
     *out = request;
     return VLC_SUCCESS;
@@ -163,9 +1009,16 @@ static void thumbnailer_request_Stop( void* owner, void* handle )
         request->params.cb( request->params.user_data, NULL );
         request->params.cb = NULL;
     }
+    if ( request->params.storyboard_cb != NULL )
+    {
+        request->params.storyboard_cb( request->params.user_data, NULL );
+        request->params.storyboard_cb = NULL;
+    }
     vlc_mutex_unlock( &request->lock );
-    assert( request->input_thread != NULL );
-    input_Stop( request->input_thread );
+    /* The thread may have fallen back to an input thread */
+    thumbnailer_request_Join( request );
+    if ( request->input_thread != NULL )
+        input_Stop( request->input_thread );
 }
 
 static int thumbnailer_request_Probe( void* owner, void* handle )
@@ -187,14 +1040,19 @@ thumbnailer_RequestCommon( vlc_thumbnailer_t* thumbnailer,
         return NULL;
     request->thumbnailer = thumbnailer;
     request->input_thread = NULL;
+    request->interrupt = NULL;
+    request->thread_running = false;
     request->params = *(vlc_thumbnailer_params_t*)params;
     request->done = false;
     input_item_Hold( request->params.input_item );
     vlc_mutex_init( &request->lock );
 
+    struct background_worker* worker =
+        params->type == VLC_THUMBNAILER_STORYBOARD ?
+            thumbnailer->storyboard_worker : thumbnailer->worker;
     int timeout = params->timeout == VLC_TICK_INVALID ?
                 0 : MS_FROM_VLC_TICK( params->timeout );
-    if ( background_worker_Push( thumbnailer->worker, request, request,
+    if ( background_worker_Push( worker, request, request,
                                   timeout ) != VLC_SUCCESS )
     {
         thumbnailer_request_Release( request );
@@ -240,14 +1098,43 @@ vlc_thumbnailer_RequestByPos( vlc_thumbnailer_t *thumbnailer,
         });
 }
 
+vlc_thumbnailer_request_t*
+vlc_thumbnailer_RequestStoryboard( vlc_thumbnailer_t *thumbnailer,
+                                   input_item_t *input_item,
+                                   vlc_tick_t interval, unsigned max_count,
+                                   unsigned tile_width, unsigned columns,
+                                   vlc_tick_t timeout,
+                                   vlc_thumbnailer_storyboard_cb cb,
+                                   void* user_data )
+{
+    if ( interval <= 0 )
+        return NULL;
+    return thumbnailer_RequestCommon( thumbnailer,
+            &(const vlc_thumbnailer_params_t){
+                .type = VLC_THUMBNAILER_STORYBOARD,
+                .fast_seek = true,
+                .input_item = input_item,
+                .timeout = timeout,
+                .user_data = user_data,
+                .interval = interval,
+                .max_count = max_count,
+                .tile_width = tile_width,
+                .columns = columns,
+                .storyboard_cb = cb,
+        });
+}
+
 void vlc_thumbnailer_Cancel( vlc_thumbnailer_t* thumbnailer,
                              vlc_thumbnailer_request_t* req )
 {
     vlc_mutex_lock( &req->lock );
     /* Ensure we won't invoke the callback if the input was running. */
     req->params.cb = NULL;
+    req->params.storyboard_cb = NULL;
     vlc_mutex_unlock( &req->lock );
-    background_worker_Cancel( thumbnailer->worker, req );
+    background_worker_Cancel( req->params.type == VLC_THUMBNAILER_STORYBOARD ?
+                                thumbnailer->storyboard_worker :
+                                thumbnailer->worker, req );
 }
 
 vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t* parent)
@@ -256,6 +1143,7 @@ vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t* parent)
     if ( unlikely( thumbnailer == NULL ) )
         return NULL;
     thumbnailer->parent = parent;
+    thumbnailer->fast = var_InheritBool( parent, "thumbnailer-fast" );
     struct background_worker_config cfg = {
         .default_timeout = -1,
         .max_threads = 1,
@@ -271,11 +1159,21 @@ vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t* parent)
         free( thumbnailer );
         return NULL;
     }
+    /* Storyboards of different items are processed in parallel */
+    cfg.max_threads = vlc_GetCPUCount();
+    thumbnailer->storyboard_worker = background_worker_New( thumbnailer, &cfg );
+    if ( unlikely( thumbnailer->storyboard_worker == NULL ) )
+    {
+        background_worker_Delete( thumbnailer->worker );
+        free( thumbnailer );
+        return NULL;
+    }
     return thumbnailer;
 }
 
 void vlc_thumbnailer_Release( vlc_thumbnailer_t *thumbnailer )
 {
+    background_worker_Delete( thumbnailer->storyboard_worker );
     background_worker_Delete( thumbnailer->worker );
     free( thumbnailer );
 }
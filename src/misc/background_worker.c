@@ -21,6 +21,7 @@
 #endif
 
 #include <assert.h>
+#include <string.h>
 #include <vlc_common.h>
 #include <vlc_atomic.h>
 #include <vlc_list.h>
@@ -29,11 +30,25 @@
 #include "libvlc.h"
 #include "background_worker.h"
 
+/* Default average task duration beyond which tasks are assumed to wait for
+ * I/O, see background_worker_config.slow_task */
+#define BACKGROUND_WORKER_SLOW_TASK VLC_TICK_FROM_MS(100)
+/* Maximum number of queued tasks looked at for one that can run now, per
+ * priority, to bound the cost of group limits with long queues */
+#define BACKGROUND_WORKER_SCAN_MAX 64
+/* Weight of new samples in the averages, as a power of 2 */
+#define BACKGROUND_WORKER_AVG_SHIFT 3
+
+#define PRIORITY_COUNT 2
+
 struct task {
     struct vlc_list node;
     void* id; /**< id associated with entity */
     void* entity; /**< the entity to process */
     vlc_tick_t timeout; /**< timeout duration in vlc_tick_t */
+    enum background_worker_priority priority;
+    char *group; /**< resource group, or NULL */
+    vlc_tick_t queued; /**< time when the task was queued */
 };
 
 struct background_worker;
@@ -53,27 +68,41 @@ struct background_worker {
 
     vlc_mutex_t lock;
 
-    int uncompleted; /**< number of tasks requested but not completed */
     int nthreads; /**< number of threads in the threads list */
     struct vlc_list threads; /**< list of active background_thread instances */
 
-    struct vlc_list queue; /**< queue of tasks */
-    vlc_cond_t queue_wait; /**< wait for the queue to be non-empty */
+    struct vlc_list queue[PRIORITY_COUNT]; /**< queues of tasks */
+    unsigned queued[PRIORITY_COUNT]; /**< number of tasks in the queues */
+    unsigned running[PRIORITY_COUNT]; /**< number of tasks being processed */
+    vlc_cond_t queue_wait; /**< wait for a task that can run */
 
     vlc_cond_t nothreads_wait; /**< wait for nthreads == 0 */
     bool closing; /**< true if background worker deletion is requested */
+
+    struct background_worker_stats stats;
 };
 
 static struct task *task_Create(struct background_worker *worker, void *id,
-                                void *entity, int timeout)
+                                void *entity, int timeout,
+                                enum background_worker_priority priority,
+                                const char *group)
 {
     struct task *task = malloc(sizeof(*task));
     if (unlikely(!task))
         return NULL;
 
+    task->group = NULL;
+    if (group && unlikely(!(task->group = strdup(group))))
+    {
+        free(task);
+        return NULL;
+    }
+
     task->id = id;
     task->entity = entity;
     task->timeout = timeout < 0 ? worker->conf.default_timeout : VLC_TICK_FROM_MS(timeout);
+    task->priority = priority;
+    task->queued = vlc_tick_now();
     worker->conf.pf_hold(task->entity);
     return task;
 }
@@ -81,26 +110,92 @@ static struct task *task_Create(struct background_worker *worker, void *id,
 static void task_Destroy(struct background_worker *worker, struct task *task)
 {
     worker->conf.pf_release(task->entity);
+    free(task->group);
     free(task);
 }
 
+static void Average(vlc_tick_t *avg, vlc_tick_t sample)
+{
+    *avg += (sample - *avg) / (1 << BACKGROUND_WORKER_AVG_SHIFT);
+}
+
+/* Current thread limit for low priority tasks. High priority tasks may use
+ * one more thread. */
+static int ThreadLimit(struct background_worker *worker)
+{
+    vlc_mutex_assert(&worker->lock);
+
+    vlc_tick_t slow = worker->conf.slow_task > 0 ? worker->conf.slow_task
+                                                 : BACKGROUND_WORKER_SLOW_TASK;
+    if (worker->conf.max_threads_io > worker->conf.max_threads
+     && worker->stats.avg_duration >= slow)
+        return worker->conf.max_threads_io;
+    return worker->conf.max_threads;
+}
+
+static int GroupRunning(struct background_worker *worker, const char *group)
+{
+    struct background_thread *thread;
+    int count = 0;
+
+    vlc_list_foreach(thread, &worker->threads, node)
+        if (thread->task && thread->task->group
+         && !strcmp(thread->task->group, group))
+            count++;
+    return count;
+}
+
+static struct task *QueueFind(struct background_worker *worker)
+{
+    vlc_mutex_assert(&worker->lock);
+
+    unsigned running = worker->running[BACKGROUND_WORKER_PRIORITY_LOW]
+                     + worker->running[BACKGROUND_WORKER_PRIORITY_HIGH];
+    unsigned limit = ThreadLimit(worker);
+
+    for (int prio = PRIORITY_COUNT - 1; prio >= 0; prio--)
+    {
+        if (running >= limit + (prio == BACKGROUND_WORKER_PRIORITY_HIGH))
+            continue;
+
+        struct task *task;
+        unsigned scanned = 0;
+        vlc_list_foreach(task, &worker->queue[prio], node)
+        {
+            if (!task->group || worker->conf.max_threads_per_group <= 0
+             || GroupRunning(worker, task->group)
+                    < worker->conf.max_threads_per_group)
+                return task;
+            if (++scanned >= BACKGROUND_WORKER_SCAN_MAX)
+                break;
+        }
+    }
+    return NULL;
+}
+
 static struct task *QueueTake(struct background_worker *worker, int timeout_ms)
 {
     vlc_mutex_assert(&worker->lock);
 
     vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_MS(timeout_ms);
     bool timeout = false;
-    while (!timeout && !worker->closing && vlc_list_is_empty(&worker->queue))
+    struct task *task;
+    while (!timeout && !worker->closing && !(task = QueueFind(worker)))
         timeout = vlc_cond_timedwait(&worker->queue_wait,
                                      &worker->lock, deadline) != 0;
 
     if (worker->closing || timeout)
         return NULL;
 
-    struct task *task = vlc_list_first_entry_or_null(&worker->queue,
-                                                     struct task, node);
     assert(task);
     vlc_list_remove(&task->node);
+    worker->queued[task->priority]--;
+    worker->running[task->priority]++;
+
+    vlc_tick_t wait = vlc_tick_now() - task->queued;
+    Average(&worker->stats.avg_wait, wait);
+    if (wait > worker->stats.max_wait)
+        worker->stats.max_wait = wait;
 
     return task;
 }
@@ -108,22 +203,25 @@ static struct task *QueueTake(struct background_worker *worker, int timeout_ms)
 static void QueuePush(struct background_worker *worker, struct task *task)
 {
     vlc_mutex_assert(&worker->lock);
-    vlc_list_append(&task->node, &worker->queue);
-    vlc_cond_signal(&worker->queue_wait);
+    vlc_list_append(&task->node, &worker->queue[task->priority]);
+    worker->queued[task->priority]++;
+    vlc_cond_broadcast(&worker->queue_wait);
 }
 
 static void QueueRemoveAll(struct background_worker *worker, void *id)
 {
     vlc_mutex_assert(&worker->lock);
     struct task *task;
-    vlc_list_foreach(task, &worker->queue, node)
-    {
-        if (!id || task->id == id)
+    for (int prio = 0; prio < PRIORITY_COUNT; prio++)
+        vlc_list_foreach(task, &worker->queue[prio], node)
         {
-            vlc_list_remove(&task->node);
-            task_Destroy(worker, task);
+            if (!id || task->id == id)
+            {
+                vlc_list_remove(&task->node);
+                worker->queued[prio]--;
+                task_Destroy(worker, task);
+            }
         }
-    }
 }
 
 static struct background_thread *
@@ -158,13 +256,18 @@ static struct background_worker *background_worker_Create(void *owner,
     worker->owner = owner;
 
     vlc_mutex_init(&worker->lock);
-    worker->uncompleted = 0;
     worker->nthreads = 0;
     vlc_list_init(&worker->threads);
-    vlc_list_init(&worker->queue);
+    for (int prio = 0; prio < PRIORITY_COUNT; prio++)
+    {
+        vlc_list_init(&worker->queue[prio]);
+        worker->queued[prio] = 0;
+        worker->running[prio] = 0;
+    }
     vlc_cond_init(&worker->queue_wait);
     vlc_cond_init(&worker->nothreads_wait);
     worker->closing = false;
+    memset(&worker->stats, 0, sizeof(worker->stats));
     return worker;
 }
 
@@ -175,33 +278,90 @@ static void background_worker_Destroy(struct background_worker *worker)
     free(worker);
 }
 
-static void TerminateTask(struct background_thread *thread, struct task *task)
+static bool SpawnThread(struct background_worker *worker);
+
+/* Starts a thread if queued tasks cannot all be taken by idle threads */
+static void SpawnIfNeeded(struct background_worker *worker)
+{
+    vlc_mutex_assert(&worker->lock);
+
+    int limit = ThreadLimit(worker);
+    unsigned high = worker->queued[BACKGROUND_WORKER_PRIORITY_HIGH];
+    unsigned all = high + worker->queued[BACKGROUND_WORKER_PRIORITY_LOW];
+    unsigned idle = worker->nthreads
+                  - worker->running[BACKGROUND_WORKER_PRIORITY_LOW]
+                  - worker->running[BACKGROUND_WORKER_PRIORITY_HIGH];
+
+    if ((all > idle && worker->nthreads < limit)
+     || (high > idle && worker->nthreads < limit + 1))
+        SpawnThread(worker);
+}
+
+/* Terminates a task; start is VLC_TICK_INVALID if it did not start */
+static void TerminateTask(struct background_thread *thread, struct task *task,
+                          vlc_tick_t start, bool timeout)
 {
     struct background_worker *worker = thread->owner;
-    task_Destroy(worker, task);
 
     vlc_mutex_lock(&worker->lock);
+    /* other threads read the current task (group, id) under the lock */
     thread->task = NULL;
-    worker->uncompleted--;
-    assert(worker->uncompleted >= 0);
+    assert(worker->running[task->priority] > 0);
+    worker->running[task->priority]--;
+    worker->stats.completed++;
+    if (timeout)
+        worker->stats.timeouts++;
+    if (start != VLC_TICK_INVALID)
+        Average(&worker->stats.avg_duration, vlc_tick_now() - start);
+    /* A thread or a group may have been freed for a queued task */
+    vlc_cond_broadcast(&worker->queue_wait);
+    SpawnIfNeeded(worker);
     vlc_mutex_unlock(&worker->lock);
+
+    task_Destroy(worker, task);
 }
 
-static void RemoveThread(struct background_thread *thread)
+static void RemoveThreadLocked(struct background_thread *thread)
 {
     struct background_worker *worker = thread->owner;
 
-    vlc_mutex_lock(&worker->lock);
+    vlc_mutex_assert(&worker->lock);
 
     vlc_list_remove(&thread->node);
     worker->nthreads--;
     assert(worker->nthreads >= 0);
     if (!worker->nthreads)
         vlc_cond_signal(&worker->nothreads_wait);
+    else if (!worker->closing)
+        /* the remaining threads may not be enough for the queued tasks */
+        SpawnIfNeeded(worker);
+}
 
-    vlc_mutex_unlock(&worker->lock);
+/* Takes the next task; returns NULL if the thread must terminate, in which
+ * case it has been removed from the worker */
+static struct task *ThreadTake(struct background_thread *thread)
+{
+    struct background_worker *worker = thread->owner;
 
-    background_thread_Destroy(thread);
+    vlc_mutex_assert(&worker->lock);
+
+    /* Shrink when tasks got faster, keeping one for high priority. The
+     * decision and the removal happen under the same lock, so that the
+     * threads never all leave together. */
+    while (!worker->closing && worker->nthreads <= ThreadLimit(worker) + 1)
+    {
+        struct task *task = QueueTake(worker, 5000);
+        if (task)
+            return task;
+
+        if (!worker->queued[BACKGROUND_WORKER_PRIORITY_LOW]
+         && !worker->queued[BACKGROUND_WORKER_PRIORITY_HIGH])
+            break; /* idle */
+        /* the queued tasks wait for their group: keep waiting */
+    }
+
+    RemoveThreadLocked(thread);
+    return NULL;
 }
 
 static void* Thread( void* data )
@@ -212,7 +372,7 @@ static void* Thread( void* data )
     for (;;)
     {
         vlc_mutex_lock(&worker->lock);
-        struct task *task = QueueTake(worker, 5000);
+        struct task *task = ThreadTake(thread);
         if (!task)
         {
             vlc_mutex_unlock(&worker->lock);
@@ -223,9 +383,10 @@ static void* Thread( void* data )
         thread->task = task;
         thread->cancel = false;
         thread->probe = false;
+        vlc_tick_t start = vlc_tick_now();
         vlc_tick_t deadline;
         if (task->timeout > 0)
-            deadline = vlc_tick_now() + task->timeout;
+            deadline = start + task->timeout;
         else
             deadline = INT64_MAX; /* no deadline */
         vlc_mutex_unlock(&worker->lock);
@@ -233,7 +394,7 @@ static void* Thread( void* data )
         void *handle;
         if (worker->conf.pf_start(worker->owner, task->entity, &handle))
         {
-            TerminateTask(thread, task);
+            TerminateTask(thread, task, VLC_TICK_INVALID, false);
             continue;
         }
 
@@ -255,13 +416,13 @@ static void* Thread( void* data )
                     || worker->conf.pf_probe(worker->owner, handle))
             {
                 worker->conf.pf_stop(worker->owner, handle);
-                TerminateTask(thread, task);
+                TerminateTask(thread, task, start, timeout);
                 break;
             }
         }
     }
 
-    RemoveThread(thread);
+    background_thread_Destroy(thread);
 
     return NULL;
 }
@@ -291,23 +452,31 @@ struct background_worker* background_worker_New( void* owner,
     return background_worker_Create(owner, conf);
 }
 
-int background_worker_Push( struct background_worker* worker, void* entity,
-                        void* id, int timeout )
+int background_worker_PushEx( struct background_worker* worker, void* entity,
+                        void* id, int timeout,
+                        enum background_worker_priority priority,
+                        const char *group )
 {
-    struct task *task = task_Create(worker, id, entity, timeout);
+    struct task *task = task_Create(worker, id, entity, timeout, priority,
+                                    group);
     if (unlikely(!task))
         return VLC_ENOMEM;
 
     vlc_mutex_lock(&worker->lock);
     QueuePush(worker, task);
-    if (++worker->uncompleted > worker->nthreads
-            && worker->nthreads < worker->conf.max_threads)
-        SpawnThread(worker);
+    SpawnIfNeeded(worker);
     vlc_mutex_unlock(&worker->lock);
 
     return VLC_SUCCESS;
 }
 
+int background_worker_Push( struct background_worker* worker, void* entity,
+                        void* id, int timeout )
+{
+    return background_worker_PushEx(worker, entity, id, timeout,
+                                    BACKGROUND_WORKER_PRIORITY_LOW, NULL);
+}
+
 static void BackgroundWorkerCancelLocked(struct background_worker *worker,
                                          void *id)
 {
@@ -347,6 +516,20 @@ void background_worker_RequestProbe( struct background_worker* worker )
     vlc_mutex_unlock(&worker->lock);
 }
 
+void background_worker_GetStats( struct background_worker* worker,
+                                 struct background_worker_stats *stats )
+{
+    vlc_mutex_lock(&worker->lock);
+    *stats = worker->stats;
+    for (int prio = 0; prio < PRIORITY_COUNT; prio++)
+        stats->queued[prio] = worker->queued[prio];
+    stats->running = worker->running[BACKGROUND_WORKER_PRIORITY_LOW]
+                   + worker->running[BACKGROUND_WORKER_PRIORITY_HIGH];
+    stats->threads = worker->nthreads;
+    stats->max_threads = ThreadLimit(worker);
+    vlc_mutex_unlock(&worker->lock);
+}
+
 void background_worker_Delete( struct background_worker* worker )
 {
     vlc_mutex_lock(&worker->lock);
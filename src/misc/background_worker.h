@@ -34,6 +34,31 @@ struct background_worker_config {
      */
     int max_threads;
 
+    /**
+     * Maximum number of threads when tasks are slow
+     *
+     * Tasks taking longer than \ref slow_task on average are assumed to be
+     * waiting for I/O rather than using the CPU. In that case, the worker
+     * grows up to this number of threads. A value not greater than
+     * \ref max_threads disables this.
+     */
+    int max_threads_io;
+
+    /**
+     * Average task duration beyond which tasks are considered slow
+     *
+     * Only meaningful if \ref max_threads_io is set. If 0, a default of
+     * 100 milliseconds is used.
+     */
+    vlc_tick_t slow_task;
+
+    /**
+     * Maximum number of threads running tasks of the same group
+     *
+     * See \ref background_worker_PushEx. 0 means no limit.
+     */
+    int max_threads_per_group;
+
     /**
      * Release an entity
      *
@@ -171,6 +196,54 @@ void background_worker_RequestProbe( struct background_worker* worker );
 int background_worker_Push( struct background_worker* worker, void* entity,
     void* id, int timeout );
 
+enum background_worker_priority
+{
+    /** Bulk work, e.g. scanning a media library */
+    BACKGROUND_WORKER_PRIORITY_LOW,
+    /** Work a user is waiting for, e.g. items visible on screen */
+    BACKGROUND_WORKER_PRIORITY_HIGH,
+};
+
+/**
+ * Push an entity into the background-worker, with a priority and a group
+ *
+ * Same as \ref background_worker_Push, except that:
+ *  - high priority entities are processed before any low priority ones,
+ *    and may run on one thread beyond the normal maximum;
+ *  - at most \ref background_worker_config.max_threads_per_group entities
+ *    of the same group run at the same time, so that a slow resource (such
+ *    as a server) does not occupy every thread.
+ *
+ * \param priority the priority of the entity
+ * \param group a name for the resource used by the entity (e.g. a host
+ *              name), or `NULL` for no limit
+ **/
+int background_worker_PushEx( struct background_worker* worker, void* entity,
+    void* id, int timeout, enum background_worker_priority priority,
+    const char *group );
+
+struct background_worker_stats
+{
+    unsigned queued[2]; /**< pending entities, by priority */
+    unsigned running; /**< entities being processed */
+    unsigned threads; /**< current number of threads */
+    unsigned max_threads; /**< current thread limit */
+    unsigned long completed; /**< entities processed */
+    unsigned long timeouts; /**< entities stopped on timeout */
+    vlc_tick_t avg_wait; /**< average time spent in the queue */
+    vlc_tick_t max_wait; /**< maximum time spent in the queue */
+    vlc_tick_t avg_duration; /**< average processing time */
+};
+
+/**
+ * Get the queue metrics of a background-worker
+ *
+ * Averages are exponentially weighted, so that they follow the recent
+ * behaviour.
+ **/
+void background_worker_GetStats( struct background_worker* worker,
+    struct background_worker_stats *stats );
+
 /**
  * Remove entities from the background-worker
  *
@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -141,6 +142,134 @@ void block_Release(block_t *block)
     block->cbs->free(block);
 }
 
+/* Shared payloads */
+
+typedef struct
+{
+    atomic_uint refs;
+    block_t *origin; /**< owner of the payload memory */
+} block_payload_t;
+
+typedef struct
+{
+    block_t self;
+    block_payload_t *payload;
+} block_shared_t;
+
+static void block_shared_Release (block_t *block)
+{
+    block_shared_t *ref = container_of(block, block_shared_t, self);
+    block_payload_t *payload = ref->payload;
+
+    if (atomic_fetch_sub_explicit(&payload->refs, 1, memory_order_acq_rel) == 1)
+    {
+        block_Release(payload->origin);
+        free(payload);
+    }
+    free(ref);
+}
+
+static const struct vlc_block_callbacks block_shared_cbs =
+{
+    block_shared_Release,
+};
+
+static block_t *block_shared_New (block_payload_t *payload, const block_t *in,
+                                  uint8_t *start, size_t size)
+{
+    block_shared_t *ref = malloc(sizeof (*ref));
+    if (unlikely(ref == NULL))
+        return NULL;
+
+    block_t *b = block_Init(&ref->self, &block_shared_cbs, start, size);
+    b->p_buffer = in->p_buffer;
+    b->i_buffer = in->i_buffer;
+    block_CopyProperties(b, in);
+    ref->payload = payload;
+    return b;
+}
+
+/**
+ * Gives the payload back to its owner if this is the last reference to it.
+ * @return the owner block, or NULL if the payload is still shared
+ */
+static block_t *block_shared_Detach (block_t *block)
+{
+    block_shared_t *ref = container_of(block, block_shared_t, self);
+    block_payload_t *payload = ref->payload;
+
+    if (atomic_load_explicit(&payload->refs, memory_order_acquire) != 1)
+        return NULL;
+
+    block_t *origin = payload->origin;
+    origin->p_buffer = block->p_buffer;
+    origin->i_buffer = block->i_buffer;
+    BlockMetaCopy(origin, block);
+    free(payload);
+    free(ref);
+    return origin;
+}
+
+block_t *block_Share (block_t **pp_block)
+{
+    block_t *block = *pp_block;
+
+    if (block->cbs != &block_shared_cbs)
+    {   /* Hand the payload over to a shared holder */
+        block_payload_t *payload = malloc(sizeof (*payload));
+        if (unlikely(payload == NULL))
+            return NULL;
+
+        atomic_init(&payload->refs, 1);
+        payload->origin = block;
+
+        block_t *first = block_shared_New(payload, block, block->p_buffer,
+                                          block->i_buffer);
+        if (unlikely(first == NULL))
+        {
+            free(payload);
+            return NULL;
+        }
+        first->p_next = block->p_next;
+        block->p_next = NULL;
+        *pp_block = block = first;
+    }
+
+    block_shared_t *ref = container_of(block, block_shared_t, self);
+    block_t *dup = block_shared_New(ref->payload, block, block->p_start,
+                                    block->i_size);
+    if (unlikely(dup == NULL))
+        return NULL;
+
+    atomic_fetch_add_explicit(&ref->payload->refs, 1, memory_order_relaxed);
+    return dup;
+}
+
+bool block_IsShared (const block_t *block)
+{
+    if (block->cbs != &block_shared_cbs)
+        return false;
+
+    const block_shared_t *ref = container_of(block, const block_shared_t, self);
+    return atomic_load_explicit(&ref->payload->refs, memory_order_acquire) > 1;
+}
+
+block_t *block_Unshare (block_t *block)
+{
+    if (block->cbs != &block_shared_cbs)
+        return block;
+
+    block_t *own = block_shared_Detach(block);
+    if (own != NULL)
+        return own;
+
+    own = block_Duplicate(block);
+    if (likely(own != NULL))
+        own->p_next = block->p_next;
+    block_Release(block);
+    return own;
+}
+
 block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 {
     block_Check( p_block );
@@ -175,6 +304,24 @@ block_t *block_TryRealloc (block_t *p_block, ssize_t i_prebody, size_t i_body)
 
     size_t requested = i_prebody + i_body;
 
+    if( p_block->cbs == &block_shared_cbs )
+    {   /* Never write to a shared payload */
+        block_t *p_own = block_shared_Detach( p_block );
+        if( p_own == NULL )
+        {
+            block_t *p_rea = block_Alloc( requested );
+            if( p_rea == NULL )
+                return NULL;
+
+            memcpy( p_rea->p_buffer + i_prebody, p_block->p_buffer,
+                    p_block->i_buffer );
+            BlockMetaCopy( p_rea, p_block );
+            block_Release( p_block );
+            return p_rea;
+        }
+        p_block = p_own;
+    }
+
     if( p_block->i_buffer == 0 )
     {   /* Corner case: nothing to preserve */
         if( requested <= p_block->i_size )
@@ -55,6 +55,12 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+# ifndef EPOLLEXCLUSIVE
+#  define EPOLLEXCLUSIVE (1u << 28)
+# endif
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -69,10 +75,20 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* how often parked connections are checked for inactivity */
+#define HTTPD_SWEEP_PERIOD VLC_TICK_FROM_SEC(1)
+/* maximum number of socket events handled per worker wake-up */
+#define HTTPD_WORKER_EVENTS 64
+
+typedef struct httpd_worker_t httpd_worker_t;
+typedef struct httpd_chunk_t httpd_chunk_t;
+
+/* maximum number of shared stream chunks queued on a client */
+#define HTTPD_CL_CHUNKS 16
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
 
-/* each host run in his own thread */
+/* each host run in its own pool of worker threads */
 struct httpd_host_t
 {
     struct vlc_common_members obj;
@@ -86,7 +102,6 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -96,13 +111,36 @@ struct httpd_host_t
      * */
     struct vlc_list urls;
 
-    size_t client_count;
-    struct vlc_list clients;
+    /* connections are sharded across the workers */
+    unsigned        worker_count;
+    httpd_worker_t *workers;
 
     /* TLS data */
     vlc_tls_server_t *p_tls;
 };
 
+/* Each worker accepts connections on the host listening sockets, and serves
+ * the clients it accepted on its own thread. */
+struct httpd_worker_t
+{
+    httpd_host_t *host;
+    vlc_thread_t  thread;
+    vlc_mutex_t   lock;
+
+    struct vlc_list clients; /* clients with pending work */
+    struct vlc_list idle;    /* clients waiting for socket I/O */
+    size_t          client_count;
+    vlc_tick_t      next_sweep;
+
+#ifdef HAVE_SYS_EPOLL_H
+    int              epfd;
+#else
+    struct pollfd   *ufd;
+    httpd_client_t **ucl;
+    size_t           ufd_size;
+#endif
+};
+
 
 struct httpd_url_t
 {
@@ -145,6 +183,11 @@ struct httpd_client_t
 
     struct vlc_list node;
 
+    /* socket readiness the client is waiting for */
+    int     i_poll_fd;
+    short   i_poll_events;
+    bool    b_polled;
+
     bool    b_stream_mode;
     uint8_t i_state;
 
@@ -156,6 +199,11 @@ struct httpd_client_t
     int     i_buffer;
     uint8_t *p_buffer;
 
+    /* stream data shared with the other clients, sent after p_buffer */
+    httpd_chunk_t *chunks[HTTPD_CL_CHUNKS];
+    unsigned       i_chunks;
+    size_t         i_chunk_offset; /* already sent from the first chunk */
+
     /*
      * If waiting for a keyframe, this is the position (in bytes) of the
      * last keyframe the stream saw before this client connected.
@@ -589,6 +637,41 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+
+/* Immutable piece of stream data, shared by all the clients sending it */
+struct httpd_chunk_t
+{
+    atomic_uint refs;
+    int64_t     i_pos;  /* absolute position of the first byte */
+    size_t      i_size;
+    uint8_t     p_data[];
+};
+
+static httpd_chunk_t *httpd_ChunkNew(const uint8_t *p_data, size_t i_data)
+{
+    httpd_chunk_t *chunk = malloc(sizeof (*chunk) + i_data);
+    if (unlikely(chunk == NULL))
+        return NULL;
+
+    atomic_init(&chunk->refs, 1);
+    chunk->i_pos = 0;
+    chunk->i_size = i_data;
+    memcpy(chunk->p_data, p_data, i_data);
+    return chunk;
+}
+
+static httpd_chunk_t *httpd_ChunkHold(httpd_chunk_t *chunk)
+{
+    atomic_fetch_add_explicit(&chunk->refs, 1, memory_order_relaxed);
+    return chunk;
+}
+
+static void httpd_ChunkRelease(httpd_chunk_t *chunk)
+{
+    if (atomic_fetch_sub_explicit(&chunk->refs, 1, memory_order_acq_rel) == 1)
+        free(chunk);
+}
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -608,9 +691,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* ring of the most recent chunks, oldest first */
+    httpd_chunk_t **pp_chunks;
+    size_t      i_chunks_alloc;
+    size_t      i_chunks_start;
+    size_t      i_chunks;
+    int64_t     i_buffer_size;      /* maximum bytes kept in the ring */
+    int64_t     i_buffer;           /* bytes currently kept in the ring */
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -619,6 +706,14 @@ struct httpd_stream_t
     httpd_header * p_http_headers;
 };
 
+static httpd_chunk_t *httpd_StreamChunk(const httpd_stream_t *stream,
+                                        size_t i)
+{
+    assert(i < stream->i_chunks);
+    return stream->pp_chunks[(stream->i_chunks_start + i)
+                             % stream->i_chunks_alloc];
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -629,47 +724,59 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
-
+        /* clients may be served concurrently by different host workers */
+        vlc_mutex_lock(&stream->lock);
         if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+            goto wait;    /* wait, no data available */
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
             if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
                 /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+                goto wait;
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
+        if (answer->i_body_offset + stream->i_buffer < stream->i_buffer_pos)
             answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+        /* Find the chunk holding the client position */
+        size_t lo = 0, hi = stream->i_chunks;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+
+            if (httpd_StreamChunk(stream, mid)->i_pos <= answer->i_body_offset)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        /* Queue references to the shared chunks, rather than copying them */
+        assert(cl->i_chunks == 0);
+        cl->i_chunk_offset = answer->i_body_offset
+                           - httpd_StreamChunk(stream, lo)->i_pos;
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+        for (size_t i = lo;
+             i < stream->i_chunks && cl->i_chunks < HTTPD_CL_CHUNKS; i++) {
+            httpd_chunk_t *chunk = httpd_StreamChunk(stream, i);
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+            cl->chunks[cl->i_chunks++] = httpd_ChunkHold(chunk);
+            answer->i_body_offset = chunk->i_pos + chunk->i_size;
+        }
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
+        vlc_mutex_unlock(&stream->lock);
 
         return VLC_SUCCESS;
+wait:
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -765,8 +872,12 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
+    stream->pp_chunks = NULL;
+    stream->i_chunks_alloc = 0;
+    stream->i_chunks_start = 0;
+    stream->i_chunks = 0;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_buffer = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,29 +913,54 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static int httpd_AppendChunk(httpd_stream_t *stream, httpd_chunk_t *chunk)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    /* drop the oldest chunks (clients may still hold references) */
+    while (stream->i_chunks > 0
+        && stream->i_buffer + (int64_t)chunk->i_size > stream->i_buffer_size) {
+        httpd_chunk_t *old = httpd_StreamChunk(stream, 0);
+
+        stream->i_buffer -= old->i_size;
+        stream->i_chunks_start = (stream->i_chunks_start + 1)
+                               % stream->i_chunks_alloc;
+        stream->i_chunks--;
+        httpd_ChunkRelease(old);
+    }
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    if (stream->i_chunks == stream->i_chunks_alloc) {
+        size_t alloc = stream->i_chunks_alloc ? 2 * stream->i_chunks_alloc : 64;
+        httpd_chunk_t **tab = vlc_alloc(alloc, sizeof (*tab));
+        if (unlikely(tab == NULL))
+            return VLC_ENOMEM;
+
+        for (size_t i = 0; i < stream->i_chunks; i++)
+            tab[i] = httpd_StreamChunk(stream, i);
+        free(stream->pp_chunks);
+        stream->pp_chunks = tab;
+        stream->i_chunks_alloc = alloc;
+        stream->i_chunks_start = 0;
     }
 
-    stream->i_buffer_pos += i_data;
+    chunk->i_pos = stream->i_buffer_pos;
+    stream->pp_chunks[(stream->i_chunks_start + stream->i_chunks)
+                      % stream->i_chunks_alloc] = chunk;
+    stream->i_chunks++;
+    stream->i_buffer += chunk->i_size;
+    stream->i_buffer_pos += chunk->i_size;
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* The data is copied once, and then shared by all the clients */
+    httpd_chunk_t *chunk = httpd_ChunkNew(p_block->p_buffer,
+                                          p_block->i_buffer);
+    if (unlikely(chunk == NULL))
+        return VLC_ENOMEM;
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
@@ -835,10 +971,12 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    int ret = httpd_AppendChunk(stream, chunk);
 
     vlc_mutex_unlock(&stream->lock);
-    return VLC_SUCCESS;
+    if (unlikely(ret != VLC_SUCCESS))
+        httpd_ChunkRelease(chunk);
+    return ret;
 }
 
 void httpd_StreamDelete(httpd_stream_t *stream)
@@ -852,7 +990,9 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (size_t i = 0; i < stream->i_chunks; i++)
+        httpd_ChunkRelease(httpd_StreamChunk(stream, i));
+    free(stream->pp_chunks);
     free(stream);
 }
 
@@ -860,6 +1000,9 @@ void httpd_StreamDelete(httpd_stream_t *stream)
  * Low level
  *****************************************************************************/
 static void* httpd_HostThread(void *);
+static int httpd_WorkerInit(httpd_worker_t *, httpd_host_t *);
+static void httpd_WorkerClean(httpd_worker_t *);
+static void httpd_WorkerDropUrl(httpd_worker_t *, const httpd_url_t *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_server_t *);
 
@@ -939,6 +1082,9 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     atomic_init(&host->ref, 1);
+    host->fds = NULL;
+    host->workers = NULL;
+    host->worker_count = 0;
 
     char *hostname = var_InheritString(p_this, hostvar);
 
@@ -953,16 +1099,32 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
 
     host->port     = port;
     vlc_list_init(&host->urls);
-    host->client_count = 0;
-    vlc_list_init(&host->clients);
     host->p_tls    = p_tls;
 
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
-        msg_Err(p_this, "cannot spawn http host thread");
+    unsigned threads = var_InheritInteger(p_this, "http-threads");
+    if (threads == 0)
+        threads = vlc_GetCPUCount();
+
+    host->workers = vlc_alloc(threads, sizeof (*host->workers));
+    if (unlikely(host->workers == NULL))
         goto error;
-    }
+
+    for (host->worker_count = 0; host->worker_count < threads;
+         host->worker_count++)
+        if (httpd_WorkerInit(&host->workers[host->worker_count], host))
+            goto error;
+
+    /* create the threads */
+    for (unsigned i = 0; i < host->worker_count; i++)
+        if (vlc_clone(&host->workers[i].thread, httpd_HostThread,
+                      &host->workers[i], VLC_THREAD_PRIORITY_LOW)) {
+            msg_Err(p_this, "cannot spawn http host thread");
+            while (i > 0) {
+                vlc_cancel(host->workers[--i].thread);
+                vlc_join(host->workers[i].thread, NULL);
+            }
+            goto error;
+        }
 
     /* now add it to httpd */
     vlc_list_append(&host->node, &httpd.hosts);
@@ -974,6 +1136,11 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        if (host->workers != NULL) {
+            for (unsigned i = 0; i < host->worker_count; i++)
+                httpd_WorkerClean(&host->workers[i]);
+            free(host->workers);
+        }
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -987,8 +1154,6 @@ error:
 /* delete a host */
 void httpd_HostDelete(httpd_host_t *host)
 {
-    httpd_client_t *client;
-
     vlc_mutex_lock(&httpd.mutex);
 
     if (atomic_fetch_sub_explicit(&host->ref, 1, memory_order_relaxed) > 1) {
@@ -999,15 +1164,16 @@ void httpd_HostDelete(httpd_host_t *host)
     }
 
     vlc_list_remove(&host->node);
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    for (unsigned i = 0; i < host->worker_count; i++)
+        vlc_cancel(host->workers[i].thread);
+    for (unsigned i = 0; i < host->worker_count; i++)
+        vlc_join(host->workers[i].thread, NULL);
 
     msg_Dbg(host, "HTTP host removed");
 
-    vlc_list_foreach(client, &host->clients, node) {
-        msg_Warn(host, "client still connected");
-        httpd_ClientDestroy(client);
-    }
+    for (unsigned i = 0; i < host->worker_count; i++)
+        httpd_WorkerClean(&host->workers[i]);
+    free(host->workers);
 
     assert(vlc_list_is_empty(&host->urls));
     vlc_tls_ServerDelete(host->p_tls);
@@ -1052,7 +1218,7 @@ httpd_url_t *httpd_UrlNew(httpd_host_t *host, const char *psz_url,
     }
 
     vlc_list_append(&url->node, &host->urls);
-    vlc_cond_signal(&host->wait);
+    vlc_cond_broadcast(&host->wait);
     vlc_mutex_unlock(&host->lock);
 
     return url;
@@ -1074,27 +1240,19 @@ int httpd_UrlCatch(httpd_url_t *url, int i_msg, httpd_callback_t cb,
 void httpd_UrlDelete(httpd_url_t *url)
 {
     httpd_host_t *host = url->host;
-    httpd_client_t *client;
 
     vlc_mutex_lock(&host->lock);
     vlc_list_remove(&url->node);
+    vlc_mutex_unlock(&host->lock);
+
+    for (unsigned i = 0; i < host->worker_count; i++)
+        httpd_WorkerDropUrl(&host->workers[i], url);
 
     vlc_mutex_destroy(&url->lock);
     free(url->psz_url);
     free(url->psz_user);
     free(url->psz_password);
-
-    vlc_list_foreach(client, &host->clients, node) {
-        if (client->url != url)
-            continue;
-
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        host->client_count--;
-        httpd_ClientDestroy(client);
-    }
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1174,6 +1332,8 @@ static void httpd_ClientInit(httpd_client_t *cl, vlc_tick_t now)
     cl->i_buffer_size = HTTPD_CL_BUFSIZE;
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
+    cl->i_chunks = 0;
+    cl->i_chunk_offset = 0;
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
 
@@ -1198,6 +1358,8 @@ static void httpd_ClientDestroy(httpd_client_t *cl)
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    for (unsigned i = 0; i < cl->i_chunks; i++)
+        httpd_ChunkRelease(cl->chunks[i]);
     free(cl->p_buffer);
     free(cl);
 }
@@ -1210,6 +1372,9 @@ static httpd_client_t *httpd_ClientNew(vlc_tls_t *sock, vlc_tick_t now)
 
     cl->sock    = sock;
     cl->url     = NULL;
+    cl->i_poll_fd = -1;
+    cl->i_poll_events = 0;
+    cl->b_polled = false;
 
     httpd_ClientInit(cl, now);
     return cl;
@@ -1231,6 +1396,37 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return sock->ops->writev(sock, &iov, 1);
 }
 
+/* Sends the queued shared chunks with a single gathered write */
+static ssize_t httpd_ClientSendChunks(httpd_client_t *cl)
+{
+    vlc_tls_t *sock = cl->sock;
+    struct iovec iov[HTTPD_CL_CHUNKS];
+
+    for (unsigned i = 0; i < cl->i_chunks; i++) {
+        iov[i].iov_base = cl->chunks[i]->p_data;
+        iov[i].iov_len = cl->chunks[i]->i_size;
+    }
+    iov[0].iov_base = (uint8_t *)iov[0].iov_base + cl->i_chunk_offset;
+    iov[0].iov_len -= cl->i_chunk_offset;
+
+    ssize_t val = sock->ops->writev(sock, iov, cl->i_chunks);
+    if (val <= 0)
+        return val;
+
+    size_t i_sent = cl->i_chunk_offset + val;
+    unsigned i_done = 0;
+
+    while (i_done < cl->i_chunks && i_sent >= cl->chunks[i_done]->i_size) {
+        i_sent -= cl->chunks[i_done]->i_size;
+        httpd_ChunkRelease(cl->chunks[i_done++]);
+    }
+
+    cl->i_chunks -= i_done;
+    memmove(cl->chunks, cl->chunks + i_done,
+            cl->i_chunks * sizeof (cl->chunks[0]));
+    cl->i_chunk_offset = i_sent;
+    return val;
+}
 
 static const struct
 {
@@ -1573,12 +1769,19 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
+    /* the shared stream chunks are sent after the private buffer */
+    bool b_chunks = cl->i_buffer >= cl->i_buffer_size && cl->i_chunks > 0;
+
+    if (b_chunks)
+        i_len = httpd_ClientSendChunks(cl);
+    else
+        i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                               cl->i_buffer_size - cl->i_buffer);
     if (i_len >= 0) {
-        cl->i_buffer += i_len;
+        if (!b_chunks)
+            cl->i_buffer += i_len;
 
-        if (cl->i_buffer >= cl->i_buffer_size) {
+        if (cl->i_buffer >= cl->i_buffer_size && cl->i_chunks == 0) {
             if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1600,7 +1803,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
 
                 cl->answer.i_body = 0;
                 cl->answer.p_body = NULL;
-            } else /* send finished */
+            } else if (cl->i_chunks == 0) /* send finished */
                 cl->i_state = HTTPD_CLIENT_SEND_DONE;
         }
     } else {
@@ -1667,367 +1870,636 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Runs the client state machine up to the point where it needs socket I/O.
+ * Returns the poll events the client waits for, or 0 if it has nothing to
+ * wait for (i.e. it is waiting for more stream data). */
+static short httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
 {
-    struct pollfd ufd[host->nfd + host->client_count];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
+    int64_t i_offset;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
 
-    vlc_mutex_lock(&host->lock);
-    /* add all socket that should be read/write and close dead connection */
-    while (vlc_list_is_empty(&host->urls)) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
 
-    vlc_tick_t now = vlc_tick_now();
-    bool b_low_delay = false;
-    httpd_client_t *cl;
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
 
-    int canc = vlc_savecancel();
-    vlc_list_foreach(cl, &host->clients, node) {
-        int64_t i_offset;
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
 
-        if (cl->i_state == HTTPD_CLIENT_DEAD
-         || (cl->i_activity_timeout > 0
-          && cl->i_activity_date + cl->i_activity_timeout < now)) {
-            host->client_count--;
-            httpd_ClientDestroy(cl);
-            continue;
-        }
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+                    if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-        pufd->events = pufd->revents = 0;
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
+                        cl->i_state = HTTPD_CLIENT_DEAD;
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
 
-                httpd_MsgInit(answer);
+                default: {
+                    httpd_url_t *url;
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
+                    /* Search the url and trigger callbacks */
+                    vlc_mutex_lock(&host->lock);
+                    vlc_list_foreach(url, &host->urls, node) {
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
 
-                    case HTTPD_MSG_OPTIONS:
-                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
+                        }
+
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
+
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
+
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+                    vlc_mutex_unlock(&host->lock);
+
+                    if (answer) {
                         answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                            httpd_MsgAdd(answer, "Connection", "close");
+                    }
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
+        }
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                bool do_close = false;
 
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+                cl->url = NULL;
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+                if (cl->query.i_proto != HTTPD_PROTO_HTTP
+                 || cl->query.i_version > 0)
+                {
+                    const char *psz_connection = httpd_MsgGet(&cl->answer,
+                                                             "Connection");
+                    if (psz_connection != NULL)
+                        do_close = !strcasecmp(psz_connection, "close");
+                }
+                else
+                    do_close = true;
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+                if (!do_close) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
-                        }
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    // Allocate an extra byte for the null terminating byte
+                    cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
 
-                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                            httpd_MsgAdd(answer, "Connection", "close");
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            break;
 
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Connection", "close");
+        case HTTPD_CLIENT_WAITING:
+            i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
 
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
 
-                    default: {
-                        httpd_url_t *url;
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        vlc_list_foreach(url, &host->urls, node) {
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+    }
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                            if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                                httpd_MsgAdd(answer, "Connection", "close");
-                        }
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return POLLIN;
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
-                }
-                break;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return POLLOUT;
+    }
+    return 0;
+}
+
+static void httpd_ClientIO(httpd_host_t *host, httpd_client_t *cl,
+                           vlc_tick_t now)
+{
+    cl->i_activity_date = now;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+        case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            httpd_ClientTlsHandshake(host, cl);
+            break;
+    }
+}
+
+/*****************************************************************************
+ * Workers
+ *****************************************************************************/
+static int httpd_WorkerInit(httpd_worker_t *worker, httpd_host_t *host)
+{
+    worker->host = host;
+    vlc_mutex_init(&worker->lock);
+    vlc_list_init(&worker->clients);
+    vlc_list_init(&worker->idle);
+    worker->client_count = 0;
+    worker->next_sweep = VLC_TICK_0;
+
+#ifdef HAVE_SYS_EPOLL_H
+    worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epfd == -1)
+        goto error;
+
+    /* Every worker accepts from the listening sockets: the kernel wakes only
+     * one of them per connection (EPOLLEXCLUSIVE), which spreads the clients
+     * over the workers without any hand-off between threads. */
+    for (unsigned i = 0; i < host->nfd; i++) {
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLEXCLUSIVE,
+            .data.ptr = &host->fds[i],
+        };
+
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+            /* EPOLLEXCLUSIVE requires Linux 4.5 */
+            ev.events = EPOLLIN;
+            if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+                vlc_close(worker->epfd);
+                goto error;
             }
+        }
+    }
+#else
+    worker->ufd = NULL;
+    worker->ucl = NULL;
+    worker->ufd_size = 0;
+#endif
+    return 0;
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    bool do_close = false;
+#ifdef HAVE_SYS_EPOLL_H
+error:
+    msg_Err(host, "cannot create event queue: %s", vlc_strerror_c(errno));
+    vlc_mutex_destroy(&worker->lock);
+    return -1;
+#endif
+}
 
-                    cl->url = NULL;
+static void httpd_WorkerRemove(httpd_worker_t *worker, httpd_client_t *cl)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (cl->b_polled)
+        epoll_ctl(worker->epfd, EPOLL_CTL_DEL, cl->i_poll_fd, NULL);
+#endif
+    worker->client_count--;
+    httpd_ClientDestroy(cl);
+}
 
-                    if (cl->query.i_proto != HTTPD_PROTO_HTTP
-                     || cl->query.i_version > 0)
-                    {
-                        const char *psz_connection = httpd_MsgGet(&cl->answer,
-                                                                 "Connection");
-                        if (psz_connection != NULL)
-                            do_close = !strcasecmp(psz_connection, "close");
-                    }
-                    else
-                        do_close = true;
-
-                    if (!do_close) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        // Allocate an extra byte for the null terminating byte
-                        cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+static void httpd_WorkerClean(httpd_worker_t *worker)
+{
+    httpd_client_t *client;
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+    vlc_list_foreach(client, &worker->idle, node) {
+        msg_Warn(worker->host, "client still connected");
+        httpd_WorkerRemove(worker, client);
+    }
+    vlc_list_foreach(client, &worker->clients, node) {
+        msg_Warn(worker->host, "client still connected");
+        httpd_WorkerRemove(worker, client);
+    }
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
+#ifdef HAVE_SYS_EPOLL_H
+    vlc_close(worker->epfd);
+#else
+    free(worker->ucl);
+    free(worker->ufd);
+#endif
+    vlc_mutex_destroy(&worker->lock);
+}
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
+/* Force closing the connections served by a deleted url. The worker owning
+ * the clients destroys them during its next pass. */
+static void httpd_WorkerDropUrl(httpd_worker_t *worker, const httpd_url_t *url)
+{
+    httpd_client_t *client;
 
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
+    vlc_mutex_lock(&worker->lock);
+    vlc_list_foreach(client, &worker->idle, node) {
+        if (client->url != url)
+            continue;
 
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+        vlc_list_remove(&client->node);
+        vlc_list_append(&client->node, &worker->clients);
+    }
+    vlc_list_foreach(client, &worker->clients, node) {
+        if (client->url != url)
+            continue;
+
+        /* TODO complete it */
+        msg_Warn(worker->host, "force closing connections");
+        client->url = NULL;
+        client->i_state = HTTPD_CLIENT_DEAD;
+    }
+    vlc_mutex_unlock(&worker->lock);
+}
+
+static void httpd_WorkerArm(httpd_worker_t *worker, httpd_client_t *cl,
+                            int fd, short events)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    /* One-shot: the client leaves the event queue as soon as it fires, and
+     * is re-armed once its state machine needs to wait again. */
+    struct epoll_event ev = {
+        .events = EPOLLONESHOT,
+        .data.ptr = cl,
+    };
+
+    if (events & POLLIN)
+        ev.events |= EPOLLIN;
+    if (events & POLLOUT)
+        ev.events |= EPOLLOUT;
+
+    if (epoll_ctl(worker->epfd, cl->b_polled ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                  fd, &ev)) {
+        msg_Err(worker->host, "cannot watch client socket: %s",
+                vlc_strerror_c(errno));
+        cl->i_state = HTTPD_CLIENT_DEAD;
+        return;
+    }
+    cl->b_polled = true;
+#endif
+    cl->i_poll_fd = fd;
+    cl->i_poll_events = events;
+
+    vlc_list_remove(&cl->node);
+    vlc_list_append(&cl->node, &worker->idle);
+}
+
+/* Processes the clients that have pending work, and parks the ones that need
+ * socket I/O. Returns true if some client must be polled again shortly. */
+static bool httpd_WorkerPrepare(httpd_worker_t *worker, vlc_tick_t now)
+{
+    httpd_host_t *host = worker->host;
+    httpd_client_t *cl;
+    bool b_low_delay = false;
+
+    if (now >= worker->next_sweep) {
+        /* check parked connections for inactivity */
+        vlc_list_foreach(cl, &worker->idle, node) {
+            if (cl->i_activity_timeout > 0
+             && cl->i_activity_date + cl->i_activity_timeout < now) {
+                vlc_list_remove(&cl->node);
+                vlc_list_append(&cl->node, &worker->clients);
+            }
+        }
+        worker->next_sweep = now + HTTPD_SWEEP_PERIOD;
+    }
+
+    vlc_list_foreach(cl, &worker->clients, node) {
+        if (cl->i_state == HTTPD_CLIENT_DEAD
+         || (cl->i_activity_timeout > 0
+          && cl->i_activity_date + cl->i_activity_timeout < now)) {
+            httpd_WorkerRemove(worker, cl);
+            continue;
         }
 
-        pufd->fd = vlc_tls_GetPollFD(cl->sock, &pufd->events);
+        short events = httpd_ClientProcess(host, cl);
+        int fd = vlc_tls_GetPollFD(cl->sock, &events);
+
+        if (cl->i_state == HTTPD_CLIENT_DEAD) {
+            httpd_WorkerRemove(worker, cl);
+            continue;
+        }
 
-        if (pufd->events != 0)
-            nfd++;
+        if (events != 0)
+            httpd_WorkerArm(worker, cl, fd, events);
         else
             b_low_delay = true;
     }
-    vlc_mutex_unlock(&host->lock);
-    vlc_restorecancel(canc);
+    return b_low_delay;
+}
 
-    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-    while (poll(ufd, nfd, b_low_delay ? 20 : -1) < 0)
+static void httpd_WorkerAccept(httpd_worker_t *worker, int fd, vlc_tick_t now)
+{
+    httpd_host_t *host = worker->host;
+
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return; /* taken by another worker */
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
+    if (unlikely(sk == NULL))
     {
-        if (errno != EINTR)
-            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+        vlc_close(fd);
+        return;
     }
 
-    canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+        vlc_tls_t *tls;
 
-    /* Handle client sockets */
-    now = vlc_tick_now();
-    nfd = host->nfd;
+        tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
+        if (tls == NULL)
+        {
+            vlc_tls_SessionDelete(sk);
+            return;
+        }
+        sk = tls;
+    }
 
-    vlc_list_foreach(cl, &host->clients, node) {
-        const struct pollfd *pufd = &ufd[nfd];
+    httpd_client_t *cl = httpd_ClientNew(sk, now);
+    if (unlikely(cl == NULL))
+    {
+        vlc_tls_Close(sk);
+        return;
+    }
 
-        assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
+    if (host->p_tls != NULL)
+        cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
 
-        if (vlc_tls_GetFD(cl->sock) != pufd->fd)
-            continue; // we were not waiting for this client
-        ++nfd;
-        if (pufd->revents == 0)
-            continue; // no event received
+    worker->client_count++;
+    vlc_list_append(&cl->node, &worker->clients);
+}
 
-        cl->i_activity_date = now;
+#ifdef HAVE_SYS_EPOLL_H
+static void httpd_WorkerWait(httpd_worker_t *worker, int timeout)
+{
+    httpd_host_t *host = worker->host;
+    struct epoll_event ev[HTTPD_WORKER_EVENTS];
+    int n;
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                httpd_ClientTlsHandshake(host, cl);
-                break;
-        }
+    while ((n = epoll_wait(worker->epfd, ev,
+                            sizeof (ev) / sizeof (ev[0]), timeout)) < 0)
+    {
+        if (errno != EINTR)
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
     }
 
-    /* Handle server sockets (accept new connections) */
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
 
-        if (ufd[nfd].revents == 0)
-            continue;
+    vlc_tick_t now = vlc_tick_now();
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
+    for (int i = 0; i < n; i++) {
+        uintptr_t ptr = (uintptr_t)ev[i].data.ptr;
 
-        vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
-        if (unlikely(sk == NULL))
-        {
-            vlc_close(fd);
+        if (ptr >= (uintptr_t)host->fds
+         && ptr < (uintptr_t)(host->fds + host->nfd)) {
+            /* Handle server sockets (accept new connections) */
+            httpd_WorkerAccept(worker, *(int *)ev[i].data.ptr, now);
             continue;
         }
 
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
-            vlc_tls_t *tls;
-
-            tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
-            if (tls == NULL)
-            {
-                vlc_tls_SessionDelete(sk);
-                continue;
-            }
-            sk = tls;
+        /* Handle client sockets */
+        httpd_client_t *cl = ev[i].data.ptr;
+
+        httpd_ClientIO(host, cl, now);
+        vlc_list_remove(&cl->node);
+        vlc_list_append(&cl->node, &worker->clients);
+    }
+
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
+}
+#else
+static void httpd_WorkerWait(httpd_worker_t *worker, int timeout)
+{
+    httpd_host_t *host = worker->host;
+    httpd_client_t *cl;
+    size_t nfd = host->nfd;
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
+    vlc_list_foreach(cl, &worker->idle, node)
+        nfd++;
+
+    if (nfd > worker->ufd_size) {
+        struct pollfd *ufd = realloc(worker->ufd, nfd * sizeof (*ufd));
+        if (ufd != NULL)
+            worker->ufd = ufd;
+
+        httpd_client_t **ucl = realloc(worker->ucl, nfd * sizeof (*ucl));
+        if (ucl != NULL)
+            worker->ucl = ucl;
+
+        if (unlikely(ufd == NULL || ucl == NULL)) {
+            vlc_mutex_unlock(&worker->lock);
+            vlc_restorecancel(canc);
+            return;
         }
+        worker->ufd_size = nfd;
+    }
 
-        cl = httpd_ClientNew(sk, now);
+    struct pollfd *ufd = worker->ufd;
 
-        if (host->p_tls != NULL)
-            cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
+    nfd = 0;
+    for (unsigned i = 0; i < host->nfd; i++, nfd++) {
+        ufd[nfd].fd = host->fds[i];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+    vlc_list_foreach(cl, &worker->idle, node) {
+        ufd[nfd].fd = cl->i_poll_fd;
+        ufd[nfd].events = cl->i_poll_events;
+        ufd[nfd].revents = 0;
+        worker->ucl[nfd++] = cl;
+    }
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
 
-        host->client_count++;
-        vlc_list_append(&cl->node, &host->clients);
+    while (poll(ufd, nfd, timeout) < 0)
+    {
+        if (errno != EINTR)
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
     }
 
+    canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
+
+    vlc_tick_t now = vlc_tick_now();
+
+    /* Handle client sockets */
+    for (size_t i = host->nfd; i < nfd; i++) {
+        if (ufd[i].revents == 0)
+            continue; // no event received
+
+        cl = worker->ucl[i];
+        httpd_ClientIO(host, cl, now);
+        vlc_list_remove(&cl->node);
+        vlc_list_append(&cl->node, &worker->clients);
+    }
+
+    /* Handle server sockets (accept new connections) */
+    for (unsigned i = 0; i < host->nfd; i++)
+        if (ufd[i].revents != 0)
+            httpd_WorkerAccept(worker, ufd[i].fd, now);
+
+    vlc_mutex_unlock(&worker->lock);
+    vlc_restorecancel(canc);
+}
+#endif
+
+static void httpdLoop(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+
+    vlc_mutex_lock(&host->lock);
+    while (vlc_list_is_empty(&host->urls)) {
+        mutex_cleanup_push(&host->lock);
+        vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+    }
     vlc_mutex_unlock(&host->lock);
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&worker->lock);
+
+    bool b_low_delay = httpd_WorkerPrepare(worker, vlc_tick_now());
+    bool b_idle = worker->client_count == 0;
+
+    vlc_mutex_unlock(&worker->lock);
     vlc_restorecancel(canc);
+
+    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
+    int timeout = -1;
+    if (b_low_delay)
+        timeout = 20;
+    else if (!b_idle)
+        timeout = MS_FROM_VLC_TICK(HTTPD_SWEEP_PERIOD);
+
+    httpd_WorkerWait(worker, timeout);
 }
 
 static void* httpd_HostThread(void *data)
 {
-    httpd_host_t *host = data;
+    httpd_worker_t *worker = data;
+    httpd_host_t *host = worker->host;
 
     while (atomic_load_explicit(&host->ref, memory_order_relaxed) > 0)
-        httpdLoop(host);
+        httpdLoop(worker);
     return NULL;
 }
 
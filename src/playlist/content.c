@@ -25,6 +25,7 @@
 #include "content.h"
 
 #include "control.h"
+#include "index.h"
 #include "item.h"
 #include "notify.h"
 #include "playlist.h"
@@ -36,6 +37,15 @@ vlc_playlist_ClearItems(vlc_playlist_t *playlist)
     vlc_vector_foreach(item, &playlist->items)
         vlc_playlist_item_Release(item);
     vlc_vector_clear(&playlist->items);
+    media_index_Clear(&playlist->media_index);
+    playlist->indexed = 0;
+}
+
+void
+vlc_playlist_InvalidateIndices(vlc_playlist_t *playlist, size_t from)
+{
+    if (from < playlist->indexed)
+        playlist->indexed = from;
 }
 
 static void
@@ -71,8 +81,12 @@ vlc_playlist_ItemsInserted(vlc_playlist_t *playlist, size_t index, size_t count)
     playlist->has_prev = vlc_playlist_ComputeHasPrev(playlist);
     playlist->has_next = vlc_playlist_ComputeHasNext(playlist);
 
-    vlc_playlist_item_t **items = &playlist->items.data[index];
-    vlc_playlist_Notify(playlist, on_items_added, index, items, count);
+    if (!vlc_playlist_batch_Defer(playlist, VLC_PLAYLIST_CHANGE_ADDED, index,
+                                  count))
+    {
+        vlc_playlist_item_t **items = &playlist->items.data[index];
+        vlc_playlist_Notify(playlist, on_items_added, index, items, count);
+    }
     vlc_playlist_state_NotifyChanges(playlist, &state);
 }
 
@@ -149,7 +163,9 @@ vlc_playlist_ItemsRemoved(vlc_playlist_t *playlist, size_t index, size_t count)
     playlist->has_prev = vlc_playlist_ComputeHasPrev(playlist);
     playlist->has_next = vlc_playlist_ComputeHasNext(playlist);
 
-    vlc_playlist_Notify(playlist, on_items_removed, index, count);
+    if (!vlc_playlist_batch_Defer(playlist, VLC_PLAYLIST_CHANGE_REMOVED, index,
+                                  count))
+        vlc_playlist_Notify(playlist, on_items_removed, index, count);
     vlc_playlist_state_NotifyChanges(playlist, &state);
 
     return current_media_changed;
@@ -183,14 +199,32 @@ vlc_playlist_Get(vlc_playlist_t *playlist, size_t index)
     return playlist->items.data[index];
 }
 
+static inline bool
+vlc_playlist_HasIndex(vlc_playlist_t *playlist, const vlc_playlist_item_t *item,
+                      size_t limit)
+{
+    /* an item removed from the playlist keeps its last index */
+    return item->index < limit && playlist->items.data[item->index] == item;
+}
+
 ssize_t
 vlc_playlist_IndexOf(vlc_playlist_t *playlist, const vlc_playlist_item_t *item)
 {
     vlc_playlist_AssertLocked(playlist);
 
-    ssize_t index;
-    vlc_vector_index_of(&playlist->items, item, &index);
-    return index;
+    if (vlc_playlist_HasIndex(playlist, item, playlist->indexed))
+        return item->index;
+
+    /* Renumber the items changed since the last call. Consecutive changes
+     * (like a bulk removal, or a sequence of moves) only cost one pass. */
+    playlist_item_vector_t *items = &playlist->items;
+    for (size_t i = playlist->indexed; i < items->size; ++i)
+        items->data[i]->index = i;
+    playlist->indexed = items->size;
+
+    if (!vlc_playlist_HasIndex(playlist, item, items->size))
+        return -1;
+    return (ssize_t) item->index;
 }
 
 ssize_t
@@ -198,11 +232,24 @@ vlc_playlist_IndexOfMedia(vlc_playlist_t *playlist, const input_item_t *media)
 {
     vlc_playlist_AssertLocked(playlist);
 
+    vlc_playlist_item_t *item;
+    size_t count = media_index_Find(&playlist->media_index, media, &item);
+    if (count == 0)
+        return -1;
+    if (count == 1 && item)
+        return vlc_playlist_IndexOf(playlist, item);
+
+    /* the media is in several items (or in a single item not known anymore),
+     * return the first one */
     playlist_item_vector_t *items = &playlist->items;
     for (size_t i = 0; i < items->size; ++i)
         if (items->data[i]->media == media)
+        {
+            if (count == 1)
+                media_index_SetItem(&playlist->media_index, items->data[i]);
             return i;
-    return -1;
+        }
+    vlc_assert_unreachable();
 }
 
 void
@@ -213,6 +260,7 @@ vlc_playlist_Clear(vlc_playlist_t *playlist)
     int ret = vlc_player_SetCurrentMedia(playlist->player, NULL);
     VLC_UNUSED(ret); /* what could we do? */
 
+    vlc_playlist_batch_Flush(playlist);
     vlc_playlist_ClearItems(playlist);
     vlc_playlist_ItemsReset(playlist);
 }
@@ -238,12 +286,16 @@ vlc_playlist_MediaToItems(input_item_t *const media[], size_t count,
     return VLC_SUCCESS;
 }
 
-int
-vlc_playlist_Insert(vlc_playlist_t *playlist, size_t index,
-                    input_item_t *const media[], size_t count)
+static int
+vlc_playlist_InsertItems(vlc_playlist_t *playlist, size_t index,
+                         input_item_t *const media[], size_t count)
 {
-    vlc_playlist_AssertLocked(playlist);
-    assert(index <= playlist->items.size);
+    vlc_playlist_batch_Prepare(playlist, VLC_PLAYLIST_CHANGE_ADDED, index,
+                               count);
+
+    /* so that adding to the media index cannot fail */
+    if (!media_index_Reserve(&playlist->media_index, count))
+        return VLC_ENOMEM;
 
     /* make space in the vector */
     if (!vlc_vector_insert_hole(&playlist->items, index, count))
@@ -259,9 +311,27 @@ vlc_playlist_Insert(vlc_playlist_t *playlist, size_t index,
         return ret;
     }
 
+    for (size_t i = 0; i < count; ++i)
+        media_index_Add(&playlist->media_index,
+                        playlist->items.data[index + i]);
+    vlc_playlist_InvalidateIndices(playlist, index);
+
     vlc_playlist_ItemsInserted(playlist, index, count);
-    vlc_player_InvalidateNextMedia(playlist->player);
+    return VLC_SUCCESS;
+}
+
+int
+vlc_playlist_Insert(vlc_playlist_t *playlist, size_t index,
+                    input_item_t *const media[], size_t count)
+{
+    vlc_playlist_AssertLocked(playlist);
+    assert(index <= playlist->items.size);
 
+    int ret = vlc_playlist_InsertItems(playlist, index, media, count);
+    if (ret != VLC_SUCCESS)
+        return ret;
+
+    vlc_player_InvalidateNextMedia(playlist->player);
     return VLC_SUCCESS;
 }
 
@@ -273,7 +343,9 @@ vlc_playlist_Move(vlc_playlist_t *playlist, size_t index, size_t count,
     assert(index + count <= playlist->items.size);
     assert(target + count <= playlist->items.size);
 
+    vlc_playlist_batch_Flush(playlist);
     vlc_vector_move_slice(&playlist->items, index, count, target);
+    vlc_playlist_InvalidateIndices(playlist, index < target ? index : target);
 
     vlc_playlist_ItemsMoved(playlist, index, count, target);
     vlc_player_InvalidateNextMedia(playlist->player);
@@ -285,12 +357,19 @@ vlc_playlist_Remove(vlc_playlist_t *playlist, size_t index, size_t count)
     vlc_playlist_AssertLocked(playlist);
     assert(index < playlist->items.size);
 
+    vlc_playlist_batch_Prepare(playlist, VLC_PLAYLIST_CHANGE_REMOVED, index,
+                               count);
     vlc_playlist_ItemsRemoving(playlist, index, count);
 
     for (size_t i = 0; i < count; ++i)
-        vlc_playlist_item_Release(playlist->items.data[index + i]);
+    {
+        vlc_playlist_item_t *item = playlist->items.data[index + i];
+        media_index_Remove(&playlist->media_index, item);
+        vlc_playlist_item_Release(item);
+    }
 
     vlc_vector_remove_slice(&playlist->items, index, count);
+    vlc_playlist_InvalidateIndices(playlist, index);
 
     bool current_media_changed = vlc_playlist_ItemsRemoved(playlist, index,
                                                            count);
@@ -307,6 +386,11 @@ vlc_playlist_Replace(vlc_playlist_t *playlist, size_t index,
     vlc_playlist_AssertLocked(playlist);
     assert(index < playlist->items.size);
 
+    vlc_playlist_batch_Flush(playlist);
+
+    if (!media_index_Reserve(&playlist->media_index, 1))
+        return VLC_ENOMEM;
+
     vlc_playlist_item_t *item = vlc_playlist_item_New(media);
     if (!item)
         return VLC_ENOMEM;
@@ -318,8 +402,11 @@ vlc_playlist_Replace(vlc_playlist_t *playlist, size_t index,
         randomizer_Add(&playlist->randomizer, &item, 1);
     }
 
+    media_index_Remove(&playlist->media_index, playlist->items.data[index]);
+    media_index_Add(&playlist->media_index, item);
     vlc_playlist_item_Release(playlist->items.data[index]);
     playlist->items.data[index] = item;
+    vlc_playlist_InvalidateIndices(playlist, index);
 
     vlc_playlist_ItemReplaced(playlist, index);
     return VLC_SUCCESS;
@@ -342,20 +429,10 @@ vlc_playlist_Expand(vlc_playlist_t *playlist, size_t index,
 
         if (count > 1)
         {
-            /* make space in the vector */
-            if (!vlc_vector_insert_hole(&playlist->items, index + 1, count - 1))
-                return VLC_ENOMEM;
-
-            /* create playlist items in place */
-            ret = vlc_playlist_MediaToItems(&media[1], count - 1,
-                                            &playlist->items.data[index + 1]);
+            ret = vlc_playlist_InsertItems(playlist, index + 1, &media[1],
+                                           count - 1);
             if (ret != VLC_SUCCESS)
-            {
-                /* we were optimistic, it failed, restore the vector state */
-                vlc_vector_remove_slice(&playlist->items, index + 1, count - 1);
                 return ret;
-            }
-            vlc_playlist_ItemsInserted(playlist, index + 1, count - 1);
         }
 
         if ((ssize_t) index == playlist->current)
@@ -28,6 +28,11 @@ typedef struct input_item_t input_item_t;
 void
 vlc_playlist_ClearItems(vlc_playlist_t *playlist);
 
+/* mark the indices stored in the items from a given index as outdated, after
+ * they have been reordered in place */
+void
+vlc_playlist_InvalidateIndices(vlc_playlist_t *playlist, size_t from);
+
 /* expand an item (replace it by the given media array) */
 int
 vlc_playlist_Expand(vlc_playlist_t *playlist, size_t index,
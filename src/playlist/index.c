@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * playlist/index.c
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include "index.h"
+#include "item.h"
+
+/* The media index is an open addressing hash table, with linear probing.
+ *
+ * The keys are the media pointers. An empty slot has a NULL media. Removals
+ * shift the following entries back instead of leaving tombstones, so that the
+ * lookups never degrade after many insertions and removals (which is the
+ * typical usage of a playlist).
+ *
+ * It stores neither the index of the items, which changes on every insertion
+ * or removal before them, nor all the items containing a media: the playlist
+ * keeps the index in the items themselves (see vlc_playlist_IndexOf()), and
+ * only needs the first item for a media. */
+
+struct media_index_entry {
+    const input_item_t *media;
+    vlc_playlist_item_t *item; /* one item containing media, or NULL */
+    size_t count; /* number of items containing media */
+};
+
+static inline size_t
+media_index_Hash(const input_item_t *media, size_t capacity)
+{
+    /* Fibonacci hashing: the low bits of pointers are not random */
+    uint64_t h = (uintptr_t) media * UINT64_C(0x9E3779B97F4A7C15);
+    return (h >> 32) & (capacity - 1);
+}
+
+/* return the slot of media, or the empty slot where to insert it */
+static struct media_index_entry *
+media_index_Slot(struct media_index *index, const input_item_t *media)
+{
+    assert(index->capacity);
+    size_t mask = index->capacity - 1;
+    size_t i = media_index_Hash(media, index->capacity);
+    while (index->entries[i].media && index->entries[i].media != media)
+        i = (i + 1) & mask;
+    return &index->entries[i];
+}
+
+void
+media_index_Init(struct media_index *index)
+{
+    index->entries = NULL;
+    index->capacity = 0;
+    index->size = 0;
+}
+
+void
+media_index_Destroy(struct media_index *index)
+{
+    free(index->entries);
+}
+
+void
+media_index_Clear(struct media_index *index)
+{
+    free(index->entries);
+    media_index_Init(index);
+}
+
+static bool
+media_index_Resize(struct media_index *index, size_t capacity)
+{
+    struct media_index_entry *old = index->entries;
+    size_t old_capacity = index->capacity;
+
+    index->entries = vlc_alloc(capacity, sizeof(*index->entries));
+    if (unlikely(!index->entries))
+    {
+        index->entries = old;
+        return false;
+    }
+    for (size_t i = 0; i < capacity; ++i)
+        index->entries[i].media = NULL;
+    index->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; ++i)
+        if (old[i].media)
+            *media_index_Slot(index, old[i].media) = old[i];
+
+    free(old);
+    return true;
+}
+
+bool
+media_index_Reserve(struct media_index *index, size_t count)
+{
+    if (count > (SIZE_MAX / 4 - index->size))
+        return false;
+
+    /* keep the load factor below 3/4 */
+    size_t needed = (index->size + count) * 4 / 3 + 1;
+    if (needed <= index->capacity)
+        return true;
+
+    size_t capacity = index->capacity ? index->capacity : 16;
+    while (capacity < needed)
+        capacity *= 2;
+    return media_index_Resize(index, capacity);
+}
+
+void
+media_index_Add(struct media_index *index, vlc_playlist_item_t *item)
+{
+    assert(index->size < index->capacity); /* must have been reserved */
+
+    struct media_index_entry *entry = media_index_Slot(index, item->media);
+    if (entry->media)
+    {
+        entry->count++;
+        return;
+    }
+
+    entry->media = item->media;
+    entry->item = item;
+    entry->count = 1;
+    index->size++;
+}
+
+static void
+media_index_RemoveAt(struct media_index *index, size_t i)
+{
+    size_t mask = index->capacity - 1;
+    size_t j = i;
+    for (;;)
+    {
+        j = (j + 1) & mask;
+        const input_item_t *media = index->entries[j].media;
+        if (!media)
+            break;
+
+        /* the entry at j may fill the hole at i only if its ideal slot is not
+         * (cyclically) in (i, j] */
+        size_t k = media_index_Hash(media, index->capacity);
+        bool in_range = i < j ? (k > i && k <= j) : (k > i || k <= j);
+        if (!in_range)
+        {
+            index->entries[i] = index->entries[j];
+            i = j;
+        }
+    }
+    index->entries[i].media = NULL;
+    index->size--;
+}
+
+void
+media_index_Remove(struct media_index *index, vlc_playlist_item_t *item)
+{
+    struct media_index_entry *entry = media_index_Slot(index, item->media);
+    assert(entry->media == item->media);
+    assert(entry->count > 0);
+
+    if (--entry->count == 0)
+        media_index_RemoveAt(index, entry - index->entries);
+    else if (entry->item == item)
+        /* another item contains the same media, but which one? */
+        entry->item = NULL;
+}
+
+size_t
+media_index_Find(struct media_index *index, const input_item_t *media,
+                 vlc_playlist_item_t **item)
+{
+    if (!index->capacity)
+        return 0;
+
+    struct media_index_entry *entry = media_index_Slot(index, media);
+    if (!entry->media)
+        return 0;
+
+    *item = entry->item;
+    return entry->count;
+}
+
+void
+media_index_SetItem(struct media_index *index, vlc_playlist_item_t *item)
+{
+    struct media_index_entry *entry = media_index_Slot(index, item->media);
+    assert(entry->media == item->media);
+    entry->item = item;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * playlist/index.h
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_PLAYLIST_INDEX_H
+#define VLC_PLAYLIST_INDEX_H
+
+#include <vlc_common.h>
+
+typedef struct vlc_playlist_item vlc_playlist_item_t;
+typedef struct input_item_t input_item_t;
+
+/**
+ * Hash map from a media to the playlist items containing it.
+ *
+ * The same media may be inserted several times in the playlist, so each
+ * entry stores the number of items containing the media, and one of them
+ * when it is known.
+ *
+ * See index.c for implementation details.
+ */
+struct media_index {
+    struct media_index_entry *entries;
+    size_t capacity; /* 0 or a power of 2 */
+    size_t size; /* number of entries */
+};
+
+/**
+ * Initialize an empty media index.
+ */
+void
+media_index_Init(struct media_index *index);
+
+/**
+ * Destroy a media index.
+ */
+void
+media_index_Destroy(struct media_index *index);
+
+/**
+ * Remove all the entries.
+ */
+void
+media_index_Clear(struct media_index *index);
+
+/**
+ * Make room for count more items, so that media_index_Add() does not fail.
+ */
+bool
+media_index_Reserve(struct media_index *index, size_t count);
+
+/**
+ * Register a new item.
+ *
+ * The space must have been reserved by media_index_Reserve().
+ */
+void
+media_index_Add(struct media_index *index, vlc_playlist_item_t *item);
+
+/**
+ * Unregister an item.
+ */
+void
+media_index_Remove(struct media_index *index, vlc_playlist_item_t *item);
+
+/**
+ * Return the number of items containing a media.
+ *
+ * If it is not 0, *item is set to one of these items, or to NULL if it is not
+ * known (after removals).
+ */
+size_t
+media_index_Find(struct media_index *index, const input_item_t *media,
+                 vlc_playlist_item_t **item);
+
+/**
+ * Remember the item containing a media, found by other means.
+ */
+void
+media_index_SetItem(struct media_index *index, vlc_playlist_item_t *item);
+
+#endif
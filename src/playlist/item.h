@@ -30,6 +30,7 @@ struct vlc_playlist_item
 {
     input_item_t *media;
     vlc_atomic_rc_t rc;
+    size_t index; /**< position in the playlist, see vlc_playlist.indexed */
 };
 
 /* _New() is private, it is called when inserting new media in the playlist */
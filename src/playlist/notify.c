@@ -58,6 +58,8 @@ vlc_playlist_AddListener(vlc_playlist_t *playlist,
 
     listener->cbs = cbs;
     listener->userdata = userdata;
+    /* the new listener must not receive changes made before it was added */
+    vlc_playlist_batch_Flush(playlist);
     vlc_list_append(&listener->node, &playlist->listeners);
 
     if (notify_current_state)
@@ -89,6 +91,10 @@ void
 vlc_playlist_state_NotifyChanges(vlc_playlist_t *playlist,
                                  struct vlc_playlist_state *saved_state)
 {
+    if (playlist->batch.depth)
+        /* notified once by vlc_playlist_EndBatch() */
+        return;
+
     if (saved_state->current != playlist->current)
         vlc_playlist_Notify(playlist, on_current_index_changed, playlist->current);
     if (saved_state->has_prev != playlist->has_prev)
@@ -97,6 +103,125 @@ vlc_playlist_state_NotifyChanges(vlc_playlist_t *playlist,
         vlc_playlist_Notify(playlist, on_has_next_changed, playlist->has_next);
 }
 
+void
+vlc_playlist_batch_Init(struct vlc_playlist_batch *batch)
+{
+    batch->depth = 0;
+    batch->pending = VLC_PLAYLIST_CHANGE_OTHER;
+    batch->index = 0;
+    batch->count = 0;
+}
+
+static bool
+vlc_playlist_batch_CanMerge(struct vlc_playlist_batch *batch,
+                            enum vlc_playlist_change change,
+                            size_t index, size_t count)
+{
+    if (change != batch->pending)
+        return false;
+
+    switch (change)
+    {
+        case VLC_PLAYLIST_CHANGE_ADDED:
+            /* the new items are adjacent to (or inside) the pending slice */
+            return index >= batch->index
+                && index <= batch->index + batch->count;
+        case VLC_PLAYLIST_CHANGE_REMOVED:
+            /* the removed items are just before or just after the pending
+             * slice (which has already been removed) */
+            return index == batch->index || index + count == batch->index;
+        default:
+            return false;
+    }
+}
+
+void
+vlc_playlist_batch_Prepare(vlc_playlist_t *playlist,
+                           enum vlc_playlist_change change,
+                           size_t index, size_t count)
+{
+    vlc_playlist_AssertLocked(playlist);
+
+    struct vlc_playlist_batch *batch = &playlist->batch;
+
+    /* a listener may change the playlist from the callbacks, deferring a new
+     * change: notify it too, before the caller changes the items */
+    while (batch->pending != VLC_PLAYLIST_CHANGE_OTHER
+        && !vlc_playlist_batch_CanMerge(batch, change, index, count))
+    {
+        enum vlc_playlist_change pending = batch->pending;
+        size_t pending_index = batch->index;
+        size_t pending_count = batch->count;
+
+        /* reset before notifying, so that the listener changes are deferred
+         * separately */
+        batch->pending = VLC_PLAYLIST_CHANGE_OTHER;
+
+        /* the items are unchanged since the pending change */
+        if (pending == VLC_PLAYLIST_CHANGE_ADDED)
+            vlc_playlist_Notify(playlist, on_items_added, pending_index,
+                                &playlist->items.data[pending_index],
+                                pending_count);
+        else
+            vlc_playlist_Notify(playlist, on_items_removed, pending_index,
+                                pending_count);
+    }
+}
+
+bool
+vlc_playlist_batch_Defer(vlc_playlist_t *playlist,
+                         enum vlc_playlist_change change,
+                         size_t index, size_t count)
+{
+    struct vlc_playlist_batch *batch = &playlist->batch;
+    if (!batch->depth)
+        return false;
+
+    if (batch->pending == VLC_PLAYLIST_CHANGE_OTHER)
+    {
+        batch->pending = change;
+        batch->index = index;
+        batch->count = count;
+    }
+    else
+    {
+        /* vlc_playlist_batch_Prepare() checked that they can be merged */
+        assert(vlc_playlist_batch_CanMerge(batch, change, index, count));
+        if (index < batch->index)
+            batch->index = index;
+        batch->count += count;
+    }
+    return true;
+}
+
+void
+vlc_playlist_BeginBatch(vlc_playlist_t *playlist)
+{
+    vlc_playlist_AssertLocked(playlist);
+
+    if (playlist->batch.depth++ == 0)
+        vlc_playlist_state_Save(playlist, &playlist->batch.state);
+}
+
+void
+vlc_playlist_EndBatch(vlc_playlist_t *playlist)
+{
+    vlc_playlist_AssertLocked(playlist);
+    assert(playlist->batch.depth > 0);
+
+    if (playlist->batch.depth > 1)
+    {
+        playlist->batch.depth--;
+        return;
+    }
+
+    /* end the batch first: the changes made by listeners from the callbacks
+     * are notified immediately */
+    playlist->batch.depth = 0;
+    vlc_playlist_batch_Flush(playlist);
+    vlc_playlist_state_NotifyChanges(playlist, &playlist->batch.state);
+}
+
 static inline bool
 vlc_playlist_HasItemUpdatedListeners(vlc_playlist_t *playlist)
 {
@@ -115,6 +240,9 @@ vlc_playlist_NotifyMediaUpdated(vlc_playlist_t *playlist, input_item_t *media)
         /* no need to find the index if there are no listeners */
         return;
 
+    /* the listeners must know the item before it is updated */
+    vlc_playlist_batch_Flush(playlist);
+
     ssize_t index;
     if (playlist->current != -1 &&
             playlist->items.data[playlist->current]->media == media)
@@ -123,7 +251,7 @@ vlc_playlist_NotifyMediaUpdated(vlc_playlist_t *playlist, input_item_t *media)
         index = playlist->current;
     else
     {
-        /* linear search */
+        /* lookup in the media index */
         index = vlc_playlist_IndexOfMedia(playlist, media);
         if (index == -1)
             return;
@@ -39,6 +39,27 @@ struct vlc_playlist_state {
     bool has_next;
 };
 
+enum vlc_playlist_change {
+    VLC_PLAYLIST_CHANGE_OTHER,
+    VLC_PLAYLIST_CHANGE_ADDED,
+    VLC_PLAYLIST_CHANGE_REMOVED,
+};
+
+/**
+ * Notifications deferred by vlc_playlist_BeginBatch().
+ *
+ * Consecutive insertions (or removals) forming a single slice are notified
+ * once, and the state (current index, has_prev and has_next) is notified
+ * at the end of the batch, only if it changed.
+ */
+struct vlc_playlist_batch {
+    unsigned depth; /**< number of nested batches */
+    struct vlc_playlist_state state; /**< state when the batch began */
+    enum vlc_playlist_change pending; /**< change not notified yet */
+    size_t index; /**< index of the pending slice */
+    size_t count; /**< size of the pending slice */
+};
+
 #define vlc_playlist_listener_foreach(listener, playlist) \
     vlc_list_foreach(listener, &(playlist)->listeners, node)
 
@@ -67,4 +88,28 @@ vlc_playlist_state_NotifyChanges(vlc_playlist_t *playlist,
 void
 vlc_playlist_NotifyMediaUpdated(vlc_playlist_t *playlist, input_item_t *media);
 
+void
+vlc_playlist_batch_Init(struct vlc_playlist_batch *batch);
+
+/* must be called before changing the items: notify the pending change unless
+ * the new one will be merged with it */
+void
+vlc_playlist_batch_Prepare(vlc_playlist_t *playlist,
+                           enum vlc_playlist_change change,
+                           size_t index, size_t count);
+
+/* notify the pending change, if any */
+static inline void
+vlc_playlist_batch_Flush(vlc_playlist_t *playlist)
+{
+    vlc_playlist_batch_Prepare(playlist, VLC_PLAYLIST_CHANGE_OTHER, 0, 0);
+}
+
+/* called once the items have been changed; return true if the notification
+ * is deferred (the caller must not notify) */
+bool
+vlc_playlist_batch_Defer(vlc_playlist_t *playlist,
+                         enum vlc_playlist_change change,
+                         size_t index, size_t count);
+
 #endif
@@ -45,7 +45,10 @@ vlc_playlist_New(vlc_object_t *parent)
     }
 
     vlc_vector_init(&playlist->items);
+    playlist->indexed = 0;
+    media_index_Init(&playlist->media_index);
     randomizer_Init(&playlist->randomizer);
+    vlc_playlist_batch_Init(&playlist->batch);
     playlist->current = -1;
     playlist->has_prev = false;
     playlist->has_next = false;
@@ -64,6 +67,7 @@ vlc_playlist_Delete(vlc_playlist_t *playlist)
     vlc_playlist_PlayerDestroy(playlist);
     randomizer_Destroy(&playlist->randomizer);
     vlc_playlist_ClearItems(playlist);
+    media_index_Destroy(&playlist->media_index);
     free(playlist);
 }
 
@@ -25,6 +25,8 @@
 #include <vlc_playlist.h>
 #include <vlc_vector.h>
 #include "../input/player.h"
+#include "index.h"
+#include "notify.h"
 #include "randomizer.h"
 
 typedef struct input_item_t input_item_t;
@@ -50,7 +52,12 @@ struct vlc_playlist
     /* all remaining fields are protected by the lock of the player */
     struct vlc_player_listener_id *player_listener;
     playlist_item_vector_t items;
+    /* the items before this index know their own index (in their index
+     * field); the following ones are renumbered on demand */
+    size_t indexed;
+    struct media_index media_index;
     struct randomizer randomizer;
+    struct vlc_playlist_batch batch;
     ssize_t current;
     bool has_prev;
     bool has_next;
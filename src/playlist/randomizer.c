@@ -531,12 +531,60 @@ randomizer_RemoveOne(struct randomizer *r, const vlc_playlist_item_t *item)
     randomizer_RemoveAt(r, index);
 }
 
+static int
+cmp_item(const void *lhs, const void *rhs)
+{
+    uintptr_t a = (uintptr_t) *(vlc_playlist_item_t *const *) lhs;
+    uintptr_t b = (uintptr_t) *(vlc_playlist_item_t *const *) rhs;
+    if (a < b)
+        return -1;
+    if (a == b)
+        return 0;
+    return 1;
+}
+
+static bool
+randomizer_RemoveMany(struct randomizer *r, vlc_playlist_item_t *const items[],
+                      size_t count)
+{
+    /* locate all the items in a single pass, instead of one linear search per
+     * item */
+    vlc_playlist_item_t **sorted = vlc_alloc(count, sizeof(*sorted));
+    size_t *indices = vlc_alloc(count, sizeof(*indices));
+    if (unlikely(!sorted || !indices))
+    {
+        free(sorted);
+        free(indices);
+        return false;
+    }
+
+    memcpy(sorted, items, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), cmp_item);
+
+    size_t found = 0;
+    for (size_t i = 0; i < r->items.size; ++i)
+        if (bsearch(&r->items.data[i], sorted, count, sizeof(*sorted),
+                    cmp_item))
+            indices[found++] = i;
+    assert(found == count); /* items must exist */
+
+    /* removing an item never moves the items before it, so remove them from
+     * the last one */
+    while (found)
+        randomizer_RemoveAt(r, indices[--found]);
+
+    free(sorted);
+    free(indices);
+    return true;
+}
+
 void
 randomizer_Remove(struct randomizer *r, vlc_playlist_item_t *const items[],
                   size_t count)
 {
-    for (size_t i = 0; i < count; ++i)
-        randomizer_RemoveOne(r, items[i]);
+    if (count < 2 || !randomizer_RemoveMany(r, items, count))
+        for (size_t i = 0; i < count; ++i)
+            randomizer_RemoveOne(r, items[i]);
 
     vlc_vector_autoshrink(&r->items);
 }
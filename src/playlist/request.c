@@ -221,7 +221,9 @@ vlc_playlist_RequestMove(vlc_playlist_t *playlist,
             target = size - 1;
 
         /* keep the items in the same order as the request (do not sort them) */
+        vlc_playlist_BeginBatch(playlist);
         vlc_playlist_MoveBySlices(playlist, vector.data, vector.size, target);
+        vlc_playlist_EndBatch(playlist);
     }
 
     vlc_vector_destroy(&vector);
@@ -246,7 +248,9 @@ vlc_playlist_RequestRemove(vlc_playlist_t *playlist,
         /* sort so that removing an item does not shift the other indices */
         qsort(vector.data, vector.size, sizeof(vector.data[0]), cmp_size);
 
+        vlc_playlist_BeginBatch(playlist);
         vlc_playlist_RemoveBySlices(playlist, vector.data, vector.size);
+        vlc_playlist_EndBatch(playlist);
     }
 
     vlc_vector_destroy(&vector);
@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <vlc_rand.h>
+#include "content.h"
 #include "control.h"
 #include "item.h"
 #include "notify.h"
@@ -46,6 +47,8 @@ vlc_playlist_Shuffle(vlc_playlist_t *playlist)
     unsigned short xsubi[3];
     vlc_rand_bytes(xsubi, sizeof(xsubi));
 
+    vlc_playlist_batch_Flush(playlist);
+
     /* Fisher-Yates shuffle */
     for (size_t i = playlist->items.size - 1; i != 0; --i)
     {
@@ -56,6 +59,7 @@ vlc_playlist_Shuffle(vlc_playlist_t *playlist)
         playlist->items.data[i] = playlist->items.data[selected];
         playlist->items.data[selected] = tmp;
     }
+    vlc_playlist_InvalidateIndices(playlist, 0);
 
     struct vlc_playlist_state state;
     if (current)
@@ -24,6 +24,7 @@
 
 #include <vlc_common.h>
 #include <vlc_rand.h>
+#include "content.h"
 #include "control.h"
 #include "item.h"
 #include "notify.h"
@@ -379,9 +380,12 @@ vlc_playlist_Sort(vlc_playlist_t *playlist,
 
     qsort_r(array, playlist->items.size, sizeof(*array), compare_meta, &req);
 
+    vlc_playlist_batch_Flush(playlist);
+
     /* apply the sorting result to the playlist */
     for (size_t i = 0; i < playlist->items.size; ++i)
         playlist->items.data[i] = array[i]->item;
+    vlc_playlist_InvalidateIndices(playlist, 0);
 
     vlc_playlist_DeleteMetaArray(array, playlist->items.size);
 
@@ -1063,6 +1063,241 @@ test_index_of(void)
     vlc_playlist_Delete(playlist);
 }
 
+static void
+test_index_of_after_changes(void)
+{
+    vlc_playlist_t *playlist = vlc_playlist_New(NULL);
+    assert(playlist);
+
+    input_item_t *media[10];
+    CreateDummyMediaArray(media, 10);
+
+    /* initial playlist with 10 items */
+    int ret = vlc_playlist_Append(playlist, media, 10);
+    assert(ret == VLC_SUCCESS);
+
+    /* add media 3 twice more, at 0 and at the end */
+    ret = vlc_playlist_InsertOne(playlist, 0, media[3]);
+    assert(ret == VLC_SUCCESS);
+    ret = vlc_playlist_AppendOne(playlist, media[3]);
+    assert(ret == VLC_SUCCESS);
+
+    /* the first occurrence is returned */
+    assert(vlc_playlist_IndexOfMedia(playlist, media[3]) == 0);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[5]) == 6);
+
+    vlc_playlist_RemoveOne(playlist, 0);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[3]) == 3);
+    vlc_playlist_RemoveOne(playlist, 3);
+    /* a single occurrence remains */
+    assert(vlc_playlist_IndexOfMedia(playlist, media[3]) == 9);
+    vlc_playlist_RemoveOne(playlist, 9);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[3]) == -1);
+
+    /* playlist: 0 1 2 4 5 6 7 8 9 */
+    vlc_playlist_Move(playlist, 1, 2, 6);
+    vlc_playlist_Move(playlist, 0, 1, 8);
+    /* playlist: 4 5 6 7 8 1 2 9 0 */
+    assert(vlc_playlist_IndexOfMedia(playlist, media[1]) == 5);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[0]) == 8);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[4]) == 0);
+
+    vlc_playlist_Shuffle(playlist);
+    for (size_t i = 0; i < vlc_playlist_Count(playlist); ++i)
+    {
+        vlc_playlist_item_t *item = vlc_playlist_Get(playlist, i);
+        assert(vlc_playlist_IndexOf(playlist, item) == (ssize_t) i);
+        assert(vlc_playlist_IndexOfMedia(playlist, item->media)
+                == (ssize_t) i);
+    }
+
+    vlc_playlist_Clear(playlist);
+    assert(vlc_playlist_IndexOfMedia(playlist, media[4]) == -1);
+
+    DestroyMediaArray(media, 10);
+    vlc_playlist_Delete(playlist);
+}
+
+static void
+test_batch(void)
+{
+    vlc_playlist_t *playlist = vlc_playlist_New(NULL);
+    assert(playlist);
+
+    input_item_t *media[10];
+    CreateDummyMediaArray(media, 10);
+
+    struct vlc_playlist_callbacks cbs = {
+        .on_items_added = callback_on_items_added,
+        .on_items_removed = callback_on_items_removed,
+        .on_has_next_changed = callback_on_has_next_changed,
+    };
+
+    struct callback_ctx ctx = CALLBACK_CTX_INITIALIZER;
+    vlc_playlist_listener_id *listener =
+            vlc_playlist_AddListener(playlist, &cbs, &ctx, false);
+    assert(listener);
+
+    vlc_playlist_BeginBatch(playlist);
+
+    /* add 10 items by chunks */
+    for (size_t i = 0; i < 10; i += 2)
+    {
+        int ret = vlc_playlist_Append(playlist, &media[i], 2);
+        assert(ret == VLC_SUCCESS);
+    }
+    assert(ctx.vec_items_added.size == 0);
+
+    vlc_playlist_EndBatch(playlist);
+
+    assert(ctx.vec_items_added.size == 1);
+    assert(ctx.vec_items_added.data[0].index == 0);
+    assert(ctx.vec_items_added.data[0].count == 10);
+    assert(ctx.vec_items_added.data[0].state.playlist_size == 10);
+
+    assert(ctx.vec_has_next_changed.size == 1);
+    assert(ctx.vec_has_next_changed.data[0].has_next);
+
+    callback_ctx_reset(&ctx);
+
+    vlc_playlist_BeginBatch(playlist);
+    /* remove 4, 5, 3 then 6: a single slice */
+    vlc_playlist_RemoveOne(playlist, 4);
+    vlc_playlist_RemoveOne(playlist, 4);
+    vlc_playlist_RemoveOne(playlist, 3);
+    vlc_playlist_RemoveOne(playlist, 3);
+    assert(ctx.vec_items_removed.size == 0);
+
+    /* not contiguous, the pending slice is notified */
+    vlc_playlist_RemoveOne(playlist, 0);
+    assert(ctx.vec_items_removed.size == 1);
+    assert(ctx.vec_items_removed.data[0].index == 3);
+    assert(ctx.vec_items_removed.data[0].count == 4);
+
+    /* another kind of change, the pending slice is notified */
+    int ret = vlc_playlist_InsertOne(playlist, 1, media[0]);
+    assert(ret == VLC_SUCCESS);
+    assert(ctx.vec_items_removed.size == 2);
+    assert(ctx.vec_items_removed.data[1].index == 0);
+    assert(ctx.vec_items_removed.data[1].count == 1);
+    assert(ctx.vec_items_added.size == 0);
+
+    vlc_playlist_EndBatch(playlist);
+
+    assert(ctx.vec_items_added.size == 1);
+    assert(ctx.vec_items_added.data[0].index == 1);
+    assert(ctx.vec_items_added.data[0].count == 1);
+    assert(ctx.vec_has_next_changed.size == 0);
+
+    /* playlist: 1 0 2 7 8 9 */
+    EXPECT_AT(0, 1);
+    EXPECT_AT(1, 0);
+    EXPECT_AT(2, 2);
+    EXPECT_AT(3, 7);
+
+    callback_ctx_destroy(&ctx);
+    vlc_playlist_RemoveListener(playlist, listener);
+    DestroyMediaArray(media, 10);
+    vlc_playlist_Delete(playlist);
+}
+
+struct append_once_ctx
+{
+    input_item_t *media; /* appended on the next items added, or NULL */
+};
+
+static void
+callback_append_once(vlc_playlist_t *playlist, size_t index,
+                     vlc_playlist_item_t *const items[], size_t count,
+                     void *userdata)
+{
+    VLC_UNUSED(index); VLC_UNUSED(items); VLC_UNUSED(count);
+    struct append_once_ctx *ctx = userdata;
+
+    input_item_t *media = ctx->media;
+    if (!media)
+        return;
+    ctx->media = NULL;
+    int ret = vlc_playlist_AppendOne(playlist, media);
+    assert(ret == VLC_SUCCESS);
+}
+
+static void
+test_batch_listener_changes(void)
+{
+    vlc_playlist_t *playlist = vlc_playlist_New(NULL);
+    assert(playlist);
+
+    input_item_t *media[10];
+    CreateDummyMediaArray(media, 10);
+
+    struct vlc_playlist_callbacks cbs = {
+        .on_items_added = callback_on_items_added,
+        .on_items_removed = callback_on_items_removed,
+    };
+
+    struct callback_ctx ctx = CALLBACK_CTX_INITIALIZER;
+    vlc_playlist_listener_id *listener =
+            vlc_playlist_AddListener(playlist, &cbs, &ctx, false);
+    assert(listener);
+
+    /* registered last, so that the first listener is notified of the pending
+     * change before the change made from the callback */
+    struct vlc_playlist_callbacks append_cbs = {
+        .on_items_added = callback_append_once,
+    };
+
+    struct append_once_ctx append_ctx = { media[9] };
+    vlc_playlist_listener_id *append_listener =
+            vlc_playlist_AddListener(playlist, &append_cbs, &append_ctx, false);
+    assert(append_listener);
+
+    /* a listener appends an item when the batch ends */
+    vlc_playlist_BeginBatch(playlist);
+    int ret = vlc_playlist_Append(playlist, &media[0], 2);
+    assert(ret == VLC_SUCCESS);
+    vlc_playlist_EndBatch(playlist);
+
+    assert(vlc_playlist_Count(playlist) == 3);
+    assert(ctx.vec_items_added.size == 2);
+    assert(ctx.vec_items_added.data[0].index == 0);
+    assert(ctx.vec_items_added.data[0].count == 2);
+    assert(ctx.vec_items_added.data[1].index == 2);
+    assert(ctx.vec_items_added.data[1].count == 1);
+
+    callback_ctx_reset(&ctx);
+
+    /* a listener appends an item when a pending slice is notified during the
+     * batch */
+    append_ctx.media = media[8];
+    vlc_playlist_BeginBatch(playlist);
+    ret = vlc_playlist_Append(playlist, &media[2], 2);
+    assert(ret == VLC_SUCCESS);
+    vlc_playlist_RemoveOne(playlist, 0);
+    vlc_playlist_EndBatch(playlist);
+
+    /* playlist: 1 9 2 3 8 */
+    assert(vlc_playlist_Count(playlist) == 5);
+    assert(ctx.vec_items_added.size == 2);
+    assert(ctx.vec_items_added.data[0].index == 3);
+    assert(ctx.vec_items_added.data[0].count == 2);
+    assert(ctx.vec_items_added.data[1].index == 5);
+    assert(ctx.vec_items_added.data[1].count == 1);
+    assert(ctx.vec_items_removed.size == 1);
+    assert(ctx.vec_items_removed.data[0].index == 0);
+    assert(ctx.vec_items_removed.data[0].count == 1);
+
+    EXPECT_AT(0, 1);
+    EXPECT_AT(1, 9);
+    EXPECT_AT(4, 8);
+
+    callback_ctx_destroy(&ctx);
+    vlc_playlist_RemoveListener(playlist, append_listener);
+    vlc_playlist_RemoveListener(playlist, listener);
+    DestroyMediaArray(media, 10);
+    vlc_playlist_Delete(playlist);
+}
+
 static void
 test_prev(void)
 {
@@ -2246,6 +2481,105 @@ test_sort(void)
 
 #undef EXPECT_AT
 
+#define BENCH_CHUNK 1000
+#define BENCH_LOOKUPS 100000
+#define BENCH_CHANGES 1000
+
+static void
+bench_report(const char *name, size_t size, size_t count, vlc_tick_t elapsed)
+{
+    printf("%-12s %7zu items: %6zu calls in %8"PRId64" us\n", name, size,
+           count, US_FROM_VLC_TICK(elapsed));
+}
+
+static void
+bench_size(size_t size)
+{
+    input_item_t **media = vlc_alloc(size, sizeof(*media));
+    assert(media);
+    CreateDummyMediaArray(media, size);
+
+    vlc_playlist_t *playlist = vlc_playlist_New(NULL);
+    assert(playlist);
+    /* also update the randomizer */
+    vlc_playlist_SetPlaybackOrder(playlist, VLC_PLAYLIST_PLAYBACK_ORDER_RANDOM);
+
+    unsigned short xsubi[3] = { 1, 2, 3 };
+    vlc_tick_t start;
+
+    /* insert by chunks, as when loading a playlist */
+    start = vlc_tick_now();
+    vlc_playlist_BeginBatch(playlist);
+    for (size_t i = 0; i < size; i += BENCH_CHUNK)
+    {
+        size_t count = size - i < BENCH_CHUNK ? size - i : BENCH_CHUNK;
+        int ret = vlc_playlist_Append(playlist, &media[i], count);
+        assert(ret == VLC_SUCCESS);
+    }
+    vlc_playlist_EndBatch(playlist);
+    bench_report("Insert", size, size / BENCH_CHUNK, vlc_tick_now() - start);
+
+    start = vlc_tick_now();
+    for (size_t i = 0; i < BENCH_LOOKUPS; ++i)
+    {
+        size_t index = nrand48(xsubi) % size;
+        ssize_t found = vlc_playlist_IndexOfMedia(playlist, media[index]);
+        assert(found == (ssize_t) index);
+    }
+    bench_report("IndexOfMedia", size, BENCH_LOOKUPS, vlc_tick_now() - start);
+
+    /* move single items, and locate them after each move */
+    start = vlc_tick_now();
+    for (size_t i = 0; i < BENCH_CHANGES; ++i)
+    {
+        size_t index = nrand48(xsubi) % size;
+        size_t target = nrand48(xsubi) % size;
+        vlc_playlist_item_t *item = vlc_playlist_Get(playlist, index);
+        vlc_playlist_Move(playlist, index, 1, target);
+        assert(vlc_playlist_IndexOf(playlist, item) == (ssize_t) target);
+    }
+    bench_report("Move", size, BENCH_CHANGES, vlc_tick_now() - start);
+
+    start = vlc_tick_now();
+    for (size_t i = 0; i < BENCH_LOOKUPS; ++i)
+    {
+        size_t index = nrand48(xsubi) % size;
+        vlc_playlist_item_t *item = vlc_playlist_Get(playlist, index);
+        assert(vlc_playlist_IndexOf(playlist, item) == (ssize_t) index);
+    }
+    bench_report("IndexOf", size, BENCH_LOOKUPS, vlc_tick_now() - start);
+
+    /* remove scattered items, in a single request */
+    vlc_playlist_item_t *items[BENCH_CHANGES];
+    for (size_t i = 0; i < BENCH_CHANGES; ++i)
+        items[i] = vlc_playlist_Get(playlist, i * (size / BENCH_CHANGES));
+
+    start = vlc_tick_now();
+    int ret = vlc_playlist_RequestRemove(playlist, items, BENCH_CHANGES, -1);
+    assert(ret == VLC_SUCCESS);
+    bench_report("Remove", size, 1, vlc_tick_now() - start);
+    assert(vlc_playlist_Count(playlist) == size - BENCH_CHANGES);
+
+    vlc_playlist_Delete(playlist);
+    DestroyMediaArray(media, size);
+    free(media);
+}
+
+static void
+bench(void)
+{
+    /* too slow and verbose for "make check", run on demand */
+    bool large = getenv("VLC_PLAYLIST_BENCH_LARGE") != NULL;
+    if (!large && !getenv("VLC_PLAYLIST_BENCH"))
+        return;
+
+    bench_size(10000);
+    bench_size(100000);
+    /* several hundreds of megabytes */
+    if (large)
+        bench_size(1000000);
+}
+
 int main(void)
 {
     test_append();
@@ -2262,6 +2596,9 @@ int main(void)
     test_playback_order_changed_callbacks();
     test_callbacks_on_add_listener();
     test_index_of();
+    test_index_of_after_changes();
+    test_batch();
+    test_batch_listener_changes();
     test_prev();
     test_next();
     test_goto();
@@ -2278,5 +2615,6 @@ int main(void)
     test_random();
     test_shuffle();
     test_sort();
+    bench();
     return 0;
 }
@@ -31,6 +31,7 @@
 #include <vlc_arrays.h>
 #include <vlc_threads.h>
 #include <vlc_memstream.h>
+#include <vlc_url.h>
 #include <vlc_meta_fetcher.h>
 
 #include "art.h"
@@ -190,6 +191,34 @@ static int SearchArt( input_fetcher_t* fetcher, input_item_t* item, int scope)
     return CheckArt( item );
 }
 
+static int PushRequest( struct background_worker* worker,
+                        struct fetcher_request* req, const char* group )
+{
+    enum background_worker_priority priority =
+        ( req->options & META_REQUEST_OPTION_PRIORITY )
+            ? BACKGROUND_WORKER_PRIORITY_HIGH : BACKGROUND_WORKER_PRIORITY_LOW;
+
+    return background_worker_PushEx( worker, req, NULL, 0, priority, group );
+}
+
+/* Downloads are limited per server, see max_threads_per_group */
+static int PushDownload( input_fetcher_t* fetcher, struct fetcher_request* req )
+{
+    char* psz_arturl = input_item_GetArtURL( req->item );
+    char* psz_host = NULL;
+    vlc_url_t url;
+
+    if( psz_arturl && !vlc_UrlParse( &url, psz_arturl ) && url.psz_host )
+        psz_host = strdup( url.psz_host );
+    if( psz_arturl )
+        vlc_UrlClean( &url );
+    free( psz_arturl );
+
+    int ret = PushRequest( fetcher->downloader, req, psz_host );
+    free( psz_host );
+    return ret;
+}
+
 static int SearchByScope( input_fetcher_t* fetcher,
     struct fetcher_request* req, int scope )
 {
@@ -208,7 +237,7 @@ static int SearchByScope( input_fetcher_t* fetcher,
         ! SearchArt( fetcher, item, scope ) )
     {
         AddAlbumCache( fetcher, req->item, false );
-        if( !background_worker_Push( fetcher->downloader, req, NULL, 0 ) )
+        if( !PushDownload( fetcher, req ) )
             return VLC_SUCCESS;
     }
 
@@ -295,7 +324,7 @@ static void SearchLocal( input_fetcher_t* fetcher, struct fetcher_request* req )
     if( var_InheritBool( fetcher->owner, "metadata-network-access" ) ||
         req->options & META_REQUEST_OPTION_SCOPE_NETWORK )
     {
-        if( background_worker_Push( fetcher->network, req, NULL, 0 ) )
+        if( PushRequest( fetcher->network, req, NULL ) )
             NotifyArtFetchEnded(req, false);
     }
     else
@@ -400,9 +429,12 @@ DEF_STARTER(   Downloader, fetcher->downloader )
 static void WorkerInit( input_fetcher_t* fetcher,
     struct background_worker** worker, int( *starter )( void*, void*, void** ) )
 {
+    int threads = var_InheritInteger( fetcher->owner, "fetch-art-threads" );
     struct background_worker_config conf = {
         .default_timeout = 0,
-        .max_threads = var_InheritInteger( fetcher->owner, "fetch-art-threads" ),
+        .max_threads = threads,
+        .max_threads_io = 2 * threads,
+        .max_threads_per_group = ( threads + 1 ) / 2,
         .pf_start = starter,
         .pf_probe = ProbeWorker,
         .pf_stop = CloseWorker,
@@ -463,7 +495,7 @@ int input_fetcher_Push( input_fetcher_t* fetcher, input_item_t* item,
     vlc_atomic_rc_init( &req->rc );
     input_item_Hold( item );
 
-    if( background_worker_Push( fetcher->local, req, NULL, 0 ) )
+    if( PushRequest( fetcher->local, req, NULL ) )
         NotifyArtFetchEnded(req, false);
 
     RequestRelease( req );
@@ -25,12 +25,15 @@
 
 #include <vlc_common.h>
 #include <vlc_atomic.h>
+#include <vlc_interrupt.h>
 
 #include "misc/background_worker.h"
 #include "input/input_interface.h"
 #include "input/input_internal.h"
+#include "input/item.h"
 #include "preparser.h"
 #include "fetcher.h"
+#include "probe.h"
 
 struct input_preparser_t
 {
@@ -38,6 +41,11 @@ struct input_preparser_t
     input_fetcher_t* fetcher;
     struct background_worker* worker;
     atomic_bool deactivated;
+    bool fast;
+
+    vlc_mutex_t stats_lock;
+    struct preparser_probe_stats stats; /**< totals of the probed items */
+    unsigned probed;
 };
 
 typedef struct input_preparser_req_t
@@ -56,6 +64,12 @@ typedef struct input_preparser_task_t
     input_thread_t* input;
     atomic_int state;
     atomic_bool done;
+
+    /* Preparsing without an input thread, see preparser_Probe() */
+    vlc_thread_t thread;
+    vlc_interrupt_t *interrupt;
+    int probe_status;
+    struct preparser_probe_stats stats;
 } input_preparser_task_t;
 
 static input_preparser_req_t *ReqCreate(input_item_t *item,
@@ -117,6 +131,44 @@ static void InputEvent( input_thread_t *input,
     }
 }
 
+static int PreparserStartInput( input_preparser_task_t *task )
+{
+    task->input = input_CreatePreparser( task->preparser->owner, InputEvent,
+                                         task, task->req->item );
+    if( !task->input )
+        return VLC_EGENERIC;
+
+    if( input_Start( task->input ) )
+    {
+        input_Close( task->input );
+        task->input = NULL;
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void *PreparserProbeThread( void *task_ )
+{
+    input_preparser_task_t *task = task_;
+    input_preparser_req_t *req = task->req;
+
+    vlc_interrupt_set( task->interrupt );
+
+    int status = preparser_Probe( task->preparser->owner, req->item, req->cbs,
+                                  req->userdata, &task->stats );
+    if( status < 0 )
+    {
+        if( PreparserStartInput( task ) == VLC_SUCCESS )
+            return NULL; /* done on INPUT_EVENT_DEAD */
+        status = ITEM_PREPARSE_FAILED;
+    }
+
+    task->probe_status = status;
+    atomic_store( &task->done, true );
+    background_worker_RequestProbe( task->preparser->worker );
+    return NULL;
+}
+
 static int PreparserOpenInput( void* preparser_, void* req_, void** out )
 {
     input_preparser_t* preparser = preparser_;
@@ -130,19 +182,25 @@ static int PreparserOpenInput( void* preparser_, void* req_, void** out )
     atomic_init( &task->done, false );
 
     task->preparser = preparser_;
-    task->input = input_CreatePreparser( preparser->owner, InputEvent,
-                                         task, req->item );
-    if( !task->input )
-        goto error;
-
     task->req = req;
     task->preparse_status = -1;
+    task->input = NULL;
+    task->interrupt = NULL;
 
-    if( input_Start( task->input ) )
+    if( preparser->fast )
     {
-        input_Close( task->input );
-        goto error;
+        task->interrupt = vlc_interrupt_create();
+        if( unlikely( !task->interrupt ) )
+            goto error;
+        if( vlc_clone( &task->thread, PreparserProbeThread, task,
+                       VLC_THREAD_PRIORITY_LOW ) )
+        {
+            vlc_interrupt_destroy( task->interrupt );
+            goto error;
+        }
     }
+    else if( PreparserStartInput( task ) )
+        goto error;
 
     *out = task;
 
@@ -188,24 +246,54 @@ static void PreparserCloseInput( void* preparser_, void* task_ )
     input_preparser_req_t *req = task->req;
 
     input_preparser_t* preparser = preparser_;
-    input_thread_t* input = task->input;
-    input_item_t* item = input_priv(task->input)->p_item;
+    input_item_t* item = req->item;
+
+    int status = ITEM_PREPARSE_TIMEOUT;
 
-    int status;
-    switch( atomic_load( &task->state ) )
+    if( task->interrupt )
     {
-        case END_S:
-            status = ITEM_PREPARSE_DONE;
-            break;
-        case ERROR_S:
-            status = ITEM_PREPARSE_FAILED;
-            break;
-        default:
-            status = ITEM_PREPARSE_TIMEOUT;
+        vlc_interrupt_kill( task->interrupt );
+        vlc_join( task->thread, NULL );
+        vlc_interrupt_destroy( task->interrupt );
+
+        if( !task->input )
+        {
+            status = task->probe_status;
+            msg_Dbg( preparser->owner, "preparsed in %"PRId64" us (open: %"
+                     PRId64" us, meta: %"PRId64" us, sub-items: %"PRId64" us)",
+                     US_FROM_VLC_TICK( task->stats.open + task->stats.meta
+                                       + task->stats.subitems ),
+                     US_FROM_VLC_TICK( task->stats.open ),
+                     US_FROM_VLC_TICK( task->stats.meta ),
+                     US_FROM_VLC_TICK( task->stats.subitems ) );
+
+            vlc_mutex_lock( &preparser->stats_lock );
+            preparser->stats.open += task->stats.open;
+            preparser->stats.meta += task->stats.meta;
+            preparser->stats.subitems += task->stats.subitems;
+            preparser->probed++;
+            vlc_mutex_unlock( &preparser->stats_lock );
+        }
     }
 
-    input_Stop( input );
-    input_Close( input );
+    input_thread_t* input = task->input;
+    if( input )
+    {
+        switch( atomic_load( &task->state ) )
+        {
+            case END_S:
+                status = ITEM_PREPARSE_DONE;
+                break;
+            case ERROR_S:
+                status = ITEM_PREPARSE_FAILED;
+                break;
+            default:
+                status = ITEM_PREPARSE_TIMEOUT;
+        }
+
+        input_Stop( input );
+        input_Close( input );
+    }
 
     if( preparser->fetcher )
     {
@@ -232,9 +320,14 @@ input_preparser_t* input_preparser_New( vlc_object_t *parent )
 {
     input_preparser_t* preparser = malloc( sizeof *preparser );
 
+    int threads = var_InheritInteger( parent, "preparse-threads" );
     struct background_worker_config conf = {
         .default_timeout = VLC_TICK_FROM_MS(var_InheritInteger( parent, "preparse-timeout" )),
-        .max_threads = var_InheritInteger( parent, "preparse-threads" ),
+        .max_threads = threads,
+        /* Grow while items wait for network servers rather than the CPU,
+         * without letting a single server take all the threads */
+        .max_threads_io = 4 * threads,
+        .max_threads_per_group = (threads + 1) / 2,
         .pf_start = PreparserOpenInput,
         .pf_probe = PreparserProbeInput,
         .pf_stop = PreparserCloseInput,
@@ -255,6 +348,10 @@ input_preparser_t* input_preparser_New( vlc_object_t *parent )
     preparser->owner = parent;
     preparser->fetcher = input_fetcher_New( parent );
     atomic_init( &preparser->deactivated, false );
+    preparser->fast = var_InheritBool( parent, "preparse-fast" );
+    vlc_mutex_init( &preparser->stats_lock );
+    memset( &preparser->stats, 0, sizeof( preparser->stats ) );
+    preparser->probed = 0;
 
     if( unlikely( !preparser->fetcher ) )
         msg_Warn( parent, "unable to create art fetcher" );
@@ -291,11 +388,17 @@ void input_preparser_Push( input_preparser_t *preparser,
     }
 
     struct input_preparser_req_t *req = ReqCreate(item, cbs, cbs_userdata);
+    enum background_worker_priority priority =
+        (i_options & META_REQUEST_OPTION_PRIORITY)
+            ? BACKGROUND_WORKER_PRIORITY_HIGH : BACKGROUND_WORKER_PRIORITY_LOW;
+    char *host = b_net ? input_item_GetHost(item) : NULL;
 
-    if (background_worker_Push(preparser->worker, req, id, timeout))
+    if (background_worker_PushEx(preparser->worker, req, id, timeout,
+                                 priority, host))
         if (req->cbs && cbs->on_preparse_ended)
             cbs->on_preparse_ended(item, ITEM_PREPARSE_FAILED, cbs_userdata);
 
+    free(host);
     ReqRelease(req);
 }
 
@@ -321,8 +424,27 @@ void input_preparser_Deactivate( input_preparser_t* preparser )
 
 void input_preparser_Delete( input_preparser_t *preparser )
 {
+    struct background_worker_stats stats;
+
+    background_worker_GetStats( preparser->worker, &stats );
+    if( stats.completed > 0 )
+        msg_Dbg( preparser->owner, "preparsed %lu items, %lu timed out"
+                 " (queued: %"PRId64" ms on average, %"PRId64" ms at most,"
+                 " duration: %"PRId64" ms on average)", stats.completed,
+                 stats.timeouts, MS_FROM_VLC_TICK( stats.avg_wait ),
+                 MS_FROM_VLC_TICK( stats.max_wait ),
+                 MS_FROM_VLC_TICK( stats.avg_duration ) );
     background_worker_Delete( preparser->worker );
 
+    if( preparser->probed > 0 )
+        msg_Dbg( preparser->owner, "preparsed %u items without input thread"
+                 " (open: %"PRId64" ms, meta: %"PRId64" ms, sub-items: %"
+                 PRId64" ms)", preparser->probed,
+                 MS_FROM_VLC_TICK( preparser->stats.open ),
+                 MS_FROM_VLC_TICK( preparser->stats.meta ),
+                 MS_FROM_VLC_TICK( preparser->stats.subitems ) );
+    vlc_mutex_destroy( &preparser->stats_lock );
+
     if( preparser->fetcher )
         input_fetcher_Delete( preparser->fetcher );
 
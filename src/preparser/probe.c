@@ -0,0 +1,332 @@
+/*****************************************************************************
+ * probe.c: preparsing without an input thread
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_input.h>
+#include <vlc_interrupt.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
+
+#include "../libvlc.h"
+#include "input/demux.h"
+#include "input/es_out.h"
+#include "input/item.h"
+#include "input/stream.h"
+#include "art.h"
+#include "probe.h"
+
+/* ES output recording the track formats in the item, without decoding */
+struct probe_out
+{
+    es_out_t out;
+    input_item_t *item;
+    const input_preparser_callbacks_t *cbs;
+    void *userdata;
+    int next_meta_id;
+};
+
+struct es_out_id_t
+{
+    int i_id;
+    int i_meta_id; /* "Stream N" info category, numbered as by the input */
+};
+
+static void probe_MergeMeta( input_item_t *item, const vlc_meta_t *meta )
+{
+    vlc_mutex_lock( &item->lock );
+    vlc_meta_Merge( item->p_meta, meta );
+    vlc_mutex_unlock( &item->lock );
+
+    const char *title = vlc_meta_Get( meta, vlc_meta_Title );
+    if( title != NULL )
+        input_item_SetName( item, title );
+}
+
+static void probe_UpdateInfo( struct probe_out *sys, es_out_id_t *id,
+                              const es_format_t *fmt )
+{
+    input_item_UpdateTracksInfo( sys->item, fmt );
+
+    /* Nothing is decoded: the demuxed format is the only one */
+    info_category_t *cat = input_EsInfoCategoryNew( id->i_meta_id, fmt, fmt,
+                                                    NULL );
+    if( likely(cat != NULL) )
+        input_item_ReplaceInfos( sys->item, cat );
+}
+
+static es_out_id_t *probe_EsAdd( es_out_t *out, const es_format_t *fmt )
+{
+    struct probe_out *sys = container_of( out, struct probe_out, out );
+    es_out_id_t *id = malloc( sizeof( *id ) );
+    if( unlikely(id == NULL) )
+        return NULL;
+
+    id->i_id = fmt->i_id;
+    id->i_meta_id = sys->next_meta_id++;
+    probe_UpdateInfo( sys, id, fmt );
+    return id;
+}
+
+static int probe_EsSend( es_out_t *out, es_out_id_t *id, block_t *block )
+{
+    VLC_UNUSED(out); VLC_UNUSED(id);
+    block_Release( block );
+    return VLC_SUCCESS;
+}
+
+static void probe_EsDel( es_out_t *out, es_out_id_t *id )
+{
+    VLC_UNUSED(out);
+    free( id );
+}
+
+static int probe_EsControl( es_out_t *out, int query, va_list args )
+{
+    struct probe_out *sys = container_of( out, struct probe_out, out );
+
+    switch( query )
+    {
+        case ES_OUT_SET_ES_FMT:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            const es_format_t *fmt = va_arg( args, const es_format_t * );
+
+            probe_UpdateInfo( sys, id, fmt );
+            return VLC_SUCCESS;
+        }
+        case ES_OUT_GET_ES_STATE:
+            va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = false;
+            return VLC_SUCCESS;
+
+        case ES_OUT_SET_META:
+            probe_MergeMeta( sys->item, va_arg( args, const vlc_meta_t * ) );
+            return VLC_SUCCESS;
+
+        case ES_OUT_POST_SUBNODE:
+        {
+            input_item_node_t *node = va_arg( args, input_item_node_t * );
+            if( sys->cbs != NULL && sys->cbs->on_subtree_added != NULL )
+                sys->cbs->on_subtree_added( sys->item, node, sys->userdata );
+            input_item_node_Delete( node );
+            return VLC_SUCCESS;
+        }
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static const struct es_out_callbacks probe_es_cbs =
+{
+    .add = probe_EsAdd,
+    .send = probe_EsSend,
+    .del = probe_EsDel,
+    .control = probe_EsControl,
+};
+
+/* Caches the cover art attached to the media, as the input does */
+static void probe_SaveArt( vlc_object_t *obj, input_item_t *item,
+                           input_attachment_t **attachments, int count )
+{
+    char *url = input_item_GetArtURL( item );
+    if( url == NULL )
+        return;
+
+    if( !strncmp( url, "attachment://", 13 ) && !input_item_IsArtFetched( item )
+     && input_FindArtInCache( item ) != VLC_SUCCESS )
+    {
+        for( int i = 0; i < count; i++ )
+        {
+            const input_attachment_t *a = attachments[i];
+            const char *type = NULL;
+
+            if( strcmp( a->psz_name, url + 13 ) )
+                continue;
+            if( !strcmp( a->psz_mime, "image/jpeg" ) )
+                type = ".jpg";
+            else if( !strcmp( a->psz_mime, "image/png" ) )
+                type = ".png";
+            else if( !strcmp( a->psz_mime, "image/x-pict" ) )
+                type = ".pct";
+            input_SaveArt( obj, item, a->p_data, a->i_data, type );
+            break;
+        }
+    }
+    free( url );
+}
+
+static void probe_ReadMeta( vlc_object_t *obj, input_item_t *item,
+                            demux_t *demux )
+{
+    vlc_meta_t *meta = vlc_meta_New();
+    if( unlikely(meta == NULL) )
+        return;
+
+    input_attachment_t **attachments = NULL;
+    int count = 0;
+    bool has_meta = !demux_Control( demux, DEMUX_GET_META, meta );
+    bool has_unsupported;
+
+    if( demux_Control( demux, DEMUX_HAS_UNSUPPORTED_META, &has_unsupported ) )
+        has_unsupported = true;
+
+    /* Same as the input: try a meta reader if the demuxer cannot tell all */
+    if( !has_meta || has_unsupported )
+    {
+        demux_meta_t *dm = vlc_custom_create( obj, sizeof( *dm ),
+                                              "demux meta" );
+        if( likely(dm != NULL) )
+        {
+            dm->p_item = item;
+
+            module_t *reader = module_need( dm, "meta reader", NULL, false );
+            if( reader != NULL )
+            {
+                if( dm->p_meta != NULL )
+                {
+                    vlc_meta_Merge( meta, dm->p_meta );
+                    vlc_meta_Delete( dm->p_meta );
+                }
+                if( dm->i_attachments > 0 )
+                {
+                    attachments = dm->attachments;
+                    count = dm->i_attachments;
+                }
+                else
+                    free( dm->attachments );
+                module_unneed( dm, reader );
+            }
+            vlc_object_release( dm );
+        }
+    }
+
+    if( count == 0
+     && demux_Control( demux, DEMUX_GET_ATTACHMENTS, &attachments, &count ) )
+        count = 0;
+
+    probe_MergeMeta( item, meta );
+    vlc_meta_Delete( meta );
+    probe_SaveArt( obj, item, attachments, count );
+
+    for( int i = 0; i < count; i++ )
+        vlc_input_attachment_Delete( attachments[i] );
+    if( count > 0 )
+        free( attachments );
+}
+
+static demux_t *probe_OpenDemux( vlc_object_t *obj, const char *url,
+                                 es_out_t *out )
+{
+    stream_t *stream = stream_AccessNew( obj, NULL, out, true, url );
+    if( stream == NULL )
+        return NULL;
+
+    stream = stream_FilterAutoNew( stream );
+
+    if( stream->pf_read == NULL && stream->pf_block == NULL
+     && stream->pf_readdir == NULL )
+        return stream; /* Combined access/demux */
+
+    char *filters = var_InheritString( obj, "stream-filter" );
+    if( filters != NULL )
+    {
+        stream = stream_FilterChainNew( stream, filters );
+        free( filters );
+    }
+
+    char *name = var_InheritString( obj, "demux" );
+    demux_t *demux = demux_NewAdvanced( obj, NULL,
+                                        name != NULL ? name : "any", url,
+                                        stream, out, true );
+    free( name );
+    if( demux == NULL )
+        vlc_stream_Delete( stream );
+    return demux;
+}
+
+int preparser_Probe( vlc_object_t *obj, input_item_t *item,
+                     const input_preparser_callbacks_t *cbs, void *userdata,
+                     struct preparser_probe_stats *stats )
+{
+    struct probe_out sys = {
+        .out = { .cbs = &probe_es_cbs },
+        .item = item,
+        .cbs = cbs,
+        .userdata = userdata,
+    };
+
+    memset( stats, 0, sizeof( *stats ) );
+
+    vlc_mutex_lock( &item->lock );
+    int options = item->i_options;
+    vlc_mutex_unlock( &item->lock );
+    if( options > 0 )
+        return -1; /* may change the access or demuxer */
+
+    char *url = input_item_GetURI( item );
+    if( url == NULL )
+        return -1;
+
+    /* access/demux://path and anchors are parsed by the input */
+    const char *scheme_end = strstr( url, "://" );
+    if( scheme_end == NULL || memchr( url, '/', scheme_end - url ) != NULL
+     || strchr( url, '#' ) != NULL )
+    {
+        free( url );
+        return -1;
+    }
+
+    vlc_tick_t start = vlc_tick_now();
+    demux_t *demux = probe_OpenDemux( obj, url, &sys.out );
+    free( url );
+    stats->open = vlc_tick_now() - start;
+    if( demux == NULL )
+        return vlc_killed() ? ITEM_PREPARSE_TIMEOUT : ITEM_PREPARSE_FAILED;
+
+    vlc_tick_t length;
+    if( !demux_Control( demux, DEMUX_GET_LENGTH, &length ) && length > 0 )
+        input_item_SetDuration( item, length );
+
+    start = vlc_tick_now();
+    probe_ReadMeta( obj, item, demux );
+    stats->meta = vlc_tick_now() - start;
+
+    /* Playlists and directories post their sub-items while demuxing */
+    bool is_playlist;
+    if( input_item_ShouldPreparseSubItems( item )
+     && !demux_Control( demux, DEMUX_IS_PLAYLIST, &is_playlist ) && is_playlist )
+    {
+        start = vlc_tick_now();
+        while( !vlc_killed()
+            && demux_Demux( demux ) == VLC_DEMUXER_SUCCESS );
+        stats->subitems = vlc_tick_now() - start;
+    }
+
+    demux_Delete( demux );
+    return vlc_killed() ? ITEM_PREPARSE_TIMEOUT : ITEM_PREPARSE_DONE;
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+ * probe.h: preparsing without an input thread
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _INPUT_PROBE_H
+#define _INPUT_PROBE_H 1
+
+#include <vlc_input_item.h>
+
+/**
+ * Time spent in each preparsing stage
+ */
+struct preparser_probe_stats
+{
+    vlc_tick_t open; /**< access, stream filters and demuxer */
+    vlc_tick_t meta; /**< demuxer meta data and meta reader modules */
+    vlc_tick_t subitems; /**< playlist or directory listing */
+};
+
+/**
+ * Reads the duration, tracks, meta data and sub-items of an item.
+ *
+ * This opens the access and the demuxer directly, as an input thread would
+ * for preparsing, but without the input thread itself and its ES output,
+ * clock and decoders. Items with input options or with an MRL that only an
+ * input thread understands are not handled.
+ *
+ * Must be called from a thread with an interruption context.
+ *
+ * @return ITEM_PREPARSE_DONE, ITEM_PREPARSE_FAILED if the item cannot be
+ * opened, ITEM_PREPARSE_TIMEOUT if interrupted, or -1 if the item needs an
+ * input thread
+ */
+int preparser_Probe( vlc_object_t *, input_item_t *,
+                     const input_preparser_callbacks_t *cbs, void *userdata,
+                     struct preparser_probe_stats *stats );
+
+#endif
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 
 #include <vlc_threads.h>
+#include <vlc_atomic.h>
 #include <vlc_fs.h>
 #include <vlc_input_item.h>
 #include <vlc_events.h>
@@ -329,6 +330,130 @@ static void test_media_subitems(libvlc_instance_t *vlc)
     libvlc_media_release (media);
 }
 
+#define PRIORITY_PREPARSE_COUNT 40
+
+struct parse_rank
+{
+    vlc_sem_t *sem;
+    atomic_uint *counter;
+    unsigned rank; /* completion order */
+};
+
+static void media_parse_ranked(const libvlc_event_t *event, void *user_data)
+{
+    (void)event;
+    struct parse_rank *rank = user_data;
+    rank->rank = atomic_fetch_add(rank->counter, 1);
+    vlc_sem_post(rank->sem);
+}
+
+/* Queues many items on a single preparser thread, then an interactive one,
+ * which must not wait for all the others */
+static void test_media_preparse_priority(void)
+{
+    const char *argv[test_defaults_nargs + 1];
+    for (int i = 0; i < test_defaults_nargs; ++i)
+        argv[i] = test_defaults_args[i];
+    argv[test_defaults_nargs] = "--preparse-threads=1";
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs + 1, argv);
+    assert(vlc != NULL);
+
+    test_log("Testing preparser priorities\n");
+
+    libvlc_media_t *medias[PRIORITY_PREPARSE_COUNT + 1];
+    struct parse_rank ranks[PRIORITY_PREPARSE_COUNT + 1];
+    atomic_uint counter = ATOMIC_VAR_INIT(0);
+    vlc_sem_t sem;
+    vlc_sem_init(&sem, 0);
+
+    for (size_t i = 0; i <= PRIORITY_PREPARSE_COUNT; ++i)
+    {
+        bool interactive = i == PRIORITY_PREPARSE_COUNT;
+
+        medias[i] = libvlc_media_new_path(vlc, test_default_video);
+        assert(medias[i] != NULL);
+
+        ranks[i].sem = &sem;
+        ranks[i].counter = &counter;
+        libvlc_event_manager_t *em = libvlc_media_event_manager(medias[i]);
+        libvlc_event_attach(em, libvlc_MediaParsedChanged, media_parse_ranked,
+                            &ranks[i]);
+        int i_ret = libvlc_media_parse_with_options(medias[i],
+                libvlc_media_parse_local
+                | (interactive ? libvlc_media_parse_interactive : 0), -1);
+        assert(i_ret == 0);
+    }
+
+    /* every item completes, even if threads come and go */
+    for (size_t i = 0; i <= PRIORITY_PREPARSE_COUNT; ++i)
+        vlc_sem_wait(&sem);
+
+    for (size_t i = 0; i <= PRIORITY_PREPARSE_COUNT; ++i)
+    {
+        assert(libvlc_media_get_parsed_status(medias[i])
+               == libvlc_media_parsed_status_done);
+        libvlc_media_release(medias[i]);
+    }
+    assert(ranks[PRIORITY_PREPARSE_COUNT].rank < PRIORITY_PREPARSE_COUNT);
+
+    vlc_sem_destroy(&sem);
+    libvlc_release(vlc);
+}
+
+#define BENCH_PREPARSE_COUNT 200
+
+/* Preparses a batch of local files and reports the throughput */
+static void bench_media_preparse(const char *name, const char *const *extra,
+                                 int extra_count)
+{
+    const char *argv[test_defaults_nargs + extra_count];
+    for (int i = 0; i < test_defaults_nargs; ++i)
+        argv[i] = test_defaults_args[i];
+    for (int i = 0; i < extra_count; ++i)
+        argv[test_defaults_nargs + i] = extra[i];
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs + extra_count,
+                                        argv);
+    assert(vlc != NULL);
+
+    libvlc_media_t *medias[BENCH_PREPARSE_COUNT];
+    vlc_sem_t sem;
+    vlc_sem_init(&sem, 0);
+
+    vlc_tick_t start = vlc_tick_now();
+    for (size_t i = 0; i < BENCH_PREPARSE_COUNT; ++i)
+    {
+        medias[i] = libvlc_media_new_path(vlc, i % 2 ? test_default_video
+                                                     : test_default_sample);
+        assert(medias[i] != NULL);
+
+        libvlc_event_manager_t *em = libvlc_media_event_manager(medias[i]);
+        libvlc_event_attach(em, libvlc_MediaParsedChanged, media_parse_ended,
+                            &sem);
+        int i_ret = libvlc_media_parse_with_options(medias[i],
+                                                    libvlc_media_parse_local,
+                                                    -1);
+        assert(i_ret == 0);
+    }
+    for (size_t i = 0; i < BENCH_PREPARSE_COUNT; ++i)
+        vlc_sem_wait(&sem);
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    test_log("%-14s %d items preparsed in %"PRId64" ms (%.1f/s)\n", name,
+             BENCH_PREPARSE_COUNT, MS_FROM_VLC_TICK(elapsed),
+             BENCH_PREPARSE_COUNT * (double)CLOCK_FREQ / elapsed);
+
+    for (size_t i = 0; i < BENCH_PREPARSE_COUNT; ++i)
+    {
+        assert(libvlc_media_get_parsed_status(medias[i])
+               == libvlc_media_parsed_status_done);
+        libvlc_media_release(medias[i]);
+    }
+    vlc_sem_destroy(&sem);
+    libvlc_release(vlc);
+}
+
 int main(int i_argc, char *ppsz_argv[])
 {
     test_init();
@@ -380,5 +505,15 @@ int main(int i_argc, char *ppsz_argv[])
 
     libvlc_release (vlc);
 
+    test_media_preparse_priority ();
+
+    /* too slow and verbose for "make check", run on demand */
+    if (getenv ("VLC_MEDIA_BENCH") != NULL)
+    {
+        static const char *const input_args[] = { "--no-preparse-fast" };
+        bench_media_preparse ("no input", NULL, 0);
+        bench_media_preparse ("input thread", input_args, 1);
+    }
+
     return 0;
 }
@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * demuxdump.c: test the dump demuxer
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_url.h>
+
+#include <string.h>
+
+#define PAD_SIZE 3000
+#define MEMBER_SIZE 200000
+
+static unsigned char member_data[MEMBER_SIZE];
+
+static void tar_WriteHeader(FILE *file, const char *name, size_t size)
+{
+    char header[512];
+
+    memset(header, 0, sizeof (header));
+    strcpy(header, name);
+    strcpy(header + 100, "0000644");
+    strcpy(header + 108, "0000000");
+    strcpy(header + 116, "0000000");
+    sprintf(header + 124, "%011zo", size);
+    strcpy(header + 136, "00000000000");
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    /* the checksum is computed with its own field set to spaces */
+    unsigned sum = 0;
+    memset(header + 148, ' ', 8);
+    for (size_t i = 0; i < sizeof (header); i++)
+        sum += (unsigned char) header[i];
+    sprintf(header + 148, "%06o", sum);
+
+    assert(fwrite(header, sizeof (header), 1, file) == 1);
+}
+
+static void tar_WriteMember(FILE *file, const char *name,
+                            const unsigned char *data, size_t size)
+{
+    static const char zero[512];
+
+    tar_WriteHeader(file, name, size);
+    assert(fwrite(data, 1, size, file) == size);
+    if (size % 512)
+        assert(fwrite(zero, 512 - size % 512, 1, file) == 1);
+}
+
+/* The member to dump does not start the archive, so that the data at the
+ * offsets of the archive file differ from the data of the member. */
+static void tar_Create(const char *path)
+{
+    static const char zero[1024];
+    unsigned char pad[PAD_SIZE];
+
+    memset(pad, 0xAA, sizeof (pad));
+    for (size_t i = 0; i < MEMBER_SIZE; i++)
+        member_data[i] = (i * 7) ^ (i >> 8);
+
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    tar_WriteMember(file, "pad.bin", pad, sizeof (pad));
+    tar_WriteMember(file, "member.bin", member_data, MEMBER_SIZE);
+    assert(fwrite(zero, sizeof (zero), 1, file) == 1);
+    assert(fclose(file) == 0);
+}
+
+static void on_event(const struct libvlc_event_t *event, void *data)
+{
+    (void) event;
+    vlc_sem_post(data);
+}
+
+static void test_dump_archive_member(const char *archive, const char *dump,
+                                     bool direct)
+{
+    char *dump_arg;
+    assert(asprintf(&dump_arg, "--demuxdump-file=%s", dump) != -1);
+
+    const char *argv[] = {
+        "-v", "--vout=vdummy", "--aout=dummy", "--demux=dump", dump_arg,
+        direct ? "--demuxdump-direct" : "--no-demuxdump-direct",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    char *uri = vlc_path2uri(archive, NULL);
+    assert(uri != NULL);
+    char *mrl;
+    assert(asprintf(&mrl, "%s#!/member.bin", uri) != -1);
+    free(uri);
+
+    test_log("dumping %s (%s copy)\n", mrl, direct ? "direct" : "block");
+    libvlc_media_t *media = libvlc_media_new_location(vlc, mrl);
+    assert(media != NULL);
+    free(mrl);
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media(media);
+    assert(mp != NULL);
+    libvlc_media_release(media);
+
+    vlc_sem_t sem;
+    vlc_sem_init(&sem, 0);
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager(mp);
+    assert(!libvlc_event_attach(em, libvlc_MediaPlayerEndReached, on_event,
+                                &sem));
+    assert(!libvlc_event_attach(em, libvlc_MediaPlayerEncounteredError,
+                                on_event, &sem));
+
+    assert(libvlc_media_player_play(mp) == 0);
+    vlc_sem_wait(&sem);
+    assert(libvlc_media_player_get_state(mp) == libvlc_Ended);
+    libvlc_media_player_stop(mp);
+    libvlc_media_player_release(mp);
+    vlc_sem_destroy(&sem);
+    libvlc_release(vlc);
+    free(dump_arg);
+
+    /* the dump must be the member, not the archive at the member offsets */
+    FILE *file = fopen(dump, "rb");
+    assert(file != NULL);
+    static unsigned char buf[MEMBER_SIZE + 1];
+    size_t size = fread(buf, 1, sizeof (buf), file);
+    fclose(file);
+    assert(size == MEMBER_SIZE);
+    assert(memcmp(buf, member_data, MEMBER_SIZE) == 0);
+    unlink(dump);
+}
+
+int main(void)
+{
+    test_init();
+
+    /* Create a dummy libvlc to initialize module bank, needed by module_exists */
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+    bool has_archive = module_exists("archive");
+    libvlc_release(vlc);
+    if (!has_archive)
+    {
+        test_log("archive module not found, skipping\n");
+        return 77;
+    }
+
+    char dir[] = "/tmp/libvlc_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+
+    char archive[sizeof (dir) + 16], dump[sizeof (dir) + 16];
+    snprintf(archive, sizeof (archive), "%s/test.tar", dir);
+    snprintf(dump, sizeof (dump), "%s/dump.bin", dir);
+    tar_Create(archive);
+
+    test_dump_archive_member(archive, dump, true);
+    test_dump_archive_member(archive, dump, false);
+
+    unlink(archive);
+    rmdir(dir);
+    return 0;
+}
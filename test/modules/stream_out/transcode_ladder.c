@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * transcode_ladder.c: transcode renditions ladder benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Transcodes the same input into a 4 renditions ladder, first with the
+ * transcode ladder option, then with one transcode per rendition behind
+ * duplicate, and reports the wall clock and CPU time of both.
+ *  TRANSCODE_TEST_INPUT  MRL of the input (required, the test is skipped
+ *                        otherwise)
+ *  TRANSCODE_TEST_VCODEC video codec (default h264)
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+
+#include <string.h>
+#include <sys/resource.h>
+
+#define RUNG(w, h, kbps) #w "x" #h "@" #kbps
+
+static const char *const rungs[] = {
+    RUNG(1920, 1080, 6000),
+    RUNG(1280, 720, 3000),
+    RUNG(960, 540, 1500),
+    RUNG(640, 360, 800),
+};
+
+static vlc_tick_t cpu_time(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+        return 0;
+    return vlc_tick_from_timeval(&ru.ru_utime)
+         + vlc_tick_from_timeval(&ru.ru_stime);
+}
+
+static void run(libvlc_instance_t *vlc, const char *mrl, const char *name,
+                const char *sout)
+{
+    libvlc_media_t *media = libvlc_media_new_location(vlc, mrl);
+    assert(media != NULL);
+    libvlc_media_add_option(media, ":no-sout-audio");
+    libvlc_media_add_option(media, ":sout-all");
+    libvlc_media_add_option(media, sout);
+
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media(media);
+    assert(mp != NULL);
+    libvlc_media_release(media);
+
+    vlc_tick_t start = vlc_tick_now();
+    vlc_tick_t cpu_start = cpu_time();
+
+    int ret = libvlc_media_player_play(mp);
+    assert(ret == 0);
+
+    libvlc_state_t state;
+    do
+    {
+        vlc_tick_sleep(VLC_TICK_FROM_MS(50));
+        state = libvlc_media_player_get_state(mp);
+    }
+    while (state != libvlc_Ended && state != libvlc_Error);
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    vlc_tick_t cpu = cpu_time() - cpu_start;
+
+    libvlc_media_player_stop(mp);
+    libvlc_media_player_release(mp);
+
+    assert(state == libvlc_Ended);
+    printf("%s: %"PRId64" ms, CPU time: %"PRId64" ms\n", name,
+           MS_FROM_VLC_TICK(elapsed), MS_FROM_VLC_TICK(cpu));
+}
+
+int main(void)
+{
+    const char *mrl = getenv("TRANSCODE_TEST_INPUT");
+    const char *vcodec = getenv("TRANSCODE_TEST_VCODEC");
+    char *sout, *dsts, *tmp;
+
+    if (mrl == NULL)
+    {
+        fprintf(stderr, "TRANSCODE_TEST_INPUT not set, skipping\n");
+        return 77;
+    }
+    if (vcodec == NULL)
+        vcodec = "h264";
+
+    setenv("VLC_TEST_TIMEOUT", "0", 0); /* inputs can be long */
+    test_init();
+
+    const char *argv[] = { "-v", "--no-audio", "--no-video" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    /* Single decoder, shared filters, one encoder thread per rendition */
+    tmp = NULL;
+    for (size_t i = 0; i < ARRAY_SIZE(rungs); i++)
+    {
+        char *ladder;
+        if (asprintf(&ladder, "%s%s%s", tmp ? tmp : "", tmp ? "," : "",
+                     rungs[i]) == -1)
+            abort();
+        free(tmp);
+        tmp = ladder;
+    }
+    if (asprintf(&sout, ":sout=#transcode{vcodec=%s,ladder=\"%s\"}:dummy",
+                 vcodec, tmp) == -1)
+        abort();
+    free(tmp);
+    run(vlc, mrl, "ladder", sout);
+    free(sout);
+
+    /* One full decode and transcode per rendition */
+    dsts = NULL;
+    for (size_t i = 0; i < ARRAY_SIZE(rungs); i++)
+    {
+        unsigned w, h, kbps;
+        if (sscanf(rungs[i], "%ux%u@%u", &w, &h, &kbps) != 3)
+            abort();
+        if (asprintf(&tmp, "%s%sdst=transcode{vcodec=%s,width=%u,height=%u,"
+                     "vb=%u}:dummy", dsts ? dsts : "", dsts ? "," : "",
+                     vcodec, w, h, kbps) == -1)
+            abort();
+        free(dsts);
+        dsts = tmp;
+    }
+    if (asprintf(&sout, ":sout=#duplicate{%s}", dsts) == -1)
+        abort();
+    free(dsts);
+    run(vlc, mrl, "duplicate", sout);
+    free(sout);
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -41,22 +41,35 @@ const struct
     bool b_fast_seek;
     vlc_tick_t i_timeout;
     bool b_expected_success;
+    bool b_can_seek;
+    vlc_tick_t i_pts_offset;
 } test_params[] = {
     /* Simple test with a thumbnail at 60s, with a video track */
     { 1, 0, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 60 ), .0f, false, true,
-        VLC_TICK_FROM_SEC( 1 ), true },
+        VLC_TICK_FROM_SEC( 1 ), true, true, 0 },
     /* Test without fast-seek */
     { 1, 0, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 60 ), .0f, false, false,
-        VLC_TICK_FROM_SEC( 1 ), true },
+        VLC_TICK_FROM_SEC( 1 ), true, true, 0 },
     /* Seek by position test */
-    { 1, 0, VLC_TICK_INVALID, 0, .3f, true, true, VLC_TICK_FROM_SEC( 1 ), true },
+    { 1, 0, VLC_TICK_INVALID, 0, .3f, true, true, VLC_TICK_FROM_SEC( 1 ), true,
+        true, 0 },
     /* Seek at a negative position */
-    { 1, 0, VLC_TICK_INVALID, -12345, .0f, false, true, VLC_TICK_FROM_SEC( 1 ), true },
+    { 1, 0, VLC_TICK_INVALID, -12345, .0f, false, true, VLC_TICK_FROM_SEC( 1 ),
+        true, true, 0 },
     /* Take a thumbnail of a file without video, which should timeout. */
-    { 0, 1, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 60 ), .0f, false, true, VLC_TICK_FROM_MS( 100 ), false },
+    { 0, 1, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 60 ), .0f, false, true,
+        VLC_TICK_FROM_MS( 100 ), false, true, 0 },
     /* Take a thumbnail of a file with a video track starting later */
     { 0, 1, VLC_TICK_FROM_SEC( 120 ), VLC_TICK_FROM_SEC( 60 ), .0f, false, true,
-        VLC_TICK_FROM_SEC( 2 ), true },
+        VLC_TICK_FROM_SEC( 2 ), true, true, 0 },
+    /* Precise thumbnails of files whose timestamps start after an hour */
+    { 1, 0, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 10 ), .0f, false, false,
+        VLC_TICK_FROM_SEC( 1 ), true, true, VLC_TICK_FROM_SEC( 3600 ) },
+    { 1, 0, VLC_TICK_INVALID, 0, .3f, true, false, VLC_TICK_FROM_SEC( 1 ), true,
+        true, VLC_TICK_FROM_SEC( 3600 ) },
+    /* Same without seeking: the frames up to the point are decoded */
+    { 1, 0, VLC_TICK_INVALID, VLC_TICK_FROM_SEC( 10 ), .0f, false, false,
+        VLC_TICK_FROM_SEC( 2 ), true, false, VLC_TICK_FROM_SEC( 3600 ) },
 };
 
 struct test_ctx
@@ -65,6 +78,7 @@ struct test_ctx
     vlc_mutex_t lock;
     size_t test_idx;
     bool b_done;
+    bool b_check_date; /* the pictures keep the stream timestamps */
 };
 
 static void thumbnailer_callback( void* data, picture_t* thumbnail )
@@ -78,6 +92,19 @@ static void thumbnailer_callback( void* data, picture_t* thumbnail )
                 "Expected failure but got a thumbnail" );
         assert( thumbnail->format.i_chroma == VLC_CODEC_ARGB );
 
+        if ( p_ctx->b_check_date && !test_params[p_ctx->test_idx].b_fast_seek )
+        {
+            /* The first picture at or after the point, every mock frame
+             * being a key frame */
+            vlc_tick_t expected_date = test_params[p_ctx->test_idx].i_pts_offset;
+            if ( test_params[p_ctx->test_idx].b_use_pos )
+                expected_date += MOCK_DURATION * test_params[p_ctx->test_idx].f_pos;
+            else
+                expected_date += test_params[p_ctx->test_idx].i_time;
+            assert( thumbnail->date >= expected_date - VLC_TICK_FROM_MS( 1 ) );
+            assert( thumbnail->date < expected_date + VLC_TICK_FROM_MS( 40 ) );
+        }
+
         /* TODO: Enable this once the new clock is merged */
 #if 0
         vlc_tick_t expected_date;
@@ -105,7 +132,7 @@ static void thumbnailer_callback( void* data, picture_t* thumbnail )
     vlc_mutex_unlock( &p_ctx->lock );
 }
 
-static void test_thumbnails( libvlc_instance_t* p_vlc )
+static void test_thumbnails( libvlc_instance_t* p_vlc, bool b_check_date )
 {
     vlc_thumbnailer_t* p_thumbnailer = vlc_thumbnailer_Create(
                 VLC_OBJECT( p_vlc->p_libvlc_int ) );
@@ -114,6 +141,7 @@ static void test_thumbnails( libvlc_instance_t* p_vlc )
     struct test_ctx ctx;
     vlc_cond_init( &ctx.cond );
     vlc_mutex_init( &ctx.lock );
+    ctx.b_check_date = b_check_date;
 
     for ( size_t i = 0; i < sizeof(test_params) / sizeof(test_params[0]); ++i)
     {
@@ -123,10 +151,13 @@ static void test_thumbnails( libvlc_instance_t* p_vlc )
         ctx.b_done = false;
 
         if ( asprintf( &psz_mrl, "mock://video_track_count=%u;audio_track_count=%u"
-                       ";length=%" PRId64 ";video_chroma=ARGB;add_video_track_at=%" PRId64,
+                       ";length=%" PRId64 ";video_chroma=ARGB;add_video_track_at=%" PRId64
+                       ";can_seek=%d;pts_offset=%" PRId64,
                        test_params[i].i_nb_video_tracks,
                        test_params[i].i_nb_audio_tracks, MOCK_DURATION,
-                       test_params[i].i_add_video_track_at ) < 0 )
+                       test_params[i].i_add_video_track_at,
+                       test_params[i].b_can_seek,
+                       test_params[i].i_pts_offset ) < 0 )
             assert( !"Failed to allocate mock mrl" );
         input_item_t* p_item = input_item_New( psz_mrl, "mock item" );
         assert( p_item != NULL );
@@ -207,6 +238,179 @@ static void test_cancel_thumbnail( libvlc_instance_t* p_vlc )
     vlc_thumbnailer_Release( p_thumbnailer );
 }
 
+struct storyboard_ctx
+{
+    vlc_cond_t cond;
+    vlc_mutex_t lock;
+    bool b_sheet;
+    bool b_done;
+};
+
+static void thumbnailer_callback_storyboard( void* data,
+                        const vlc_thumbnailer_storyboard_t* p_storyboard )
+{
+    struct storyboard_ctx* p_ctx = data;
+    assert( p_storyboard != NULL );
+
+    /* One thumbnail every 10s of a 60s item, in media time (every mock
+     * frame is a key frame, so within a frame of each point) */
+    assert( p_storyboard->count == 6 );
+    assert( p_storyboard->length == VLC_TICK_FROM_SEC( 60 ) );
+    for ( size_t i = 0; i < p_storyboard->count; ++i )
+    {
+        vlc_tick_t i_delta = p_storyboard->times[i] - VLC_TICK_FROM_SEC( 10 ) * i;
+
+        assert( p_storyboard->thumbnails[i] != NULL );
+        assert( p_storyboard->thumbnails[i]->format.i_chroma == VLC_CODEC_ARGB );
+        assert( i_delta > -VLC_TICK_FROM_MS( 40 ) );
+        assert( i_delta < VLC_TICK_FROM_MS( 40 ) );
+    }
+
+    if ( p_ctx->b_sheet )
+    {
+        /* 640x480 pictures in 64x48 tiles, 4 per row */
+        assert( p_storyboard->sheet != NULL );
+        assert( p_storyboard->sheet->format.i_chroma == VLC_CODEC_RGBA );
+        assert( p_storyboard->columns == 4 && p_storyboard->rows == 2 );
+        assert( p_storyboard->tile_width == 64 );
+        assert( p_storyboard->tile_height == 48 );
+        assert( p_storyboard->sheet->format.i_visible_width == 256 );
+        assert( p_storyboard->sheet->format.i_visible_height == 96 );
+
+        char* psz_vtt = vlc_thumbnailer_storyboard_WebVTT( p_storyboard,
+                                                           "sheet.png" );
+        assert( psz_vtt != NULL );
+        assert( strncmp( psz_vtt, "WEBVTT\n\n00:00:00.000 --> ", 25 ) == 0 );
+        assert( strstr( psz_vtt, "\nsheet.png#xywh=0,0,64,48\n" ) != NULL );
+        assert( strstr( psz_vtt, "\nsheet.png#xywh=64,48,64,48\n" ) != NULL );
+        assert( strstr( psz_vtt, " --> 00:01:00.000\n" ) != NULL );
+        free( psz_vtt );
+    }
+    else
+    {
+        assert( p_storyboard->sheet == NULL );
+        assert( vlc_thumbnailer_storyboard_WebVTT( p_storyboard, "x" ) == NULL );
+    }
+
+    vlc_mutex_lock( &p_ctx->lock );
+    p_ctx->b_done = true;
+    vlc_mutex_unlock( &p_ctx->lock );
+    vlc_cond_signal( &p_ctx->cond );
+}
+
+static void test_storyboard( libvlc_instance_t* p_vlc )
+{
+    vlc_thumbnailer_t* p_thumbnailer = vlc_thumbnailer_Create(
+                VLC_OBJECT( p_vlc->p_libvlc_int ) );
+    assert( p_thumbnailer != NULL );
+
+    struct storyboard_ctx ctx;
+    vlc_cond_init( &ctx.cond );
+    vlc_mutex_init( &ctx.lock );
+
+    /* With and without seeking, with and without a sprite sheet, and with
+     * timestamps starting at 0 or after an hour */
+    for ( int i = 0; i < 8; ++i )
+    {
+        char* psz_mrl;
+        if ( asprintf( &psz_mrl, "mock://video_track_count=1;audio_track_count=1"
+                       ";length=%" PRId64 ";video_chroma=ARGB;can_seek=%d"
+                       ";pts_offset=%" PRId64,
+                       VLC_TICK_FROM_SEC( 60 ), i / 2 % 2,
+                       i / 4 ? VLC_TICK_FROM_SEC( 3600 ) : 0 ) < 0 )
+            assert( !"Failed to allocate mock mrl" );
+        input_item_t* p_item = input_item_New( psz_mrl, "mock item" );
+        assert( p_item != NULL );
+
+        ctx.b_sheet = i % 2;
+        ctx.b_done = false;
+
+        vlc_mutex_lock( &ctx.lock );
+        vlc_thumbnailer_request_t* p_req =
+            vlc_thumbnailer_RequestStoryboard( p_thumbnailer, p_item,
+                VLC_TICK_FROM_SEC( 10 ), 0, ctx.b_sheet ? 64 : 0, 4,
+                VLC_TICK_INVALID, thumbnailer_callback_storyboard, &ctx );
+        assert( p_req != NULL );
+        while ( ctx.b_done == false )
+        {
+            vlc_tick_t timeout = vlc_tick_now() + VLC_TICK_FROM_SEC( 5 );
+            int res = vlc_cond_timedwait( &ctx.cond, &ctx.lock, timeout );
+            assert( res != ETIMEDOUT );
+        }
+        vlc_mutex_unlock( &ctx.lock );
+
+        input_item_Release( p_item );
+        free( psz_mrl );
+    }
+    vlc_thumbnailer_Release( p_thumbnailer );
+}
+
+static void thumbnailer_callback_bench( void* data, picture_t* p_thumbnail )
+{
+    struct test_ctx* p_ctx = data;
+    assert( p_thumbnail != NULL );
+    vlc_mutex_lock( &p_ctx->lock );
+    p_ctx->test_idx++;
+    vlc_mutex_unlock( &p_ctx->lock );
+    vlc_cond_signal( &p_ctx->cond );
+}
+
+#define BENCH_CORPUS 16
+#define BENCH_ROUNDS 4
+
+/* Thumbnails a corpus of items of various lengths and track layouts, and
+ * reports the throughput. */
+static void bench_thumbnails( libvlc_instance_t* p_vlc, const char* psz_name )
+{
+    vlc_thumbnailer_t* p_thumbnailer = vlc_thumbnailer_Create(
+                VLC_OBJECT( p_vlc->p_libvlc_int ) );
+    assert( p_thumbnailer != NULL );
+
+    struct test_ctx ctx;
+    vlc_cond_init( &ctx.cond );
+    vlc_mutex_init( &ctx.lock );
+    ctx.test_idx = 0;
+
+    input_item_t* pp_items[BENCH_CORPUS];
+    for ( size_t i = 0; i < BENCH_CORPUS; ++i )
+    {
+        char* psz_mrl;
+        if ( asprintf( &psz_mrl, "mock://video_track_count=1;audio_track_count=%zu"
+                       ";length=%" PRId64 ";video_chroma=ARGB",
+                       i % 3, VLC_TICK_FROM_SEC( 30 * ( i + 1 ) ) ) < 0 )
+            assert( !"Failed to allocate mock mrl" );
+        pp_items[i] = input_item_New( psz_mrl, "mock item" );
+        assert( pp_items[i] != NULL );
+        free( psz_mrl );
+    }
+
+    const size_t i_count = BENCH_CORPUS * BENCH_ROUNDS;
+    vlc_tick_t i_start = vlc_tick_now();
+
+    for ( size_t i = 0; i < i_count; ++i )
+        vlc_thumbnailer_RequestByPos( p_thumbnailer, .1f * ( i % 9 ),
+            VLC_THUMBNAILER_SEEK_FAST, pp_items[i % BENCH_CORPUS],
+            VLC_TICK_INVALID, thumbnailer_callback_bench, &ctx );
+
+    vlc_mutex_lock( &ctx.lock );
+    while ( ctx.test_idx < i_count )
+    {
+        vlc_tick_t timeout = vlc_tick_now() + VLC_TICK_FROM_SEC( 5 );
+        int res = vlc_cond_timedwait( &ctx.cond, &ctx.lock, timeout );
+        assert( res != ETIMEDOUT );
+    }
+    vlc_mutex_unlock( &ctx.lock );
+
+    vlc_tick_t i_elapsed = vlc_tick_now() - i_start;
+    printf( "%-12s %zu thumbnails in %"PRId64" ms (%.1f/s)\n", psz_name,
+            i_count, MS_FROM_VLC_TICK( i_elapsed ),
+            i_count * (double)CLOCK_FREQ / i_elapsed );
+
+    vlc_thumbnailer_Release( p_thumbnailer );
+    for ( size_t i = 0; i < BENCH_CORPUS; ++i )
+        input_item_Release( pp_items[i] );
+}
+
 int main()
 {
     test_init();
@@ -218,8 +422,25 @@ int main()
     libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
     assert(vlc);
 
-    test_thumbnails( vlc );
+    test_thumbnails( vlc, true );
+    test_cancel_thumbnail( vlc );
+    test_storyboard( vlc );
+    bench_thumbnails( vlc, "lightweight" );
+
+    libvlc_release( vlc );
+
+    /* Same tests through a full input thread */
+    static const char * argv_input[] = {
+        "-v",
+        "--ignore-config",
+        "--no-thumbnailer-fast",
+    };
+    vlc = libvlc_new(ARRAY_SIZE(argv_input), argv_input);
+    assert(vlc);
+
+    test_thumbnails( vlc, false );
     test_cancel_thumbnail( vlc );
+    bench_thumbnails( vlc, "input" );
 
     libvlc_release( vlc );
 }
@@ -0,0 +1,164 @@
+/*****************************************************************************
+ * block.c: test shared block payloads
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#include <string.h>
+
+#define PAYLOAD_SIZE 1316
+#define BRANCHES     10
+
+static block_t *test_block(size_t size)
+{
+    block_t *block = block_Alloc(size);
+    assert(block != NULL);
+    for (size_t i = 0; i < size; i++)
+        block->p_buffer[i] = i;
+    block->i_pts = VLC_TICK_FROM_SEC(1);
+    block->i_flags = BLOCK_FLAG_TYPE_I;
+    return block;
+}
+
+static bool test_payload(const block_t *block, size_t offset)
+{
+    for (size_t i = 0; i < block->i_buffer; i++)
+        if (block->p_buffer[i] != (uint8_t)(i + offset))
+            return false;
+    return true;
+}
+
+static void test_share(void)
+{
+    block_t *block = test_block(PAYLOAD_SIZE);
+    block_t *orig = block;
+
+    assert(!block_IsShared(block));
+    assert(block_Unshare(block) == block);
+
+    block_t *ref = block_Share(&block);
+    assert(ref != NULL);
+    assert(block != orig); /* replaced with a shared block */
+    assert(block_IsShared(block) && block_IsShared(ref));
+    assert(ref->p_buffer == block->p_buffer);
+    assert(ref->i_buffer == PAYLOAD_SIZE);
+    assert(ref->i_pts == block->i_pts && ref->i_flags == block->i_flags);
+
+    /* Properties are private to each reference */
+    ref->i_pts = VLC_TICK_FROM_SEC(2);
+    ref->p_buffer += 16;
+    ref->i_buffer -= 16;
+    assert(block->i_pts == VLC_TICK_FROM_SEC(1));
+    assert(block->i_buffer == PAYLOAD_SIZE);
+
+    /* Prepending must not write over the shared payload */
+    block_t *rea = block_Realloc(ref, 4, ref->i_buffer);
+    assert(rea != NULL && !block_IsShared(rea));
+    memset(rea->p_buffer, 0xff, 4);
+    assert(test_payload(block, 0));
+    assert(rea->i_pts == VLC_TICK_FROM_SEC(2));
+    assert(rea->i_buffer == PAYLOAD_SIZE - 16 + 4);
+    assert(memcmp(rea->p_buffer + 4, block->p_buffer + 16, rea->i_buffer - 4) == 0);
+    block_Release(rea);
+
+    /* The last reference gets the original payload back */
+    assert(!block_IsShared(block));
+    block = block_Unshare(block);
+    assert(block == orig);
+    assert(test_payload(block, 0));
+    block_Release(block);
+}
+
+static void test_unshare(void)
+{
+    block_t *block = test_block(PAYLOAD_SIZE);
+    block_t *refs[BRANCHES];
+
+    for (unsigned i = 0; i < BRANCHES; i++)
+    {
+        refs[i] = block_Share(&block);
+        assert(refs[i] != NULL);
+    }
+
+    /* A writable copy does not affect the other references */
+    refs[0] = block_Unshare(refs[0]);
+    assert(refs[0] != NULL && !block_IsShared(refs[0]));
+    memset(refs[0]->p_buffer, 0, refs[0]->i_buffer);
+
+    /* Released in any order */
+    for (unsigned i = BRANCHES - 1; i > 0; i--)
+    {
+        assert(test_payload(refs[i], 0));
+        block_Release(refs[i]);
+    }
+    assert(test_payload(block, 0));
+    block_Release(block);
+    block_Release(refs[0]);
+}
+
+static vlc_tick_t fanout(bool share, size_t size, unsigned frames)
+{
+    vlc_tick_t start = vlc_tick_now();
+
+    for (unsigned n = 0; n < frames; n++)
+    {
+        block_t *block = block_Alloc(size);
+        block_t *refs[BRANCHES - 1];
+
+        assert(block != NULL);
+        memset(block->p_buffer, n, size);
+        for (unsigned i = 0; i < BRANCHES - 1; i++)
+        {
+            refs[i] = share ? block_Share(&block) : block_Duplicate(block);
+            assert(refs[i] != NULL);
+        }
+        for (unsigned i = 0; i < BRANCHES - 1; i++)
+            block_Release(refs[i]);
+        block_Release(block);
+    }
+    return vlc_tick_now() - start;
+}
+
+int main(void)
+{
+    test_init();
+
+    test_share();
+    test_unshare();
+
+    /* 10 s of a 20 Mbit/s 25 fps elementary stream */
+    const size_t size = 20000000 / 8 / 25;
+    const unsigned frames = 25 * 10;
+    uint64_t copied = (uint64_t)frames * size * (BRANCHES - 1);
+    vlc_tick_t dup = fanout(false, size, frames);
+    vlc_tick_t shared = fanout(true, size, frames);
+
+    printf("%u branches, %u frames: duplicate %"PRId64" us "
+           "(%"PRIu64" MiB copied), share %"PRId64" us (no copy)\n",
+           BRANCHES, frames, US_FROM_VLC_TICK(dup), copied >> 20,
+           US_FROM_VLC_TICK(shared));
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*****************************************************************************
+ * httpd.c: HTTP server load test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Connects many local clients to a live httpd_stream_t, and reports the
+ * aggregated throughput and the per-client delivery latency.
+ * The load can be tuned with the following environment variables:
+ *  HTTPD_TEST_CLIENTS  number of clients (default 64)
+ *  HTTPD_TEST_THREADS  value of the http-threads option (default 0)
+ *  HTTPD_TEST_SECONDS  test duration (default 2)
+ *  HTTPD_TEST_BITRATE  stream bit rate in kbit/s (default 1000)
+ *  HTTPD_TEST_PORT     listening TCP port (default 18080)
+ * Large client counts require raising the file descriptor limit.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_httpd.h>
+#include <vlc_network.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define BLOCK_SIZE     1316
+#define BLOCK_INTERVAL VLC_TICK_FROM_MS(10)
+#define SYNC_SIZE      12 /* marker and timestamp at the start of each block */
+
+static const uint8_t marker[4] = { 'V', 'L', 'C', 'H' };
+
+struct test_client
+{
+    int fd;
+    bool b_body;
+    unsigned header_match;
+
+    uint8_t sync[SYNC_SIZE];
+    unsigned sync_len;
+
+    vlc_tick_t connect_date;
+    vlc_tick_t first_byte_delay;
+    vlc_tick_t latency_sum;
+    vlc_tick_t latency_max;
+    unsigned blocks;
+    uint64_t bytes;
+};
+
+struct test_feeder
+{
+    httpd_stream_t *stream;
+    vlc_tick_t deadline;
+    unsigned bitrate;
+};
+
+static unsigned getenv_uint(const char *name, unsigned defval)
+{
+    const char *str = getenv(name);
+    return (str != NULL) ? strtoul(str, NULL, 0) : defval;
+}
+
+static void *feeder_thread(void *data)
+{
+    struct test_feeder *feeder = data;
+    vlc_tick_t date = vlc_tick_now();
+    /* blocks per interval, in thousandths */
+    uint64_t rate = (uint64_t)feeder->bitrate * 1000
+                  * MS_FROM_VLC_TICK(BLOCK_INTERVAL) / (8 * BLOCK_SIZE);
+    uint64_t credit = 0;
+
+    while (date < feeder->deadline)
+    {
+        for (credit += rate; credit >= 1000; credit -= 1000)
+        {
+            block_t *block = block_Alloc(BLOCK_SIZE);
+            assert(block != NULL);
+
+            memset(block->p_buffer, 0, BLOCK_SIZE);
+            memcpy(block->p_buffer, marker, sizeof (marker));
+            SetQWBE(block->p_buffer + sizeof (marker), vlc_tick_now());
+            httpd_StreamSend(feeder->stream, block);
+            block_Release(block);
+        }
+
+        date += BLOCK_INTERVAL;
+        vlc_tick_wait(date);
+    }
+    return NULL;
+}
+
+static void client_parse(struct test_client *cl, const uint8_t *buf,
+                         size_t len, vlc_tick_t now)
+{
+    static const char eoh[] = "\r\n\r\n";
+
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t c = buf[i];
+
+        if (!cl->b_body)
+        {   /* skip the response header */
+            cl->header_match = (c == eoh[cl->header_match])
+                             ? cl->header_match + 1 : (c == '\r');
+            if (cl->header_match == 4)
+            {
+                cl->b_body = true;
+                cl->first_byte_delay = now - cl->connect_date;
+            }
+            continue;
+        }
+
+        cl->bytes++;
+
+        if (cl->sync_len < sizeof (marker))
+        {
+            if (c == marker[cl->sync_len])
+                cl->sync[cl->sync_len++] = c;
+            else
+                cl->sync_len = (c == marker[0]);
+            continue;
+        }
+
+        cl->sync[cl->sync_len++] = c;
+        if (cl->sync_len < SYNC_SIZE)
+            continue;
+
+        vlc_tick_t latency = now - (vlc_tick_t)GetQWBE(cl->sync + 4);
+        if (latency > cl->latency_max)
+            cl->latency_max = latency;
+        cl->latency_sum += latency;
+        cl->blocks++;
+        cl->sync_len = 0;
+    }
+}
+
+static vlc_tick_t cpu_time(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+        return 0;
+    return vlc_tick_from_timeval(&ru.ru_utime)
+         + vlc_tick_from_timeval(&ru.ru_stime);
+}
+
+static int cmp_tick(const void *a, const void *b)
+{
+    vlc_tick_t x = *(const vlc_tick_t *)a, y = *(const vlc_tick_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    unsigned n_clients = getenv_uint("HTTPD_TEST_CLIENTS", 64);
+    unsigned n_threads = getenv_uint("HTTPD_TEST_THREADS", 0);
+    unsigned seconds = getenv_uint("HTTPD_TEST_SECONDS", 2);
+    unsigned port = getenv_uint("HTTPD_TEST_PORT", 18080);
+    unsigned bitrate = getenv_uint("HTTPD_TEST_BITRATE", 1000);
+    char port_arg[32], threads_arg[32];
+
+    assert(n_clients > 0);
+    if (getenv("VLC_TEST_TIMEOUT") == NULL)
+    {
+        char timeout[16];
+        snprintf(timeout, sizeof (timeout), "%u", seconds + 10);
+        setenv("VLC_TEST_TIMEOUT", timeout, 1);
+    }
+    test_init();
+
+    snprintf(port_arg, sizeof (port_arg), "--http-port=%u", port);
+    snprintf(threads_arg, sizeof (threads_arg), "--http-threads=%u",
+             n_threads);
+
+    const char *argv[] = {
+        "-v", "--http-host=127.0.0.1", port_arg, threads_arg,
+    };
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    httpd_host_t *host = vlc_http_HostNew(obj);
+    assert(host != NULL);
+    httpd_stream_t *stream = httpd_StreamNew(host, "/stream",
+                                             "application/octet-stream",
+                                             NULL, NULL);
+    assert(stream != NULL);
+
+    struct test_client *clients = calloc(n_clients, sizeof (*clients));
+    struct pollfd *ufd = calloc(n_clients, sizeof (*ufd));
+    assert(clients != NULL && ufd != NULL);
+
+    static const char request[] = "GET /stream HTTP/1.0\r\n\r\n";
+
+    for (unsigned i = 0; i < n_clients; i++)
+    {
+        struct test_client *cl = &clients[i];
+
+        cl->connect_date = vlc_tick_now();
+        cl->fd = net_ConnectTCP(obj, "127.0.0.1", port);
+        if (cl->fd == -1)
+        {
+            fprintf(stderr, "client %u: cannot connect: %s\n", i,
+                    vlc_strerror_c(errno));
+            abort();
+        }
+
+        ssize_t val = write(cl->fd, request, strlen(request));
+        assert(val == (ssize_t)strlen(request));
+        fcntl(cl->fd, F_SETFL, fcntl(cl->fd, F_GETFL) | O_NONBLOCK);
+
+        ufd[i].fd = cl->fd;
+        ufd[i].events = POLLIN;
+    }
+
+    struct test_feeder feeder = {
+        .stream = stream,
+        .deadline = vlc_tick_now() + VLC_TICK_FROM_SEC(seconds),
+        .bitrate = bitrate,
+    };
+    vlc_thread_t th;
+
+    if (vlc_clone(&th, feeder_thread, &feeder, VLC_THREAD_PRIORITY_LOW))
+        abort();
+
+    vlc_tick_t start = vlc_tick_now();
+    vlc_tick_t cpu_start = cpu_time();
+    uint8_t buf[65536];
+
+    while (vlc_tick_now() < feeder.deadline)
+    {
+        if (poll(ufd, n_clients, 100) <= 0)
+            continue;
+
+        vlc_tick_t now = vlc_tick_now();
+
+        for (unsigned i = 0; i < n_clients; i++)
+        {
+            if (ufd[i].revents == 0)
+                continue;
+
+            ssize_t len = read(ufd[i].fd, buf, sizeof (buf));
+            if (len > 0)
+                client_parse(&clients[i], buf, len, now);
+            else if (len == 0 || errno != EAGAIN)
+                ufd[i].fd = -1; /* disconnected */
+        }
+    }
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    vlc_tick_t cpu = cpu_time() - cpu_start;
+    vlc_join(th, NULL);
+
+    uint64_t total = 0;
+    vlc_tick_t latency_sum = 0;
+    vlc_tick_t first_byte_sum = 0;
+    vlc_tick_t *latency_max = malloc(n_clients * sizeof (*latency_max));
+    unsigned blocks = 0;
+    assert(latency_max != NULL);
+
+    for (unsigned i = 0; i < n_clients; i++)
+    {
+        struct test_client *cl = &clients[i];
+
+        /* every client must have received some stream data */
+        assert(cl->b_body);
+        assert(cl->blocks > 0);
+        assert(ufd[i].fd != -1);
+
+        total += cl->bytes;
+        blocks += cl->blocks;
+        latency_sum += cl->latency_sum;
+        first_byte_sum += cl->first_byte_delay;
+        latency_max[i] = cl->latency_max;
+        vlc_close(cl->fd);
+    }
+
+    qsort(latency_max, n_clients, sizeof (*latency_max), cmp_tick);
+
+    printf("clients: %u, threads: %u, bit rate: %u kbit/s, "
+           "duration: %"PRId64" ms\n", n_clients, n_threads, bitrate,
+           MS_FROM_VLC_TICK(elapsed));
+    /* includes the test clients themselves */
+    printf("CPU time: %"PRId64" ms (%.1f%% of one core)\n",
+           MS_FROM_VLC_TICK(cpu), 100. * cpu / elapsed);
+    printf("throughput: %.2f MiB/s (%"PRIu64" bytes)\n",
+           total / (1048576. * secf_from_vlc_tick(elapsed)), total);
+    printf("time to first byte: %"PRId64" us average\n",
+           US_FROM_VLC_TICK(first_byte_sum / n_clients));
+    printf("block latency: %"PRId64" us average, "
+           "worst client %"PRId64" us (median %"PRId64" us, p99 %"PRId64" us)\n",
+           US_FROM_VLC_TICK(latency_sum / blocks),
+           US_FROM_VLC_TICK(latency_max[n_clients - 1]),
+           US_FROM_VLC_TICK(latency_max[n_clients / 2]),
+           US_FROM_VLC_TICK(latency_max[(n_clients * 99) / 100]));
+
+    free(latency_max);
+    free(ufd);
+    free(clients);
+    httpd_StreamDelete(stream);
+    httpd_HostDelete(host);
+    libvlc_release(vlc);
+    return 0;
+}